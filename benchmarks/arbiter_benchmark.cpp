@@ -0,0 +1,86 @@
+#include "feed/arbiter.hpp"
+#include "feed/udpfeed.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+using nanofill::feed::ItchMessage;
+using nanofill::feed::Line;
+using nanofill::feed::Sequenced;
+
+constexpr std::uint64_t sequence_count = 10000000;
+
+struct Arrival {
+    Line line;
+    std::uint64_t sequence;
+    std::uint64_t arrival_tsc;
+};
+
+// Both lines carry every sequence number, each dropping about one in a hundred. B is usually a
+// little behind A but sometimes ahead, and each line's messages can swap with their neighbours.
+// 両方の回線が全てのシーケンス番号を運んで、それぞれ約百に一つを落とす。BはたいていAより少し遅いが、たまに
+// 先で、各回線のメッセージは隣と入れ替わることがある。
+std::vector<Arrival> make_arrivals() {
+    std::mt19937_64 random(42);
+    std::vector<Arrival> arrivals;
+    arrivals.reserve(sequence_count * 2);
+
+    for (std::uint64_t sequence = 1; sequence <= sequence_count; ++sequence) {
+        const std::uint64_t time = sequence * 100;
+
+        if (random() % 100 != 0) {
+            arrivals.push_back({ Line::A, sequence, time + random() % 150 });
+        }
+
+        if (random() % 100 != 0) {
+            arrivals.push_back({ Line::B, sequence, time + 50 + random() % 150 });
+        }
+    }
+
+    std::sort(arrivals.begin(), arrivals.end(), [](const Arrival& a, const Arrival& b) {
+        return a.arrival_tsc < b.arrival_tsc;
+    });
+
+    return arrivals;
+}
+
+int main() {
+    const auto arrivals = make_arrivals();
+    // Every copy carries the same add order message, copied in as the line receiver would.
+    // 全てのコピーが同じ追加注文メッセージを運び、回線の受信と同じようにコピーされる。
+    std::vector<std::uint8_t> add;
+    nanofill::fileio::itch::append_add_order(add, 34200000000000ULL, 1, true, 100, 3000);
+    ItchMessage message { .length = static_cast<std::uint16_t>(add.size() - 2), .bytes = {} };
+    std::copy(add.begin() + 2, add.end(), message.bytes.begin());
+
+    auto arbiter = std::make_unique<nanofill::feed::FeedArbiter<ItchMessage>>();
+    std::uint64_t checksum = 0;
+    const auto release = [&](const ItchMessage& released) {
+        checksum += released.length;
+    };
+
+    auto clock_start = std::chrono::steady_clock::now();
+
+    for (const Arrival& arrival : arrivals) {
+        arbiter->on_message(arrival.line, Sequenced<ItchMessage> { arrival.sequence, arrival.arrival_tsc, message }, release);
+    }
+
+    arbiter->flush(release);
+    auto clock_end = std::chrono::steady_clock::now();
+    const double nanoseconds = std::chrono::duration<double, std::nano>(clock_end - clock_start).count();
+    const auto& stats = arbiter->get_stats();
+    const auto& a = arbiter->get_line_stats(Line::A);
+    const auto& b = arbiter->get_line_stats(Line::B);
+
+    std::cout << "===== A/B feed arbitration (" << arrivals.size() << " copies of " << sequence_count << " messages) =====" << std::endl
+        << "Per copy: " << nanoseconds / arrivals.size() << "ns" << std::endl
+        << "Per released message: " << nanoseconds / stats.released << "ns" << std::endl
+        << "Released: " << stats.released << ", missing on both lines: " << stats.missing
+        << ", out of order: " << stats.out_of_order << " (checksum " << checksum << ")" << std::endl
+        << "A first: " << a.first << ", B first: " << b.first << std::endl;
+
+    return 0;
+}
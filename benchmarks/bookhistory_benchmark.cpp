@@ -0,0 +1,106 @@
+#include "storage/bookhistory.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using nanofill::events::Event;
+using nanofill::events::EventType;
+using nanofill::storage::BookHistory;
+using nanofill::storage::CompressedEventStore;
+using nanofill::storage::HistoricalBook;
+
+constexpr std::uint32_t event_count = 2000000;
+constexpr std::uint32_t query_count = 20000;
+
+// A day of orders around a moving price, with a few thousand resting at any time and most of the
+// rest cancelled soon after they're placed. Times are in seconds like LOBSTER's.
+// 動く価格の周りの一日分の注文で、いつも数千個置いてあって、残りのほとんどは出した後すぐキャンセルされる。
+// 時はLOBSTERのように秒単位だ。
+std::vector<Event> make_events() {
+    std::mt19937 random(42);
+    std::vector<Event> events;
+    std::vector<Event> resting;
+    std::uint32_t price = 1500000;
+    std::uint32_t time = 34200;
+    events.reserve(event_count);
+
+    for (std::uint32_t i = 0; events.size() < event_count; ++i) {
+        price += (static_cast<int>(random() % 5) - 2) * 100;
+        time += i % 50 == 0;
+
+        const int side = random() % 2 == 0 ? 1 : -1;
+        Event submission {
+            .price = price - side * static_cast<std::uint32_t>(random() % 50 + 1) * 100,
+            .time = time,
+            .order_id = 5000000 + i,
+            .size = static_cast<std::int16_t>(side * static_cast<int>(random() % 10 + 1) * 100),
+            .type = EventType::Submission,
+            .symbol_id = 0
+        };
+
+        events.push_back(submission);
+        resting.push_back(submission);
+
+        if (resting.size() > 5000) {
+            std::swap(resting[resting.size() - 1 - random() % (random() % 10 == 0 ? resting.size() : 20)], resting.back());
+            Event removal = resting.back();
+            resting.pop_back();
+            removal.time = time;
+            removal.type = random() % 10 == 0 ? EventType::ExecutionVisible : EventType::Deletion;
+            events.push_back(removal);
+        }
+    }
+
+    return events;
+}
+
+template<typename Query>
+double query_rate(Query&& query) {
+    std::mt19937 random(7);
+    HistoricalBook book;
+    std::uint64_t checksum = 0;
+    auto clock_start = std::chrono::steady_clock::now();
+
+    for (std::uint32_t i = 0; i < query_count; ++i) {
+        query(random, book);
+        checksum += book.get_best_bid();
+    }
+
+    auto clock_end = std::chrono::steady_clock::now();
+
+    if (checksum == 0) {
+        std::cout << "checksum: " << checksum << std::endl;
+    }
+
+    return query_count / std::chrono::duration<double>(clock_end - clock_start).count();
+}
+
+int main() {
+    const auto events = make_events();
+    const CompressedEventStore store(events);
+    const std::uint32_t first_time = events.front().time;
+    const std::uint32_t last_time = events.back().time;
+
+    std::cout << "===== Book history (" << events.size() << " events) =====" << std::endl;
+
+    for (const std::size_t interval : { 256, 1024, 4096 }) {
+        auto clock_start = std::chrono::steady_clock::now();
+        const BookHistory history(store, interval);
+        auto clock_end = std::chrono::steady_clock::now();
+
+        std::cout << "Every " << interval << " events: "
+            << history.get_checkpoint_count() << " checkpoints, "
+            << history.checkpoint_bytes() / 1e6 << " MB, built in "
+            << std::chrono::duration<double>(clock_end - clock_start).count() << " seconds" << std::endl
+            << "  By time: " << query_rate([&](std::mt19937& random, HistoricalBook& book) {
+                   history.at_time(first_time + random() % (last_time - first_time + 1), book);
+               }) << " queries per second" << std::endl
+            << "  By event: " << query_rate([&](std::mt19937& random, HistoricalBook& book) {
+                   history.at_event(random() % (events.size() + 1), book);
+               }) << " queries per second" << std::endl;
+    }
+
+    return 0;
+}
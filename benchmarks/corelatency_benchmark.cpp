@@ -0,0 +1,385 @@
+#include "concurrency/spscringbuffer.hpp"
+#include "events/event.hpp"
+#include "stats/tsc.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+
+// Where to pin the producer and consumer: for every ordered pair of CPUs, how long one message
+// takes to cross an SPSCRingBuffer, how long a round trip through two of them takes, and how many
+// events a second get through one at a few consumer batch sizes. Prints each as a matrix (producer
+// CPUs down the side, consumer CPUs along the top) and writes everything to JSON.
+// Usage: corelatency_benchmark [JSON file] [CPUs, e.g. 0,2,4]
+// 生産者と消費者をどこに固定するか。CPUの順序付きの全ての組について、一つのメッセージがSPSCRingBufferを
+// 渡るのにかかる時間、二つを通る往復にかかる時間と、いくつかの消費者のバッチサイズで一つを毎秒いくつのイベント
+// が通るか。それぞれを行列（横に生産者のCPU、上に消費者のCPU）として出力して、全部をJSONに書く。
+// 使い方：corelatency_benchmark [JSONのファイル] [CPU、例えば0,2,4]
+
+using nanofill::concurrency::SPSCRingBuffer;
+using nanofill::events::Event;
+using nanofill::events::EventType;
+
+constexpr std::size_t ring_size = 1024;
+constexpr unsigned int warm_up_messages = 1000;
+constexpr unsigned int latency_samples = 20000;
+constexpr unsigned int throughput_messages = 2000000;
+constexpr std::array<unsigned int, 4> batch_sizes = { 1, 16, 64, 256 };
+
+struct Message {
+    std::uint64_t sent_tsc;
+    std::uint64_t sequence;
+};
+
+using MessageRing = SPSCRingBuffer<Message, ring_size>;
+using EventRing = SPSCRingBuffer<Event, ring_size>;
+
+struct Percentiles {
+    double p50 = 0;
+    double p99 = 0;
+};
+
+struct PairResult {
+    unsigned int producer;
+    unsigned int consumer;
+    Percentiles one_way;
+    Percentiles round_trip;
+    // Events per second, one per batch size.
+    // バッチサイズごとの毎秒のイベント数。
+    std::array<double, batch_sizes.size()> throughput{};
+};
+
+void pin_to(const unsigned int cpu) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+}
+
+// Every CPU this process may run on.
+// このプロセスが動ける全てのCPU。
+std::vector<unsigned int> allowed_cpus() {
+    cpu_set_t cpus;
+    std::vector<unsigned int> result;
+
+    if (sched_getaffinity(0, sizeof(cpus), &cpus) == 0) {
+        for (unsigned int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &cpus)) {
+                result.push_back(cpu);
+            }
+        }
+    }
+
+    return result;
+}
+
+std::vector<unsigned int> parse_cpus(std::string_view list) {
+    std::vector<unsigned int> result;
+
+    while (!list.empty()) {
+        const std::size_t comma = list.find(',');
+        result.push_back(std::stoul(std::string(list.substr(0, comma))));
+        list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+    }
+
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+
+    return result;
+}
+
+// Run producer on one CPU and consumer on another, starting them together.
+// producerを一つのCPUで、consumerを別のCPUで、同時に始めて走らせる。
+template<typename Producer, typename Consumer>
+void run_pair(const unsigned int producer_cpu, const unsigned int consumer_cpu, Producer&& producer, Consumer&& consumer) {
+    std::atomic<int> ready{0};
+    const auto start = [&ready](const unsigned int cpu) {
+        pin_to(cpu);
+        ready.fetch_add(1, std::memory_order_acq_rel);
+
+        while (ready.load(std::memory_order_acquire) < 2) {}
+    };
+
+    std::thread consumer_thread([&] {
+        start(consumer_cpu);
+        consumer();
+    });
+
+    start(producer_cpu);
+    producer();
+    consumer_thread.join();
+}
+
+Percentiles percentiles(std::vector<std::uint64_t>& ticks, const double nanoseconds_per_tick) {
+    std::sort(ticks.begin(), ticks.end());
+
+    return {
+        .p50 = ticks[ticks.size() / 2] * nanoseconds_per_tick,
+        .p99 = ticks[ticks.size() * 99 / 100] * nanoseconds_per_tick
+    };
+}
+
+// The producer sends one message at a time, spaced out so the ring is always empty when it
+// arrives, and the consumer compares its own TSC to the one in the message. This relies on the
+// TSC being the same on every core, which it is on anything with an invariant TSC.
+// 生産者は一度に一つのメッセージを、届くときにリングがいつも空なように間隔を空けて送って、消費者は自分の
+// TSCとメッセージの中のものを比べる。これは全てのコアでTSCが同じであることに頼っていて、不変のTSCがある
+// ものなら全部そうだ。
+Percentiles measure_one_way(const unsigned int producer_cpu, const unsigned int consumer_cpu, const double nanoseconds_per_tick) {
+    auto ring = std::make_unique<MessageRing>();
+    std::vector<std::uint64_t> ticks(latency_samples);
+    const std::uint64_t spacing = static_cast<std::uint64_t>(2000 / nanoseconds_per_tick);
+
+    run_pair(producer_cpu, consumer_cpu, [&] {
+        std::uint64_t next = nanofill::stats::read_tsc();
+
+        for (std::uint64_t i = 0; i < warm_up_messages + latency_samples; ++i) {
+            while (nanofill::stats::read_tsc() < next) {}
+
+            while (!ring->push({ .sent_tsc = nanofill::stats::read_tsc(), .sequence = i })) {}
+
+            next = nanofill::stats::read_tsc() + spacing;
+        }
+    }, [&] {
+        Message message;
+
+        for (unsigned int i = 0; i < warm_up_messages + latency_samples; ++i) {
+            while (!ring->pop(message)) {}
+
+            const std::uint64_t now = nanofill::stats::read_tsc();
+
+            if (i >= warm_up_messages) {
+                ticks[i - warm_up_messages] = now > message.sent_tsc ? now - message.sent_tsc : 0;
+            }
+        }
+    });
+
+    return percentiles(ticks, nanoseconds_per_tick);
+}
+
+// The producer sends a message and waits for the consumer to send it back on a second ring.
+// 生産者はメッセージを送って、消費者が二つ目のリングで送り返すのを待つ。
+Percentiles measure_round_trip(const unsigned int producer_cpu, const unsigned int consumer_cpu, const double nanoseconds_per_tick) {
+    auto there = std::make_unique<MessageRing>();
+    auto back = std::make_unique<MessageRing>();
+    std::vector<std::uint64_t> ticks(latency_samples);
+
+    run_pair(producer_cpu, consumer_cpu, [&] {
+        Message message;
+
+        for (std::uint64_t i = 0; i < warm_up_messages + latency_samples; ++i) {
+            const std::uint64_t sent = nanofill::stats::read_tsc();
+
+            while (!there->push({ .sent_tsc = sent, .sequence = i })) {}
+            while (!back->pop(message)) {}
+
+            if (i >= warm_up_messages) {
+                ticks[i - warm_up_messages] = nanofill::stats::read_tsc() - sent;
+            }
+        }
+    }, [&] {
+        Message message;
+
+        for (unsigned int i = 0; i < warm_up_messages + latency_samples; ++i) {
+            while (!there->pop(message)) {}
+            while (!back->push(message)) {}
+        }
+    });
+
+    return percentiles(ticks, nanoseconds_per_tick);
+}
+
+// The producer pushes events as fast as the ring takes them and the consumer takes up to
+// batch_size at a time with pop_many, the way the engine's consumer does. Returns events per
+// second, timed on the consumer.
+// 生産者はリングが受け取る速さでイベントを入れて、消費者はエンジンの消費者のようにpop_manyで一度に
+// batch_size個まで取る。消費者で測った毎秒のイベント数を返す。
+double measure_throughput(const unsigned int producer_cpu, const unsigned int consumer_cpu, const unsigned int batch_size) {
+    auto ring = std::make_unique<EventRing>();
+    double seconds = 0;
+    bool in_order = true;
+
+    run_pair(producer_cpu, consumer_cpu, [&] {
+        for (std::uint32_t i = 0; i < throughput_messages; ++i) {
+            while (!ring->push({ .price = 3000000, .time = 34200, .order_id = i, .size = 100, .type = EventType::Submission, .symbol_id = 0 })) {}
+        }
+    }, [&] {
+        std::array<Event, batch_sizes.back()> batch;
+        std::uint32_t expected = 0;
+        auto clock_start = std::chrono::steady_clock::now();
+
+        while (expected < throughput_messages) {
+            const unsigned int found = ring->pop_many(batch.data(), batch_size);
+
+            for (unsigned int i = 0; i < found; ++i) {
+                in_order &= batch[i].order_id == expected++;
+            }
+        }
+
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - clock_start).count();
+    });
+
+    if (!in_order) {
+        std::cerr << "Events arrived out of order between CPUs " << producer_cpu << " and " << consumer_cpu << std::endl;
+    }
+
+    return throughput_messages / seconds;
+}
+
+// One matrix, with each cell shaded from light to dark across the range of values in it.
+// 一つの行列。各セルは中の値の範囲で明るいから暗いまで陰を付ける。
+template<typename Value>
+void print_matrix(
+    const std::string& title,
+    const std::vector<unsigned int>& cpus,
+    const std::vector<PairResult>& results,
+    Value&& value
+) {
+    static constexpr std::array<const char*, 5> shades = { " ", "░", "▒", "▓", "█" };
+
+    double lowest = 0;
+    double highest = 0;
+
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const double current = value(results[i]);
+        lowest = i == 0 ? current : std::min(lowest, current);
+        highest = i == 0 ? current : std::max(highest, current);
+    }
+
+    std::cout << std::endl << "===== " << title << " =====" << std::endl << std::setw(6) << "";
+
+    for (const unsigned int consumer : cpus) {
+        std::cout << std::setw(9) << consumer;
+    }
+
+    std::cout << std::endl;
+
+    for (const unsigned int producer : cpus) {
+        std::cout << std::setw(6) << producer;
+
+        for (const unsigned int consumer : cpus) {
+            const auto result = std::find_if(results.begin(), results.end(), [&](const PairResult& pair) {
+                return pair.producer == producer && pair.consumer == consumer;
+            });
+
+            if (result == results.end()) {
+                std::cout << std::setw(9) << "-";
+                continue;
+            }
+
+            const double current = value(*result);
+            const std::size_t shade = highest == lowest ? 0 : static_cast<std::size_t>((current - lowest) / (highest - lowest) * (shades.size() - 1) + 0.5);
+
+            std::cout << std::setw(8) << std::fixed << std::setprecision(current < 100 ? 1 : 0) << current << shades[shade];
+        }
+
+        std::cout << std::endl;
+    }
+
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+void write_json(std::ostream& out, const std::vector<unsigned int>& cpus, const std::vector<PairResult>& results) {
+    out << "{\"ring_size\":" << ring_size << ",\"latency_samples\":" << latency_samples
+        << ",\"throughput_messages\":" << throughput_messages << ",\"cpus\":[";
+
+    for (std::size_t i = 0; i < cpus.size(); ++i) {
+        out << (i == 0 ? "" : ",") << cpus[i];
+    }
+
+    out << "],\"batch_sizes\":[";
+
+    for (std::size_t i = 0; i < batch_sizes.size(); ++i) {
+        out << (i == 0 ? "" : ",") << batch_sizes[i];
+    }
+
+    out << "],\"pairs\":[";
+
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const PairResult& result = results[i];
+
+        out << (i == 0 ? "\n" : ",\n")
+            << "{\"producer\":" << result.producer << ",\"consumer\":" << result.consumer
+            << ",\"one_way_ns\":{\"p50\":" << result.one_way.p50 << ",\"p99\":" << result.one_way.p99 << "}"
+            << ",\"round_trip_ns\":{\"p50\":" << result.round_trip.p50 << ",\"p99\":" << result.round_trip.p99 << "}"
+            << ",\"events_per_second\":[";
+
+        for (std::size_t j = 0; j < batch_sizes.size(); ++j) {
+            out << (j == 0 ? "" : ",") << result.throughput[j];
+        }
+
+        out << "]}";
+    }
+
+    out << "\n]}" << std::endl;
+}
+
+int main(const int argc, char** argv) {
+    const std::string json_path = argc > 1 ? argv[1] : "core_latency.json";
+    const std::vector<unsigned int> cpus = argc > 2 ? parse_cpus(argv[2]) : allowed_cpus();
+    const double nanoseconds_per_tick = 1 / nanofill::stats::tsc_ticks_per_nanosecond();
+    std::vector<PairResult> results;
+
+    std::cout << "===== Core to core (" << cpus.size() << " CPUs, " << cpus.size() * (cpus.size() - 1) << " pairs) =====" << std::endl;
+
+    for (const unsigned int producer : cpus) {
+        for (const unsigned int consumer : cpus) {
+            if (producer == consumer) {
+                continue;
+            }
+
+            PairResult result {
+                .producer = producer,
+                .consumer = consumer,
+                .one_way = measure_one_way(producer, consumer, nanoseconds_per_tick),
+                .round_trip = measure_round_trip(producer, consumer, nanoseconds_per_tick)
+            };
+
+            for (std::size_t i = 0; i < batch_sizes.size(); ++i) {
+                result.throughput[i] = measure_throughput(producer, consumer, batch_sizes[i]);
+            }
+
+            std::cout << producer << " -> " << consumer << ": one way " << result.one_way.p50 << "ns, round trip "
+                << result.round_trip.p50 << "ns, " << result.throughput.back() / 1e6 << " million events per second" << std::endl;
+
+            results.push_back(result);
+        }
+    }
+
+    if (results.empty()) {
+        std::cout << "Need at least two CPUs to measure anything" << std::endl;
+    } else {
+        print_matrix("One way p50 (ns)", cpus, results, [](const PairResult& result) { return result.one_way.p50; });
+        print_matrix("Round trip p50 (ns)", cpus, results, [](const PairResult& result) { return result.round_trip.p50; });
+
+        for (std::size_t i = 0; i < batch_sizes.size(); ++i) {
+            print_matrix("Million events per second, batches of " + std::to_string(batch_sizes[i]), cpus, results, [i](const PairResult& result) {
+                return result.throughput[i] / 1e6;
+            });
+        }
+    }
+
+    std::ofstream file(json_path);
+
+    if (!file) {
+        std::cerr << "Could not open file " << json_path << std::endl;
+
+        return 1;
+    }
+
+    write_json(file, cpus, results);
+    std::cout << std::endl << "Wrote " << json_path << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include "storage/eventstore.hpp"
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using nanofill::events::Event;
+using nanofill::events::EventType;
+using nanofill::storage::CompressedEventStore;
+
+constexpr std::uint32_t event_count = 10000000;
+
+// Submissions around a price that moves by a tick or two, each later cancelled, deleted or
+// executed, with times in seconds like LOBSTER's.
+// 1、2ティック動く価格の周りの注文の出しで、それぞれ後でキャンセル、削除か約定される。時はLOBSTERのように
+// 秒単位だ。
+std::vector<Event> make_events() {
+    std::mt19937 random(42);
+    std::vector<Event> events;
+    std::vector<Event> resting;
+    std::uint32_t price = 1500000;
+    std::uint32_t time = 34200;
+    events.reserve(event_count);
+
+    for (std::uint32_t i = 0; events.size() < event_count; ++i) {
+        price += (static_cast<int>(random() % 5) - 2) * 100;
+        time += i % 2000 == 0;
+
+        const int side = random() % 2 == 0 ? 1 : -1;
+        Event submission {
+            .price = price + side * static_cast<std::uint32_t>(random() % 10) * 100,
+            .time = time,
+            .order_id = 5000000 + i * 3 + static_cast<std::uint32_t>(random() % 3),
+            .size = static_cast<std::int16_t>(-side * static_cast<int>(random() % 10 + 1) * 100),
+            .type = EventType::Submission,
+            .symbol_id = 0
+        };
+
+        events.push_back(submission);
+        resting.push_back(submission);
+
+        if (resting.size() > 100) {
+            // Most orders are cancelled soon after they're placed.
+            // ほとんどの注文は出した後すぐキャンセルされる。
+            std::swap(resting[resting.size() - 1 - random() % 20], resting.back());
+            Event removal = resting.back();
+            resting.pop_back();
+            removal.time = time;
+            removal.type = random() % 10 == 0 ? EventType::ExecutionVisible : EventType::Deletion;
+            events.push_back(removal);
+        }
+    }
+
+    return events;
+}
+
+template<typename Decode>
+double decode_rate(const CompressedEventStore& store, Decode&& decode) {
+    alignas(32) std::array<Event, CompressedEventStore::block_size> decoded;
+    std::uint64_t checksum = 0;
+    auto clock_start = std::chrono::steady_clock::now();
+
+    for (int repeat = 0; repeat < 5; ++repeat) {
+        for (std::size_t block = 0; block < store.block_count(); ++block) {
+            const std::size_t count = decode(block, decoded.data());
+            checksum += decoded[count - 1].order_id;
+        }
+    }
+
+    auto clock_end = std::chrono::steady_clock::now();
+
+    if (checksum == 0) {
+        std::cout << "checksum: " << checksum << std::endl;
+    }
+
+    return 5 * store.size() / std::chrono::duration<double>(clock_end - clock_start).count() / 1e6;
+}
+
+int main() {
+    const auto events = make_events();
+
+    auto clock_start = std::chrono::steady_clock::now();
+    const CompressedEventStore store(events);
+    auto clock_end = std::chrono::steady_clock::now();
+
+    std::cout << "===== Compressed event store (" << events.size() << " events) =====" << std::endl
+        << "Plain: " << events.size() * sizeof(Event) / 1e6 << " MB" << std::endl
+        << "Compressed: " << store.compressed_bytes() / 1e6 << " MB ("
+        << store.compression_ratio() << "x, " << store.compressed_bytes() * 8.0 / store.size() << " bits per event)" << std::endl
+        << "Encode: " << events.size() / std::chrono::duration<double>(clock_end - clock_start).count() / 1e6
+        << " million events per second" << std::endl
+        << "Decode (SIMD): " << decode_rate(store, [&](std::size_t block, Event* out) { return store.decode_block(block, out); })
+        << " million events per second" << std::endl
+        << "Decode (scalar): " << decode_rate(store, [&](std::size_t block, Event* out) { return store.decode_block_scalar(block, out); })
+        << " million events per second" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include "tradingengine/bookfeatures.hpp"
+#include "tradingengine/tradingengine.hpp"
+#include "orderbook/orderbook.hpp"
+#include "stats/latencyhistogram.hpp"
+#include "stats/tsc.hpp"
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+using nanofill::events::Event;
+using nanofill::events::EventType;
+using nanofill::orderbook::OrderBook;
+
+constexpr std::uint32_t event_count = 2000000;
+
+// Submissions either side of a drifting mid price, most of them close to it, with resting orders
+// deleted or executed at random once there are enough of them.
+// 動く仲値の両側への注文の出し。ほとんどは仲値の近く。十分溜まったら、残っている注文をランダムに削除するか
+// 約定させる。
+std::vector<Event> make_events() {
+    std::mt19937 random(42);
+    std::geometric_distribution<int> distance(0.1);
+    std::uniform_int_distribution<int> size(1, 500);
+    std::vector<Event> events;
+    std::vector<Event> resting;
+    std::uint32_t mid_price = 300000;
+    events.reserve(event_count);
+
+    for (std::uint32_t i = 0; events.size() < event_count; ++i) {
+        mid_price += static_cast<int>(random() % 3) - 1;
+
+        const bool buy = random() % 2 == 0;
+        Event submission {
+            .price = buy ? mid_price - 1 - distance(random) : mid_price + 1 + distance(random),
+            .time = i,
+            .order_id = i,
+            .size = static_cast<std::int16_t>(buy ? size(random) : -size(random)),
+            .type = EventType::Submission,
+            .symbol_id = 0
+        };
+
+        events.push_back(submission);
+        resting.push_back(submission);
+
+        if (resting.size() > 2000) {
+            std::swap(resting[random() % resting.size()], resting.back());
+            Event removal = resting.back();
+            resting.pop_back();
+            removal.time = i;
+            removal.type = random() % 4 == 0 ? EventType::ExecutionVisible : EventType::Deletion;
+            events.push_back(removal);
+        }
+    }
+
+    return events;
+}
+
+// Time the engine's global average against the top-of-book features, each on top of the same book
+// updates, so the difference is what the strategy itself costs per event.
+// 同じ板の更新の上で、エンジンの全体の平均と板の上位の特徴量を測るので、差は戦略自体のイベントごとのコストだ。
+template<typename Strategy>
+void run(const char* name, const std::vector<Event>& events, Strategy& strategy) {
+    auto order_book = std::make_unique<OrderBook>();
+    nanofill::stats::LatencyHistogram latency;
+    const double nanoseconds_per_tick = 1 / nanofill::stats::tsc_ticks_per_nanosecond();
+
+    const auto clock_start = std::chrono::steady_clock::now();
+
+    for (const Event& event : events) {
+        if (order_book->process_event(event)) {
+            const std::uint64_t start = nanofill::stats::read_tsc();
+            strategy.on_event(event, *order_book);
+            latency.record(static_cast<std::uint32_t>((nanofill::stats::read_tsc() - start) * nanoseconds_per_tick));
+        }
+    }
+
+    const auto clock_end = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(clock_end - clock_start).count();
+
+    std::cout << std::endl << "===== " << name << " (" << events.size() / seconds / 1e6 << " million events per second with the book) =====" << std::endl;
+    nanofill::stats::print_latency_percentiles(std::cout, latency);
+}
+
+int main() {
+    const auto events = make_events();
+    nanofill::tradingengine::TradingEngine trading_engine(10000);
+    nanofill::tradingengine::BookFeatures<8> features_8;
+    nanofill::tradingengine::BookFeatures<16> features_16;
+
+    run("Average price (TradingEngine)", events, trading_engine);
+    run("Book features, 8 levels", events, features_8);
+    run("Book features, 16 levels", events, features_16);
+
+    const auto& values = features_8.get();
+    std::cout << std::endl << "Final features: imbalance " << values.imbalance << ", microprice " << values.microprice
+        << ", weighted mid " << values.weighted_mid << ", order flow imbalance " << values.order_flow_imbalance << std::endl;
+
+    return 0;
+}
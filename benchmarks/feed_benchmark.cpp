@@ -0,0 +1,100 @@
+#include "feed/udpfeed.hpp"
+#include "threads/threads.hpp"
+#include "memory/hugepages.hpp"
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using nanofill::events::Event;
+using nanofill::concurrency::SPSCRingBuffer;
+namespace itch = nanofill::fileio::itch;
+
+constexpr std::uint64_t message_count = 2000000;
+
+// Adds, with each order deleted, cancelled or executed a little later, around one price.
+// 追加と、少し後でそれぞれの注文の削除、取消か約定。一つの価格の周り。
+std::vector<std::uint8_t> make_feed() {
+    std::mt19937_64 random(42);
+    std::vector<std::uint8_t> data;
+    std::uint64_t timestamp = 34200ULL * 1000000000;
+    data.reserve(message_count * 34);
+
+    for (std::uint64_t reference = 1; reference <= message_count / 2; ++reference) {
+        const bool buy = random() % 2 == 0;
+        timestamp += random() % 10000;
+        itch::append_add_order(data, timestamp, reference, buy, (random() % 10 + 1) * 100,
+            300000 + (buy ? -1 : 1) * static_cast<std::uint32_t>(random() % 20 + 1) * 100);
+
+        if (reference > 500) {
+            const auto kind = random() % 4;
+
+            if (kind < 2) {
+                itch::append_order_delete(data, timestamp, reference - 500);
+            } else if (kind < 3) {
+                itch::append_order_cancel(data, timestamp, reference - 500, 100000);
+            } else {
+                itch::append_order_executed(data, timestamp, reference - 500, 100000);
+            }
+        }
+    }
+
+    return data;
+}
+
+// Sends a generated feed over loopback and runs it through the whole receive path: recvmmsg, the
+// decoder, the event buffer and the consumer. Usage: feed_benchmark [messages per second, 0 = max]
+// 生成したフィードをループバックで送って、受信の経路全体を通す：recvmmsg、デコーダー、イベントバッファと
+// 消費者。使い方：feed_benchmark [毎秒のメッセージ数、0 = 最大]
+int main(int argc, char** argv) {
+    const double messages_per_second = argc > 1 ? std::stod(argv[1]) : 1000000;
+    const auto data = make_feed();
+
+    nanofill::orderbook::OrderBook order_book;
+    nanofill::tradingengine::TradingEngine trading_engine(10000);
+    nanofill::stats::LatencyHistogram latency;
+    std::atomic<bool> finished{false};
+    nanofill::feed::UdpReceiver receiver("127.0.0.1:0");
+    nanofill::feed::FeedHandler handler;
+    auto buffer = nanofill::memory::make_huge_page_unique<SPSCRingBuffer<Event, 1024>>();
+    nanofill::feed::SenderStats sent;
+
+    std::thread consumer_thread(
+        nanofill::threads::stream_consumer<1024>,
+        std::ref(*buffer), std::ref(order_book),
+        std::ref(trading_engine),
+        std::ref(latency),
+        std::cref(finished),
+        nanofill::threads::ConsumerHooks{}
+    );
+    std::thread sender_thread([&] {
+        sent = nanofill::feed::send_itch_feed(data, "127.0.0.1:" + std::to_string(receiver.get_port()),
+            { .messages_per_second = messages_per_second });
+    });
+
+    const auto clock_start = std::chrono::steady_clock::now();
+    nanofill::threads::feed_producer(receiver, handler, *buffer, finished, std::chrono::milliseconds(200));
+    consumer_thread.join();
+    const auto clock_end = std::chrono::steady_clock::now();
+    sender_thread.join();
+
+    const double seconds = std::chrono::duration<double>(clock_end - clock_start).count();
+    const auto& stats = handler.get_stats();
+
+    std::cout << "===== UDP feed over loopback (" << message_count << " messages, target "
+        << (messages_per_second > 0 ? std::to_string(messages_per_second / 1e6) + " million/s" : "max") << ") =====" << std::endl
+        << "Busy polling: " << (receiver.is_busy_polling() ? "on" : "off") << std::endl
+        << "Sent: " << sent.messages << " messages in " << sent.packets << " packets, "
+        << sent.messages / sent.seconds / 1e6 << " million per second" << std::endl
+        << "Received: " << stats.messages << " messages in " << stats.packets << " packets, "
+        << stats.messages / seconds / 1e6 << " million per second" << std::endl
+        << "Gaps: " << stats.gaps << " (" << stats.missing_messages << " messages missing)" << std::endl
+        << "Unknown orders after gaps: " << handler.get_decoder().get_unknown_orders() << std::endl
+        << std::endl << "===== Per-event consumer latency =====" << std::endl;
+
+    nanofill::stats::print_latency_percentiles(std::cout, latency);
+
+    return 0;
+}
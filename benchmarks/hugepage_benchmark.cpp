@@ -0,0 +1,100 @@
+#include "orderbook/orderbook.hpp"
+#include "memory/hugepages.hpp"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using nanofill::events::Event;
+using nanofill::events::EventType;
+using nanofill::orderbook::OrderBook;
+
+constexpr std::size_t event_count = 2000000;
+
+// Open a counter for data TLB load misses in this thread. Returns -1 if we aren't allowed to
+// (see /proc/sys/kernel/perf_event_paranoid).
+// このスレッドのデータTLBのロードミスのカウンタを開く。許可されていなかったら、-1を返す
+// （/proc/sys/kernel/perf_event_paranoidを参照）。
+int open_dtlb_miss_counter() {
+    perf_event_attr attributes;
+    std::memset(&attributes, 0, sizeof(attributes));
+    attributes.type = PERF_TYPE_HW_CACHE;
+    attributes.size = sizeof(attributes);
+    attributes.config = PERF_COUNT_HW_CACHE_DTLB
+        | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+
+    return syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+}
+
+// Events that land on random prices across the whole book, so most of them touch a different
+// page to the last one.
+// 板全体のランダムな価格に当たるイベント。ほとんどのイベントが前回と違うページを触る。
+std::vector<Event> make_events() {
+    std::mt19937 random(42);
+    std::uniform_int_distribution<std::uint32_t> price(1, nanofill::orderbook::order_book_size - 1);
+    std::vector<Event> events;
+    events.reserve(event_count);
+
+    for (std::uint32_t i = 0; i < event_count / 2; ++i) {
+        events.push_back({ .price = price(random), .time = i, .order_id = i, .size = 100, .type = EventType::Submission });
+    }
+
+    for (std::uint32_t i = 0; i < event_count / 2; ++i) {
+        events.push_back({ .price = events[i].price, .time = i, .order_id = i, .size = 100, .type = EventType::Deletion });
+    }
+
+    return events;
+}
+
+void run(const std::vector<Event>& events, const bool huge_pages) {
+    nanofill::memory::set_huge_pages_enabled(huge_pages);
+
+    OrderBook order_book;
+    const int counter = open_dtlb_miss_counter();
+
+    ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+    ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+    auto clock_start = std::chrono::steady_clock::now();
+
+    for (const Event& event : events) {
+        order_book.process_event(event);
+    }
+
+    auto clock_end = std::chrono::steady_clock::now();
+    ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+
+    std::uint64_t misses = 0;
+    const bool counted = counter != -1 && read(counter, &misses, sizeof(misses)) == sizeof(misses);
+
+    std::cout << (huge_pages ? "With huge pages: " : "Without huge pages: ")
+        << std::chrono::duration<double, std::nano>(clock_end - clock_start).count() / events.size() << "ns per event, ";
+
+    if (counted) {
+        std::cout << misses << " dTLB load misses" << std::endl;
+    } else {
+        std::cout << "dTLB load misses unavailable" << std::endl;
+    }
+
+    if (counter != -1) {
+        close(counter);
+    }
+}
+
+int main() {
+    auto events = make_events();
+
+    std::cout << "===== Huge page order book benchmark =====" << std::endl;
+    run(events, false);
+    run(events, true);
+
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include "fileio/itchdecoder.hpp"
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using nanofill::events::Event;
+namespace itch = nanofill::fileio::itch;
+
+constexpr std::uint64_t message_count = 20000000;
+
+// A feed where about half the messages are adds and the rest cancel, delete, execute or replace
+// one of the last thousand or so orders, in roughly the proportions NASDAQ sends them.
+// メッセージの約半分が追加で、残りが最後の千ぐらいの注文の一つを取消、削除、約定か置き換えするフィード。
+// 大体NASDAQが送る割合で。
+std::vector<std::uint8_t> make_feed() {
+    std::mt19937_64 random(42);
+    std::vector<std::uint8_t> data;
+    std::vector<std::uint64_t> live;
+    std::uint64_t next_reference = 1;
+    std::uint64_t timestamp = 34200ULL * 1000000000;
+    data.reserve(message_count * 34);
+
+    for (std::uint64_t i = 0; i < message_count; ++i) {
+        timestamp += random() % 10000;
+
+        if (live.size() < 1000 || random() % 2 == 0) {
+            const bool buy = random() % 2 == 0;
+            itch::append_add_order(data, timestamp, next_reference, buy, (random() % 10 + 1) * 100,
+                300000 + (buy ? -1 : 1) * static_cast<std::uint32_t>(random() % 20) * 100);
+            live.push_back(next_reference++);
+            continue;
+        }
+
+        const std::size_t index = random() % live.size();
+        const std::uint64_t reference = live[index];
+        const auto kind = random() % 10;
+
+        if (kind < 5) {
+            itch::append_order_delete(data, timestamp, reference);
+        } else if (kind < 7) {
+            itch::append_order_cancel(data, timestamp, reference, 1000);
+        } else if (kind < 9) {
+            itch::append_order_executed(data, timestamp, reference, 1000);
+        } else {
+            itch::append_order_replace(data, timestamp, reference, next_reference, 200, 300000);
+            live.push_back(next_reference++);
+        }
+
+        live[index] = live.back();
+        live.pop_back();
+    }
+
+    return data;
+}
+
+int main() {
+    const auto data = make_feed();
+    std::uint64_t events = 0;
+    std::uint64_t checksum = 0;
+
+    nanofill::fileio::ItchDecoder decoder;
+    auto clock_start = std::chrono::steady_clock::now();
+    decoder.decode_buffer(data, [&](const Event& event) {
+        ++events;
+        checksum += event.price;
+    });
+    auto clock_end = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(clock_end - clock_start).count();
+
+    std::cout << "===== ITCH 5.0 decoder (" << decoder.get_messages() << " messages, "
+        << data.size() / 1e6 << " MB) =====" << std::endl
+        << "Time: " << seconds << "s" << std::endl
+        << "Messages: " << decoder.get_messages() / seconds / 1e6 << " million per second" << std::endl
+        << "Events: " << events / seconds / 1e6 << " million per second" << std::endl
+        << "Throughput: " << data.size() / seconds / 1e9 << " GB/s" << std::endl
+        << "Unknown orders: " << decoder.get_unknown_orders() << " (checksum " << checksum << ")" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include "concurrency/seqlock.hpp"
+#include "orderbook/topofbook.hpp"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using nanofill::orderbook::TopOfBook;
+using nanofill::orderbook::TopOfBookPublisher;
+
+constexpr unsigned int writes = 10000000;
+constexpr unsigned int max_readers = 4;
+
+// Measure how long the writer takes to publish a top of book snapshot while the given number of
+// readers hammer the same seqlock.
+// 指定した数の読み取り側が同じシーケンスロックを読み続けている間に、書き込み側が板の一番上のスナップショットを
+// 公開するのにかかる時間を測る。
+double nanoseconds_per_write(const unsigned int reader_count) {
+    TopOfBookPublisher publisher;
+    std::atomic<bool> running{true};
+    std::atomic<std::uint64_t> reads{0};
+    std::vector<std::thread> readers;
+
+    for (unsigned int i = 0; i < reader_count; ++i) {
+        readers.emplace_back([&] {
+            std::uint64_t local_reads = 0;
+            TopOfBook snapshot;
+
+            while (running.load(std::memory_order_relaxed)) {
+                local_reads += publisher.try_load(snapshot);
+            }
+
+            reads += local_reads;
+        });
+    }
+
+    auto clock_start = std::chrono::steady_clock::now();
+
+    for (unsigned int i = 0; i < writes; ++i) {
+        publisher.store(TopOfBook {
+            .best_bid = i,
+            .best_ask = i + 100,
+            .mid_price = i + 50,
+            .target_buy_price = i - 1000,
+            .target_sell_price = i + 1000,
+            .time = i
+        });
+    }
+
+    auto clock_end = std::chrono::steady_clock::now();
+    running = false;
+
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    return std::chrono::duration<double, std::nano>(clock_end - clock_start).count() / writes;
+}
+
+int main() {
+    std::cout << "===== Seqlock top of book writer overhead =====" << std::endl;
+
+    for (unsigned int reader_count = 0; reader_count <= max_readers; ++reader_count) {
+        std::cout << reader_count << " readers: " << nanoseconds_per_write(reader_count) << "ns per write" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include "ipc/sharedbook.hpp"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+using nanofill::events::Event;
+using nanofill::events::EventType;
+using nanofill::ipc::SharedBookReader;
+using nanofill::ipc::SharedBookWriter;
+
+constexpr std::uint32_t event_count = 20000000;
+
+// Average nanoseconds for the writer to publish an event and its level change.
+// 書き手がイベントとそのレベルの変化を公開するのにかかる平均ナノ秒。
+double time_writer(SharedBookWriter& writer) {
+    auto clock_start = std::chrono::steady_clock::now();
+
+    for (std::uint32_t i = 0; i < event_count; ++i) {
+        writer.publish_event(Event { .price = 3000 + (i & 63), .time = i >> 10, .order_id = i, .size = 100, .type = EventType::Submission, .symbol_id = 0 });
+        writer.publish_level(3000 + (i & 63), i & 1023, i >> 10);
+    }
+
+    auto clock_end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(clock_end - clock_start).count() / event_count;
+}
+
+// The writer's cost with nobody reading, with a reader following along, and with readers
+// attaching and detaching the whole time, which should all be about the same.
+// 誰も読んでいないとき、読み手が付いてきているとき、読み手がずっと接続と切断をしているときの書き手のコスト。
+// 全部ほぼ同じはずだ。
+int main() {
+    SharedBookWriter writer("/nanofill_benchmark_" + std::to_string(getpid()), 1 << 20);
+    std::atomic<bool> stop{false};
+    std::uint64_t records_read = 0;
+    std::uint64_t records_lost = 0;
+    std::uint64_t attachments = 0;
+
+    const double alone = time_writer(writer);
+
+    std::thread follower([&] {
+        SharedBookReader reader(writer.get_name());
+        nanofill::ipc::SharedRecord record;
+
+        while (!stop.load(std::memory_order_relaxed)) {
+            records_read += reader.next(record) == SharedBookReader::Result::Record;
+        }
+
+        records_lost = reader.get_lost_records();
+    });
+    const double following = time_writer(writer);
+    stop = true;
+    follower.join();
+    stop = false;
+
+    std::thread attacher([&] {
+        while (!stop.load(std::memory_order_relaxed)) {
+            SharedBookReader reader(writer.get_name());
+            reader.load_top_of_book();
+            ++attachments;
+        }
+    });
+    const double attaching = time_writer(writer);
+    stop = true;
+    attacher.join();
+
+    std::cout << "===== Shared book writer (" << event_count << " events, each with a level change) =====" << std::endl
+        << "No readers: " << alone << "ns per event" << std::endl
+        << "One reader following: " << following << "ns per event (read " << records_read << ", lost " << records_lost << ")" << std::endl
+        << "Readers attaching and detaching: " << attaching << "ns per event (" << attachments << " attachments)" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "tradingengine/parametersweep.hpp"
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+using nanofill::events::Event;
+using nanofill::events::EventType;
+using nanofill::tradingengine::SweepParameters;
+
+constexpr std::uint32_t event_count = 1000000;
+
+// A random walk of submissions around a drifting price, with about one in four of the resting
+// orders later executed and the rest deleted.
+// 動く価格の周りの注文の出しのランダムウォーク。残っている注文の約四分の一は後で約定して、他は削除される。
+std::vector<Event> make_events() {
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> offset(-500, 500);
+    std::uniform_int_distribution<int> size(1, 500);
+    std::vector<Event> events;
+    std::vector<Event> resting;
+    std::uint32_t mid_price = 300000;
+    events.reserve(event_count);
+
+    for (std::uint32_t i = 0; events.size() < event_count; ++i) {
+        mid_price += offset(random) / 100;
+
+        const int price_offset = offset(random);
+        Event submission {
+            .price = static_cast<std::uint32_t>(mid_price + price_offset),
+            .time = i,
+            .order_id = i,
+            .size = static_cast<std::int16_t>(price_offset < 0 ? size(random) : -size(random)),
+            .type = EventType::Submission,
+            .symbol_id = 0
+        };
+
+        events.push_back(submission);
+        resting.push_back(submission);
+
+        if (resting.size() > 1000) {
+            std::swap(resting[random() % resting.size()], resting.back());
+            Event removal = resting.back();
+            resting.pop_back();
+            removal.time = i;
+            removal.type = random() % 4 == 0 ? EventType::ExecutionVisible : EventType::Deletion;
+            events.push_back(removal);
+        }
+    }
+
+    return events;
+}
+
+int main() {
+    const auto events = nanofill::tradingengine::filter_actioned_events(make_events());
+    std::vector<SweepParameters> parameters;
+
+    for (std::uint32_t spread = 0; spread < 2000; spread += 10) {
+        for (std::uint32_t quote_size = 50; quote_size <= 500; quote_size += 50) {
+            parameters.push_back({ .price_spread = spread, .quote_size = quote_size });
+        }
+    }
+
+    std::cout << "===== Parameter sweep (" << parameters.size() << " parameterisations, "
+        << events.size() << " events) =====" << std::endl;
+
+    const unsigned int max_threads = std::max(1U, std::thread::hardware_concurrency());
+
+    for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+        auto clock_start = std::chrono::steady_clock::now();
+        const auto results = nanofill::tradingengine::run_parameter_sweep(events, parameters, threads);
+        auto clock_end = std::chrono::steady_clock::now();
+        const double seconds = std::chrono::duration<double>(clock_end - clock_start).count();
+
+        std::cout << threads << " threads: " << seconds << "s, "
+            << events.size() * parameters.size() / seconds / 1e9 << " billion parameter-events per second" << std::endl;
+
+        if (threads * 2 > max_threads) {
+            nanofill::tradingengine::print_sweep_results(std::cout, results, 10);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,435 @@
+#pragma once
+
+#include "events/event.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+
+// Simulates our own orders resting on a book that is being replayed, so that a strategy can be
+// backtested against real market data. We can't change the market by trading in it, so this is
+// only an estimate, but it keeps track of where each of our orders sits in its level's queue so
+// that fills happen when they realistically could have, rather than as soon as the price touches.
+// 再生している板に自分の注文を置くのをシミュレートするので、実際の市場データで戦略をバックテストできる。
+// 取引しても市場は変わらないので、これは推定にすぎないが、自分の各注文がレベルの待ち行列のどこにいるかを
+// 管理するので、価格が触れたらすぐではなく、現実的に約定できたときに約定する。
+namespace nanofill::backtest {
+
+using events::Event;
+using events::EventType;
+
+enum class Side : std::uint8_t {
+    Buy,
+    Sell,
+};
+
+// One of our orders being (partly) filled.
+// 自分の注文の一つが（一部）約定した。
+struct SimulatedFill {
+    // What place returned for the order.
+    // 注文についてplaceが返したもの。
+    int order;
+    Side side;
+    // Dollar price times 10,000.
+    // 10,000倍したドルの価格。
+    std::uint32_t price;
+    std::uint32_t size;
+    // The time of the event that filled us.
+    // 約定させたイベントの時。
+    std::uint32_t time;
+};
+
+// The queue model is:
+// - Everything already on our side of a level when we join it is ahead of us, and anything that
+//   joins after us is behind.
+// - Visible executions on our level eat the queue from the front, so once the shares ahead of us
+//   are gone, the rest of the execution fills us.
+// - Cancellations and deletions of orders that were there before us move us forward. Orders are
+//   assumed to be numbered in the order they arrive, which holds for LOBSTER data.
+// - An execution at a worse price than ours on our side means the market traded through us, so
+//   we would have been filled first, best priced order first.
+// - One execution never fills more of our orders in total than its own size.
+// - An order that crosses the spread when placed takes what's on the opposite side up to its
+//   price, best price first, and the rest of it rests at its price. The replayed book can't lose
+//   those shares, so later crossing orders see them too.
+//
+// Everything lives in fixed arrays, so nothing is ever allocated. Every event's size carries the
+// side of the market order it's about (negative for sells), which is what tells us which of our
+// orders it can touch.
+// 待ち行列のモデル：
+// - レベルに加わったときに、既にそのレベルの同じ側にあるものは全部前にあって、後から加わったものは後ろにある。
+// - レベルの見える約定は待ち行列を前から食べるので、前の株がなくなったら、約定の残りで自分が約定する。
+// - 前からあった注文の取消と削除で自分が前に進む。注文は来た順番に番号が付けられているとみなす。LOBSTERの
+//   データではそうだ。
+// - 同じ側で自分より悪い価格の約定は、市場が自分を通り越して取引したということなので、自分が先に、良い価格の
+//   注文から約定したはず。
+// - 一つの約定が自分の注文を合計で約定させるのは、決してその約定の数量より多くない。
+// - 置いたときにスプレッドを越える注文は、自分の価格までの反対側にあるものを最良の価格から取って、残りは自分の
+//   価格に置く。再生している板からその株はなくならないので、後からスプレッドを越える注文にも見える。
+//
+// 全部固定の配列にあるので、何も割り当てない。各イベントのサイズは、それが関わる市場の注文の側を持っていて
+// （売りならネガティブ）、それで自分のどの注文に触れられるかが分かる。
+template<std::size_t MaxOrders = 64>
+class FillSimulator {
+    struct SimulatedOrder {
+        std::uint32_t price;
+        std::uint32_t remaining;
+        // Shares on our side of the level that are in front of us.
+        // レベルの同じ側で自分の前にある株。
+        std::uint64_t shares_ahead;
+        // The newest market order that was on the book when we were placed.
+        // 置いたときに板にあった一番新しい市場の注文。
+        std::uint32_t newest_order_ahead;
+        Side side;
+        bool active;
+    };
+
+    std::array<SimulatedOrder, MaxOrders> orders{};
+    std::size_t active_orders = 0;
+    // The newest order id submitted to the market.
+    // 市場に出された一番新しい注文のID。
+    std::uint32_t newest_order_id = 0;
+
+    std::int64_t position = 0;
+    std::int64_t cash = 0;
+    std::uint64_t fill_count = 0;
+    std::uint64_t shares_bought = 0;
+    std::uint64_t shares_sold = 0;
+    std::uint32_t last_price = 0;
+
+    // Returns how many shares were filled.
+    // 約定した株の数を返す。
+    template<typename OnFill>
+    [[gnu::always_inline]]
+    std::uint32_t fill(
+        const int index,
+        const std::uint32_t price,
+        std::uint32_t size,
+        const std::uint32_t time,
+        OnFill& on_fill
+    ) noexcept {
+        SimulatedOrder& order = orders[index];
+
+        if (size > order.remaining) {
+            size = order.remaining;
+        }
+
+        if (size == 0) {
+            return 0;
+        }
+
+        order.remaining -= size;
+
+        if (order.side == Side::Buy) {
+            position += size;
+            cash -= static_cast<std::int64_t>(price) * size;
+            shares_bought += size;
+        } else {
+            position -= size;
+            cash += static_cast<std::int64_t>(price) * size;
+            shares_sold += size;
+        }
+
+        ++fill_count;
+        on_fill(SimulatedFill { .order = index, .side = order.side, .price = price, .size = size, .time = time });
+
+        if (order.remaining == 0) {
+            order.active = false;
+            --active_orders;
+        }
+
+        return size;
+    }
+
+public:
+    // Place a limit order, returning a handle for it, or -1 if there's no room for another. Fills
+    // for a crossing order are passed to on_fill straight away.
+    // 指値注文を置いて、そのハンドルを返す。もう入らなかったら、-1を返す。スプレッドを越える注文の約定は、
+    // すぐにon_fillに渡す。
+    template<typename Book, typename OnFill>
+    int place(
+        const Side side,
+        const std::uint32_t price,
+        const std::uint32_t size,
+        const std::uint32_t time,
+        const Book& book,
+        OnFill&& on_fill
+    ) noexcept {
+        int index = 0;
+
+        while (index < static_cast<int>(MaxOrders) && orders[index].active) {
+            ++index;
+        }
+
+        if (index == static_cast<int>(MaxOrders) || size == 0) {
+            return -1;
+        }
+
+        const bool buy = side == Side::Buy;
+
+        orders[index] = SimulatedOrder {
+            .price = price,
+            .remaining = size,
+            .shares_ahead = buy ? book.get_buy_size_for_price(price) : book.get_sell_size_for_price(price),
+            .newest_order_ahead = newest_order_id,
+            .side = side,
+            .active = true
+        };
+
+        ++active_orders;
+
+        // Walk the opposite side as a marketable order would, taking each level's shares until we
+        // run out or reach our price.
+        // 市場性のある注文のように反対側を歩いて、なくなるか自分の価格に届くまで各レベルの株を取る。
+        std::uint32_t opposite = buy ? book.get_best_ask() : book.get_best_bid();
+
+        while (orders[index].active && opposite != 0 && (buy ? price >= opposite : price <= opposite)) {
+            fill(index, opposite, buy ? book.get_sell_size_for_price(opposite) : book.get_buy_size_for_price(opposite), time, on_fill);
+            opposite = buy ? book.get_next_ask(opposite) : book.get_next_bid(opposite);
+        }
+
+        return index;
+    }
+
+    template<typename Book>
+    int place(const Side side, const std::uint32_t price, const std::uint32_t size, const std::uint32_t time, const Book& book) noexcept {
+        return place(side, price, size, time, book, [](const SimulatedFill&) {});
+    }
+
+    // Returns false if the order was already filled or cancelled.
+    // 注文が既に約定したか取り消されたら、falseを返す。
+    bool cancel(const int order) noexcept {
+        if (order < 0 || order >= static_cast<int>(MaxOrders) || !orders[order].active) {
+            return false;
+        }
+
+        orders[order].active = false;
+        --active_orders;
+
+        return true;
+    }
+
+    // Update our orders for a market event, passing any fills to on_fill.
+    // 市場のイベントで自分の注文を更新して、約定をon_fillに渡す。
+    template<typename OnFill>
+    [[gnu::always_inline]]
+    void process_event(const Event event, OnFill&& on_fill) noexcept {
+        const bool execution = event.type == EventType::ExecutionVisible || event.type == EventType::ExecutionHidden;
+
+        if (event.type == EventType::Submission) {
+            newest_order_id = event.order_id > newest_order_id ? event.order_id : newest_order_id;
+            return;
+        }
+
+        if (execution) {
+            last_price = event.price;
+        }
+
+        if (active_orders == 0) {
+            return;
+        }
+
+        // An execution's sign is the side of the resting order it hit, so a buy execution can only
+        // be trading with (or through) our bids.
+        // 約定の符号は当たった置いてある注文の側なので、買いの約定は自分の買い注文としか（またはそれを通り
+        // 越してしか）取引できない。
+        const bool event_buy = event.size > 0;
+        const auto size = static_cast<std::uint32_t>(std::abs(event.size));
+        // What's left of the execution to fill our orders with, shared between all of them.
+        // 自分の注文を約定させるのに残っている約定の数量。全部の注文で共有する。
+        std::uint32_t budget = size;
+
+        // The market went through our orders priced better than the execution, best first.
+        // 市場は約定より良い価格の自分の注文を、良いものから通り越した。
+        while (execution && budget != 0) {
+            int best = -1;
+
+            for (int i = 0; i < static_cast<int>(MaxOrders); ++i) {
+                const SimulatedOrder& order = orders[i];
+
+                if (!order.active || (order.side == Side::Buy) != event_buy) {
+                    continue;
+                }
+
+                const bool worse_than_ours = event_buy ? event.price < order.price : event.price > order.price;
+                const bool better_than_best = best == -1
+                    || (event_buy ? order.price > orders[best].price : order.price < orders[best].price);
+
+                if (worse_than_ours && better_than_best) {
+                    best = i;
+                }
+            }
+
+            if (best == -1) {
+                break;
+            }
+
+            budget -= fill(best, orders[best].price, budget, event.time, on_fill);
+        }
+
+        for (int i = 0; i < static_cast<int>(MaxOrders); ++i) {
+            SimulatedOrder& order = orders[i];
+
+            if (!order.active || (order.side == Side::Buy) != event_buy || event.price != order.price) {
+                continue;
+            }
+
+            if (event.type == EventType::ExecutionVisible) {
+                const std::uint64_t ahead = order.shares_ahead;
+
+                order.shares_ahead = ahead > size ? ahead - size : 0;
+
+                if (size > ahead) {
+                    budget -= fill(i, order.price, std::min(size - static_cast<std::uint32_t>(ahead), budget), event.time, on_fill);
+                }
+            } else if (!execution && event.order_id <= order.newest_order_ahead) {
+                order.shares_ahead -= order.shares_ahead < size ? order.shares_ahead : size;
+            }
+        }
+    }
+
+    [[gnu::always_inline]]
+    void process_event(const Event event) noexcept {
+        process_event(event, [](const SimulatedFill&) {});
+    }
+
+    // Shares still to fill on an order, or 0 if it's finished.
+    // 注文のまだ約定していない株。終わっていたら、0。
+    std::uint32_t get_remaining(const int order) const noexcept {
+        return orders[order].active ? orders[order].remaining : 0;
+    }
+
+    std::uint64_t get_shares_ahead(const int order) const noexcept {
+        return orders[order].shares_ahead;
+    }
+
+    // Shares held. Negative means short.
+    // 持っている株の数。ネガティブなら、空売り。
+    std::int64_t get_position() const noexcept {
+        return position;
+    }
+
+    // Cash in 10,000ths of a dollar.
+    // 10,000倍したドルの現金。
+    std::int64_t get_cash() const noexcept {
+        return cash;
+    }
+
+    // Cash plus the position valued at the last execution price.
+    // 現金と、最後の約定価格で評価したポジション。
+    std::int64_t get_profit() const noexcept {
+        return cash + position * static_cast<std::int64_t>(last_price);
+    }
+
+    std::uint64_t get_fill_count() const noexcept {
+        return fill_count;
+    }
+
+    std::uint64_t get_shares_bought() const noexcept {
+        return shares_bought;
+    }
+
+    std::uint64_t get_shares_sold() const noexcept {
+        return shares_sold;
+    }
+};
+
+// Turns a strategy's target prices into orders on a FillSimulator, the way OrderRouter does for
+// the gateway: one order of quote_size on each side, cancelled and placed again at the new price
+// whenever the target moves, or placed again once the last one has filled. A target of 0 means
+// don't quote that side.
+// 戦略の目標価格をFillSimulatorの注文にする。OrderRouterがゲートウェイにするのと同じように、各側に
+// quote_sizeの注文を一つ置いて、目標が動くたびに取り消して新しい価格に置き直して、前のものが約定したらまた
+// 置く。目標が0なら、その側に気配を出さない。
+template<std::size_t MaxOrders = 64>
+class QuoteDriver {
+    struct Quote {
+        // -1 when there's nothing resting.
+        // 何も置いていないときは-1。
+        int order = -1;
+        std::uint32_t price = 0;
+    };
+
+    FillSimulator<MaxOrders>& simulator;
+    std::uint32_t quote_size;
+    std::array<Quote, 2> quotes{};
+    std::uint64_t placed = 0;
+    std::uint64_t cancelled = 0;
+
+    template<typename Book, typename OnFill>
+    void requote(const Side side, const std::uint32_t target, const std::uint32_t time, const Book& book, OnFill& on_fill) noexcept {
+        Quote& quote = quotes[static_cast<std::size_t>(side)];
+
+        if (quote.order != -1 && quote.price == target) {
+            return;
+        }
+
+        if (quote.order != -1 && simulator.cancel(quote.order)) {
+            ++cancelled;
+        }
+
+        quote = { .order = -1, .price = target };
+
+        if (target == 0) {
+            return;
+        }
+
+        quote.order = simulator.place(side, target, quote_size, time, book, on_fill);
+        placed += quote.order != -1;
+
+        // A handle freed by a crossing order filling straight away can be reused by the next one.
+        // すぐに約定したスプレッドを越える注文のハンドルは、次の注文に再利用されうる。
+        if (quote.order != -1 && simulator.get_remaining(quote.order) == 0) {
+            quote.order = -1;
+        }
+    }
+
+public:
+    QuoteDriver(FillSimulator<MaxOrders>& simulator, const std::uint32_t quote_size = 100) noexcept
+        : simulator(simulator), quote_size(quote_size) {}
+
+    // Call after the strategy has seen each event, once the book has processed it, passing any
+    // fills from crossing orders to on_fill.
+    // 戦略が各イベントを見た後、板が処理してから呼んで、スプレッドを越える注文の約定をon_fillに渡す。
+    template<typename Book, typename OnFill>
+    void on_targets(
+        const std::uint32_t target_buy_price,
+        const std::uint32_t target_sell_price,
+        const std::uint32_t time,
+        const Book& book,
+        OnFill&& on_fill
+    ) noexcept {
+        // Forget filled quotes on both sides before placing anything, since placing can reuse
+        // their handles.
+        // 置くとハンドルが再利用されうるので、何か置く前に両側の約定した気配を忘れる。
+        for (Quote& quote : quotes) {
+            if (quote.order != -1 && simulator.get_remaining(quote.order) == 0) {
+                quote.order = -1;
+            }
+        }
+
+        requote(Side::Buy, target_buy_price, time, book, on_fill);
+        requote(Side::Sell, target_sell_price, time, book, on_fill);
+    }
+
+    template<typename Book>
+    void on_targets(const std::uint32_t target_buy_price, const std::uint32_t target_sell_price, const std::uint32_t time, const Book& book) noexcept {
+        on_targets(target_buy_price, target_sell_price, time, book, [](const SimulatedFill&) {});
+    }
+
+    // The order resting on a side, or -1 if there's none.
+    // ある側に置いてある注文。なければ、-1。
+    int get_order(const Side side) const noexcept {
+        return quotes[static_cast<std::size_t>(side)].order;
+    }
+
+    std::uint64_t get_placed() const noexcept {
+        return placed;
+    }
+
+    std::uint64_t get_cancelled() const noexcept {
+        return cancelled;
+    }
+};
+
+}
@@ -0,0 +1,306 @@
+#pragma once
+
+#include "events/event.hpp"
+#include "concurrency/spscringbuffer.hpp"
+#include "memory/hugepages.hpp"
+#include "orderbook/orderbook.hpp"
+#include "tradingengine/tradingengine.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+
+namespace nanofill::bookmanager {
+
+using concurrency::SPSCRingBuffer;
+using events::Event;
+using events::max_symbols;
+using orderbook::BasicOrderBook;
+using tradingengine::TradingEngine;
+
+// Owns one order book and one trading engine per symbol, and spreads the symbols over a number
+// of consumer threads (shards). Every shard has its own ring, so the producer routes each event
+// straight to the one thread that owns its symbol, and no symbol's state is ever touched by more
+// than one thread.
+//
+// Symbols can only be added and moved between shards while the manager is stopped. Given a
+// rebalance interval, the producer moves them itself every that many routed events, by briefly
+// draining and stopping the shards.
+//
+// A manager holds at most max_symbols symbols, one per symbol id. Every symbol's book is sized by
+// Policy. With the default policy that's about 25 MB, mostly the arrays with one entry per price
+// level, so for many symbols use a policy with a narrower price range (see policies.hpp).
+// 銘柄ごとに一つの注文板と一つの取引処理エンジンを持って、銘柄を複数の消費者スレッド（シャード）に分ける。
+// 各シャードは独自のリングを持つので、生産者は各イベントをその銘柄を持っているスレッドに直接送って、どの
+// 銘柄の状態も二つ以上のスレッドに触られない。
+//
+// 銘柄の追加とシャード間の移動は、止まっている間にしかできない。リバランスの間隔が与えられたら、生産者は
+// その数のイベントを送るたびに、シャードを少し空にして止めて、自分で移動する。
+//
+// マネージャーは銘柄IDごとに一つ、最大max_symbols個の銘柄を持つ。各銘柄の板はPolicyでサイズが決まる。
+// デフォルトのポリシーでは約25MBで、ほとんどは価格レベルごとに一つのエントリがある配列なので、多くの銘柄には
+// 価格の範囲が狭いポリシーを使って（policies.hppを参照）。
+template<typename Policy = orderbook::DefaultOrderBookPolicy, std::size_t RingSize = 1024>
+class BookManager {
+    // Everything belonging to one symbol. Each lives in its own allocation on its own cache lines
+    // so that shards never share anything.
+    // 一つの銘柄のもの全部。シャードが何も共有しないように、それぞれ独自の割り当てと独自のキャッシュラインにある。
+    struct alignas(std::hardware_destructive_interference_size) Symbol {
+        BasicOrderBook<Policy> book;
+        TradingEngine engine;
+
+        explicit Symbol(const int price_spread) : engine(price_spread) {}
+    };
+
+    using Ring = SPSCRingBuffer<Event, RingSize>;
+
+    std::vector<memory::HugePageUniquePtr<Ring>> rings;
+    // Indexed by symbol id. These are on the heap since there's an entry for every possible id.
+    // 銘柄IDで索引する。全ての可能なIDにエントリがあるので、ヒープにある。
+    std::vector<std::unique_ptr<Symbol>> symbols = std::vector<std::unique_ptr<Symbol>>(max_symbols);
+    // Which shard each symbol is on.
+    // 各銘柄がどのシャードにあるか。
+    std::vector<std::uint16_t> symbol_shards = std::vector<std::uint16_t>(max_symbols);
+    // Events routed per symbol since the last rebalance. Only the producer touches this.
+    // 前回のリバランスから銘柄ごとに送ったイベントの数。生産者しか触らない。
+    std::vector<std::uint64_t> symbol_event_counts = std::vector<std::uint64_t>(max_symbols);
+    // The ids that have been added, so that nothing has to walk every possible id.
+    // 全ての可能なIDを回らなくていいように、追加されたID。
+    std::vector<std::uint16_t> added_symbols;
+    // Rebalance every this many routed events, or never if 0. Only the producer touches these.
+    // この数のイベントを送るたびにリバランスする。0なら決してしない。生産者しか触らない。
+    std::uint64_t rebalance_interval;
+    std::uint64_t events_until_rebalance;
+    std::size_t rebalance_count = 0;
+    // Events for symbols that were never added, which are dropped. Only the producer touches this.
+    // 追加されなかった銘柄のイベント。捨てる。生産者しか触らない。
+    std::uint64_t unknown_symbol_events = 0;
+    std::vector<std::thread> threads;
+    // Cores to pin each shard's thread to. Empty means don't pin.
+    // 各シャードのスレッドを固定するコア。空なら、固定しない。
+    std::vector<int> shard_cores;
+    alignas(std::hardware_destructive_interference_size) std::atomic<bool> stopping{false};
+
+    // Process events for the symbols on one shard until we're told to stop and the ring is empty.
+    // 止めろと言われて、リングが空になるまで、一つのシャードの銘柄のイベントを処理する。
+    void consume_shard(Ring& ring) noexcept {
+        Event events[orderbook::max_batch_size];
+
+        while (true) {
+            unsigned int events_found = ring.pop_many(events, orderbook::max_batch_size);
+
+            if (events_found == 0) {
+                if (!stopping.load(std::memory_order_acquire)) {
+                    continue;
+                }
+
+                // The producer pushes everything before setting stopping, so if the ring is still
+                // empty after seeing it, we're done.
+                // 生産者はstoppingを設定する前に全部入れるので、それを見てもリングが空なら、終わりだ。
+                events_found = ring.pop_many(events, orderbook::max_batch_size);
+
+                if (events_found == 0) {
+                    return;
+                }
+            }
+
+            for (unsigned int i = 0; i < events_found; ++i) {
+                Symbol& symbol = *symbols[events[i].symbol_id];
+
+                if (symbol.book.process_event(events[i])) {
+                    symbol.engine.process_event(events[i]);
+                }
+            }
+        }
+    }
+
+public:
+    // cores optionally gives a core to pin each shard's thread to. rebalance_interval is how many
+    // routed events to rebalance after while running, or 0 to only rebalance when asked.
+    // coresは任意で、各シャードのスレッドを固定するコアを指定する。rebalance_intervalは実行中に何個のイベントを
+    // 送ったらリバランスするか。0なら頼まれたときしかしない。
+    explicit BookManager(const std::size_t shard_count, std::vector<int> cores = {}, const std::uint64_t rebalance_interval = 0)
+        : rebalance_interval(rebalance_interval), events_until_rebalance(rebalance_interval), shard_cores(std::move(cores)) {
+        if (shard_count == 0 || shard_count > max_symbols) {
+            throw std::invalid_argument("shard_count must be between 1 and max_symbols");
+        }
+
+        if (!shard_cores.empty() && shard_cores.size() != shard_count) {
+            throw std::invalid_argument("Give either no cores or one core per shard");
+        }
+
+        for (std::size_t i = 0; i < shard_count; ++i) {
+            rings.push_back(memory::make_huge_page_unique<Ring>());
+        }
+    }
+
+    ~BookManager() {
+        stop();
+    }
+
+    BookManager(const BookManager&) = delete;
+    BookManager& operator=(const BookManager&) = delete;
+
+    // Create the book and engine for a symbol and put it on the least busy shard.
+    // 銘柄の板とエンジンを作って、一番暇なシャードに置く。
+    void add_symbol(const std::uint16_t symbol_id, const int price_spread) {
+        if (symbols[symbol_id] != nullptr) {
+            throw std::invalid_argument("Symbol " + std::to_string(symbol_id) + " already exists");
+        }
+
+        std::vector<std::size_t> symbols_per_shard(rings.size());
+
+        for (const std::uint16_t added : added_symbols) {
+            ++symbols_per_shard[symbol_shards[added]];
+        }
+
+        symbols[symbol_id] = std::make_unique<Symbol>(price_spread);
+        symbol_shards[symbol_id] = static_cast<std::uint16_t>(
+            std::min_element(symbols_per_shard.begin(), symbols_per_shard.end()) - symbols_per_shard.begin());
+        added_symbols.push_back(symbol_id);
+    }
+
+    // Start one consumer thread per shard. Throws if they're already running.
+    // シャードごとに一つの消費者スレッドを始める。もう実行中なら、例外を投げる。
+    void start() {
+        if (!threads.empty()) {
+            throw std::logic_error("BookManager is already started");
+        }
+
+        stopping.store(false, std::memory_order_relaxed);
+
+        for (std::size_t i = 0; i < rings.size(); ++i) {
+            threads.emplace_back(&BookManager::consume_shard, this, std::ref(*rings[i]));
+
+            if (!shard_cores.empty()) {
+                cpu_set_t cpus;
+                CPU_ZERO(&cpus);
+                CPU_SET(shard_cores[i], &cpus);
+                pthread_setaffinity_np(threads.back().native_handle(), sizeof(cpus), &cpus);
+            }
+        }
+    }
+
+    // Wait for every shard to finish what's been routed to it, then stop the threads. Producer
+    // thread only.
+    // 各シャードが送られたものを全部処理するまで待ってから、スレッドを止める。生産者スレッド専用。
+    void stop() {
+        stopping.store(true, std::memory_order_release);
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        threads.clear();
+    }
+
+    // Send an event to the shard that owns its symbol, waiting if that shard is behind. Events for
+    // symbols that haven't been added are dropped and counted. Rebalances afterwards if the interval
+    // is up. Producer thread only.
+    // イベントをその銘柄を持っているシャードに送る。シャードが遅れていたら、待つ。追加されていない銘柄の
+    // イベントは捨てて数える。間隔が来たら、後でリバランスする。生産者スレッド専用。
+    [[gnu::always_inline]]
+    void route(const Event event) {
+        if (symbols[event.symbol_id] == nullptr) [[unlikely]] {
+            ++unknown_symbol_events;
+            return;
+        }
+
+        ++symbol_event_counts[event.symbol_id];
+
+        Ring& ring = *rings[symbol_shards[event.symbol_id]];
+
+        while (!ring.push(event)) {}
+
+        if (rebalance_interval != 0 && --events_until_rebalance == 0) [[unlikely]] {
+            rebalance_while_running();
+        }
+    }
+
+    // Let the shards finish what they have, move the symbols, and carry on. Every event routed so
+    // far is processed before any symbol moves, so no symbol's events are ever on two shards.
+    // シャードに持っているものを終わらせて、銘柄を移動して、続ける。銘柄を移動する前にそれまで送った全ての
+    // イベントを処理するので、どの銘柄のイベントも二つのシャードにあることはない。
+    [[gnu::noinline]]
+    void rebalance_while_running() {
+        const bool running = !threads.empty();
+
+        stop();
+        rebalance();
+
+        if (running) {
+            start();
+        }
+    }
+
+    // Reassign symbols to shards so that each shard gets about the same number of events, based on
+    // how many were routed to each symbol since the last rebalance. Busiest symbols are placed
+    // first, each on whichever shard has the least load so far. Only call this while stopped.
+    // 前回のリバランスから各銘柄に送ったイベントの数によって、各シャードがほぼ同じ数のイベントを受け取るように、
+    // 銘柄をシャードに割り当て直す。一番忙しい銘柄から、今まで一番負荷が少ないシャードに置く。止まっている間に
+    // しか呼ばないで。
+    void rebalance() {
+        std::vector<std::uint16_t> order = added_symbols;
+        std::stable_sort(order.begin(), order.end(), [&](const std::uint16_t a, const std::uint16_t b) {
+            return symbol_event_counts[a] > symbol_event_counts[b];
+        });
+
+        std::vector<std::uint64_t> shard_loads(rings.size());
+
+        for (const std::uint16_t symbol_id : order) {
+            const std::size_t shard = std::min_element(shard_loads.begin(), shard_loads.end()) - shard_loads.begin();
+            symbol_shards[symbol_id] = static_cast<std::uint16_t>(shard);
+            // Count every symbol as at least one event so idle symbols still spread out.
+            // 暇な銘柄も分かれるように、各銘柄を少なくとも一つのイベントとして数える。
+            shard_loads[shard] += std::max<std::uint64_t>(symbol_event_counts[symbol_id], 1);
+        }
+
+        for (const std::uint16_t symbol_id : added_symbols) {
+            symbol_event_counts[symbol_id] = 0;
+        }
+
+        events_until_rebalance = rebalance_interval;
+        ++rebalance_count;
+    }
+
+    std::uint64_t get_unknown_symbol_events() const noexcept {
+        return unknown_symbol_events;
+    }
+
+    std::size_t get_rebalance_count() const noexcept {
+        return rebalance_count;
+    }
+
+    std::size_t get_symbol_count() const noexcept {
+        return added_symbols.size();
+    }
+
+    std::size_t get_shard_count() const noexcept {
+        return rings.size();
+    }
+
+    std::size_t get_shard_for_symbol(const std::uint16_t symbol_id) const noexcept {
+        return symbol_shards[symbol_id];
+    }
+
+    // Only safe to use while stopped.
+    // 止まっている間にしか安全に使えない。
+    const BasicOrderBook<Policy>& get_book(const std::uint16_t symbol_id) const noexcept {
+        return symbols[symbol_id]->book;
+    }
+
+    // Only safe to use while stopped.
+    // 止まっている間にしか安全に使えない。
+    const TradingEngine& get_engine(const std::uint16_t symbol_id) const noexcept {
+        return symbols[symbol_id]->engine;
+    }
+};
+
+}
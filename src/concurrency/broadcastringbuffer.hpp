@@ -0,0 +1,204 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+namespace nanofill::concurrency {
+
+// A ring buffer with one producer and a fixed number of consumers that each see every item. Each
+// consumer has its own cursor, and can optionally be made to stay behind another consumer (e.g. a
+// journal that should only see events after the book has processed them). Consumers read the
+// slots in place, so nothing is copied unless pop_many is used.
+//
+// Unlike SPSCRingBuffer, positions only ever increase and are masked on access, so all N slots
+// can be used.
+// 一つの生産者と、各々がすべてのアイテムを見る決まった数の消費者のリングバッファ。各消費者は独自のカーソルを
+// 持って、任意で他の消費者の後ろに留まらせられる（例えば、板が処理した後にしかイベントを見ないジャーナル）。
+// 消費者はスロットをその場で読むので、pop_manyを使わなければ、何もコピーしない。
+//
+// SPSCRingBufferと違って、位置は増えるだけでアクセスするときにマスクするので、Ｎ個のスロットを全部使える。
+template<typename T, std::size_t N, std::size_t Consumers>
+class BroadcastRingBuffer {
+    // By enforcing this we don't have to do any integer division which is faster.
+    // そうすると、整数除算が必要がなくなり、速くなる。
+    static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of 2");
+    static_assert(Consumers > 0, "There must be at least one consumer");
+
+public:
+    static constexpr std::size_t no_dependency = std::numeric_limits<std::size_t>::max();
+
+private:
+    // Each cursor gets its own cache line so consumers don't slow each other down.
+    // 消費者が互いに遅くしないように、各カーソルは独自のキャッシュラインを持つ。
+    struct alignas(std::hardware_destructive_interference_size) Cursor {
+        std::atomic<std::size_t> position{0};
+    };
+
+    // The position the producer will write next.
+    // 生産者が次に書き込む位置。
+    alignas(std::hardware_destructive_interference_size) std::atomic<std::size_t> head{0};
+    // The slowest consumer's position the last time the producer looked. Producer only.
+    // 生産者が最後に見たときの一番遅い消費者の位置。生産者専用。
+    alignas(std::hardware_destructive_interference_size) std::size_t cached_slowest = 0;
+    // The next position each consumer will read.
+    // 各消費者が次に読む位置。
+    Cursor cursors[Consumers];
+    // Which consumer each consumer must stay behind, or no_dependency to just follow the producer.
+    // 各消費者がどの消費者の後ろに留まらなければならないか。生産者にだけ従うなら、no_dependency。
+    std::array<std::size_t, Consumers> dependencies;
+    alignas(std::hardware_destructive_interference_size) std::array<T, N> buffer;
+
+    // The furthest position the consumer may read up to (exclusive).
+    // 消費者が読める一番遠い位置（含まない）。
+    [[gnu::always_inline]]
+    std::size_t get_limit(const std::size_t consumer) const noexcept {
+        const std::size_t dependency = dependencies[consumer];
+
+        if (dependency == no_dependency) {
+            return head.load(std::memory_order_acquire);
+        }
+
+        return cursors[dependency].position.load(std::memory_order_acquire);
+    }
+
+public:
+    // Dependencies must be set up front and must not form a cycle.
+    // 依存関係は前もって設定しなければならなくて、循環してはいけない。
+    explicit BroadcastRingBuffer(const std::array<std::size_t, Consumers> consumer_dependencies) {
+        for (std::size_t consumer = 0; consumer < Consumers; ++consumer) {
+            // Walk the chain; if it's longer than the number of consumers, it loops.
+            // 連鎖をたどる。消費者の数より長ければ、循環している。
+            std::size_t current = consumer;
+
+            for (std::size_t steps = 0; current != no_dependency; ++steps) {
+                if (steps == Consumers || (consumer_dependencies[current] >= Consumers
+                    && consumer_dependencies[current] != no_dependency)) {
+                    throw std::invalid_argument("Consumer dependencies must be valid and acyclic");
+                }
+
+                current = consumer_dependencies[current];
+            }
+        }
+
+        dependencies = consumer_dependencies;
+    }
+
+    BroadcastRingBuffer() : BroadcastRingBuffer(make_independent()) {}
+
+    static constexpr std::array<std::size_t, Consumers> make_independent() noexcept {
+        std::array<std::size_t, Consumers> independent;
+        independent.fill(no_dependency);
+
+        return independent;
+    }
+
+    // Returns true if successful. Fails if the slowest consumer is N items behind.
+    // 成功なら、trueを返す。一番遅い消費者がＮ個遅れていたら、失敗する。
+    bool push(const T item) noexcept {
+        const std::size_t current_head = head.load(std::memory_order_relaxed);
+
+        if (current_head - cached_slowest == N) {
+            // Only go and look at every consumer's cursor when we think we're full.
+            // 一杯だと思うときにしか、各消費者のカーソルを見に行かない。
+            std::size_t slowest = current_head;
+
+            for (const Cursor& cursor : cursors) {
+                const std::size_t position = cursor.position.load(std::memory_order_acquire);
+
+                if (position < slowest) {
+                    slowest = position;
+                }
+            }
+
+            cached_slowest = slowest;
+
+            if (current_head - slowest == N) {
+                return false;
+            }
+        }
+
+        buffer[current_head & (N - 1)] = item;
+        head.store(current_head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Get the contiguous run of slots the consumer can read now, up to maximum. The slots stay
+    // valid until advance is called. The run stops at the end of the buffer, so call again after
+    // advancing to get anything that wrapped around.
+    //
+    // Slots are read-only, since other consumers may be reading or copying the same ones at the
+    // same time. To pass something on to the consumers that depend on this one, keep it in a side
+    // array indexed by get_position (see threads::StageResults).
+    // 消費者が今読める連続したスロットを最大maximum個返す。advanceを呼ぶまで、スロットは有効だ。バッファの
+    // 最後で止まるので、先頭に戻った分は、advanceしてからもう一度呼んで。
+    //
+    // 他の消費者が同時に同じスロットを読んだりコピーしたりしているかもしれないので、スロットは読み取り専用だ。
+    // この消費者に依存している消費者に何かを渡すには、get_positionで索引する別の配列に入れて
+    // （threads::StageResultsを参照）。
+    [[gnu::always_inline]]
+    std::span<const T> read(const std::size_t consumer, const std::size_t maximum) const noexcept {
+        const std::size_t position = cursors[consumer].position.load(std::memory_order_relaxed);
+        const std::size_t available = get_limit(consumer) - position;
+        const std::size_t offset = position & (N - 1);
+        std::size_t count = available < maximum ? available : maximum;
+
+        if (count > N - offset) {
+            count = N - offset;
+        }
+
+        return { &buffer[offset], count };
+    }
+
+    // The position of the next slot the consumer will read, i.e. the sequence number of the first
+    // slot read returns. Only the consumer itself should ask.
+    // 消費者が次に読むスロットの位置、つまりreadが返す最初のスロットの通し番号。その消費者自身しか聞かないで。
+    [[gnu::always_inline]]
+    std::size_t get_position(const std::size_t consumer) const noexcept {
+        return cursors[consumer].position.load(std::memory_order_relaxed);
+    }
+
+    // Mark the next count slots as finished with.
+    // 次のcount個のスロットを終わったとする。
+    [[gnu::always_inline]]
+    void advance(const std::size_t consumer, const std::size_t count) noexcept {
+        const std::size_t position = cursors[consumer].position.load(std::memory_order_relaxed);
+        cursors[consumer].position.store(position + count, std::memory_order_release);
+    }
+
+    // Copy out up to maximum items for the consumer, returning how many were copied.
+    // 消費者のために最大maximum個のアイテムをコピーして、コピーした数を返す。
+    unsigned int pop_many(const std::size_t consumer, T* items, const unsigned int maximum) noexcept {
+        static_assert(std::is_trivially_copyable_v<T>, "pop_many requires trivially copyable T");
+
+        const std::size_t position = cursors[consumer].position.load(std::memory_order_relaxed);
+        const std::size_t available = get_limit(consumer) - position;
+        const std::size_t number_to_pop = available < maximum ? available : maximum;
+        const std::size_t offset = position & (N - 1);
+
+        if (offset + number_to_pop <= N) {
+            // No wrap-around, we can just copy everything in one go.
+            //　先頭に戻らず、一発でコピーできる。
+            std::memcpy(items, &buffer[offset], number_to_pop * sizeof(T));
+        } else {
+            // We have to do two copies.
+            // 二回コピーしなければならない。
+            const std::size_t first_copy_size = N - offset;
+
+            std::memcpy(items, &buffer[offset], first_copy_size * sizeof(T));
+            std::memcpy(&items[first_copy_size], &buffer[0], (number_to_pop - first_copy_size) * sizeof(T));
+        }
+
+        cursors[consumer].position.store(position + number_to_pop, std::memory_order_release);
+
+        return number_to_pop;
+    }
+};
+
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <new>
+#include <vector>
+#include <cstdint>
+#include <bit>
+
+namespace nanofill::concurrency {
+
+// The latest state of one price level.
+// 一つの価格レベルの最新の状態。
+struct LevelUpdate {
+    // Dollar price times 10,000.
+    // 10,000倍したドルの価格。
+    std::uint32_t price;
+    // The number of shares on the level.
+    // レベルの株の数。
+    std::uint32_t size;
+    // The time of the last event on the level.
+    // レベルの最後のイベントの時。
+    std::uint32_t last_modified;
+};
+
+// Publishes the latest state of each price level from the order book thread to one reader
+// thread. If the reader falls behind, it only sees the most recent value of each level instead
+// of every intermediate change, so memory use and reader lag are bounded by the number of levels.
+//
+// The writer owns one of two dirty bitmaps and only ever does plain stores into it, so it never
+// has to wait on (or do a locked instruction for) the reader. When the reader wants more data it
+// asks the writer to swap bitmaps, and then drains the one the writer has given up.
+//
+// Use one channel per reader.
+// 板のスレッドから一つの読み取りスレッドに各価格レベルの最新の状態を伝える。読み取りスレッドが遅れたら、
+// すべての途中の変更ではなく各レベルの最新の値しか見えないので、メモリ使用量と遅延はレベルの数で制限される。
+//
+// 書き込み側は二つのダーティビットマップの一つを持っていて、普通のストアしかしないので、読み取り側を待つ
+// （またはロック命令を使う）必要が全くない。読み取り側がデータを欲しいとき、書き込み側にビットマップの
+// 交換を頼んでから、書き込み側が手放したほうを処理する。
+//
+// 一つの読み取り側ごとに一つのチャンネルを使って。
+template<std::size_t Levels>
+class ConflatedLevelChannel {
+    static constexpr std::size_t bits_per_word = 64;
+    static constexpr std::size_t dirty_words = (Levels + bits_per_word - 1) / bits_per_word;
+    static constexpr std::size_t summary_words = (dirty_words + bits_per_word - 1) / bits_per_word;
+
+    // A dirty bitmap with one bit per level, plus a summary bitmap with one bit per dirty word
+    // so that the reader doesn't have to scan every word.
+    // レベルごとに一ビットのダーティビットマップ。読み取り側がすべてのワードを走査しなくてもいいように、
+    // ダーティワードごとに一ビットの要約ビットマップもある。
+    struct DirtyBitmap {
+        std::vector<std::uint64_t> dirty;
+        std::vector<std::uint64_t> summary;
+    };
+
+    // Only the writer touches these.
+    // これは書き込み側しか触らない。
+    alignas(std::hardware_destructive_interference_size) unsigned int writer_active = 0;
+    std::uint64_t writer_swaps_acknowledged = 0;
+
+    // Only the reader touches this.
+    // これは読み取り側しか触らない。
+    alignas(std::hardware_destructive_interference_size) std::uint64_t reader_swaps_requested = 0;
+
+    alignas(std::hardware_destructive_interference_size) std::atomic<std::uint64_t> swaps_requested{0};
+    alignas(std::hardware_destructive_interference_size) std::atomic<std::uint64_t> swaps_acknowledged{0};
+
+    DirtyBitmap bitmaps[2];
+    // The latest size and time of each level, packed so that each can be read without tearing.
+    // 各レベルの最新のサイズと時。千切れずに読めるように、一つの値に詰め込んでいる。
+    std::vector<std::atomic<std::uint64_t>> latest_values;
+
+public:
+    ConflatedLevelChannel() : latest_values(Levels) {
+        for (auto& bitmap : bitmaps) {
+            bitmap.dirty.resize(dirty_words);
+            bitmap.summary.resize(summary_words);
+        }
+    }
+
+    // Record the latest state of a level. Writer thread only. O(1) and wait-free.
+    // レベルの最新の状態を記録する。書き込みスレッド専用。O(1)でウェイトフリー。
+    [[gnu::always_inline]]
+    void publish(const std::uint32_t price, const std::uint32_t size, const std::uint32_t last_modified) noexcept {
+        latest_values[price].store(
+            (static_cast<std::uint64_t>(size) << 32) | last_modified,
+            std::memory_order_relaxed
+        );
+
+        const std::size_t word = price / bits_per_word;
+        DirtyBitmap& bitmap = bitmaps[writer_active];
+        bitmap.dirty[word] |= std::uint64_t{1} << (price % bits_per_word);
+        bitmap.summary[word / bits_per_word] |= std::uint64_t{1} << (word % bits_per_word);
+
+        service();
+    }
+
+    // Hand the active bitmap over to the reader if it has asked for it. publish already does this,
+    // but the writer should also call this when it is idle so that the reader isn't left waiting for
+    // the last changes of a burst. Writer thread only.
+    // 読み取り側が頼んだら、使っているビットマップを渡す。publishはもうこれをするが、バーストの最後の変更を
+    // 読み取り側が待ち続けないように、書き込み側が暇なときにも呼ぶべき。書き込みスレッド専用。
+    [[gnu::always_inline]]
+    void service() noexcept {
+        const std::uint64_t requested = swaps_requested.load(std::memory_order_acquire);
+
+        if (requested != writer_swaps_acknowledged) [[unlikely]] {
+            writer_active ^= 1;
+            writer_swaps_acknowledged = requested;
+            // Releases all the level values we've written so far to the reader.
+            // 今まで書いたレベルの値を読み取り側に公開する。
+            swaps_acknowledged.store(requested, std::memory_order_release);
+        }
+    }
+
+    // Call the callback with the latest state of every level in the bitmap the writer last handed
+    // over, returning the number of levels drained. Returns 0 if the writer hasn't handed one over
+    // yet. A change is always seen by the drain after the next one, but may be seen earlier (and a
+    // level may be seen again with the same value). Reader thread only.
+    // 書き込み側が最後に渡したビットマップにある各レベルの最新の状態でコールバックを呼んで、処理したレベルの
+    // 数を返す。まだ渡されていなかったら、0を返す。変更は必ず次の次のdrainで見えるが、その前に見えることも
+    // ある（同じ値でレベルがもう一度見えることもある）。読み取りスレッド専用。
+    template<typename Callback>
+    std::size_t drain(Callback&& callback) {
+        if (swaps_acknowledged.load(std::memory_order_acquire) != reader_swaps_requested) {
+            return 0;
+        }
+
+        // The writer flips bitmaps once per request, so it is using the other one to us.
+        // 書き込み側は頼みごとに一回交換するので、もう一つを使っている。
+        DirtyBitmap& bitmap = bitmaps[(reader_swaps_requested & 1) ^ 1];
+        std::size_t drained = 0;
+
+        for (std::size_t summary_word = 0; summary_word < summary_words; ++summary_word) {
+            std::uint64_t summary_bits = bitmap.summary[summary_word];
+            bitmap.summary[summary_word] = 0;
+
+            while (summary_bits != 0) {
+                const std::size_t word = summary_word * bits_per_word + std::countr_zero(summary_bits);
+                summary_bits &= summary_bits - 1;
+
+                std::uint64_t dirty_bits = bitmap.dirty[word];
+                bitmap.dirty[word] = 0;
+
+                while (dirty_bits != 0) {
+                    const auto price = static_cast<std::uint32_t>(word * bits_per_word + std::countr_zero(dirty_bits));
+                    dirty_bits &= dirty_bits - 1;
+
+                    const std::uint64_t value = latest_values[price].load(std::memory_order_relaxed);
+
+                    callback(LevelUpdate {
+                        .price = price,
+                        .size = static_cast<std::uint32_t>(value >> 32),
+                        .last_modified = static_cast<std::uint32_t>(value)
+                    });
+
+                    ++drained;
+                }
+            }
+        }
+
+        // Our bitmap is clean again, so the writer can have it back.
+        // ビットマップがまた綺麗になったので、書き込み側に返せる。
+        swaps_requested.store(++reader_swaps_requested, std::memory_order_release);
+
+        return drained;
+    }
+};
+
+}
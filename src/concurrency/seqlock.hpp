@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <new>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace nanofill::concurrency {
+
+// Publishes a small value from one writer thread to any number of reader threads. The writer
+// never waits for readers; instead, a reader that overlaps a write notices and tries again.
+// The whole thing lives on its own cache lines so it doesn't slow down anything next to it.
+// 一つの書き込みスレッドから複数の読み取りスレッドに小さい値を公開する。書き込み側は読み取り側を全く待た
+// ない。その代わりに、書き込みと重なった読み取り側が気づいて、やり直す。他のデータを遅くしないように、全体が
+// 独自のキャッシュラインにある。
+template<typename T>
+class alignas(std::hardware_destructive_interference_size) SeqLock {
+    static_assert(std::is_trivially_copyable_v<T>, "SeqLock requires trivially copyable T");
+
+    // The value is copied in and out as atomic words, so that a read racing a write is never
+    // undefined behaviour (it is just thrown away).
+    // 値はアトミックのワードとしてコピーするので、書き込みと競合する読み取りは未定義動作にならない
+    // （ただ捨てられる）。
+    static constexpr std::size_t word_count = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+    // Odd while a write is in progress.
+    // 書き込み中は奇数だ。
+    std::atomic<std::uint64_t> sequence{0};
+    std::atomic<std::uint64_t> words[word_count]{};
+
+public:
+    // Writer thread only.
+    // 書き込みスレッド専用。
+    [[gnu::always_inline]]
+    void store(const T& value) noexcept {
+        std::uint64_t raw[word_count]{};
+        std::memcpy(raw, &value, sizeof(T));
+
+        const std::uint64_t current_sequence = sequence.load(std::memory_order_relaxed);
+        sequence.store(current_sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (std::size_t i = 0; i < word_count; ++i) {
+            words[i].store(raw[i], std::memory_order_relaxed);
+        }
+
+        sequence.store(current_sequence + 2, std::memory_order_release);
+    }
+
+    // Try to read the value once. Returns false if a write got in the way.
+    // 一回値を読んでみる。書き込みが邪魔したら、falseを返す。
+    [[gnu::always_inline]]
+    bool try_load(T& value) const noexcept {
+        const std::uint64_t sequence_before = sequence.load(std::memory_order_acquire);
+
+        if (sequence_before & 1) {
+            return false;
+        }
+
+        std::uint64_t raw[word_count];
+
+        for (std::size_t i = 0; i < word_count; ++i) {
+            raw[i] = words[i].load(std::memory_order_relaxed);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (sequence.load(std::memory_order_relaxed) != sequence_before) {
+            return false;
+        }
+
+        std::memcpy(&value, raw, sizeof(T));
+
+        return true;
+    }
+
+    // Read the value, retrying until we get a consistent copy.
+    // 一貫したコピーが取れるまで繰り返して、値を読む。
+    T load() const noexcept {
+        T value;
+
+        while (!try_load(value)) {}
+
+        return value;
+    }
+};
+
+}
@@ -83,6 +83,16 @@ public:
         return number_to_pop;
     }
 
+    // How many items are waiting. Only exact on the consumer's side, and anything pushed meanwhile
+    // isn't counted.
+    // 待っているものの数。消費者側でしか正確ではなくて、その間に入れられたものは数えない。
+    std::size_t size() const noexcept {
+        const std::size_t current_tail = tail.load(std::memory_order_relaxed);
+        const std::size_t current_head = head.load(std::memory_order_acquire);
+
+        return (current_head - current_tail) & (N - 1);
+    }
+
     // Returns true if successful.
     // 成功なら、trueを返す。
     bool push(const T item) noexcept {
@@ -25,7 +25,7 @@ events_from_csv_data(const std::vector<consts::TradingDataCSVFormat>& csv_data)
     for (std::size_t i = 0; i < csv_data.size(); ++i) {
         const auto event_data = csv_data[i];
 
-        events[i].time = std::get<0>(event_data);
+        set_fractional_time(events[i], std::get<0>(event_data));
         events[i].type = static_cast<EventType>(std::get<1>(event_data));
         events[i].order_id = std::get<2>(event_data);
         events[i].size = std::get<3>(event_data) * std::get<5>(event_data);
@@ -35,4 +35,21 @@ events_from_csv_data(const std::vector<consts::TradingDataCSVFormat>& csv_data)
     return events;
 }
 
+const char* event_type_name(const EventType type) noexcept {
+    switch (type) {
+        case EventType::Submission:
+            return "submission";
+        case EventType::Cancellation:
+            return "cancellation";
+        case EventType::Deletion:
+            return "deletion";
+        case EventType::ExecutionVisible:
+            return "execution";
+        case EventType::ExecutionHidden:
+            return "hidden execution";
+        default:
+            return "unknown";
+    }
+}
+
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "consts/consts.hpp"
+#include <cmath>
 #include <cstdint>
 #include <vector>
 #include <new>
@@ -48,11 +49,45 @@ struct Event {
     // 株の数。ネガティブなら、これは売り注文だ。
     std::int16_t size;
     EventType type;
+    // Which instrument this event is for. Wide enough for every ITCH stock locate.
+    // このイベントの銘柄。ITCHの全ての銘柄の位置が収まる幅だ。
+    std::uint16_t symbol_id = 0;
+    // Nanoseconds into the second given by time, for data that says when within it.
+    // timが示す秒の中のナノ秒。秒の中のいつかが分かるデータのため。
+    std::uint32_t nanoseconds = 0;
 };
 
+static_assert(sizeof(Event) == 24, "Event should stay 24 bytes");
+
+constexpr std::uint64_t nanoseconds_per_second = 1000000000;
+
+// When an event happened in nanoseconds after midnight, for comparing times within a second.
+// イベントが発生したときの零時からのナノ秒。一秒の中の時を比べるため。
+[[gnu::always_inline]]
+inline std::uint64_t time_in_nanoseconds(const Event& event) noexcept {
+    return event.time * nanoseconds_per_second + event.nanoseconds;
+}
+
+// Set an event's time from seconds after midnight with a fraction, as LOBSTER writes them.
+// LOBSTERが書くような小数のある零時からの秒から、イベントの時を設定する。
+inline void set_fractional_time(Event& event, const double seconds) noexcept {
+    const auto nanoseconds = static_cast<std::uint64_t>(std::llround(seconds * static_cast<double>(nanoseconds_per_second)));
+
+    event.time = static_cast<std::uint32_t>(nanoseconds / nanoseconds_per_second);
+    event.nanoseconds = static_cast<std::uint32_t>(nanoseconds % nanoseconds_per_second);
+}
+
+// The number of distinct instruments an Event can refer to.
+// Eventが指せる銘柄の数。
+constexpr std::size_t max_symbols = 65536;
+
 std::vector<Event>
 events_from_csv_data(const std::vector<consts::TradingDataCSVFormat>& csv_data);
 
 void print_event(const Event event);
 
+// A short lowercase name for the type, or "unknown".
+// 種類の短い小文字の名前か、"unknown"。
+const char* event_type_name(const EventType type) noexcept;
+
 }
\ No newline at end of file
@@ -0,0 +1,248 @@
+#pragma once
+
+#include "stats/latencyhistogram.hpp"
+#include "stats/tsc.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+
+namespace nanofill::feed {
+
+// Exchanges send every message on two identical lines, A and B, so one can be lost without the
+// other.
+// 取引所は全てのメッセージを二つの同じ回線AとBで送るので、片方が失われても、もう片方は失われない。
+enum class Line : std::uint8_t {
+    A = 0,
+    B = 1
+};
+
+// Something from one line, with its sequence number and the TSC when it arrived.
+// 一つの回線からのもの。そのシーケンス番号と、届いたときのTSC付き。
+template<typename T>
+struct Sequenced {
+    // Starts at 1, like MoldUDP64.
+    // MoldUDP64のように1から始まる。
+    std::uint64_t sequence;
+    std::uint64_t arrival_tsc;
+    T payload;
+};
+
+struct LineStats {
+    std::uint64_t received = 0;
+    // Messages this line delivered before the other one.
+    // この回線がもう片方より先に届けたメッセージ。
+    std::uint64_t first = 0;
+    // Messages the other line had already delivered.
+    // もう片方がもう届けたメッセージ。
+    std::uint64_t second = 0;
+    // Copies too old to compare with anything, e.g. after the window moved past them.
+    // 何とも比べられないほど古いコピー。例えば、窓が通り過ぎた後のもの。
+    std::uint64_t stale = 0;
+    // When this line was first and the other copy turned up too, how many nanoseconds ahead it was.
+    // この回線が先で、もう片方のコピーも来たとき、何ナノ秒先だったか。
+    stats::LatencyHistogram lead;
+};
+
+struct ArbiterStats {
+    std::uint64_t released = 0;
+    // Messages that arrived ahead of one still missing, and had to wait in the window.
+    // まだ欠けているものより先に届いて、窓で待たなければならなかったメッセージ。
+    std::uint64_t out_of_order = 0;
+    // Runs of sequence numbers neither line delivered before the window moved past them.
+    // 窓が通り過ぎる前にどちらの回線も届けなかったシーケンス番号の連続。
+    std::uint64_t gaps = 0;
+    std::uint64_t missing = 0;
+};
+
+// Merges the A and B lines, releasing each sequence number exactly once and in order, from
+// whichever line had it first. Anything that arrives ahead of a missing message waits in a window of
+// the last Window sequence numbers. When something arrives too far ahead to fit, the missing
+// messages are given up on, the ones waiting are released, and the gap is counted.
+//
+// The window also remembers which line each released message came from and when, so the second
+// copy can be timed against the first. It's all fixed-size arrays used from one thread, with no
+// locks or allocation.
+//
+// Sequence numbers have to mean one T each. For a MoldUDP64 feed that's one message, not one
+// event, so arbitrate the raw messages (see LineSplitter) and decode what's released.
+// AとBの回線を合わせて、各シーケンス番号を先に持っていた回線から、正確に一回、順番に出す。欠けている
+// メッセージより先に届いたものは、最後のWindow個のシーケンス番号の窓で待つ。収まらないほど先のものが届いたら、
+// 欠けているメッセージを諦めて、待っているものを出して、ギャップを数える。
+//
+// 窓は出した各メッセージがどの回線からいつ来たかも覚えているので、二つ目のコピーを一つ目と比べて測れる。全部
+// 一つのスレッドから使う固定サイズの配列で、ロックも割り当てもない。
+//
+// シーケンス番号は一つのTにつき一つでなければならない。MoldUDP64のフィードではそれはイベントではなく
+// メッセージなので、生のメッセージを調停して（LineSplitterを参照）、出したものをデコードして。
+template<typename T, std::size_t Window = 256>
+class FeedArbiter {
+    static_assert(std::has_single_bit(Window), "Window must be a power of 2");
+
+    struct Slot {
+        // 0 means the slot has never been used.
+        // 0はスロットが一度も使われていないことを意味する。
+        std::uint64_t sequence = 0;
+        std::uint64_t arrival_tsc = 0;
+        Line line = Line::A;
+        bool pending = false;
+        // Whether the other line's copy has turned up too.
+        // もう片方の回線のコピーも来たか。
+        bool duplicated = false;
+        T payload{};
+    };
+
+    std::array<Slot, Window> slots;
+    std::uint64_t next_sequence = 1;
+    std::array<LineStats, 2> lines;
+    ArbiterStats stats;
+    double nanoseconds_per_tick = 1 / stats::tsc_ticks_per_nanosecond();
+
+    [[gnu::always_inline]]
+    static constexpr std::size_t slot_of(const std::uint64_t sequence) noexcept {
+        return sequence & (Window - 1);
+    }
+
+    // Time a second copy against the first, crediting the line that won.
+    // 二つ目のコピーを一つ目と比べて測って、勝った回線の手柄にする。
+    [[gnu::always_inline]]
+    void record_second(const Line line, Slot& winner, const std::uint64_t arrival_tsc) noexcept {
+        if (winner.line == line || winner.duplicated) [[unlikely]] {
+            // A line sent it twice.
+            // 回線が二回送った。
+            ++lines[static_cast<std::size_t>(line)].stale;
+
+            return;
+        }
+
+        winner.duplicated = true;
+
+        const std::uint64_t ticks = arrival_tsc > winner.arrival_tsc ? arrival_tsc - winner.arrival_tsc : 0;
+        const double nanoseconds = std::min(ticks * nanoseconds_per_tick, 4e9);
+
+        ++lines[static_cast<std::size_t>(line)].second;
+        lines[static_cast<std::size_t>(winner.line)].lead.record(static_cast<std::uint32_t>(nanoseconds));
+    }
+
+    template<typename Release>
+    [[gnu::always_inline]]
+    void release_ready(Release& release) noexcept {
+        for (Slot* slot = &slots[slot_of(next_sequence)]; slot->pending && slot->sequence == next_sequence;
+            slot = &slots[slot_of(next_sequence)]) {
+            slot->pending = false;
+            release(slot->payload);
+            ++stats.released;
+            ++next_sequence;
+        }
+    }
+
+    // Give up on everything missing before sequence, releasing whatever has arrived in between.
+    // sequenceより前に欠けているものを全部諦めて、その間に届いたものを出す。
+    template<typename Release>
+    [[gnu::noinline]]
+    void skip_to(const std::uint64_t sequence, Release& release) noexcept {
+        bool in_gap = false;
+
+        while (next_sequence < sequence) {
+            Slot& slot = slots[slot_of(next_sequence)];
+
+            if (slot.pending && slot.sequence == next_sequence) {
+                slot.pending = false;
+                release(slot.payload);
+                ++stats.released;
+                in_gap = false;
+            } else {
+                stats.gaps += !in_gap;
+                ++stats.missing;
+                in_gap = true;
+            }
+
+            ++next_sequence;
+        }
+    }
+
+public:
+    // Take one message from a line, calling release for it (and anything it was holding up) if it's
+    // the next one due.
+    // 回線から一つのメッセージを受け取って、次の番なら、それ（とそれが止めていたもの）でreleaseを呼ぶ。
+    template<typename Release>
+    [[gnu::always_inline]]
+    void on_message(const Line line, const Sequenced<T>& message, Release&& release) noexcept {
+        LineStats& line_stats = lines[static_cast<std::size_t>(line)];
+        const std::uint64_t sequence = message.sequence;
+
+        ++line_stats.received;
+
+        if (sequence < next_sequence) {
+            // Released already, so this is the second copy (or one we gave up on).
+            // もう出したので、これは二つ目のコピー（または諦めたもの）だ。
+            Slot& slot = slots[slot_of(sequence)];
+
+            if (slot.sequence == sequence) {
+                record_second(line, slot, message.arrival_tsc);
+            } else {
+                ++line_stats.stale;
+            }
+
+            return;
+        }
+
+        if (sequence - next_sequence >= Window) [[unlikely]] {
+            skip_to(sequence - Window + 1, release);
+            release_ready(release);
+        }
+
+        Slot& slot = slots[slot_of(sequence)];
+
+        if (slot.sequence == sequence) {
+            // Both copies are waiting behind a missing message.
+            // 両方のコピーが欠けているメッセージの後ろで待っている。
+            record_second(line, slot, message.arrival_tsc);
+
+            return;
+        }
+
+        slot.sequence = sequence;
+        slot.arrival_tsc = message.arrival_tsc;
+        slot.line = line;
+        slot.pending = true;
+        slot.duplicated = false;
+        slot.payload = message.payload;
+        ++line_stats.first;
+
+        if (sequence == next_sequence) [[likely]] {
+            release_ready(release);
+        } else {
+            ++stats.out_of_order;
+        }
+    }
+
+    // Give up on anything still missing and release everything waiting, e.g. once both lines end.
+    // まだ欠けているものを諦めて、待っているものを全部出す。例えば、両方の回線が終わったとき。
+    template<typename Release>
+    void flush(Release&& release) noexcept {
+        std::uint64_t last = next_sequence;
+
+        for (const Slot& slot : slots) {
+            if (slot.pending) {
+                last = std::max(last, slot.sequence + 1);
+            }
+        }
+
+        skip_to(last, release);
+    }
+
+    std::uint64_t get_next_sequence() const noexcept {
+        return next_sequence;
+    }
+
+    const LineStats& get_line_stats(const Line line) const noexcept {
+        return lines[static_cast<std::size_t>(line)];
+    }
+
+    const ArbiterStats& get_stats() const noexcept {
+        return stats;
+    }
+};
+
+}
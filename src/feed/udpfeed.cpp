@@ -0,0 +1,284 @@
+#include "udpfeed.hpp"
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace nanofill::feed {
+
+namespace mold {
+
+void write_header(std::uint8_t* packet, const std::uint64_t sequence, const std::uint16_t count) noexcept {
+    const std::uint64_t sequence_big_endian = std::byteswap(sequence);
+    const std::uint16_t count_big_endian = std::byteswap(count);
+
+    std::memcpy(packet, "NANOFILL  ", session_length);
+    std::memcpy(packet + sequence_offset, &sequence_big_endian, sizeof(sequence_big_endian));
+    std::memcpy(packet + count_offset, &count_big_endian, sizeof(count_big_endian));
+}
+
+}
+
+namespace {
+
+// Parse host:port, where host is an IPv4 address.
+// host:portを解析する。hostはIPv4のアドレスだ。
+sockaddr_in parse_address(const std::string& address) {
+    const std::size_t colon = address.rfind(':');
+    sockaddr_in result {};
+
+    result.sin_family = AF_INET;
+
+    if (colon == std::string::npos || inet_pton(AF_INET, address.substr(0, colon).c_str(), &result.sin_addr) != 1) {
+        throw std::invalid_argument("Expected an IPv4 address and port like 127.0.0.1:5000, not " + address);
+    }
+
+    result.sin_port = htons(static_cast<std::uint16_t>(std::stoul(address.substr(colon + 1))));
+
+    return result;
+}
+
+bool is_multicast(const sockaddr_in& address) noexcept {
+    return IN_MULTICAST(ntohl(address.sin_addr.s_addr));
+}
+
+// Bigger socket buffers ride out the consumer falling behind for a moment without dropping
+// datagrams. The kernel caps them at net.core.rmem_max and wmem_max, which is fine.
+// ソケットのバッファが大きいと、消費者が一瞬遅れてもデータグラムを落とさずに済む。カーネルは
+// net.core.rmem_maxとwmem_maxで上限を付けるが、それで構わない。
+constexpr int socket_buffer_size = 16 << 20;
+
+int open_socket(const std::string& address, const int flags) {
+    const int result = ::socket(AF_INET, SOCK_DGRAM | flags, 0);
+
+    if (result == -1) {
+        throw std::runtime_error("Could not create a UDP socket for " + address + ": " + std::strerror(errno));
+    }
+
+    return result;
+}
+
+[[noreturn]]
+void close_and_throw(const int socket, const std::string& message) {
+    const std::string reason = std::strerror(errno);
+
+    close(socket);
+    throw std::runtime_error(message + ": " + reason);
+}
+
+}
+
+struct UdpReceiver::Buffers {
+    std::array<std::array<std::uint8_t, mold::max_packet_size>, batch_size> datagrams;
+    std::array<iovec, batch_size> vectors;
+    std::array<mmsghdr, batch_size> headers;
+};
+
+UdpReceiver::UdpReceiver(const std::string& address) : buffers(std::make_unique<Buffers>()) {
+    sockaddr_in local = parse_address(address);
+    const bool multicast = is_multicast(local);
+    const int enable = 1;
+
+    socket = open_socket(address, SOCK_NONBLOCK);
+
+    // Let several readers listen to the same group.
+    // 複数の読み手が同じグループを聞けるようにする。
+    setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    setsockopt(socket, SOL_SOCKET, SO_RCVBUF, &socket_buffer_size, sizeof(socket_buffer_size));
+
+    sockaddr_in bound = local;
+
+    if (multicast) {
+        bound.sin_addr.s_addr = htonl(INADDR_ANY);
+    }
+
+    if (bind(socket, reinterpret_cast<const sockaddr*>(&bound), sizeof(bound)) != 0) {
+        close_and_throw(socket, "Could not bind to " + address);
+    }
+
+    if (multicast) {
+        const ip_mreq membership { .imr_multiaddr = local.sin_addr, .imr_interface = { htonl(INADDR_ANY) } };
+
+        if (setsockopt(socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0) {
+            close_and_throw(socket, "Could not join multicast group " + address);
+        }
+    }
+
+    socklen_t length = sizeof(bound);
+    getsockname(socket, reinterpret_cast<sockaddr*>(&bound), &length);
+    port = ntohs(bound.sin_port);
+
+    // Spin in the driver for up to this many microseconds on each receive instead of waiting for an
+    // interrupt. Raising it above net.core.busy_read needs CAP_NET_ADMIN, so it's fine if this fails.
+    // 各受信で割り込みを待つ代わりに、最大でこのマイクロ秒数だけドライバでスピンする。net.core.busy_readより
+    // 上げるにはCAP_NET_ADMINが要るので、失敗しても構わない。
+#ifdef SO_BUSY_POLL
+    const int busy_poll_microseconds = 50;
+    busy_polling = setsockopt(socket, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_microseconds, sizeof(busy_poll_microseconds)) == 0;
+#endif
+#ifdef SO_PREFER_BUSY_POLL
+    if (busy_polling) {
+        setsockopt(socket, SOL_SOCKET, SO_PREFER_BUSY_POLL, &enable, sizeof(enable));
+    }
+#endif
+
+    for (unsigned int i = 0; i < batch_size; ++i) {
+        buffers->vectors[i] = iovec { .iov_base = buffers->datagrams[i].data(), .iov_len = mold::max_packet_size };
+        buffers->headers[i] = mmsghdr {};
+        buffers->headers[i].msg_hdr.msg_iov = &buffers->vectors[i];
+        buffers->headers[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+UdpReceiver::~UdpReceiver() {
+    close(socket);
+}
+
+unsigned int UdpReceiver::receive_batch() noexcept {
+    const int received = recvmmsg(socket, buffers->headers.data(), batch_size, MSG_DONTWAIT, nullptr);
+
+    return received > 0 ? received : 0;
+}
+
+std::span<const std::uint8_t> UdpReceiver::get_datagram(const unsigned int index) const noexcept {
+    const mmsghdr& header = buffers->headers[index];
+
+    // A datagram too big for the buffer is cut short, so hand it on empty to be counted as bad.
+    // バッファに大きすぎるデータグラムは切られるので、不正として数えられるように空で渡す。
+    if (header.msg_hdr.msg_flags & MSG_TRUNC) [[unlikely]] {
+        return {};
+    }
+
+    return { buffers->datagrams[index].data(), header.msg_len };
+}
+
+SenderStats send_itch_feed(const std::span<const std::uint8_t> messages, const std::string& address, const SenderOptions& options) {
+    constexpr unsigned int batch_size = UdpReceiver::batch_size;
+
+    if (options.max_packet_size < mold::header_length + 2 || options.max_packet_size > mold::max_packet_size) {
+        throw std::invalid_argument("The packet size must be between the header size and " + std::to_string(mold::max_packet_size));
+    }
+
+    const sockaddr_in remote = parse_address(address);
+    const int socket = open_socket(address, 0);
+
+    setsockopt(socket, SOL_SOCKET, SO_SNDBUF, &socket_buffer_size, sizeof(socket_buffer_size));
+
+    if (is_multicast(remote)) {
+        // Loop back so a receiver on the same machine sees the group, and stay on this network.
+        // 同じマシンの受信者にグループが見えるようにループバックして、このネットワークに留まる。
+        const int loop = 1;
+        const int ttl = 1;
+        setsockopt(socket, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+        setsockopt(socket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    }
+
+    if (connect(socket, reinterpret_cast<const sockaddr*>(&remote), sizeof(remote)) != 0) {
+        close_and_throw(socket, "Could not connect to " + address);
+    }
+
+    auto packets = std::make_unique<std::array<std::array<std::uint8_t, mold::max_packet_size>, batch_size>>();
+    std::array<iovec, batch_size> vectors;
+    std::array<mmsghdr, batch_size> headers {};
+    unsigned int pending = 0;
+    SenderStats stats;
+    std::uint64_t sequence = 1;
+    std::size_t position = 0;
+
+    for (unsigned int i = 0; i < batch_size; ++i) {
+        vectors[i].iov_base = (*packets)[i].data();
+        headers[i].msg_hdr.msg_iov = &vectors[i];
+        headers[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    const auto flush = [&] {
+        unsigned int sent = 0;
+
+        while (sent < pending) {
+            const int result = sendmmsg(socket, headers.data() + sent, pending - sent, 0);
+
+            if (result > 0) {
+                sent += result;
+            } else if (errno == ECONNREFUSED) {
+                // Nobody is listening on loopback yet, so this one is lost, like it would be on a
+                // real network.
+                // ループバックでまだ誰も聞いていないので、これは失われる。本当のネットワークと同じだ。
+                ++sent;
+            } else if (errno != EINTR && errno != ENOBUFS && errno != EAGAIN) {
+                close_and_throw(socket, "Could not send to " + address);
+            }
+        }
+
+        stats.packets += pending;
+        pending = 0;
+    };
+
+    const auto clock_start = std::chrono::steady_clock::now();
+
+    while (messages.size() - position >= 2) {
+        // Wait until the first message in this packet is due, sending anything waiting first.
+        // このパケットの最初のメッセージの時間まで待つ。待っているものを先に送る。
+        if (options.messages_per_second > 0) {
+            const auto due = clock_start + std::chrono::duration<double>((sequence - 1) / options.messages_per_second);
+
+            if (std::chrono::steady_clock::now() < due) {
+                flush();
+
+                while (std::chrono::steady_clock::now() < due) {}
+            }
+        }
+
+        std::uint8_t* packet = (*packets)[pending].data();
+        std::size_t size = mold::header_length;
+        std::uint16_t count = 0;
+
+        while (messages.size() - position >= 2 && count < mold::end_of_session - 1) {
+            const std::size_t length = 2 + fileio::itch::load_big_endian<std::uint16_t>(messages.data() + position);
+
+            if (messages.size() - position < length || size + length > options.max_packet_size) {
+                break;
+            }
+
+            std::memcpy(packet + size, messages.data() + position, length);
+            size += length;
+            position += length;
+            ++count;
+        }
+
+        if (count == 0) {
+            // Either the input ends part way through a message, or a message is bigger than a packet.
+            // 入力がメッセージの途中で終わるか、メッセージがパケットより大きい。
+            break;
+        }
+
+        mold::write_header(packet, sequence, count);
+        vectors[pending].iov_len = size;
+        sequence += count;
+        stats.messages += count;
+
+        if (++pending == batch_size) {
+            flush();
+        }
+    }
+
+    flush();
+
+    for (unsigned int i = 0; i < options.end_of_session_repeats; ++i) {
+        mold::write_header((*packets)[0].data(), sequence, mold::end_of_session);
+        vectors[0].iov_len = mold::header_length;
+        pending = 1;
+        flush();
+    }
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - clock_start).count();
+    close(socket);
+
+    return stats;
+}
+
+}
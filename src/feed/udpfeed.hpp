@@ -0,0 +1,357 @@
+#pragma once
+
+#include "arbiter.hpp"
+#include "fileio/itchdecoder.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace nanofill::feed {
+
+using events::Event;
+
+// Datagrams are framed like NASDAQ's MoldUDP64: a 10-byte session, the sequence number of the first
+// message, a message count and then that many length-prefixed ITCH messages. A count of
+// end_of_session means the sender has nothing more to send.
+// データグラムはNASDAQのMoldUDP64のように枠付けする：10バイトのセッション、最初のメッセージのシーケンス番号、
+// メッセージの数、そしてその数の長さを前に付けたITCHのメッセージ。数がend_of_sessionなら、送信者にはもう
+// 送るものがない。
+namespace mold {
+
+constexpr std::size_t session_length = 10;
+constexpr std::size_t sequence_offset = 10;
+constexpr std::size_t count_offset = 18;
+constexpr std::size_t header_length = 20;
+constexpr std::uint16_t end_of_session = 0xFFFF;
+// Fits in a standard Ethernet frame after the IP and UDP headers.
+// IPとUDPのヘッダの後で、普通のイーサネットのフレームに収まる。
+constexpr std::size_t max_packet_size = 1472;
+
+struct PacketHeader {
+    std::uint64_t sequence;
+    std::uint16_t count;
+};
+
+[[gnu::always_inline]]
+inline PacketHeader read_header(const std::uint8_t* packet) noexcept {
+    return PacketHeader {
+        .sequence = fileio::itch::load_big_endian<std::uint64_t>(packet + sequence_offset),
+        .count = fileio::itch::load_big_endian<std::uint16_t>(packet + count_offset)
+    };
+}
+
+// Write a header at the start of packet, with the session "NANOFILL".
+// packetの最初にヘッダを書く。セッションは"NANOFILL"だ。
+void write_header(std::uint8_t* packet, std::uint64_t sequence, std::uint16_t count) noexcept;
+
+// Call on_message with the sequence number and bytes (without the length prefix) of each message
+// in a packet whose header has been read already. Returns false if the packet was cut short, after
+// passing on the messages before the cut.
+// ヘッダをもう読んだパケットの各メッセージのシーケンス番号とバイト（長さの前置きなし）でon_messageを呼ぶ。
+// パケットが短く切れていたら、切れた所の前のメッセージを渡してから、falseを返す。
+template<typename OnMessage>
+[[gnu::always_inline]]
+inline bool for_each_message(const std::span<const std::uint8_t> packet, const PacketHeader header, OnMessage&& on_message) noexcept {
+    std::size_t position = header_length;
+
+    for (std::uint16_t i = 0; i < header.count; ++i) {
+        if (packet.size() - position < 2) [[unlikely]] {
+            return false;
+        }
+
+        const std::size_t length = fileio::itch::load_big_endian<std::uint16_t>(packet.data() + position);
+
+        if (packet.size() - position - 2 < length) [[unlikely]] {
+            return false;
+        }
+
+        on_message(header.sequence + i, packet.subspan(position + 2, length));
+        position += 2 + length;
+    }
+
+    return true;
+}
+
+}
+
+// What the feed handler has seen.
+// フィードハンドラーが見たもの。
+struct FeedStats {
+    std::uint64_t packets = 0;
+    std::uint64_t messages = 0;
+    std::uint64_t events = 0;
+    // Times the sequence number jumped forward, and how many messages were skipped over in total.
+    // シーケンス番号が前に跳んだ回数と、合計で飛ばされたメッセージの数。
+    std::uint64_t gaps = 0;
+    std::uint64_t missing_messages = 0;
+    // Packets that only had messages we'd already seen.
+    // もう見たメッセージしかなかったパケット。
+    std::uint64_t duplicate_packets = 0;
+    // Packets that were cut short or didn't hold the messages their header said.
+    // 短く切れたか、ヘッダが言うメッセージを持っていなかったパケット。
+    std::uint64_t bad_packets = 0;
+};
+
+// Turns sequenced packets into events, checking the sequence numbers as it goes. A gap is counted
+// and then skipped over, since there's no retransmission server to ask; orders added in the gap
+// then show up as the decoder's unknown orders. Messages older than the next one expected are
+// dropped, so a repeated packet is harmless.
+//
+// Kept apart from the socket so it can be fed packets from anywhere.
+// シーケンス付きのパケットをイベントに変えて、同時にシーケンス番号を確認する。問い合わせる再送サーバーがない
+// ので、ギャップは数えてから飛び越える。ギャップで追加された注文はその後デコーダーの不明な注文として現れる。
+// 次に期待するものより古いメッセージは捨てるので、繰り返されたパケットは無害だ。
+//
+// どこからでもパケットを渡せるように、ソケットから分けてある。
+class FeedHandler {
+    fileio::ItchDecoder decoder;
+    std::uint64_t next_sequence = 1;
+    bool ended = false;
+    FeedStats stats;
+
+public:
+    explicit FeedHandler(std::size_t max_live_orders = 1 << 22, const fileio::ItchFilter& filter = {})
+        : decoder(max_live_orders, filter) {}
+
+    // Decode one packet, calling on_event for each event in it.
+    // 一つのパケットをデコードして、その中の各イベントでon_eventを呼ぶ。
+    template<typename OnEvent>
+    [[gnu::always_inline]]
+    void on_packet(const std::span<const std::uint8_t> packet, OnEvent&& on_event) noexcept {
+        ++stats.packets;
+
+        if (packet.size() < mold::header_length) [[unlikely]] {
+            ++stats.bad_packets;
+
+            return;
+        }
+
+        const mold::PacketHeader header = mold::read_header(packet.data());
+
+        if (header.count == mold::end_of_session) [[unlikely]] {
+            ended = true;
+
+            return;
+        }
+
+        if (header.sequence > next_sequence) [[unlikely]] {
+            ++stats.gaps;
+            stats.missing_messages += header.sequence - next_sequence;
+            next_sequence = header.sequence;
+        }
+
+        if (header.sequence + header.count <= next_sequence) [[unlikely]] {
+            ++stats.duplicate_packets;
+
+            return;
+        }
+
+        // Skip whatever we've already seen.
+        // もう見たものを飛ばす。
+        const bool complete = mold::for_each_message(packet, header, [&](const std::uint64_t sequence, const std::span<const std::uint8_t> message) {
+            if (sequence >= next_sequence) {
+                decoder.decode_message(message.data(), message.size(), [&](const Event& event) {
+                    ++stats.events;
+                    on_event(event);
+                });
+                ++stats.messages;
+                ++next_sequence;
+            }
+        });
+
+        stats.bad_packets += !complete;
+    }
+
+    // Whether the sender said it had finished.
+    // 送信者が終わったと言ったか。
+    bool has_ended() const noexcept {
+        return ended;
+    }
+
+    std::uint64_t get_next_sequence() const noexcept {
+        return next_sequence;
+    }
+
+    const FeedStats& get_stats() const noexcept {
+        return stats;
+    }
+
+    const fileio::ItchDecoder& get_decoder() const noexcept {
+        return decoder;
+    }
+};
+
+// One ITCH message copied out of its packet, so that it can wait in a FeedArbiter's window.
+// FeedArbiterの窓で待てるように、パケットからコピーした一つのITCHのメッセージ。
+struct ItchMessage {
+    // Room for ITCH 5.0's longest message (50 bytes), rounding the whole thing up to 64 bytes.
+    // ITCH 5.0の一番長いメッセージ（50バイト）の場所。全体を64バイトに切り上げる。
+    static constexpr std::size_t max_length = 62;
+
+    std::uint16_t length;
+    std::array<std::uint8_t, max_length> bytes;
+};
+
+// What a LineSplitter has seen on its line.
+// LineSplitterがその回線で見たもの。
+struct LineFeedStats {
+    std::uint64_t packets = 0;
+    std::uint64_t messages = 0;
+    // Packets that were cut short or didn't hold the messages their header said.
+    // 短く切れたか、ヘッダが言うメッセージを持っていなかったパケット。
+    std::uint64_t bad_packets = 0;
+    // Messages too long for an ItchMessage, which are passed on empty so their sequence number
+    // isn't counted as missing. The decoder skips them.
+    // ItchMessageには長すぎるメッセージ。シーケンス番号が欠けていると数えられないように空で渡す。デコーダーは
+    // それを飛ばす。
+    std::uint64_t long_messages = 0;
+};
+
+// Splits one line of an A/B feed into sequenced messages for a FeedArbiter, without decoding them.
+// MoldUDP64 numbers messages rather than events, and one message can make more than one event (a
+// replace makes two), so the lines have to be merged by message before a single decoder sees them.
+// A/Bのフィードの一つの回線を、デコードせずにFeedArbiterのためのシーケンス付きのメッセージに分ける。
+// MoldUDP64はイベントではなくメッセージに番号を付けて、一つのメッセージが二つ以上のイベントを作りうる（置き換え
+// は二つ作る）ので、一つのデコーダーが見る前に、回線をメッセージで合わせなければならない。
+class LineSplitter {
+    LineFeedStats stats;
+    bool ended = false;
+
+public:
+    // Split one packet, calling on_message with a Sequenced<ItchMessage> for each message in it.
+    // 一つのパケットを分けて、その中の各メッセージでSequenced<ItchMessage>を渡してon_messageを呼ぶ。
+    template<typename OnMessage>
+    [[gnu::always_inline]]
+    void on_packet(const std::span<const std::uint8_t> packet, const std::uint64_t arrival_tsc, OnMessage&& on_message) noexcept {
+        ++stats.packets;
+
+        if (packet.size() < mold::header_length) [[unlikely]] {
+            ++stats.bad_packets;
+
+            return;
+        }
+
+        const mold::PacketHeader header = mold::read_header(packet.data());
+
+        if (header.count == mold::end_of_session) [[unlikely]] {
+            ended = true;
+
+            return;
+        }
+
+        const bool complete = mold::for_each_message(packet, header, [&](const std::uint64_t sequence, const std::span<const std::uint8_t> message) {
+            Sequenced<ItchMessage> sequenced { .sequence = sequence, .arrival_tsc = arrival_tsc, .payload = { .length = 0, .bytes = {} } };
+
+            if (message.size() <= ItchMessage::max_length) [[likely]] {
+                sequenced.payload.length = static_cast<std::uint16_t>(message.size());
+                std::copy(message.begin(), message.end(), sequenced.payload.bytes.begin());
+            } else {
+                ++stats.long_messages;
+            }
+
+            ++stats.messages;
+            on_message(sequenced);
+        });
+
+        stats.bad_packets += !complete;
+    }
+
+    // Whether the sender said it had finished.
+    // 送信者が終わったと言ったか。
+    bool has_ended() const noexcept {
+        return ended;
+    }
+
+    const LineFeedStats& get_stats() const noexcept {
+        return stats;
+    }
+};
+
+// A UDP socket that receives datagrams in batches with recvmmsg. The address is host:port; a
+// multicast host is joined on every interface, and anything else (e.g. 127.0.0.1) is bound to
+// directly. Port 0 picks a free port, which get_port() then returns.
+//
+// The socket asks the kernel to busy-poll the device queue where SO_BUSY_POLL is available, and
+// receive() never blocks, so the thread calling it spins like the rest of the pipeline.
+// Throws if the socket can't be set up.
+// recvmmsgでデータグラムをバッチで受け取るUDPソケット。アドレスはhost:portだ。マルチキャストのホストには全ての
+// インターフェースで参加して、他のもの（例えば127.0.0.1）には直接バインドする。ポート0は空いているポートを
+// 選んで、get_port()がそれを返す。
+//
+// SO_BUSY_POLLが使えるところでは、カーネルにデバイスのキューをビジーポーリングするように頼んで、receive()は
+// 決してブロックしないので、それを呼ぶスレッドはパイプラインの他の部分と同じくスピンする。ソケットが用意
+// できなかったら、投げる。
+class UdpReceiver {
+public:
+    static constexpr unsigned int batch_size = 64;
+
+private:
+    struct Buffers;
+
+    int socket = -1;
+    std::uint16_t port = 0;
+    bool busy_polling = false;
+    std::unique_ptr<Buffers> buffers;
+
+    // Receive up to batch_size datagrams without waiting, returning how many came (0 if none did).
+    // 待たずにbatch_size個までのデータグラムを受け取って、来た数を返す（何も来なかったら0）。
+    unsigned int receive_batch() noexcept;
+    std::span<const std::uint8_t> get_datagram(unsigned int index) const noexcept;
+
+public:
+    explicit UdpReceiver(const std::string& address);
+    ~UdpReceiver();
+    UdpReceiver(const UdpReceiver&) = delete;
+    UdpReceiver& operator=(const UdpReceiver&) = delete;
+
+    // Call on_datagram for each waiting datagram, up to one batch. Returns how many there were.
+    // 待っている各データグラムで、一つのバッチまでon_datagramを呼ぶ。その数を返す。
+    template<typename OnDatagram>
+    unsigned int receive(OnDatagram&& on_datagram) noexcept {
+        const unsigned int received = receive_batch();
+
+        for (unsigned int i = 0; i < received; ++i) {
+            on_datagram(get_datagram(i));
+        }
+
+        return received;
+    }
+
+    std::uint16_t get_port() const noexcept {
+        return port;
+    }
+
+    bool is_busy_polling() const noexcept {
+        return busy_polling;
+    }
+};
+
+struct SenderOptions {
+    // 0 sends as fast as the socket takes them.
+    // 0はソケットが受け取るだけ速く送る。
+    double messages_per_second = 0;
+    std::size_t max_packet_size = mold::max_packet_size;
+    // How many times to send the end of session packet, in case some are dropped.
+    // 落とされる場合のため、セッションの終わりのパケットを送る回数。
+    unsigned int end_of_session_repeats = 3;
+};
+
+struct SenderStats {
+    std::uint64_t packets = 0;
+    std::uint64_t messages = 0;
+    double seconds = 0;
+};
+
+// Replay length-prefixed ITCH messages (e.g. a NASDAQ file) to address as sequenced datagrams,
+// packing as many messages into each as fit and pacing them to the given rate. Packets that are
+// already due are sent together with sendmmsg. Throws if the socket can't be set up.
+// 長さを前に付けたITCHのメッセージ（例えばNASDAQのファイル）をシーケンス付きのデータグラムとしてaddressに
+// 再生する。各データグラムに収まるだけのメッセージを詰めて、与えられたレートに合わせる。もう送るべき
+// パケットはsendmmsgで一緒に送る。ソケットが用意できなかったら、投げる。
+SenderStats send_itch_feed(std::span<const std::uint8_t> messages, const std::string& address, const SenderOptions& options = {});
+
+}
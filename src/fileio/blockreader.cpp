@@ -0,0 +1,201 @@
+#include "blockreader.hpp"
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <zlib.h>
+
+extern char** environ;
+
+namespace nanofill::fileio {
+
+BlockReader::BlockReader(const std::string& path) : blocks(std::make_unique<Block[]>(stream_block_count)) {
+    if (path == "-") {
+        file = STDIN_FILENO;
+    } else if (path.ends_with(".zst")) {
+        // There's no zstd library to link against, so let the zstd tool do it in its own process
+        // and read what it writes to a pipe.
+        // リンクできるzstdのライブラリがないので、zstdツールに独自のプロセスで解凍させて、パイプに書いたものを読む。
+        int pipe_ends[2];
+
+        if (pipe(pipe_ends) != 0) {
+            throw std::runtime_error("Could not create a pipe for " + path);
+        }
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, pipe_ends[1], STDOUT_FILENO);
+        posix_spawn_file_actions_addclose(&actions, pipe_ends[0]);
+        posix_spawn_file_actions_addclose(&actions, pipe_ends[1]);
+
+        const char* arguments[] = { "zstd", "-dcq", "--", path.c_str(), nullptr };
+        const int result = posix_spawnp(&decompressor, "zstd", &actions, nullptr, const_cast<char**>(arguments), environ);
+
+        posix_spawn_file_actions_destroy(&actions);
+        close(pipe_ends[1]);
+
+        if (result != 0) {
+            close(pipe_ends[0]);
+            throw std::runtime_error("Could not start zstd to read " + path);
+        }
+
+        file = pipe_ends[0];
+    } else {
+        file = open(path.c_str(), O_RDONLY);
+
+        if (file == -1) {
+            throw std::runtime_error("Could not open file " + path);
+        }
+
+        posix_fadvise(file, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        if (path.ends_with(".gz")) {
+            gz_file = gzdopen(file, "rb");
+
+            if (gz_file == nullptr) {
+                close(file);
+                throw std::runtime_error("Could not open gzip file " + path);
+            }
+
+            gzbuffer(static_cast<gzFile>(gz_file), stream_block_size);
+        }
+    }
+
+    for (std::uint32_t i = 0; i < stream_block_count; ++i) {
+        empty_blocks.push(i);
+    }
+
+    thread = std::thread(&BlockReader::read_blocks, this);
+}
+
+BlockReader::~BlockReader() {
+    // The reading thread only ever waits on the input or on us, so this can't hang unless the
+    // input itself does (e.g. a terminal on stdin).
+    // 読み込みスレッドは入力か自分しか待たないので、入力そのもの（例えば、標準入力の端末）が止まらない限り、
+    // これは止まらない。
+    stopping.store(true, std::memory_order_release);
+    thread.join();
+
+    if (gz_file != nullptr) {
+        gzclose(static_cast<gzFile>(gz_file));
+    } else if (file != STDIN_FILENO) {
+        // If we stopped early, this makes zstd exit on its next write.
+        // 途中で止めたら、これでzstdが次の書き込みで終了する。
+        close(file);
+    }
+
+    if (decompressor != -1) {
+        waitpid(decompressor, nullptr, 0);
+    }
+}
+
+long BlockReader::read_some(char* destination, const std::size_t size) noexcept {
+    if (gz_file != nullptr) {
+        return gzread(static_cast<gzFile>(gz_file), destination, size);
+    }
+
+    while (true) {
+        const long result = read(file, destination, size);
+
+        if (result != -1 || errno != EINTR) {
+            return result;
+        }
+    }
+}
+
+void BlockReader::read_blocks() noexcept {
+    while (true) {
+        std::uint32_t index;
+
+        while (!empty_blocks.pop(index)) {
+            if (stopping.load(std::memory_order_acquire)) {
+                return;
+            }
+
+            std::this_thread::yield();
+        }
+
+        Block& block = blocks[index];
+        block.size = 0;
+
+        // Fill the whole block unless the input ends, since pipes hand data over in small pieces.
+        // パイプはデータを小さく渡すので、入力が終わらない限り、ブロック全体を埋める。
+        while (block.size != block.data.size()) {
+            const long result = read_some(block.data.data() + block.size, block.data.size() - block.size);
+
+            if (result <= 0) {
+                if (result < 0) {
+                    failed.store(true, std::memory_order_release);
+                }
+
+                break;
+            }
+
+            block.size += result;
+        }
+
+        const bool ended = block.size != block.data.size();
+
+        if (ended && decompressor != -1) {
+            // zstd reports a missing or corrupt file by exiting with an error.
+            // zstdはファイルがないか壊れていることを、エラーで終了することで知らせる。
+            int status = 0;
+
+            if (waitpid(decompressor, &status, 0) == decompressor) {
+                decompressor = -1;
+
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                    failed.store(true, std::memory_order_release);
+                }
+            }
+        }
+
+        while (!full_blocks.push(index)) {}
+
+        if (ended) {
+            // Make sure the consumer gets an empty block to tell it we've finished.
+            // 終わったことを伝えるために、消費者が必ず空のブロックを受け取るようにする。
+            if (block.size != 0) {
+                while (!empty_blocks.pop(index)) {
+                    if (stopping.load(std::memory_order_acquire)) {
+                        return;
+                    }
+
+                    std::this_thread::yield();
+                }
+
+                blocks[index].size = 0;
+
+                while (!full_blocks.push(index)) {}
+            }
+
+            return;
+        }
+    }
+}
+
+std::span<const char> BlockReader::next_block() noexcept {
+    if (held_block != stream_block_count) {
+        while (!empty_blocks.push(held_block)) {}
+        held_block = stream_block_count;
+    }
+
+    if (finished) {
+        return {};
+    }
+
+    std::uint32_t index;
+
+    while (!full_blocks.pop(index)) {
+        std::this_thread::yield();
+    }
+
+    held_block = index;
+    finished = blocks[index].size == 0;
+
+    return { blocks[index].data.data(), blocks[index].size };
+}
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "concurrency/spscringbuffer.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+#include <sys/types.h>
+
+namespace nanofill::fileio {
+
+// The size of each block BlockReader hands out.
+// BlockReaderが渡す各ブロックのサイズ。
+constexpr std::size_t stream_block_size = 64 * 1024;
+// How many blocks can be in flight between the reading thread and the consumer.
+// 読み込みスレッドと消費者の間で同時に使える ブロックの数。
+constexpr std::size_t stream_block_count = 8;
+
+// Reads a file, a pipe or stdin ("-") in fixed-size blocks on its own thread, so that waiting on
+// the disk (and decompressing) overlaps with whatever the consumer does with the last block.
+// Files ending in .gz are decompressed with zlib on that thread, and files ending in .zst through
+// a zstd process. Memory use is fixed at stream_block_count blocks however big the input is.
+// ファイル、パイプまたは標準入力（"-"）を独自のスレッドで固定サイズのブロックずつ読むので、ディスクを待つ
+// こと（と解凍）が、消費者が前のブロックですることと重なる。.gzで終わるファイルはそのスレッドでzlibで、.zstで
+// 終わるファイルはzstdのプロセスで解凍する。入力がどれだけ大きくても、メモリ使用量はstream_block_count個の
+// ブロックに固定されている。
+class BlockReader {
+    struct Block {
+        std::array<char, stream_block_size> data;
+        std::size_t size;
+    };
+
+    std::unique_ptr<Block[]> blocks;
+    // Blocks the reading thread has filled, and blocks the consumer has finished with.
+    // 読み込みスレッドが埋めたブロックと、消費者が使い終わったブロック。
+    concurrency::SPSCRingBuffer<std::uint32_t, stream_block_count * 2> full_blocks;
+    concurrency::SPSCRingBuffer<std::uint32_t, stream_block_count * 2> empty_blocks;
+    int file = -1;
+    // A gzFile, kept as void* so zlib.h doesn't leak out of this header.
+    // gzFile。zlib.hがこのヘッダから漏れないように、void*として持つ。
+    void* gz_file = nullptr;
+    pid_t decompressor = -1;
+    // The block the consumer has right now.
+    // 消費者が今持っているブロック。
+    std::uint32_t held_block = stream_block_count;
+    bool finished = false;
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> failed{false};
+    std::thread thread;
+
+    void read_blocks() noexcept;
+    // Like read(), returning 0 at the end and -1 on errors.
+    // read()のように、最後で0、エラーで-1を返す。
+    long read_some(char* destination, std::size_t size) noexcept;
+
+public:
+    // Throws if the input can't be opened.
+    // 入力が開けなかったら、投げる。
+    explicit BlockReader(const std::string& path);
+    ~BlockReader();
+
+    BlockReader(const BlockReader&) = delete;
+    BlockReader& operator=(const BlockReader&) = delete;
+
+    // Wait for the next block. The data stays valid until the next call. An empty block means
+    // the input has ended.
+    // 次のブロックを待つ。データは次の呼び出しまで有効だ。空のブロックなら、入力が終わった。
+    std::span<const char> next_block() noexcept;
+
+    // True if the input ended because of an error rather than reaching the end.
+    // 最後まで行かずにエラーで入力が終わったら、true。
+    bool has_failed() const noexcept {
+        return failed.load(std::memory_order_acquire);
+    }
+};
+
+}
@@ -12,7 +12,7 @@ template<typename T>
 T parse_csv_column(const std::string& column);
 
 template<>
-std::uint32_t parse_csv_column<std::uint32_t>(const std::string& column) {
+inline std::uint32_t parse_csv_column<std::uint32_t>(const std::string& column) {
     int output;
     std::from_chars(column.data(), column.data()+column.size(), output);
 
@@ -24,7 +24,7 @@ std::uint32_t parse_csv_column<std::uint32_t>(const std::string& column) {
 }
 
 template<>
-std::uint16_t parse_csv_column<std::uint16_t>(const std::string& column) {
+inline std::uint16_t parse_csv_column<std::uint16_t>(const std::string& column) {
     int output;
     std::from_chars(column.data(), column.data()+column.size(), output);
 
@@ -36,7 +36,7 @@ std::uint16_t parse_csv_column<std::uint16_t>(const std::string& column) {
 }
 
 template<>
-std::uint8_t parse_csv_column<std::uint8_t>(const std::string& column) {
+inline std::uint8_t parse_csv_column<std::uint8_t>(const std::string& column) {
     int output;
     std::from_chars(column.data(), column.data()+column.size(), output);
 
@@ -48,7 +48,7 @@ std::uint8_t parse_csv_column<std::uint8_t>(const std::string& column) {
 }
 
 template<>
-std::int8_t parse_csv_column<std::int8_t>(const std::string& column) {
+inline std::int8_t parse_csv_column<std::int8_t>(const std::string& column) {
     int output;
     std::from_chars(column.data(), column.data()+column.size(), output);
 
@@ -60,7 +60,7 @@ std::int8_t parse_csv_column<std::int8_t>(const std::string& column) {
 }
 
 template<>
-double parse_csv_column<double>(const std::string& column) {
+inline double parse_csv_column<double>(const std::string& column) {
     double output;
     std::from_chars(column.data(), column.data()+column.size(), output);
 
@@ -0,0 +1,174 @@
+#include "itchdecoder.hpp"
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nanofill::fileio {
+
+namespace itch {
+
+namespace {
+
+template<typename T>
+void store_big_endian(std::uint8_t* data, const T value) noexcept {
+    const T swapped = std::byteswap(value);
+    std::memcpy(data, &swapped, sizeof(T));
+}
+
+// Add a zeroed message with its length prefix and common fields filled in, returning where the
+// message starts.
+// 長さの前置きと共通のフィールドを埋めたゼロのメッセージを追加して、メッセージの始まりを返す。
+template<MessageType Type>
+std::uint8_t* append_message(std::vector<std::uint8_t>& out, const std::uint64_t timestamp, const std::uint16_t stock_locate) {
+    constexpr std::size_t length = Layout<Type>::length;
+    const std::size_t start = out.size();
+
+    out.resize(start + 2 + length, 0);
+
+    std::uint8_t* message = out.data() + start + 2;
+
+    store_big_endian(out.data() + start, static_cast<std::uint16_t>(length));
+    message[0] = static_cast<std::uint8_t>(Type);
+    store_big_endian(message + stock_locate_offset, stock_locate);
+    store_big_endian(message + timestamp_offset, static_cast<std::uint16_t>(timestamp >> 32));
+    store_big_endian(message + timestamp_offset + 2, static_cast<std::uint32_t>(timestamp));
+
+    return message;
+}
+
+}
+
+void append_add_order(std::vector<std::uint8_t>& out, const std::uint64_t timestamp, const std::uint64_t reference,
+    const bool buy, const std::uint32_t shares, const std::uint32_t price, const std::uint16_t stock_locate) {
+    using Layout = Layout<MessageType::AddOrder>;
+    std::uint8_t* message = append_message<MessageType::AddOrder>(out, timestamp, stock_locate);
+
+    store_big_endian(message + reference_offset, reference);
+    message[Layout::side] = buy ? 'B' : 'S';
+    store_big_endian(message + Layout::shares, shares);
+    std::memcpy(message + Layout::shares + 4, "NANOFILL", 8);
+    store_big_endian(message + Layout::price, price);
+}
+
+void append_order_executed(std::vector<std::uint8_t>& out, const std::uint64_t timestamp, const std::uint64_t reference,
+    const std::uint32_t shares, const std::uint16_t stock_locate) {
+    std::uint8_t* message = append_message<MessageType::OrderExecuted>(out, timestamp, stock_locate);
+
+    store_big_endian(message + reference_offset, reference);
+    store_big_endian(message + Layout<MessageType::OrderExecuted>::shares, shares);
+}
+
+void append_order_cancel(std::vector<std::uint8_t>& out, const std::uint64_t timestamp, const std::uint64_t reference,
+    const std::uint32_t shares, const std::uint16_t stock_locate) {
+    std::uint8_t* message = append_message<MessageType::OrderCancel>(out, timestamp, stock_locate);
+
+    store_big_endian(message + reference_offset, reference);
+    store_big_endian(message + Layout<MessageType::OrderCancel>::shares, shares);
+}
+
+void append_order_delete(std::vector<std::uint8_t>& out, const std::uint64_t timestamp, const std::uint64_t reference,
+    const std::uint16_t stock_locate) {
+    std::uint8_t* message = append_message<MessageType::OrderDelete>(out, timestamp, stock_locate);
+
+    store_big_endian(message + reference_offset, reference);
+}
+
+void append_order_replace(std::vector<std::uint8_t>& out, const std::uint64_t timestamp, const std::uint64_t reference,
+    const std::uint64_t new_reference, const std::uint32_t shares, const std::uint32_t price, const std::uint16_t stock_locate) {
+    using Layout = Layout<MessageType::OrderReplace>;
+    std::uint8_t* message = append_message<MessageType::OrderReplace>(out, timestamp, stock_locate);
+
+    store_big_endian(message + reference_offset, reference);
+    store_big_endian(message + Layout::new_reference, new_reference);
+    store_big_endian(message + Layout::shares, shares);
+    store_big_endian(message + Layout::price, price);
+}
+
+}
+
+ItchDecoder::ItchDecoder(const std::size_t max_live_orders, const ItchFilter& filter)
+    : live_orders(std::bit_ceil(std::max<std::size_t>(max_live_orders * 2, 2))),
+      mask(live_orders.size() - 1),
+      max_live_orders(max_live_orders),
+      filter(filter) {}
+
+void ItchDecoder::erase(LiveOrder* order) noexcept {
+    std::size_t hole = order - live_orders.data();
+    std::size_t slot = hole;
+
+    --live_order_count;
+
+    while (true) {
+        slot = (slot + 1) & mask;
+
+        if (live_orders[slot].reference == 0) {
+            break;
+        }
+
+        // Move the order back into the hole unless its home slot is between the hole and here
+        // (wrapping around), in which case it has to stay where it is.
+        // 本来のスロットが穴とここの間（一周を含めて）になければ、注文を穴に戻す。あれば、そのままでなければ
+        // ならない。
+        const std::size_t home = slot_of(live_orders[slot].reference);
+
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            live_orders[hole] = live_orders[slot];
+            hole = slot;
+        }
+    }
+
+    live_orders[hole].reference = 0;
+}
+
+std::vector<Event> decode_itch_file(const std::string& path, const std::size_t max_live_orders) {
+    ItchDecoder decoder(max_live_orders);
+
+    return decode_itch_file(path, decoder);
+}
+
+std::vector<Event> decode_itch_file(const std::string& path, ItchDecoder& decoder) {
+    const int file = open(path.c_str(), O_RDONLY);
+
+    if (file == -1) {
+        throw std::runtime_error("Could not open file " + path);
+    }
+
+    struct stat status;
+
+    if (fstat(file, &status) != 0) {
+        close(file);
+        throw std::runtime_error("Could not read the size of " + path);
+    }
+
+    std::vector<Event> events;
+
+    if (status.st_size == 0) {
+        close(file);
+
+        return events;
+    }
+
+    void* data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("Could not map " + path);
+    }
+
+    madvise(data, status.st_size, MADV_SEQUENTIAL);
+
+    // Book-changing messages are around 20-40 bytes each.
+    // 板を変えるメッセージはそれぞれ20から40バイトぐらいだ。
+    events.reserve(status.st_size / 32);
+
+    decoder.decode_buffer({ static_cast<const std::uint8_t*>(data), static_cast<std::size_t>(status.st_size) },
+        [&](const Event& event) { events.push_back(event); });
+
+    munmap(data, status.st_size);
+
+    return events;
+}
+
+}
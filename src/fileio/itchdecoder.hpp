@@ -0,0 +1,492 @@
+#pragma once
+
+#include "events/event.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace nanofill::fileio {
+
+using events::Event;
+using events::EventType;
+
+namespace itch {
+
+// The NASDAQ TotalView-ITCH 5.0 messages that change the book. Everything else is skipped.
+// 板を変えるNASDAQ TotalView-ITCH 5.0のメッセージ。他は全部飛ばす。
+enum class MessageType : char {
+    AddOrder = 'A',
+    AddOrderWithMpid = 'F',
+    OrderExecuted = 'E',
+    OrderExecutedWithPrice = 'C',
+    OrderCancel = 'X',
+    OrderDelete = 'D',
+    OrderReplace = 'U',
+};
+
+// Every message starts with its type, stock locate, tracking number and a 6-byte timestamp in
+// nanoseconds after midnight. All numbers are big-endian.
+// 全てのメッセージは種類、銘柄の位置、追跡番号と、零時からのナノ秒の6バイトのタイムスタンプで始まる。全ての
+// 数値はビッグエンディアンだ。
+constexpr std::size_t stock_locate_offset = 1;
+constexpr std::size_t timestamp_offset = 5;
+constexpr std::size_t reference_offset = 11;
+
+// Where each message's fields are, from the ITCH 5.0 specification.
+// ITCH 5.0の仕様による、各メッセージのフィールドの位置。
+template<MessageType Type>
+struct Layout;
+
+template<>
+struct Layout<MessageType::AddOrder> {
+    static constexpr std::size_t length = 36;
+    static constexpr std::size_t side = 19;
+    static constexpr std::size_t shares = 20;
+    static constexpr std::size_t price = 32;
+};
+
+template<>
+struct Layout<MessageType::AddOrderWithMpid> : Layout<MessageType::AddOrder> {
+    static constexpr std::size_t length = 40;
+};
+
+template<>
+struct Layout<MessageType::OrderExecuted> {
+    static constexpr std::size_t length = 31;
+    static constexpr std::size_t shares = 19;
+};
+
+template<>
+struct Layout<MessageType::OrderExecutedWithPrice> : Layout<MessageType::OrderExecuted> {
+    static constexpr std::size_t length = 36;
+};
+
+template<>
+struct Layout<MessageType::OrderCancel> {
+    static constexpr std::size_t length = 23;
+    static constexpr std::size_t shares = 19;
+};
+
+template<>
+struct Layout<MessageType::OrderDelete> {
+    static constexpr std::size_t length = 19;
+};
+
+template<>
+struct Layout<MessageType::OrderReplace> {
+    static constexpr std::size_t length = 35;
+    static constexpr std::size_t new_reference = 19;
+    static constexpr std::size_t shares = 27;
+    static constexpr std::size_t price = 31;
+};
+
+template<typename T>
+[[gnu::always_inline]]
+inline T load_big_endian(const std::uint8_t* data) noexcept {
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+
+    return std::byteswap(value);
+}
+
+[[gnu::always_inline]]
+inline std::uint64_t load_timestamp(const std::uint8_t* message) noexcept {
+    return static_cast<std::uint64_t>(load_big_endian<std::uint16_t>(message + timestamp_offset)) << 32
+        | load_big_endian<std::uint32_t>(message + timestamp_offset + 2);
+}
+
+// Append messages in the length-prefixed form NASDAQ's ITCH files use. For tests, benchmarks and
+// the feed sender.
+// NASDAQのITCHファイルが使う長さを前に付けた形でメッセージを追加する。テスト、ベンチマークとフィードの
+// 送信者のため。
+void append_add_order(std::vector<std::uint8_t>& out, std::uint64_t timestamp, std::uint64_t reference,
+    bool buy, std::uint32_t shares, std::uint32_t price, std::uint16_t stock_locate = 1);
+void append_order_executed(std::vector<std::uint8_t>& out, std::uint64_t timestamp, std::uint64_t reference,
+    std::uint32_t shares, std::uint16_t stock_locate = 1);
+void append_order_cancel(std::vector<std::uint8_t>& out, std::uint64_t timestamp, std::uint64_t reference,
+    std::uint32_t shares, std::uint16_t stock_locate = 1);
+void append_order_delete(std::vector<std::uint8_t>& out, std::uint64_t timestamp, std::uint64_t reference,
+    std::uint16_t stock_locate = 1);
+void append_order_replace(std::vector<std::uint8_t>& out, std::uint64_t timestamp, std::uint64_t reference,
+    std::uint64_t new_reference, std::uint32_t shares, std::uint32_t price, std::uint16_t stock_locate = 1);
+
+}
+
+// Which events an ItchDecoder passes on. The defaults pass on everything that fits in an Event.
+// ItchDecoderがどのイベントを渡すか。デフォルトはEventに収まる全てのものを渡す。
+struct ItchFilter {
+    // Only pass on this stock, as symbol 0, so that it can go straight into one book. 0 passes on
+    // every stock, with its locate as the symbol.
+    // この銘柄だけを銘柄0として渡すので、そのまま一つの板に入れられる。0なら、全ての銘柄を、その位置を銘柄として
+    // 渡す。
+    std::uint16_t stock_locate = 0;
+    // With no stock_locate, only pass on the stock of the first order message.
+    // stock_locateがなければ、最初の注文のメッセージの銘柄だけを渡す。
+    bool first_stock = false;
+    // Orders priced outside this range or off the tick are never passed on, e.g. those a book has
+    // no level for. They're still tracked, so later messages about them aren't unknown orders.
+    // この範囲の外か呼値の単位から外れた価格の注文は決して渡さない。例えば板にレベルがないもの。それでも
+    // 追跡するので、後のそれについてのメッセージは不明な注文にならない。
+    std::uint32_t min_price = 0;
+    std::uint32_t max_price = std::numeric_limits<std::uint32_t>::max();
+    std::uint32_t tick_size = 1;
+};
+
+// Turns ITCH 5.0 messages into events. Only adds carry a price and side, so the decoder remembers
+// every live order in a fixed-size hash table to fill them in on cancels, deletes and executions,
+// which is what OrderBook needs to find the order. A replace becomes a delete of the old order and
+// an add of the new one.
+//
+// Events only have room for 32-bit order ids and 16-bit sizes, so order references are cut down to
+// fit and share counts above 32767 are capped. Symbols are 16 bits like stock locates, so every
+// stock fits.
+// ITCH 5.0のメッセージをイベントに変える。価格と売買は追加にしかないので、デコーダーは全ての生きている注文を
+// 固定サイズのハッシュ表に覚えて、取消、削除と約定でそれを埋める。OrderBookが注文を見つけるにはそれが必要だ。
+// 置き換えは古い注文の削除と新しい注文の追加になる。
+//
+// イベントには32ビットの注文IDと16ビットのサイズの余裕しかないので、注文の参照番号は収まるように切り詰めて、
+// 32767を超える株数は上限で止める。銘柄は銘柄の位置と同じく16ビットなので、全ての銘柄が収まる。
+class ItchDecoder {
+    // Shares are negative for sell orders, like Event sizes.
+    // Eventのサイズと同じく、売り注文の株数はネガティブだ。
+    struct LiveOrder {
+        // 0 means the slot is empty, which ITCH never uses as a reference.
+        // 0はスロットが空であることを意味する。ITCHは参照番号としてそれを使わない。
+        std::uint64_t reference;
+        std::uint32_t price;
+        std::int32_t shares;
+    };
+
+    std::vector<LiveOrder> live_orders;
+    std::size_t mask;
+    std::size_t live_order_count = 0;
+    std::size_t max_live_orders;
+    ItchFilter filter;
+
+    std::uint64_t messages = 0;
+    std::uint64_t skipped_messages = 0;
+    std::uint64_t unknown_orders = 0;
+    std::uint64_t dropped_orders = 0;
+    std::uint64_t other_stock_messages = 0;
+    std::uint64_t out_of_range_events = 0;
+
+    // ITCH hands out references in order, so using their low bits keeps the orders that are live
+    // together close together in the table, and they only collide once the table wraps around.
+    // ITCHは参照番号を順番に渡すので、下位ビットを使うと、同時に生きている注文が表で近くにまとまって、表が一周
+    // するまで衝突しない。
+    [[gnu::always_inline]]
+    std::size_t slot_of(const std::uint64_t reference) const noexcept {
+        return reference & mask;
+    }
+
+    [[gnu::always_inline]]
+    LiveOrder* find(const std::uint64_t reference) noexcept {
+        for (std::size_t slot = slot_of(reference); ; slot = (slot + 1) & mask) {
+            LiveOrder& order = live_orders[slot];
+
+            if (order.reference == reference) {
+                return &order;
+            }
+
+            if (order.reference == 0) [[unlikely]] {
+                ++unknown_orders;
+
+                return nullptr;
+            }
+        }
+    }
+
+    [[gnu::always_inline]]
+    void insert(const std::uint64_t reference, const std::uint32_t price, const std::int32_t shares) noexcept {
+        if (live_order_count == max_live_orders) [[unlikely]] {
+            ++dropped_orders;
+
+            return;
+        }
+
+        std::size_t slot = slot_of(reference);
+
+        while (live_orders[slot].reference != 0) {
+            slot = (slot + 1) & mask;
+        }
+
+        live_orders[slot] = { .reference = reference, .price = price, .shares = shares };
+        ++live_order_count;
+    }
+
+    // Remove an order, shifting back any later ones in its run so lookups never need tombstones.
+    // 注文を削除して、その連続の後ろのものを戻すので、検索に墓石が要らない。
+    void erase(LiveOrder* order) noexcept;
+
+    [[gnu::always_inline]]
+    bool in_price_range(const std::uint32_t price) const noexcept {
+        return price >= filter.min_price && price <= filter.max_price && (price - filter.min_price) % filter.tick_size == 0;
+    }
+
+    // Pass an event on unless its price is out of range. handle has already checked the stock.
+    // 価格が範囲外でなければ、イベントを渡す。銘柄はhandleがもう確認した。
+    template<typename OnEvent>
+    [[gnu::always_inline]]
+    void emit(const std::uint8_t* message, const EventType type, const std::uint64_t reference,
+        const std::uint32_t price, const std::int32_t shares, OnEvent& on_event) noexcept {
+        if (!in_price_range(price)) [[unlikely]] {
+            ++out_of_range_events;
+
+            return;
+        }
+
+        const std::uint64_t timestamp = itch::load_timestamp(message);
+
+        on_event(Event {
+            .price = price,
+            .time = static_cast<std::uint32_t>(timestamp / events::nanoseconds_per_second),
+            .order_id = static_cast<std::uint32_t>(reference),
+            .size = static_cast<std::int16_t>(std::clamp(shares, -32767, 32767)),
+            .type = type,
+            .symbol_id = filter.stock_locate != 0
+                ? std::uint16_t{0}
+                : itch::load_big_endian<std::uint16_t>(message + itch::stock_locate_offset),
+            .nanoseconds = static_cast<std::uint32_t>(timestamp % events::nanoseconds_per_second)
+        });
+    }
+
+    // Whether a message is about a stock the filter passes on, picking the first stock if asked to.
+    // メッセージがフィルターが渡す銘柄についてか。頼まれたら、最初の銘柄を選ぶ。
+    [[gnu::always_inline]]
+    bool wanted_stock(const std::uint8_t* message) noexcept {
+        const auto stock_locate = itch::load_big_endian<std::uint16_t>(message + itch::stock_locate_offset);
+
+        if (filter.stock_locate == 0 && filter.first_stock) [[unlikely]] {
+            filter.stock_locate = stock_locate;
+        }
+
+        return filter.stock_locate == 0 || stock_locate == filter.stock_locate;
+    }
+
+    // Take shares off an order (an execution or cancel), reporting it as type, or as a delete if
+    // that was all of it.
+    // 注文から株を取って（約定か取消）、typeとして、それで全部なら削除として知らせる。
+    template<typename OnEvent>
+    [[gnu::always_inline]]
+    void reduce(const std::uint8_t* message, const EventType type, const std::uint32_t shares, OnEvent& on_event) noexcept {
+        const auto reference = itch::load_big_endian<std::uint64_t>(message + itch::reference_offset);
+        LiveOrder* order = find(reference);
+
+        if (order == nullptr) {
+            return;
+        }
+
+        const std::int32_t sign = order->shares < 0 ? -1 : 1;
+        const std::int32_t remaining = sign * order->shares;
+        const std::int32_t taken = std::min(static_cast<std::int32_t>(std::min<std::uint32_t>(shares, INT32_MAX)), remaining);
+
+        if (taken == remaining && type == EventType::Cancellation) {
+            emit(message, EventType::Deletion, reference, order->price, order->shares, on_event);
+        } else {
+            emit(message, type, reference, order->price, sign * taken, on_event);
+        }
+
+        order->shares -= sign * taken;
+
+        if (order->shares == 0) {
+            erase(order);
+        }
+    }
+
+    template<itch::MessageType Type, typename OnEvent>
+    [[gnu::always_inline]]
+    void handle(const std::uint8_t* message, OnEvent& on_event) noexcept {
+        using Layout = itch::Layout<Type>;
+        using itch::MessageType;
+        using itch::load_big_endian;
+
+        if constexpr (Type == MessageType::AddOrder || Type == MessageType::AddOrderWithMpid) {
+            const auto reference = load_big_endian<std::uint64_t>(message + itch::reference_offset);
+            const auto price = load_big_endian<std::uint32_t>(message + Layout::price);
+            const auto shares = static_cast<std::int32_t>(std::min<std::uint32_t>(load_big_endian<std::uint32_t>(message + Layout::shares), INT32_MAX));
+            const std::int32_t signed_shares = shares * (1 - 2 * (message[Layout::side] == 'S'));
+
+            insert(reference, price, signed_shares);
+            emit(message, EventType::Submission, reference, price, signed_shares, on_event);
+        } else if constexpr (Type == MessageType::OrderExecuted || Type == MessageType::OrderExecutedWithPrice) {
+            reduce(message, EventType::ExecutionVisible, load_big_endian<std::uint32_t>(message + Layout::shares), on_event);
+        } else if constexpr (Type == MessageType::OrderCancel) {
+            reduce(message, EventType::Cancellation, load_big_endian<std::uint32_t>(message + Layout::shares), on_event);
+        } else if constexpr (Type == MessageType::OrderDelete) {
+            const auto reference = load_big_endian<std::uint64_t>(message + itch::reference_offset);
+            LiveOrder* order = find(reference);
+
+            if (order != nullptr) {
+                emit(message, EventType::Deletion, reference, order->price, order->shares, on_event);
+                erase(order);
+            }
+        } else if constexpr (Type == MessageType::OrderReplace) {
+            const auto reference = load_big_endian<std::uint64_t>(message + itch::reference_offset);
+            LiveOrder* order = find(reference);
+
+            if (order != nullptr) {
+                // The new order keeps the old one's side.
+                // 新しい注文は古い注文の売買を引き継ぐ。
+                const std::int32_t sign = order->shares < 0 ? -1 : 1;
+                const auto new_reference = load_big_endian<std::uint64_t>(message + Layout::new_reference);
+                const auto price = load_big_endian<std::uint32_t>(message + Layout::price);
+                const auto shares = static_cast<std::int32_t>(std::min<std::uint32_t>(load_big_endian<std::uint32_t>(message + Layout::shares), INT32_MAX));
+
+                emit(message, EventType::Deletion, reference, order->price, order->shares, on_event);
+                erase(order);
+                insert(new_reference, price, sign * shares);
+                emit(message, EventType::Submission, new_reference, price, sign * shares, on_event);
+            }
+        }
+    }
+
+    template<itch::MessageType Type, typename OnEvent>
+    [[gnu::always_inline]]
+    bool handle_checked(const std::uint8_t* message, const std::size_t length, OnEvent& on_event) noexcept {
+        if (length < itch::Layout<Type>::length) [[unlikely]] {
+            ++skipped_messages;
+
+            return false;
+        }
+
+        if (!wanted_stock(message)) {
+            ++other_stock_messages;
+
+            return false;
+        }
+
+        handle<Type>(message, on_event);
+
+        return true;
+    }
+
+public:
+    // max_live_orders is how many orders can be resting at once, across every stock passed on.
+    // max_live_ordersは、渡す全ての銘柄で同時に残っていられる注文の数。
+    explicit ItchDecoder(std::size_t max_live_orders = 1 << 22, const ItchFilter& filter = {});
+
+    // Decode one message (without its length prefix), calling on_event for each event it makes,
+    // which is none for messages that don't change the book and two for a replace. Returns false
+    // if the message was skipped.
+    // 一つのメッセージ（長さの前置きなし）をデコードして、作った各イベントでon_eventを呼ぶ。板を変えない
+    // メッセージは零個、置き換えは二個だ。メッセージを飛ばしたら、falseを返す。
+    template<typename OnEvent>
+    [[gnu::always_inline]]
+    bool decode_message(const std::uint8_t* message, const std::size_t length, OnEvent&& on_event) noexcept {
+        using itch::MessageType;
+
+        ++messages;
+
+        if (length == 0) [[unlikely]] {
+            ++skipped_messages;
+
+            return false;
+        }
+
+        // Each case is its own instantiation, so every offset is a constant.
+        // 各caseは独自のインスタンス化なので、全てのオフセットが定数だ。
+        switch (static_cast<MessageType>(message[0])) {
+            case MessageType::AddOrder:
+                return handle_checked<MessageType::AddOrder>(message, length, on_event);
+            case MessageType::AddOrderWithMpid:
+                return handle_checked<MessageType::AddOrderWithMpid>(message, length, on_event);
+            case MessageType::OrderExecuted:
+                return handle_checked<MessageType::OrderExecuted>(message, length, on_event);
+            case MessageType::OrderExecutedWithPrice:
+                return handle_checked<MessageType::OrderExecutedWithPrice>(message, length, on_event);
+            case MessageType::OrderCancel:
+                return handle_checked<MessageType::OrderCancel>(message, length, on_event);
+            case MessageType::OrderDelete:
+                return handle_checked<MessageType::OrderDelete>(message, length, on_event);
+            case MessageType::OrderReplace:
+                return handle_checked<MessageType::OrderReplace>(message, length, on_event);
+            default:
+                ++skipped_messages;
+
+                return false;
+        }
+    }
+
+    // Decode length-prefixed messages, as in NASDAQ's ITCH files. Returns how many bytes were used,
+    // which is less than the whole buffer if it ends part way through a message.
+    // NASDAQのITCHファイルのように、長さを前に付けたメッセージをデコードする。使ったバイト数を返す。メッセージの
+    // 途中で終わったら、バッファ全体より少ない。
+    template<typename OnEvent>
+    std::size_t decode_buffer(const std::span<const std::uint8_t> data, OnEvent&& on_event) noexcept {
+        std::size_t position = 0;
+
+        while (data.size() - position >= 2) {
+            const std::size_t length = itch::load_big_endian<std::uint16_t>(data.data() + position);
+
+            if (data.size() - position - 2 < length) {
+                break;
+            }
+
+            decode_message(data.data() + position + 2, length, on_event);
+            position += 2 + length;
+        }
+
+        return position;
+    }
+
+    std::uint64_t get_messages() const noexcept {
+        return messages;
+    }
+
+    // Messages that don't change the book, or were too short.
+    // 板を変えないか、短すぎたメッセージ。
+    std::uint64_t get_skipped_messages() const noexcept {
+        return skipped_messages;
+    }
+
+    // Messages about orders we never saw added, e.g. from before we joined the feed.
+    // 追加を見なかった注文についてのメッセージ。例えば、フィードに参加する前のもの。
+    std::uint64_t get_unknown_orders() const noexcept {
+        return unknown_orders;
+    }
+
+    // Adds that didn't fit in the live order table.
+    // 生きている注文の表に収まらなかった追加。
+    std::uint64_t get_dropped_orders() const noexcept {
+        return dropped_orders;
+    }
+
+    // Messages about stocks the filter doesn't pass on.
+    // フィルターが渡さない銘柄についてのメッセージ。
+    std::uint64_t get_other_stock_messages() const noexcept {
+        return other_stock_messages;
+    }
+
+    // Events not passed on because of their price.
+    // 価格のせいで渡さなかったイベント。
+    std::uint64_t get_out_of_range_events() const noexcept {
+        return out_of_range_events;
+    }
+
+    // The stock being passed on, or 0 for every stock (or none seen yet with first_stock).
+    // 渡している銘柄。全ての銘柄（またはfirst_stockでまだ見ていない）なら、0。
+    std::uint16_t get_stock_locate() const noexcept {
+        return filter.stock_locate;
+    }
+
+    std::size_t get_live_order_count() const noexcept {
+        return live_order_count;
+    }
+};
+
+// Decode a whole ITCH 5.0 file (length-prefixed messages, uncompressed) by mapping it into memory.
+// Throws if it can't be opened.
+// ITCH 5.0のファイル全体（長さを前に付けたメッセージ、非圧縮）をメモリにマップしてデコードする。開けなかったら、
+// 投げる。
+std::vector<Event> decode_itch_file(const std::string& path, std::size_t max_live_orders = 1 << 22);
+
+// The same with a decoder of your own, e.g. to filter the events or read its counts afterwards.
+// 自分のデコーダーで同じことをする。例えばイベントを絞り込むか、後でその数を読むため。
+std::vector<Event> decode_itch_file(const std::string& path, ItchDecoder& decoder);
+
+}
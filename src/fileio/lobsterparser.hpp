@@ -0,0 +1,152 @@
+#pragma once
+
+#include "events/event.hpp"
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+namespace nanofill::fileio {
+
+using events::Event;
+
+// Parses LOBSTER message data into events a piece at a time, so input can be parsed as it arrives
+// instead of after the whole file has been read. A line split across two pieces is carried over
+// in a small fixed buffer, so nothing is allocated.
+// LOBSTERのメッセージデータを一部ずつイベントに解析するので、ファイル全体を読み込んでからではなく、入力が
+// 届くたびに解析できる。二つの部分に分かれた行は小さい固定のバッファで持ち越すので、何も割り当てない。
+class LobsterStreamParser {
+public:
+    // Lines longer than this are skipped. Real LOBSTER lines are around 50 characters.
+    // これより長い行は飛ばす。本当のLOBSTERの行は50文字ぐらいだ。
+    static constexpr std::size_t max_line_length = 256;
+
+private:
+    std::array<char, max_line_length> partial_line;
+    std::size_t partial_size = 0;
+    // True while skipping the rest of a line that was too long.
+    // 長すぎた行の残りを飛ばしている間は、true。
+    bool skipping_line = false;
+    std::uint64_t bad_lines = 0;
+
+    template<typename T>
+    [[gnu::always_inline]]
+    static bool parse_field(const char*& position, const char* end, T& value) noexcept {
+        const auto [next, error] = std::from_chars(position, end, value);
+
+        if (error != std::errc{}) {
+            return false;
+        }
+
+        position = next < end && *next == ',' ? next + 1 : next;
+
+        return true;
+    }
+
+    template<typename OnEvent>
+    [[gnu::always_inline]]
+    void parse_and_emit(const char* begin, const char* end, OnEvent& on_event) noexcept {
+        if (end != begin && end[-1] == '\r') {
+            --end;
+        }
+
+        if (begin == end) {
+            return;
+        }
+
+        Event event;
+
+        if (parse_line(begin, end, event)) {
+            on_event(event);
+        } else {
+            ++bad_lines;
+        }
+    }
+
+public:
+    // Parse one line (without the newline) in the same format as events_from_csv_data. Returns
+    // false if it's malformed.
+    // events_from_csv_dataと同じ形式で一行（改行なし）を解析する。形式が正しくなければ、falseを返す。
+    static bool parse_line(const char* position, const char* end, Event& event) noexcept {
+        double time;
+        int type;
+        std::uint32_t order_id;
+        int size;
+        std::uint32_t price;
+        int direction;
+
+        if (!parse_field(position, end, time) || !parse_field(position, end, type)
+            || !parse_field(position, end, order_id) || !parse_field(position, end, size)
+            || !parse_field(position, end, price) || !parse_field(position, end, direction)) {
+            return false;
+        }
+
+        event = Event {
+            .price = price,
+            .time = 0,
+            .order_id = order_id,
+            .size = static_cast<std::int16_t>(size * direction),
+            .type = static_cast<events::EventType>(type),
+            .symbol_id = 0
+        };
+        events::set_fractional_time(event, time);
+
+        return true;
+    }
+
+    // Parse the next piece of input, calling on_event for every complete line.
+    // 入力の次の部分を解析して、各完全な行でon_eventを呼ぶ。
+    template<typename OnEvent>
+    void feed(const std::span<const char> data, OnEvent&& on_event) noexcept {
+        const char* position = data.data();
+        const char* const end = position + data.size();
+
+        while (position != end) {
+            const char* newline = static_cast<const char*>(std::memchr(position, '\n', end - position));
+            const char* line_end = newline == nullptr ? end : newline;
+            const std::size_t length = line_end - position;
+
+            if (skipping_line) {
+                skipping_line = newline == nullptr;
+            } else if (partial_size + length > max_line_length) {
+                ++bad_lines;
+                partial_size = 0;
+                skipping_line = newline == nullptr;
+            } else if (newline == nullptr) {
+                std::memcpy(partial_line.data() + partial_size, position, length);
+                partial_size += length;
+            } else if (partial_size != 0) {
+                std::memcpy(partial_line.data() + partial_size, position, length);
+                parse_and_emit(partial_line.data(), partial_line.data() + partial_size + length, on_event);
+                partial_size = 0;
+            } else {
+                // The common case: a whole line inside this piece, parsed where it is.
+                // よくある場合：この部分の中に行全体があって、その場で解析する。
+                parse_and_emit(position, line_end, on_event);
+            }
+
+            position = newline == nullptr ? end : newline + 1;
+        }
+    }
+
+    // Parse whatever is left if the input didn't end with a newline.
+    // 入力が改行で終わらなかったら、残りを解析する。
+    template<typename OnEvent>
+    void finish(OnEvent&& on_event) noexcept {
+        if (partial_size != 0 && !skipping_line) {
+            parse_and_emit(partial_line.data(), partial_line.data() + partial_size, on_event);
+        }
+
+        partial_size = 0;
+        skipping_line = false;
+    }
+
+    // Lines that were too long or couldn't be parsed.
+    // 長すぎたか解析できなかった行。
+    std::uint64_t get_bad_lines() const noexcept {
+        return bad_lines;
+    }
+};
+
+}
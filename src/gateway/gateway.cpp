@@ -0,0 +1,16 @@
+#include "gateway.hpp"
+
+namespace nanofill::gateway {
+
+void print_order_report(std::ostream& out, const OrderStats& stats) {
+    out << "New orders: " << stats.new_orders << '\n'
+        << "Cancels: " << stats.cancels << '\n'
+        << "Rejected by risk checks: " << stats.rejected << '\n'
+        << "Acknowledged: " << stats.acks << '\n'
+        << '\n' << "===== Tick-to-trade latency percentiles =====" << '\n';
+    stats::print_latency_percentiles(out, stats.tick_to_trade);
+    out << '\n' << "===== Order round-trip latency percentiles =====" << '\n';
+    stats::print_latency_percentiles(out, stats.round_trip);
+}
+
+}
@@ -0,0 +1,293 @@
+#pragma once
+
+#include "concurrency/spscringbuffer.hpp"
+#include "risk/riskchecker.hpp"
+#include "stats/latencyhistogram.hpp"
+#include "stats/tsc.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+// The outbound half of the loop: the strategy's quotes turned into order messages, a simulated
+// exchange gateway that acknowledges them, and the timings of both legs.
+// ループの外向きの半分。戦略の気配を注文メッセージにして、それを受け付けるシミュレートした取引所のゲートウェイと、
+// 両方の区間の時間。
+namespace nanofill::gateway {
+
+using concurrency::SPSCRingBuffer;
+
+enum class Side : std::uint8_t {
+    Buy = 0,
+    Sell = 1
+};
+
+enum class OrderAction : std::uint8_t {
+    New = 1,
+    Cancel = 2
+};
+
+struct OrderMessage {
+    // When the consumer started on the market event that caused this order.
+    // この注文の原因となった市場のイベントを消費者が始めたとき。
+    std::uint64_t tick_tsc;
+    // When it was pushed onto the order ring.
+    // 注文リングに入れたとき。
+    std::uint64_t sent_tsc;
+    std::uint32_t order_id;
+    // Dollar price times 10,000.
+    // 10,000倍したドルの価格。
+    std::uint32_t price;
+    std::uint32_t size;
+    Side side;
+    OrderAction action;
+};
+
+struct OrderAck {
+    std::uint64_t tick_tsc;
+    std::uint64_t sent_tsc;
+    // When the gateway took the order off the ring, i.e. when it would have gone on the wire.
+    // ゲートウェイがリングから注文を取ったとき、つまり回線に出たはずのとき。
+    std::uint64_t gateway_tsc;
+    std::uint32_t order_id;
+    OrderAction action;
+};
+
+constexpr std::size_t order_ring_size = 1024;
+using OrderRing = SPSCRingBuffer<OrderMessage, order_ring_size>;
+using AckRing = SPSCRingBuffer<OrderAck, order_ring_size>;
+
+struct OrderStats {
+    std::uint64_t new_orders = 0;
+    std::uint64_t cancels = 0;
+    std::uint64_t acks = 0;
+    // New orders the risk checks stopped (see RiskChecker for why).
+    // リスクチェックが止めた新しい注文（理由はRiskCheckerを参照）。
+    std::uint64_t rejected = 0;
+    // From the consumer starting on a market event to the gateway taking the order it caused.
+    // 消費者が市場のイベントを始めてから、それが原因の注文をゲートウェイが取るまで。
+    stats::LatencyHistogram tick_to_trade;
+    // From pushing an order to reading its acknowledgement.
+    // 注文を入れてから、その受付を読むまで。
+    stats::LatencyHistogram round_trip;
+};
+
+// Turns a strategy's target prices into orders: whenever a side's target changes, the resting order
+// on that side is cancelled and a new one sent at the new price (a target of 0 just cancels). Every
+// new order goes through the risk checks first; one that fails isn't sent, and that side stays
+// empty until the target moves again. Acknowledgements coming back are read in drain_acks, which
+// times both legs. Used from the consumer thread only, so nothing in here is shared except the two
+// rings.
+// 戦略の目標価格を注文にする。片側の目標が変わるたびに、その側に置いてある注文を取り消して、新しい価格で
+// 新しいものを送る（目標が0なら取り消すだけ）。全ての新しい注文はまずリスクチェックを通る。失敗したものは
+// 送らなくて、目標がまた動くまでその側は空のままだ。戻ってくる受付はdrain_acksで読んで、両方の区間を測る。
+// 消費者のスレッドからしか使わないので、二つのリング以外は何も共有しない。
+class OrderRouter {
+    struct Quote {
+        // 0 when there's nothing resting.
+        // 何も置いていないときは0。
+        std::uint32_t order_id = 0;
+        std::uint32_t price = 0;
+    };
+
+    static constexpr unsigned int ack_batch_size = 64;
+
+    OrderRing& orders;
+    AckRing& acks;
+    risk::RiskChecker& risk;
+    std::uint32_t quote_size;
+    std::array<Quote, 2> quotes{};
+    std::uint32_t next_order_id = 1;
+    std::uint64_t outstanding = 0;
+    OrderStats stats;
+    double nanoseconds_per_tick = 1 / stats::tsc_ticks_per_nanosecond();
+
+    [[gnu::always_inline]]
+    std::uint32_t to_nanoseconds(const std::uint64_t from, const std::uint64_t to) const noexcept {
+        const std::uint64_t ticks = to > from ? to - from : 0;
+
+        return static_cast<std::uint32_t>(std::min(ticks * nanoseconds_per_tick, 4e9));
+    }
+
+    [[gnu::always_inline]]
+    void send(OrderMessage message) noexcept {
+        message.sent_tsc = stats::read_tsc();
+
+        // Keep reading acks while the ring is full, or the gateway could be stuck waiting for us.
+        // リングが一杯の間は受付を読み続ける。そうしないと、ゲートウェイが自分を待って止まるかもしれない。
+        while (!orders.push(message)) {
+            drain_acks();
+        }
+
+        ++outstanding;
+    }
+
+    [[gnu::noinline]]
+    void requote(const Side side, const std::uint32_t target, const std::uint32_t reference_price, const std::uint64_t tick_tsc) noexcept {
+        Quote& quote = quotes[static_cast<std::size_t>(side)];
+
+        if (quote.order_id != 0) {
+            send({ .tick_tsc = tick_tsc, .sent_tsc = 0, .order_id = quote.order_id, .price = quote.price, .size = quote_size, .side = side, .action = OrderAction::Cancel });
+            risk.on_cancel(static_cast<std::uint32_t>(side), quote_size);
+            ++stats.cancels;
+        }
+
+        // Remember the target even if nothing rests there, so a rejected order isn't retried until
+        // the target moves.
+        // 何も置いていなくても目標を覚えるので、拒否された注文は目標が動くまで再試行しない。
+        quote = { .order_id = 0, .price = target };
+
+        if (target == 0) {
+            return;
+        }
+
+        if (risk.check_new_order(static_cast<std::uint32_t>(side), target, quote_size, reference_price, tick_tsc) != 0) {
+            ++stats.rejected;
+
+            return;
+        }
+
+        quote.order_id = next_order_id++;
+        send({ .tick_tsc = tick_tsc, .sent_tsc = 0, .order_id = quote.order_id, .price = target, .size = quote_size, .side = side, .action = OrderAction::New });
+        ++stats.new_orders;
+    }
+
+public:
+    OrderRouter(OrderRing& orders, AckRing& acks, risk::RiskChecker& risk, const std::uint32_t quote_size = 100) noexcept
+        : orders(orders), acks(acks), risk(risk), quote_size(quote_size) {}
+
+    // Call after every event the strategy has seen, with the book's mid price (0 if it has none) for
+    // the price band, and tick_tsc from when the event was picked up.
+    // 戦略が見た各イベントの後で、価格帯のための板の仲値（なければ0）と、イベントを取り上げたときのtick_tscで
+    // 呼ぶ。
+    [[gnu::always_inline]]
+    void on_targets(
+        const std::uint32_t target_buy_price,
+        const std::uint32_t target_sell_price,
+        const std::uint32_t reference_price,
+        const std::uint64_t tick_tsc
+    ) noexcept {
+        if (target_buy_price != quotes[0].price) {
+            requote(Side::Buy, target_buy_price, reference_price, tick_tsc);
+        }
+
+        if (target_sell_price != quotes[1].price) {
+            requote(Side::Sell, target_sell_price, reference_price, tick_tsc);
+        }
+    }
+
+    // Read whatever acknowledgements have come back. Nothing is held from the risk limits across
+    // this, so it also lets a reload retire the old ones.
+    // 戻ってきた受付を全部読む。この間はリスクの制限から何も持っていないので、再読み込みが古いものを
+    // 引退させられるようにもする。
+    [[gnu::always_inline]]
+    void drain_acks() noexcept {
+        risk.quiescent();
+
+        OrderAck batch[ack_batch_size];
+        unsigned int found;
+
+        while ((found = acks.pop_many(batch, ack_batch_size)) != 0) {
+            const std::uint64_t now = stats::read_tsc();
+
+            for (unsigned int i = 0; i < found; ++i) {
+                stats.tick_to_trade.record(to_nanoseconds(batch[i].tick_tsc, batch[i].gateway_tsc));
+                stats.round_trip.record(to_nanoseconds(batch[i].sent_tsc, now));
+            }
+
+            stats.acks += found;
+            outstanding -= found;
+        }
+    }
+
+    // Spin until every order sent has been acknowledged, e.g. once the consumer has stopped.
+    // 送った注文が全部受け付けられるまで回る。例えば、消費者が止まった後。
+    void wait_for_acks() noexcept {
+        while (outstanding != 0) {
+            drain_acks();
+        }
+    }
+
+    std::uint64_t get_outstanding() const noexcept {
+        return outstanding;
+    }
+
+    const OrderStats& get_stats() const noexcept {
+        return stats;
+    }
+};
+
+// Stands in for the connection to the exchange: takes orders off the order ring and acknowledges
+// each one ack_delay_nanoseconds later (the venue's response time), in order. Waiting acks sit in a
+// fixed array, so nothing is allocated. Used from the gateway thread only; see
+// threads::order_gateway.
+// 取引所への接続の代わり。注文リングから注文を取って、それぞれをack_delay_nanoseconds後に（取引所の応答時間）、
+// 順番に受け付ける。待っている受付は固定の配列にあるので、何も割り当てない。ゲートウェイのスレッドからしか
+// 使わない。threads::order_gatewayを参照。
+class SimulatedGateway {
+    static constexpr unsigned int batch_size = 64;
+
+    OrderRing& orders;
+    AckRing& acks;
+    std::uint64_t ack_delay_ticks;
+    std::array<OrderAck, order_ring_size> pending;
+    std::size_t pending_head = 0;
+    std::size_t pending_tail = 0;
+    std::uint64_t orders_received = 0;
+
+public:
+    SimulatedGateway(OrderRing& orders, AckRing& acks, const std::uint32_t ack_delay_nanoseconds = 0) noexcept
+        : orders(orders),
+          acks(acks),
+          ack_delay_ticks(static_cast<std::uint64_t>(ack_delay_nanoseconds * stats::tsc_ticks_per_nanosecond())) {}
+
+    // Take any new orders and send any acks that are due. Returns how much was done.
+    // 新しい注文を取って、期限が来た受付を送る。どれだけしたかを返す。
+    unsigned int poll() noexcept {
+        const std::uint64_t now = stats::read_tsc();
+        const std::size_t space = pending.size() - (pending_tail - pending_head);
+        OrderMessage batch[batch_size];
+        const unsigned int found = orders.pop_many(batch, static_cast<unsigned int>(std::min<std::size_t>(batch_size, space)));
+
+        for (unsigned int i = 0; i < found; ++i) {
+            pending[pending_tail++ % pending.size()] = {
+                .tick_tsc = batch[i].tick_tsc,
+                .sent_tsc = batch[i].sent_tsc,
+                .gateway_tsc = now,
+                .order_id = batch[i].order_id,
+                .action = batch[i].action
+            };
+        }
+
+        orders_received += found;
+
+        unsigned int released = 0;
+
+        while (pending_head != pending_tail) {
+            const OrderAck& ack = pending[pending_head % pending.size()];
+
+            if (ack.gateway_tsc + ack_delay_ticks > now || !acks.push(ack)) {
+                break;
+            }
+
+            ++pending_head;
+            ++released;
+        }
+
+        return found + released;
+    }
+
+    // Whether every order taken has been acknowledged.
+    // 取った注文が全部受け付けられたか。
+    bool is_idle() const noexcept {
+        return pending_head == pending_tail;
+    }
+
+    std::uint64_t get_orders_received() const noexcept {
+        return orders_received;
+    }
+};
+
+void print_order_report(std::ostream& out, const OrderStats& stats);
+
+}
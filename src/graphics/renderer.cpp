@@ -61,7 +61,7 @@ void render_latency_chart(std::vector<unsigned int> performance_data) {
 
     for (std::size_t i = 0; i < frequency_table.size(); ++i) {
         std::string label = std::to_string(smallest_latency + (i * band_size)) + "ns";
-        label.insert(0, label_size - label.size(), ' ');
+        label.insert(0, label.size() < label_size ? label_size - label.size() : 0, ' ');
 
         // I think this technically causes a bug where the last column is incorrectly overrepresented,
         // but the graph's tail is so small that it doesn't really matter in our data.
@@ -0,0 +1,145 @@
+#include "sharedbook.hpp"
+#include <bit>
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nanofill::ipc {
+
+namespace {
+
+std::string normalise_name(const std::string& name) {
+    return name.starts_with('/') ? name : "/" + name;
+}
+
+// The top of the book and the ring each start on their own page.
+// 板の一番上とリングはそれぞれ独自のページから始まる。
+constexpr std::size_t page_size = 4096;
+constexpr std::size_t top_of_book_offset = page_size;
+constexpr std::size_t ring_offset = 2 * page_size;
+
+static_assert(sizeof(SegmentHeader) <= top_of_book_offset);
+static_assert(sizeof(orderbook::TopOfBookPublisher) <= ring_offset - top_of_book_offset);
+
+}
+
+SharedBookWriter::SharedBookWriter(const std::string& name, const std::size_t capacity)
+    : name(normalise_name(name)),
+      size(ring_offset + capacity * sizeof(SharedSlot)),
+      mask(capacity - 1) {
+    if (!std::has_single_bit(capacity)) {
+        throw std::invalid_argument("The shared ring's capacity must be a power of two");
+    }
+
+    // Start from a fresh segment so old readers can't confuse it with this one.
+    // 古い読み手がこれと混同しないように、新しいセグメントから始める。
+    shm_unlink(this->name.c_str());
+
+    const int file = shm_open(this->name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+
+    if (file == -1) {
+        throw std::runtime_error("Could not create shared memory " + this->name + ": " + std::strerror(errno));
+    }
+
+    if (ftruncate(file, size) != 0) {
+        close(file);
+        shm_unlink(this->name.c_str());
+        throw std::runtime_error("Could not size shared memory " + this->name + ": " + std::strerror(errno));
+    }
+
+    // Populate it now so the hot path never page faults.
+    // ホットパスでページフォルトが起きないように、今全部埋める。
+    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, file, 0);
+    close(file);
+
+    if (memory == MAP_FAILED) {
+        shm_unlink(this->name.c_str());
+        throw std::runtime_error("Could not map shared memory " + this->name + ": " + std::strerror(errno));
+    }
+
+    auto bytes = static_cast<std::byte*>(memory);
+
+    header = new (bytes) SegmentHeader {};
+    top_of_book = new (bytes + top_of_book_offset) orderbook::TopOfBookPublisher {};
+    slots = reinterpret_cast<SharedSlot*>(bytes + ring_offset);
+
+    // ftruncate zeroed the slots, which is what an unused slot looks like.
+    // ftruncateがスロットをゼロにした。それが使われていないスロットの姿だ。
+    header->version = segment_version;
+    header->header_size = sizeof(SegmentHeader);
+    header->segment_size = size;
+    header->capacity = capacity;
+    header->top_of_book_offset = top_of_book_offset;
+    header->ring_offset = ring_offset;
+    header->writer_pid = static_cast<std::uint64_t>(getpid());
+    header->magic.store(segment_magic, std::memory_order_release);
+}
+
+SharedBookWriter::~SharedBookWriter() {
+    header->closed.store(1, std::memory_order_release);
+    munmap(memory, size);
+    shm_unlink(name.c_str());
+}
+
+SharedBookReader::SharedBookReader(const std::string& name) {
+    const std::string full_name = normalise_name(name);
+    const int file = shm_open(full_name.c_str(), O_RDONLY, 0);
+
+    if (file == -1) {
+        throw std::runtime_error("Could not open shared memory " + full_name + ": " + std::strerror(errno));
+    }
+
+    struct stat status;
+
+    if (fstat(file, &status) != 0 || static_cast<std::size_t>(status.st_size) < ring_offset) {
+        close(file);
+        throw std::runtime_error("Shared memory " + full_name + " is too small to be a NanoFill segment");
+    }
+
+    size = status.st_size;
+    memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, file, 0);
+    close(file);
+
+    if (memory == MAP_FAILED) {
+        throw std::runtime_error("Could not map shared memory " + full_name + ": " + std::strerror(errno));
+    }
+
+    const auto bytes = static_cast<const std::byte*>(memory);
+    header = reinterpret_cast<const SegmentHeader*>(bytes);
+
+    const auto fail = [&](const std::string& reason) {
+        munmap(const_cast<void*>(memory), size);
+        throw std::runtime_error("Can't attach to " + full_name + ": " + reason);
+    };
+
+    if (header->magic.load(std::memory_order_acquire) != segment_magic) {
+        fail("it isn't a NanoFill segment, or isn't set up yet");
+    }
+
+    if (header->version != segment_version) {
+        fail("its layout is version " + std::to_string(header->version) + ", but this reader understands version "
+            + std::to_string(segment_version));
+    }
+
+    capacity = header->capacity;
+
+    if (header->header_size != sizeof(SegmentHeader) || !std::has_single_bit(capacity)
+        || header->segment_size != size || header->ring_offset + capacity * sizeof(SharedSlot) > size
+        || header->top_of_book_offset + sizeof(orderbook::TopOfBookPublisher) > header->ring_offset) {
+        fail("its header doesn't make sense");
+    }
+
+    top_of_book = reinterpret_cast<const orderbook::TopOfBookPublisher*>(bytes + header->top_of_book_offset);
+    slots = reinterpret_cast<const SharedSlot*>(bytes + header->ring_offset);
+    mask = capacity - 1;
+    position = header->head.load(std::memory_order_acquire);
+}
+
+SharedBookReader::~SharedBookReader() {
+    munmap(const_cast<void*>(memory), size);
+}
+
+}
@@ -0,0 +1,287 @@
+#pragma once
+
+#include "events/event.hpp"
+#include "concurrency/conflatedlevelchannel.hpp"
+#include "concurrency/seqlock.hpp"
+#include "orderbook/topofbook.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+namespace nanofill::ipc {
+
+// ===== Segment layout ===== //
+// ===== セグメントのレイアウト ===== //
+//
+// Everything below is shared with other processes, which may have been built from a different
+// version of this file. Bump segment_version whenever any of it changes; readers refuse to attach
+// to any other version.
+// 以下は全て、このファイルの違うバージョンからビルドされたかもしれない他のプロセスと共有する。どれかを変えたら
+// segment_versionを上げて。読み手は他のバージョンには接続しない。
+
+// "NANOFILL" read as a little-endian number.
+// リトルエンディアンの数として読んだ"NANOFILL"。
+constexpr std::uint64_t segment_magic = 0x4C4C49464F4E414EULL;
+constexpr std::uint32_t segment_version = 3;
+
+enum class RecordKind : std::uint8_t {
+    Event = 1,
+    // A price level's new total, after an event changed it.
+    // イベントが変えた後の価格レベルの新しい合計。
+    Level = 2
+};
+
+struct SharedRecord {
+    union {
+        events::Event event;
+        concurrency::LevelUpdate level;
+    };
+    RecordKind kind;
+
+    // Needed since Event's default member initialiser makes the union's own default constructor
+    // deleted.
+    // Eventのデフォルトメンバ初期化子が共用体自身のデフォルトコンストラクタを削除するので必要だ。
+    SharedRecord() noexcept : level{}, kind{} {}
+};
+
+static_assert(std::is_trivially_copyable_v<SharedRecord>);
+static_assert(sizeof(SharedRecord) == 28);
+
+// One ring slot. sequence is 2 * position + 2 once the record for that position is complete, and
+// odd while it's being written, so a reader can tell a finished record from a torn or newer one.
+// The record is copied in and out as atomic words, like SeqLock.
+// リングの一つのスロット。sequenceはその位置のレコードが完成したら2 * 位置 + 2で、書き込み中は奇数なので、
+// 読み手は完成したレコードと千切れたものや新しいものを見分けられる。レコードはSeqLockのようにアトミックの
+// ワードとしてコピーする。
+struct SharedSlot {
+    static constexpr std::size_t word_count = (sizeof(SharedRecord) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+    std::atomic<std::uint64_t> sequence;
+    std::atomic<std::uint64_t> words[word_count];
+};
+
+static_assert(sizeof(SharedSlot) == 40);
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "Shared atomics must be lock-free to work across processes");
+
+// At the start of the segment. The writer fills in everything else before storing magic, so a
+// reader that sees the magic sees the rest.
+// セグメントの最初にある。書き手はmagicを格納する前に他を全部埋めるので、magicが見える読み手には残りも見える。
+struct SegmentHeader {
+    std::atomic<std::uint64_t> magic;
+    std::uint32_t version;
+    std::uint32_t header_size;
+    std::uint64_t segment_size;
+    // Slots in the ring, a power of two.
+    // リングのスロットの数。二のべき乗。
+    std::uint64_t capacity;
+    std::uint64_t top_of_book_offset;
+    std::uint64_t ring_offset;
+    std::uint64_t writer_pid;
+    // Set when the writer shuts down cleanly.
+    // 書き手がきちんと終了したときに設定する。
+    std::atomic<std::uint32_t> closed;
+    // The next position the writer will fill, on its own cache line since it changes with every
+    // record.
+    // 書き手が次に埋める位置。レコードごとに変わるので、独自のキャッシュラインにある。
+    alignas(64) std::atomic<std::uint64_t> head;
+};
+
+static_assert(offsetof(SegmentHeader, head) == 64);
+static_assert(sizeof(SegmentHeader) == 128);
+
+// ===== End of segment layout ===== //
+// ===== セグメントのレイアウトの終わり ===== //
+
+// Publishes events, level changes and the top of the book to a POSIX shared memory segment that
+// other processes can attach to with SharedBookReader. The ring never waits for readers: they
+// only ever map the segment read-only, so each keeps its own position and the writer simply
+// overwrites the oldest slot. A reader that falls a whole ring behind finds out and skips ahead.
+//
+// The segment is created (replacing any old one with the same name) by the constructor and
+// removed by the destructor. Throws if it can't be set up.
+// 他のプロセスがSharedBookReaderで接続できるPOSIXの共有メモリのセグメントに、イベント、レベルの変化と板の
+// 一番上を公開する。リングは読み手を決して待たない。読み手はセグメントを読み取り専用でしかマップしないので、
+// 各々が独自の位置を持って、書き手はただ一番古いスロットを上書きする。リング一周分遅れた読み手はそれに気づいて
+// 先に飛ぶ。
+//
+// セグメントはコンストラクタが作って（同じ名前の古いものを置き換える）、デストラクタが削除する。用意できなかった
+// ら、投げる。
+class SharedBookWriter {
+    std::string name;
+    void* memory = nullptr;
+    std::size_t size = 0;
+    SegmentHeader* header = nullptr;
+    orderbook::TopOfBookPublisher* top_of_book = nullptr;
+    SharedSlot* slots = nullptr;
+    std::uint64_t mask = 0;
+    // A private copy of the head, so publishing never reads shared memory.
+    // 公開が共有メモリを読まないための、ヘッドの自分用のコピー。
+    std::uint64_t head = 0;
+
+    [[gnu::always_inline]]
+    void publish(const SharedRecord& record) noexcept {
+        std::uint64_t raw[SharedSlot::word_count]{};
+        std::memcpy(raw, &record, sizeof(SharedRecord));
+
+        SharedSlot& slot = slots[head & mask];
+
+        slot.sequence.store(2 * head + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (std::size_t i = 0; i < SharedSlot::word_count; ++i) {
+            slot.words[i].store(raw[i], std::memory_order_relaxed);
+        }
+
+        slot.sequence.store(2 * head + 2, std::memory_order_release);
+        ++head;
+        header->head.store(head, std::memory_order_release);
+    }
+
+public:
+    // name is a POSIX shared memory name like "/nanofill" (the slash is added if it's missing).
+    // capacity must be a power of two.
+    // nameは"/nanofill"のようなPOSIXの共有メモリの名前（スラッシュがなければ付ける）。capacityは二のべき乗で
+    // なければならない。
+    explicit SharedBookWriter(const std::string& name, std::size_t capacity = 1 << 16);
+    ~SharedBookWriter();
+    SharedBookWriter(const SharedBookWriter&) = delete;
+    SharedBookWriter& operator=(const SharedBookWriter&) = delete;
+
+    [[gnu::always_inline]]
+    void publish_event(const events::Event& event) noexcept {
+        SharedRecord record;
+        record.event = event;
+        record.kind = RecordKind::Event;
+        publish(record);
+    }
+
+    [[gnu::always_inline]]
+    void publish_level(const std::uint32_t price, const std::uint32_t size, const std::uint32_t last_modified) noexcept {
+        SharedRecord record;
+        record.level = concurrency::LevelUpdate { .price = price, .size = size, .last_modified = last_modified };
+        record.kind = RecordKind::Level;
+        publish(record);
+    }
+
+    [[gnu::always_inline]]
+    void store_top_of_book(const orderbook::TopOfBook& value) noexcept {
+        top_of_book->store(value);
+    }
+
+    const std::string& get_name() const noexcept {
+        return name;
+    }
+};
+
+// Attaches to a SharedBookWriter's segment from any process, read-only. It starts at the newest
+// record, so it only sees what's published after attaching. Attaching and detaching never touch
+// anything the writer reads. Throws if the segment doesn't exist, isn't finished being set up, or
+// has a different layout version.
+// どのプロセスからでも、読み取り専用でSharedBookWriterのセグメントに接続する。一番新しいレコードから始まる
+// ので、接続した後に公開されたものしか見ない。接続と切断は書き手が読むものに決して触らない。セグメントが
+// ない、まだ用意が終わっていない、またはレイアウトのバージョンが違うなら、投げる。
+class SharedBookReader {
+public:
+    enum class Result {
+        Record,
+        // Nothing new yet.
+        // まだ新しいものがない。
+        Empty,
+        // The writer lapped us, so we skipped ahead and lost some records (see get_lost_records).
+        // 書き手に周回されたので、先に飛んで、いくつかのレコードを失った（get_lost_recordsを参照）。
+        Overrun
+    };
+
+private:
+    const void* memory = nullptr;
+    std::size_t size = 0;
+    const SegmentHeader* header = nullptr;
+    const orderbook::TopOfBookPublisher* top_of_book = nullptr;
+    const SharedSlot* slots = nullptr;
+    std::uint64_t mask = 0;
+    std::uint64_t capacity = 0;
+    std::uint64_t position = 0;
+    std::uint64_t lost_records = 0;
+
+    // Jump to half a ring behind the writer, which leaves room before it laps us again.
+    // 書き手の半周後ろに飛ぶ。また周回されるまでに余裕が残る。
+    [[gnu::noinline]]
+    void skip_ahead() noexcept {
+        const std::uint64_t head = header->head.load(std::memory_order_acquire);
+        const std::uint64_t resume = head > capacity / 2 ? head - capacity / 2 : 0;
+
+        if (resume > position) {
+            lost_records += resume - position;
+            position = resume;
+        }
+    }
+
+public:
+    explicit SharedBookReader(const std::string& name);
+    ~SharedBookReader();
+    SharedBookReader(const SharedBookReader&) = delete;
+    SharedBookReader& operator=(const SharedBookReader&) = delete;
+
+    // Read the next record, if there is one.
+    // 次のレコードがあれば、読む。
+    [[gnu::always_inline]]
+    Result next(SharedRecord& record) noexcept {
+        const SharedSlot& slot = slots[position & mask];
+        const std::uint64_t expected = 2 * position + 2;
+        const std::uint64_t sequence_before = slot.sequence.load(std::memory_order_acquire);
+
+        if (sequence_before < expected) {
+            return Result::Empty;
+        }
+
+        std::uint64_t raw[SharedSlot::word_count];
+
+        if (sequence_before == expected) {
+            for (std::size_t i = 0; i < SharedSlot::word_count; ++i) {
+                raw[i] = slot.words[i].load(std::memory_order_relaxed);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (slot.sequence.load(std::memory_order_relaxed) == expected) [[likely]] {
+                std::memcpy(&record, raw, sizeof(SharedRecord));
+                ++position;
+
+                return Result::Record;
+            }
+        }
+
+        skip_ahead();
+
+        return Result::Overrun;
+    }
+
+    orderbook::TopOfBook load_top_of_book() const noexcept {
+        return top_of_book->load();
+    }
+
+    // Records the writer overwrote before we got to them.
+    // 読む前に書き手が上書きしたレコード。
+    std::uint64_t get_lost_records() const noexcept {
+        return lost_records;
+    }
+
+    // How far behind the writer we are.
+    // 書き手からどれだけ遅れているか。
+    std::uint64_t get_lag() const noexcept {
+        return header->head.load(std::memory_order_acquire) - position;
+    }
+
+    bool is_writer_closed() const noexcept {
+        return header->closed.load(std::memory_order_acquire) != 0;
+    }
+
+    std::uint64_t get_writer_pid() const noexcept {
+        return header->writer_pid;
+    }
+};
+
+}
@@ -1,15 +1,45 @@
+#include "backtest/fillsimulator.hpp"
+#include "bookmanager/bookmanager.hpp"
 #include "fileio/fileio.hpp"
 #include "fileio/csv.hpp"
+#include "fileio/itchdecoder.hpp"
+#include "feed/udpfeed.hpp"
+#include "ipc/sharedbook.hpp"
+#include "gateway/gateway.hpp"
+#include "risk/riskchecker.hpp"
+#include "tradingengine/bars.hpp"
+#include "tradingengine/parametersweep.hpp"
+#include "tradingengine/strategy.hpp"
 #include "events/event.hpp"
 #include "orderbook/orderbook.hpp"
+#include "orderbook/topofbook.hpp"
 #include "concurrency/spscringbuffer.hpp"
+#include "concurrency/conflatedlevelchannel.hpp"
 #include "tradingengine/tradingengine.hpp"
 #include "threads/threads.hpp"
 #include "graphics/renderer.hpp"
 #include "consts/consts.hpp"
+#include "memory/hugepages.hpp"
+#include "replay/replay.hpp"
+#include "stats/latencyhistogram.hpp"
+#include "stats/perfcounters.hpp"
+#include "stats/flightrecorder.hpp"
+#include "storage/bookhistory.hpp"
+#include <algorithm>
 #include <iostream>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <atomic>
 #include <chrono>
+#include <cstring>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <tuple>
+#include <utility>
+#include <sys/resource.h>
 
 using nanofill::events::Event;
 using nanofill::tradingengine::TradingEngine;
@@ -33,53 +63,1130 @@ std::vector<Event> parse_events(const std::vector<nanofill::consts::TradingDataC
     return events;
 }
 
+// Only what one OrderBook can hold: one stock (the first one with orders unless one is given) at
+// prices it has a level for.
+// 一つのOrderBookが持てるものだけ。一つの銘柄（与えられなければ、注文がある最初の銘柄）の、レベルがある価格の
+// もの。
+nanofill::fileio::ItchFilter book_filter(const char* stock_locate) {
+    using Policy = nanofill::orderbook::DefaultOrderBookPolicy;
+
+    return {
+        .stock_locate = stock_locate == nullptr ? std::uint16_t{0} : static_cast<std::uint16_t>(std::stoul(stock_locate)),
+        .first_stock = stock_locate == nullptr,
+        .min_price = Policy::min_price,
+        .max_price = Policy::max_price,
+        .tick_size = Policy::tick_size
+    };
+}
+
+void print_itch_filtering(const nanofill::fileio::ItchDecoder& decoder) {
+    std::cout << "Stock locate " << decoder.get_stock_locate() << " (skipped " << decoder.get_other_stock_messages()
+        << " messages for other stocks, dropped " << decoder.get_out_of_range_events() << " events priced outside the book)" << std::endl;
+}
+
+std::vector<Event> decode_itch_events(const char* path, const char* stock_locate = nullptr) {
+    std::cout << "Decoding ITCH messages from " << path << "..." << std::endl;
+    nanofill::fileio::ItchDecoder decoder(1 << 22, book_filter(stock_locate));
+    auto clock_start = std::chrono::steady_clock::now();
+    auto events = nanofill::fileio::decode_itch_file(path, decoder);
+    auto clock_end = std::chrono::steady_clock::now();
+    std::int64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(clock_end - clock_start).count();
+    double elapsed_seconds = elapsed / 1000000.0;
+    std::cout << "Decoded " << events.size() << " events in " << elapsed_seconds << " seconds" << std::endl;
+    print_itch_filtering(decoder);
+
+    return events;
+}
+
+// The events from an ITCH file, or from the LOBSTER data if there's no path.
+// ITCHのファイルから、パスがなければLOBSTERのデータからのイベント。
+std::vector<Event> load_events(const char* itch_path) {
+    if (itch_path != nullptr) {
+        return decode_itch_events(itch_path);
+    }
+
+    const auto file_data = nanofill::fileio::open_text_file("./data/MSFT_2012-06-21_34200000_57600000_message_10.csv");
+
+    return parse_events(nanofill::fileio::parse_csv_data<nanofill::consts::TradingDataCSVFormat>(file_data));
+}
+
+// Say how many outliers the flight recorder saw and write the ones it caught to a Chrome trace, if
+// there was one.
+// フライトレコーダーがあれば、見た外れ値の数を言って、取り込んだものをChromeのトレースに書く。
+void write_flight_recording(nanofill::stats::FlightRecorder* flight_recorder) {
+    if (flight_recorder == nullptr) {
+        return;
+    }
+
+    flight_recorder->flush();
+
+    std::cout << std::endl
+        << "===== Flight recorder =====" << std::endl
+        << "Outliers: " << flight_recorder->get_outlier_count() << std::endl;
+
+    if (flight_recorder->get_snapshots().empty()) {
+        return;
+    }
+
+    const char* path = "flight_recording.json";
+    std::ofstream file(path);
+    const nanofill::stats::FlightRecorder* recorders[] = { flight_recorder };
+    nanofill::stats::write_chrome_trace(file, recorders);
+
+    std::cout << "Wrote " << flight_recorder->get_snapshots().size() << " of them to " << path
+        << " (open in ui.perfetto.dev or chrome://tracing)" << std::endl;
+}
+
+// What a reader on another thread saw of the book's levels through a conflated level channel.
+// 別のスレッドの読み取り側が、間引くレベルチャンネルを通して見た板のレベル。
+struct LevelView {
+    // The latest state the reader has of each level, indexed by price.
+    // 読み取り側が持っている各レベルの最新の状態。価格で添字を付ける。
+    std::vector<nanofill::concurrency::LevelUpdate> levels;
+    std::uint64_t updates = 0;
+    std::uint64_t drains = 0;
+};
+
+// What a reader on another thread saw of the top of the book.
+// 別のスレッドの読み取り側が見た板の一番上。
+struct TopOfBookView {
+    nanofill::orderbook::TopOfBook last{};
+    std::uint64_t samples = 0;
+    // Samples that differed from the one before.
+    // 前のものと違ったサンプル。
+    std::uint64_t changes = 0;
+};
+
+void print_top_of_book(const nanofill::orderbook::TopOfBook& top_of_book) {
+    std::cout << "Bid " << top_of_book.best_bid << " / ask " << top_of_book.best_ask
+        << ", quoting " << top_of_book.target_buy_price << " / " << top_of_book.target_sell_price
+        << " at " << top_of_book.time << "s" << std::endl;
+}
+
+// Which of the optional extras process_events runs alongside the book and the engine. Each one is
+// off unless asked for, since each one costs a thread or some time on the consumer.
+// process_eventsが板とエンジンと一緒に動かす任意の追加機能。それぞれスレッドか消費者の時間を使うので、
+// 頼まれなければオフだ。
+struct Extras {
+    nanofill::stats::PerfCounterProfile* perf_counters = nullptr;
+    nanofill::stats::FlightRecorder* flight_recorder = nullptr;
+    nanofill::ipc::SharedBookWriter* shared_book = nullptr;
+    // Send the strategy's quotes through these checks to a simulated gateway.
+    // 戦略の気配をこのチェックを通してシミュレートしたゲートウェイに送る。
+    nanofill::risk::RiskChecker* risk_checker = nullptr;
+    nanofill::gateway::OrderStats* order_stats = nullptr;
+    // Build bars from every execution into this.
+    // 全ての約定からここにバーを作る。
+    std::vector<nanofill::tradingengine::Bar>* bars = nullptr;
+    // Keep this up to date from another thread with every level the book changes.
+    // 板が変える各レベルで、別のスレッドからこれを最新に保つ。
+    LevelView* level_view = nullptr;
+    // Sample the top of the book from another thread every millisecond into this, printing it once
+    // a second.
+    // 別のスレッドから一ミリ秒ごとに板の一番上をここにサンプリングして、一秒ごとに出力する。
+    TopOfBookView* top_of_book_view = nullptr;
+};
+
+// The strategies that can be picked at start with --strategy.
+// --strategyで起動時に選べる戦略。
+constexpr std::string_view strategy_names[] = {
+    TradingEngine::name,
+    nanofill::tradingengine::BookMidStrategy::name,
+    nanofill::tradingengine::MicropriceStrategy::name
+};
+
+// Call run with a new strategy of the given name, quoting $1 either side of its price. Each one is
+// its own type, so the consumer is compiled for it and its calls are still inlined. Returns false
+// if there isn't one by that name.
+// 与えられた名前の新しい戦略でrunを呼ぶ。戦略は自分の価格から$1離れて気配を出す。それぞれ別の型なので、消費者は
+// それのためにコンパイルされて、呼び出しはインライン化されたままだ。その名前のものがなければ、falseを返す。
+template<typename Run>
+bool with_strategy(const std::string_view name, Run&& run) {
+    constexpr std::uint32_t price_spread = 10000;
+
+    if (name == TradingEngine::name) {
+        TradingEngine strategy(price_spread);
+        run(strategy);
+    } else if (name == nanofill::tradingengine::BookMidStrategy::name) {
+        nanofill::tradingengine::BookMidStrategy strategy(price_spread);
+        run(strategy);
+    } else if (name == nanofill::tradingengine::MicropriceStrategy::name) {
+        nanofill::tradingengine::MicropriceStrategy strategy(price_spread);
+        run(strategy);
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+template<typename Engine>
 std::vector<unsigned int>
-process_events(const std::vector<Event>& events, TradingEngine& trading_engine, OrderBook& order_book) {
+process_events(
+    const std::vector<Event>& events,
+    Engine& trading_engine,
+    OrderBook& order_book,
+    const Extras& extras
+) {
     std::vector<unsigned int> performance_data;
     performance_data.resize(events.size());
-    SPSCRingBuffer<Event, 1024> buffer;
-    
+    // Huge pages keep the ring's slots and indexes under one TLB entry.
+    // ヒュージページで、リングのスロットとインデックスが一つのTLBエントリに収まる。
+    auto buffer = nanofill::memory::make_huge_page_unique<SPSCRingBuffer<Event, 1024>>();
+    nanofill::threads::ConsumerHooks hooks{
+        .perf_counters = extras.perf_counters,
+        .flight_recorder = extras.flight_recorder,
+        .shared_book = extras.shared_book
+    };
+    // Orders go out to the simulated gateway on one ring and its acks come back on another.
+    // 注文は一つのリングでシミュレートしたゲートウェイに出て、受付は別のリングで戻ってくる。
+    nanofill::memory::HugePageUniquePtr<nanofill::gateway::OrderRing> order_ring;
+    nanofill::memory::HugePageUniquePtr<nanofill::gateway::AckRing> ack_ring;
+    std::optional<nanofill::gateway::OrderRouter> order_router;
+    std::optional<nanofill::gateway::SimulatedGateway> gateway;
+    std::atomic<bool> orders_finished{false};
+    std::thread gateway_thread;
+    // Finished bars are collected off the consumer thread, which never allocates.
+    // 終わったバーは消費者のスレッドの外で集める。消費者のスレッドは決して割り当てない。
+    nanofill::memory::HugePageUniquePtr<nanofill::tradingengine::BarRing> bar_ring;
+    std::optional<nanofill::tradingengine::BarAggregator> bar_aggregator;
+    std::atomic<bool> bars_finished{false};
+    std::thread bar_thread;
+    std::unique_ptr<nanofill::concurrency::ConflatedLevelChannel<nanofill::orderbook::order_book_size>> level_channel;
+    std::atomic<bool> levels_finished{false};
+    std::thread level_thread;
+    std::unique_ptr<nanofill::orderbook::TopOfBookPublisher> top_of_book;
+    std::atomic<bool> top_of_book_finished{false};
+    std::thread top_of_book_thread;
+    const auto read_level = [&](const nanofill::concurrency::LevelUpdate& level) {
+        extras.level_view->levels[level.price] = level;
+        ++extras.level_view->updates;
+    };
+
     std::cout << "Processing " << events.size() << " events..." << std::endl;
 
-    std::thread event_producer_thread(nanofill::threads::event_producer<1024>, std::ref(buffer), std::ref(events));
+    if (extras.risk_checker != nullptr) {
+        order_ring = nanofill::memory::make_huge_page_unique<nanofill::gateway::OrderRing>();
+        ack_ring = nanofill::memory::make_huge_page_unique<nanofill::gateway::AckRing>();
+        order_router.emplace(*order_ring, *ack_ring, *extras.risk_checker);
+        gateway.emplace(*order_ring, *ack_ring);
+        hooks.order_router = &*order_router;
+        gateway_thread = std::thread(nanofill::threads::order_gateway, std::ref(*gateway), std::cref(orders_finished));
+    }
+
+    if (extras.bars != nullptr) {
+        bar_ring = nanofill::memory::make_huge_page_unique<nanofill::tradingengine::BarRing>();
+        bar_aggregator.emplace(*bar_ring);
+        hooks.bars = &*bar_aggregator;
+        bar_thread = std::thread([&] {
+            nanofill::tradingengine::Bar bar;
+
+            while (true) {
+                const bool ending = bars_finished.load(std::memory_order_acquire);
+
+                while (bar_ring->pop(bar)) {
+                    extras.bars->push_back(bar);
+                }
+
+                if (ending) {
+                    return;
+                }
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+    }
+
+    if (extras.level_view != nullptr) {
+        level_channel = std::make_unique<nanofill::concurrency::ConflatedLevelChannel<nanofill::orderbook::order_book_size>>();
+        extras.level_view->levels.assign(nanofill::orderbook::order_book_size, {});
+        hooks.level_channel = level_channel.get();
+        level_thread = std::thread([&] {
+            while (!levels_finished.load(std::memory_order_acquire)) {
+                extras.level_view->drains += level_channel->drain(read_level) != 0;
+            }
+        });
+    }
+
+    if (extras.top_of_book_view != nullptr) {
+        top_of_book = std::make_unique<nanofill::orderbook::TopOfBookPublisher>();
+        hooks.top_of_book = top_of_book.get();
+        top_of_book_thread = std::thread([&] {
+            TopOfBookView& view = *extras.top_of_book_view;
+            auto next_report = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+
+            while (!top_of_book_finished.load(std::memory_order_acquire)) {
+                const nanofill::orderbook::TopOfBook sample = top_of_book->load();
+
+                view.changes += std::memcmp(&sample, &view.last, sizeof(sample)) != 0;
+                view.last = sample;
+                ++view.samples;
+
+                if (std::chrono::steady_clock::now() >= next_report) {
+                    print_top_of_book(sample);
+                    next_report += std::chrono::seconds(1);
+                }
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            view.last = top_of_book->load();
+        });
+    }
+
+    std::thread event_producer_thread(nanofill::threads::event_producer<1024>, std::ref(*buffer), std::ref(events));
     std::thread event_consumer_thread(
-        nanofill::threads::event_consumer<1024>,
-        std::ref(buffer), std::ref(order_book),
+        nanofill::threads::event_consumer<1024, Engine>,
+        std::ref(*buffer), std::ref(order_book),
         std::ref(trading_engine),
-        std::ref(performance_data)
+        std::ref(performance_data),
+        hooks
     );
     event_producer_thread.join();
     event_consumer_thread.join();
+
+    if (top_of_book != nullptr) {
+        top_of_book_finished.store(true, std::memory_order_release);
+        top_of_book_thread.join();
+    }
+
+    if (level_channel != nullptr) {
+        levels_finished.store(true, std::memory_order_release);
+        level_thread.join();
+
+        // Both threads are done, so this one can be the writer and the reader. Changes are always
+        // seen by the drain after the next one.
+        // 両方のスレッドが終わったので、このスレッドが書き込み側にも読み取り側にもなれる。変更は必ず次の次の
+        // drainで見える。
+        for (int i = 0; i < 2; ++i) {
+            level_channel->service();
+            extras.level_view->drains += level_channel->drain(read_level) != 0;
+        }
+    }
+
+    if (order_router) {
+        order_router->wait_for_acks();
+        orders_finished.store(true, std::memory_order_release);
+        gateway_thread.join();
+        *extras.order_stats = order_router->get_stats();
+    }
+
+    if (bar_aggregator) {
+        bar_aggregator->flush();
+        bars_finished.store(true, std::memory_order_release);
+        bar_thread.join();
+
+        if (bar_aggregator->get_dropped() != 0) {
+            std::cout << "WARNING: " << bar_aggregator->get_dropped() << " bars didn't fit in the bar ring" << std::endl;
+        }
+    }
     
     std::cout << "Done!" << std::endl;
 
     return performance_data;
 }
 
-int main() {
+// Replay many days at once. Usage: nanofill --replay <directory or glob> [threads] [memory budget in MB]
+// 多くの日を同時に再生する。使い方：nanofill --replay <ディレクトリかグロブ> [スレッド数] [MB単位のメモリ予算]
+int replay(const int argc, char** argv) {
+    nanofill::replay::ReplayOptions options;
+
+    if (argc > 3) {
+        options.threads = std::stoul(argv[3]);
+    }
+
+    if (argc > 4) {
+        options.memory_budget = std::stoull(argv[4]) << 20;
+    }
+
+    const auto files = nanofill::replay::find_replay_files(argv[2]);
+
+    std::cout << "Replaying " << files.size() << " days on " << options.threads << " threads..." << std::endl;
+
+    const auto reports = nanofill::replay::run_replay(files, options);
+
+    nanofill::replay::print_replay_report(std::cout, reports);
+
+    return 0;
+}
+
+// Process events as they're read instead of loading the whole file first, so it starts straight
+// away and uses the same memory however big the input is. Usage: nanofill --stream <file, pipe or ->
+// ファイル全体を先に読み込まずに、読むたびにイベントを処理するので、すぐ始まって、入力がどれだけ大きくても同じ
+// メモリしか使わない。使い方：nanofill --stream <ファイル、パイプまたは->
+int stream(
+    const char* path,
+    nanofill::stats::FlightRecorder* flight_recorder,
+    nanofill::ipc::SharedBookWriter* shared_book
+) {
+    OrderBook order_book;
+    TradingEngine trading_engine(10000);
+    nanofill::stats::LatencyHistogram latency;
+    std::atomic<bool> finished{false};
+    nanofill::threads::StreamStats stats;
+    auto buffer = nanofill::memory::make_huge_page_unique<SPSCRingBuffer<Event, 1024>>();
+
+    std::cout << "Streaming events from " << path << "..." << std::endl;
+
+    std::thread event_consumer_thread(
+        nanofill::threads::stream_consumer<1024>,
+        std::ref(*buffer), std::ref(order_book),
+        std::ref(trading_engine),
+        std::ref(latency),
+        std::cref(finished),
+        nanofill::threads::ConsumerHooks{ .flight_recorder = flight_recorder, .shared_book = shared_book }
+    );
+
+    try {
+        stats = nanofill::threads::stream_producer(path, *buffer, finished);
+    } catch (...) {
+        finished = true;
+        event_consumer_thread.join();
+        throw;
+    }
+
+    event_consumer_thread.join();
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    std::cout << "Done!" << std::endl
+        << std::endl
+        << "===== Stream =====" << std::endl
+        << "Events: " << stats.events << std::endl
+        << "Bytes read: " << stats.bytes << std::endl
+        << "Bad lines: " << stats.bad_lines << std::endl
+        << "Time to first event: " << stats.time_to_first_event.count() / 1000.0 << "us" << std::endl
+        << "Peak RSS: " << usage.ru_maxrss / 1024 << "MB" << std::endl;
+
+    if (stats.failed) {
+        std::cout << "WARNING: the input ended with a read error" << std::endl;
+    }
+
+    std::cout << std::endl << "===== Per-event latency percentiles =====" << std::endl;
+    nanofill::stats::print_latency_percentiles(std::cout, latency);
+    write_flight_recording(flight_recorder);
+
+    return stats.failed ? 1 : 0;
+}
+
+// Receive a live ITCH feed over UDP and process one stock of it as it arrives, e.g. from nanofill
+// --send on the same machine. Usage: nanofill --feed <address:port> [stock locate]
+// UDPでライブのITCHフィードを受け取って、その一つの銘柄を届くたびに処理する。例えば同じマシンのnanofill
+// --sendから。使い方：nanofill --feed <アドレス:ポート> [銘柄の位置]
+int receive_feed(
+    const char* address,
+    const char* stock_locate,
+    nanofill::stats::FlightRecorder* flight_recorder,
+    nanofill::ipc::SharedBookWriter* shared_book
+) {
+    OrderBook order_book;
+    TradingEngine trading_engine(10000);
+    nanofill::stats::LatencyHistogram latency;
+    std::atomic<bool> finished{false};
+    nanofill::feed::UdpReceiver receiver(address);
+    nanofill::feed::FeedHandler handler(1 << 22, book_filter(stock_locate));
+    auto buffer = nanofill::memory::make_huge_page_unique<SPSCRingBuffer<Event, 1024>>();
+
+    std::cout << "Listening on " << address << " (port " << receiver.get_port() << ", busy polling "
+        << (receiver.is_busy_polling() ? "on" : "off") << ")..." << std::endl;
+
+    std::thread event_consumer_thread(
+        nanofill::threads::stream_consumer<1024>,
+        std::ref(*buffer), std::ref(order_book),
+        std::ref(trading_engine),
+        std::ref(latency),
+        std::cref(finished),
+        nanofill::threads::ConsumerHooks{ .flight_recorder = flight_recorder, .shared_book = shared_book }
+    );
+
+    nanofill::threads::feed_producer(receiver, handler, *buffer, finished, std::chrono::seconds(1));
+    event_consumer_thread.join();
+
+    const nanofill::feed::FeedStats& stats = handler.get_stats();
+
+    std::cout << "Done!" << std::endl
+        << std::endl
+        << "===== Feed =====" << std::endl
+        << "Packets: " << stats.packets << std::endl
+        << "Messages: " << stats.messages << std::endl
+        << "Events: " << stats.events << std::endl
+        << "Gaps: " << stats.gaps << " (" << stats.missing_messages << " messages missing)" << std::endl
+        << "Duplicate packets: " << stats.duplicate_packets << std::endl
+        << "Bad packets: " << stats.bad_packets << std::endl
+        << "Unknown orders: " << handler.get_decoder().get_unknown_orders() << std::endl;
+    print_itch_filtering(handler.get_decoder());
+
+    if (!handler.has_ended()) {
+        std::cout << "WARNING: the sender went quiet without ending the session" << std::endl;
+    }
+
+    std::cout << std::endl << "===== Per-event latency percentiles =====" << std::endl;
+    nanofill::stats::print_latency_percentiles(std::cout, latency);
+    write_flight_recording(flight_recorder);
+
+    return 0;
+}
+
+// Receive the same ITCH feed on two lines, e.g. two multicast groups, and process one stock of
+// whichever copy of each message arrives first. Usage: nanofill --feed <A address:port> <B address:port> [stock locate]
+// 同じITCHフィードを二つの回線（例えば二つのマルチキャストグループ）で受け取って、各メッセージの先に届いた
+// コピーから一つの銘柄を処理する。使い方：nanofill --feed <Aのアドレス:ポート> <Bのアドレス:ポート> [銘柄の位置]
+int receive_two_line_feed(
+    const char* address_a,
+    const char* address_b,
+    const char* stock_locate,
+    nanofill::stats::FlightRecorder* flight_recorder,
+    nanofill::ipc::SharedBookWriter* shared_book
+) {
+    using nanofill::feed::ItchMessage;
+    using nanofill::feed::Line;
+    using nanofill::feed::Sequenced;
+
+    OrderBook order_book;
+    TradingEngine trading_engine(10000);
+    nanofill::stats::LatencyHistogram latency;
+    std::atomic<bool> lines_finished{false};
+    std::atomic<bool> finished{false};
+    nanofill::feed::UdpReceiver receiver_a(address_a);
+    nanofill::feed::UdpReceiver receiver_b(address_b);
+    nanofill::feed::LineSplitter splitter_a;
+    nanofill::feed::LineSplitter splitter_b;
+    nanofill::fileio::ItchDecoder decoder(1 << 22, book_filter(stock_locate));
+    auto arbiter = std::make_unique<nanofill::feed::FeedArbiter<ItchMessage>>();
+    auto line_a = nanofill::memory::make_huge_page_unique<SPSCRingBuffer<Sequenced<ItchMessage>, 4096>>();
+    auto line_b = nanofill::memory::make_huge_page_unique<SPSCRingBuffer<Sequenced<ItchMessage>, 4096>>();
+    auto buffer = nanofill::memory::make_huge_page_unique<SPSCRingBuffer<Event, 1024>>();
+
+    std::cout << "Listening on " << address_a << " (port " << receiver_a.get_port() << ") and " << address_b
+        << " (port " << receiver_b.get_port() << ")..." << std::endl;
+
+    std::thread event_consumer_thread(
+        nanofill::threads::stream_consumer<1024>,
+        std::ref(*buffer), std::ref(order_book),
+        std::ref(trading_engine),
+        std::ref(latency),
+        std::cref(finished),
+        nanofill::threads::ConsumerHooks{ .flight_recorder = flight_recorder, .shared_book = shared_book }
+    );
+    std::thread arbitrator_thread(
+        nanofill::threads::feed_arbitrator<4096, 1024, 256>,
+        std::ref(*line_a), std::ref(*line_b), std::cref(lines_finished), std::ref(*arbiter), std::ref(decoder),
+        std::ref(*buffer), std::ref(finished)
+    );
+
+    nanofill::threads::line_receiver<4096>(receiver_a, receiver_b, splitter_a, splitter_b, *line_a, *line_b,
+        lines_finished, std::chrono::seconds(1));
+    arbitrator_thread.join();
+    event_consumer_thread.join();
+
+    const auto& stats = arbiter->get_stats();
+
+    std::cout << "Done!" << std::endl
+        << std::endl
+        << "===== Feed =====" << std::endl;
+
+    for (const auto& [line, name, splitter] : { std::tuple(Line::A, "A", &splitter_a), std::tuple(Line::B, "B", &splitter_b) }) {
+        const auto& line_stats = arbiter->get_line_stats(line);
+
+        std::cout << "Line " << name << ": " << splitter->get_stats().packets << " packets, "
+            << splitter->get_stats().messages << " messages (" << splitter->get_stats().bad_packets << " bad packets, "
+            << splitter->get_stats().long_messages << " too long), first " << line_stats.first << ", second "
+            << line_stats.second << ", lead P50 " << line_stats.lead.get_percentile(0.5) << "ns" << std::endl;
+    }
+
+    std::cout << "Released: " << stats.released << std::endl
+        << "Gaps: " << stats.gaps << " (" << stats.missing << " messages missing on both lines)" << std::endl
+        << "Out of order: " << stats.out_of_order << std::endl
+        << "Unknown orders: " << decoder.get_unknown_orders() << std::endl;
+    print_itch_filtering(decoder);
+
+    if (!splitter_a.has_ended() || !splitter_b.has_ended()) {
+        std::cout << "WARNING: a line went quiet without ending the session" << std::endl;
+    }
+
+    std::cout << std::endl << "===== Per-event latency percentiles =====" << std::endl;
+    nanofill::stats::print_latency_percentiles(std::cout, latency);
+    write_flight_recording(flight_recorder);
+
+    return 0;
+}
+
+// Replay an ITCH file to a feed at a given rate (0 or nothing for as fast as possible).
+// Usage: nanofill --send <file> <address:port> [messages per second]
+// ITCHのファイルを与えられたレート（0か無しなら最速）でフィードに再生する。
+// 使い方：nanofill --send <ファイル> <アドレス:ポート> [毎秒のメッセージ数]
+int send_feed(const int argc, char** argv) {
+    nanofill::feed::SenderOptions options;
+
+    if (argc > 4) {
+        options.messages_per_second = std::stod(argv[4]);
+    }
+
+    std::ifstream file(argv[2], std::ios::binary);
+
+    if (!file) {
+        std::cerr << "Could not open file " << argv[2] << std::endl;
+
+        return 1;
+    }
+
+    const std::vector<std::uint8_t> messages((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    std::cout << "Sending " << argv[2] << " to " << argv[3] << "..." << std::endl;
+
+    const auto stats = nanofill::feed::send_itch_feed(messages, argv[3], options);
+
+    std::cout << "Sent " << stats.messages << " messages in " << stats.packets << " packets in " << stats.seconds
+        << " seconds (" << stats.messages / stats.seconds / 1e6 << " million messages per second)" << std::endl;
+
+    return 0;
+}
+
+// Attach to another NanoFill's shared book and print what it's doing once a second, until it
+// shuts down. Usage: nanofill --watch <name>
+// 他のNanoFillの共有の板に接続して、終了するまで、一秒ごとに何をしているかを出力する。
+// 使い方：nanofill --watch <名前>
+int watch(const char* name) {
+    using Result = nanofill::ipc::SharedBookReader::Result;
+
+    nanofill::ipc::SharedBookReader reader(name);
+    nanofill::ipc::SharedRecord record;
+    std::uint64_t events = 0;
+    std::uint64_t levels = 0;
+    auto next_report = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+
+    std::cout << "Watching " << name << " (writer pid " << reader.get_writer_pid() << ")..." << std::endl;
+
+    while (true) {
+        const bool closed = reader.is_writer_closed();
+        Result result;
+
+        while ((result = reader.next(record)) != Result::Empty) {
+            if (result == Result::Record) {
+                events += record.kind == nanofill::ipc::RecordKind::Event;
+                levels += record.kind == nanofill::ipc::RecordKind::Level;
+            }
+        }
+
+        if (closed || std::chrono::steady_clock::now() >= next_report) {
+            const auto top_of_book = reader.load_top_of_book();
+
+            std::cout << "Bid " << top_of_book.best_bid << " / ask " << top_of_book.best_ask
+                << " at " << top_of_book.time << "s | events " << events << ", level changes " << levels
+                << ", lost " << reader.get_lost_records() << std::endl;
+            next_report += std::chrono::seconds(1);
+        }
+
+        if (closed) {
+            std::cout << "The writer has shut down" << std::endl;
+
+            return 0;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+// A time of day as seconds after midnight or as HH:MM:SS, either with a fraction of a second, e.g.
+// 37867.123456 or 10:31:07.123456, split into whole seconds and nanoseconds.
+// 零時からの秒かHH:MM:SSとしての時刻。どちらも秒の小数があってもいい。例えば37867.123456か10:31:07.123456。
+// 秒とナノ秒に分ける。
+std::pair<std::uint32_t, std::uint32_t> parse_time_of_day(const std::string_view text) {
+    const std::size_t point = text.find('.');
+    const std::string_view whole = text.substr(0, point);
+    std::uint32_t seconds = 0;
+    std::uint32_t nanoseconds = 0;
+
+    for (std::size_t begin = 0; begin <= whole.size();) {
+        const std::size_t colon = std::min(whole.find(':', begin), whole.size());
+        seconds = seconds * 60 + static_cast<std::uint32_t>(std::stoul(std::string(whole.substr(begin, colon - begin))));
+        begin = colon + 1;
+    }
+
+    if (point != std::string_view::npos) {
+        const std::string_view fraction = text.substr(point + 1, 9);
+        nanoseconds = static_cast<std::uint32_t>(std::stoul(std::string(fraction)));
+
+        for (std::size_t digits = fraction.size(); digits < 9; ++digits) {
+            nanoseconds *= 10;
+        }
+    }
+
+    return { seconds, nanoseconds };
+}
+
+// Print the book as it was at one or more times (seconds after midnight or HH:MM:SS, with any
+// fraction of a second, separated by commas), from the LOBSTER data or an ITCH file. A time without
+// a fraction means the end of that second. Usage: nanofill --history <times> [ITCH file]
+// LOBSTERのデータかITCHのファイルから、一つ以上の時（零時からの秒かHH:MM:SSで、秒の小数があってもいい。
+// コンマで区切る）の板を出力する。小数のない時はその秒の終わりだ。使い方：nanofill --history <時> [ITCHのファイル]
+int history(const int argc, char** argv) {
+    constexpr std::size_t depth = 5;
+
+    const std::vector<Event> events = load_events(argc > 3 ? argv[3] : nullptr);
+
+    auto clock_start = std::chrono::steady_clock::now();
+    const nanofill::storage::CompressedEventStore store(events);
+    const nanofill::storage::BookHistory book_history(store);
+    auto clock_end = std::chrono::steady_clock::now();
+
+    std::cout << "Indexed " << store.size() << " events into " << book_history.get_checkpoint_count() << " checkpoints ("
+        << book_history.checkpoint_bytes() / 1e6 << " MB) in " << std::chrono::duration<double>(clock_end - clock_start).count()
+        << " seconds" << std::endl;
+
+    nanofill::storage::HistoricalBook book;
+    std::string_view times = argv[2];
+
+    while (!times.empty()) {
+        const std::size_t comma = times.find(',');
+        const std::string_view time = times.substr(0, comma);
+        const auto [seconds, nanoseconds] = parse_time_of_day(time);
+        times = comma == std::string_view::npos ? std::string_view() : times.substr(comma + 1);
+
+        clock_start = std::chrono::steady_clock::now();
+
+        if (time.contains('.')) {
+            book_history.at_time(seconds, nanoseconds, book);
+        } else {
+            book_history.at_time(seconds, book);
+        }
+
+        clock_end = std::chrono::steady_clock::now();
+
+        std::cout << std::endl << "===== Book at " << time << " (after " << book.get_event_count() << " events, "
+            << std::chrono::duration<double, std::micro>(clock_end - clock_start).count() << "us) =====" << std::endl;
+
+        // The few levels either side of the spread, highest price first.
+        // スプレッドの両側の少しのレベル。高い価格から。
+        const auto levels = book.get_levels();
+        const auto asks = std::find_if(levels.begin(), levels.end(), [&](const auto& level) { return level.price >= book.get_best_ask() && level.sell_size != 0; });
+        const auto bids = std::find_if(levels.rbegin(), levels.rend(), [&](const auto& level) { return level.price <= book.get_best_bid() && level.buy_size != 0; });
+        const auto ask_end = asks + std::min<std::ptrdiff_t>(depth, levels.end() - asks);
+
+        for (auto level = ask_end; level != asks; --level) {
+            std::cout << "ask " << (level - 1)->price << " " << (level - 1)->sell_size << std::endl;
+        }
+
+        for (auto level = bids; level != levels.rend() && level - bids < static_cast<std::ptrdiff_t>(depth); ++level) {
+            std::cout << "bid " << level->price << " " << level->buy_size << std::endl;
+        }
+    }
+
+    return 0;
+}
+
+// Replay the LOBSTER data or an ITCH file through every price spread from 0 to 2000 and quote size
+// from 50 to 500, and print the parameterisations that would have made the most.
+// Usage: nanofill --sweep [ITCH file]
+// LOBSTERのデータかITCHのファイルを0から2000までの全ての価格スプレッドと50から500までの気配の数量で再生して、
+// 一番儲かったはずのパラメータ設定を出力する。使い方：nanofill --sweep [ITCHのファイル]
+int sweep(const int argc, char** argv) {
+    const auto events = nanofill::tradingengine::filter_actioned_events(load_events(argc > 2 ? argv[2] : nullptr));
+    std::vector<nanofill::tradingengine::SweepParameters> parameters;
+
+    for (std::uint32_t spread = 0; spread <= 2000; spread += 10) {
+        for (std::uint32_t quote_size = 50; quote_size <= 500; quote_size += 50) {
+            parameters.push_back({ .price_spread = spread, .quote_size = quote_size });
+        }
+    }
+
+    const unsigned int threads = std::max(1U, std::thread::hardware_concurrency());
+
+    std::cout << "Sweeping " << parameters.size() << " parameterisations over " << events.size()
+        << " events on " << threads << " threads..." << std::endl;
+
+    auto clock_start = std::chrono::steady_clock::now();
+    const auto results = nanofill::tradingengine::run_parameter_sweep(events, parameters, threads);
+    auto clock_end = std::chrono::steady_clock::now();
+
+    std::cout << "Done in " << std::chrono::duration<double>(clock_end - clock_start).count() << " seconds" << std::endl
+        << std::endl << "===== Best parameterisations =====" << std::endl;
+    nanofill::tradingengine::print_sweep_results(std::cout, results, 10);
+
+    return 0;
+}
+
+// Backtest the strategy picked with --strategy on the LOBSTER data or an ITCH file. Its quotes rest
+// on a FillSimulator, which fills them when the replayed market would have, and the fills and profit
+// are printed at the end. Usage: nanofill --backtest [ITCH file]
+// --strategyで選んだ戦略をLOBSTERのデータかITCHのファイルでバックテストする。その気配はFillSimulatorに
+// 置いて、再生している市場が約定させたはずのときに約定して、最後に約定と利益を出力する。
+// 使い方：nanofill --backtest [ITCHのファイル]
+int backtest(const int argc, char** argv, const std::string_view strategy_name) {
+    const auto events = load_events(argc > 2 ? argv[2] : nullptr);
+    OrderBook order_book;
+    nanofill::backtest::FillSimulator<> simulator;
+    nanofill::backtest::QuoteDriver<> quote_driver(simulator);
+    std::uint32_t first_fill_time = 0;
+    std::uint32_t last_fill_time = 0;
+
+    const auto on_fill = [&](const nanofill::backtest::SimulatedFill& fill) {
+        first_fill_time = simulator.get_fill_count() == 1 ? fill.time : first_fill_time;
+        last_fill_time = fill.time;
+    };
+
+    std::cout << "Backtesting the " << strategy_name << " strategy over " << events.size() << " events..." << std::endl;
+
+    const auto clock_start = std::chrono::steady_clock::now();
+
+    with_strategy(strategy_name, [&](auto& strategy) {
+        for (const Event& event : events) {
+            simulator.process_event(event, on_fill);
+
+            if (order_book.process_event(event)) {
+                strategy.on_event(event, order_book);
+                quote_driver.on_targets(strategy.target_buy_price, strategy.target_sell_price, event.time, order_book, on_fill);
+            }
+        }
+    });
+
+    const auto clock_end = std::chrono::steady_clock::now();
+
+    std::cout << "Done in " << std::chrono::duration<double>(clock_end - clock_start).count() << " seconds" << std::endl
+        << std::endl
+        << "===== Backtest =====" << std::endl
+        << "Orders placed: " << quote_driver.get_placed() << " (" << quote_driver.get_cancelled() << " cancelled)" << std::endl
+        << "Fills: " << simulator.get_fill_count();
+
+    if (simulator.get_fill_count() != 0) {
+        std::cout << " (from " << first_fill_time << "s to " << last_fill_time << "s)";
+    }
+
+    std::cout << std::endl
+        << "Shares bought: " << simulator.get_shares_bought() << std::endl
+        << "Shares sold: " << simulator.get_shares_sold() << std::endl
+        << "Position: " << simulator.get_position() << " shares" << std::endl
+        << "Cash: $" << simulator.get_cash() / 10000.0 << std::endl
+        << "PnL (position at the last trade price): $" << simulator.get_profit() / 10000.0 << std::endl;
+
+    return 0;
+}
+
+// Process every stock in an ITCH file at once, each with its own book and engine, spread over a
+// number of threads and rebalanced by event rate as it goes. Each book takes about 25 MB, so only
+// the busiest stocks get one. Usage: nanofill --symbols <threads> <ITCH file> [stocks]
+// ITCHのファイルの全ての銘柄を同時に処理する。各銘柄は独自の板とエンジンを持って、複数のスレッドに分けて、
+// 進みながらイベントのレートでリバランスする。各板は約25MBかかるので、一番忙しい銘柄しか板をもらわない。
+// 使い方：nanofill --symbols <スレッド数> <ITCHのファイル> [銘柄数]
+int symbols(const int argc, char** argv) {
+    using Policy = nanofill::orderbook::DefaultOrderBookPolicy;
+
+    const std::size_t shard_count = std::stoul(argv[2]);
+    const std::size_t max_stocks = argc > 4 ? std::stoul(argv[4]) : 16;
+
+    std::cout << "Decoding ITCH messages from " << argv[3] << "..." << std::endl;
+    nanofill::fileio::ItchDecoder decoder(1 << 22, { .min_price = Policy::min_price, .max_price = Policy::max_price, .tick_size = Policy::tick_size });
+    const auto events = nanofill::fileio::decode_itch_file(argv[3], decoder);
+
+    std::vector<std::uint64_t> stock_events(nanofill::events::max_symbols);
+    std::vector<std::uint16_t> stocks;
+
+    for (const Event& event : events) {
+        stocks.push_back(event.symbol_id);
+        ++stock_events[event.symbol_id];
+    }
+
+    std::sort(stocks.begin(), stocks.end());
+    stocks.erase(std::unique(stocks.begin(), stocks.end()), stocks.end());
+    std::stable_sort(stocks.begin(), stocks.end(), [&](const std::uint16_t a, const std::uint16_t b) {
+        return stock_events[a] > stock_events[b];
+    });
+
+    const std::size_t stock_count = stocks.size();
+    stocks.resize(std::min(stock_count, max_stocks));
+
+    auto manager = std::make_unique<nanofill::bookmanager::BookManager<Policy>>(shard_count, std::vector<int>{}, 1 << 20);
+
+    for (const std::uint16_t stock : stocks) {
+        manager->add_symbol(stock, 10000);
+    }
+
+    std::cout << "Processing " << events.size() << " events for " << stocks.size() << " of " << stock_count
+        << " stocks on " << shard_count << " threads..." << std::endl;
+
+    const auto clock_start = std::chrono::steady_clock::now();
+    manager->start();
+
+    for (const Event& event : events) {
+        manager->route(event);
+    }
+
+    manager->stop();
+    const auto clock_end = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(clock_end - clock_start).count();
+
+    std::cout << "Done in " << seconds << " seconds (" << events.size() / seconds / 1e6 << " million events per second)" << std::endl
+        << std::endl
+        << "===== Symbols =====" << std::endl
+        << "Rebalances: " << manager->get_rebalance_count() << std::endl
+        << "Events for stocks without a book: " << manager->get_unknown_symbol_events() << std::endl;
+
+    for (const std::uint16_t stock : stocks) {
+        const auto& book = manager->get_book(stock);
+
+        std::cout << "Stock locate " << stock << ": " << stock_events[stock] << " events on thread "
+            << manager->get_shard_for_symbol(stock) << ", bid " << book.get_best_bid() << " / ask " << book.get_best_ask()
+            << ", average price " << manager->get_engine(stock).average_share_price << std::endl;
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
     std::cout << "Initialising..." << std::endl;
     initialise();
 
+    std::unique_ptr<nanofill::stats::FlightRecorder> flight_recorder;
+    std::unique_ptr<nanofill::ipc::SharedBookWriter> shared_book;
+    std::string risk_limits_path;
+    std::string_view strategy_name = TradingEngine::name;
+    bool send_orders = false;
+    bool build_bars = false;
+    bool follow_levels = false;
+    bool follow_top_of_book = false;
+
+    // Leading options, in any order, before the mode.
+    // モードの前の、順番を問わない先頭のオプション。
+    while (argc > 1) {
+        const std::string_view option = argv[1];
+
+        if (argc > 2 && option == "--trace-threshold") {
+            // Keep the last few thousand events and write the ones around any slower than this to a
+            // trace. Usage: nanofill [--trace-threshold <ns>] ...
+            // 最後の数千のイベントを持って、これより遅いものの周りをトレースに書く。
+            // 使い方：nanofill [--trace-threshold <ns>] ...
+            nanofill::stats::FlightRecorderOptions flight_recorder_options;
+            flight_recorder_options.threshold_nanoseconds = std::stoul(argv[2]);
+            flight_recorder = std::make_unique<nanofill::stats::FlightRecorder>(flight_recorder_options);
+            argc -= 2;
+            argv += 2;
+        } else if (argc > 2 && option == "--share") {
+            // Let other processes see the book. Usage: nanofill [--share <name>] ...
+            // 他のプロセスに板を見せる。使い方：nanofill [--share <名前>] ...
+            shared_book = std::make_unique<nanofill::ipc::SharedBookWriter>(argv[2]);
+            std::cout << "Sharing the book as " << shared_book->get_name() << std::endl;
+            argc -= 2;
+            argv += 2;
+        } else if (argc > 2 && option == "--risk") {
+            // Check orders against limits read from a file, and reload them whenever it changes.
+            // Implies --orders. Usage: nanofill [--risk <file>] ...
+            // ファイルから読んだ制限と注文を照らし合わせて、ファイルが変わるたびに再読み込みする。--ordersを
+            // 含む。使い方：nanofill [--risk <ファイル>] ...
+            risk_limits_path = argv[2];
+            send_orders = true;
+            argc -= 2;
+            argv += 2;
+        } else if (argc > 2 && option == "--strategy") {
+            // Trade with another strategy in the default run, with --itch or with --backtest. Usage:
+            // nanofill [--strategy <average_price, book_mid or microprice>] ...
+            // 普通の実行か--itchか--backtestで別の戦略で取引する。使い方：nanofill
+            // [--strategy <average_price、book_midまたはmicroprice>] ...
+            strategy_name = argv[2];
+
+            if (std::ranges::find(strategy_names, strategy_name) == std::end(strategy_names)) {
+                std::cerr << "Unknown strategy " << strategy_name << " (average_price, book_mid or microprice)" << std::endl;
+
+                return 1;
+            }
+
+            argc -= 2;
+            argv += 2;
+        } else if (option == "--orders") {
+            // Send the strategy's quotes to a simulated gateway on its own thread and report
+            // tick-to-trade. Usage: nanofill [--orders] ...
+            // 戦略の気配を自分のスレッドのシミュレートしたゲートウェイに送って、tick-to-tradeを報告する。
+            // 使い方：nanofill [--orders] ...
+            send_orders = true;
+            --argc;
+            ++argv;
+        } else if (option == "--levels") {
+            // Follow every level the book changes from another thread through a conflated level
+            // channel, and check what it saw against the book at the end. Usage: nanofill [--levels] ...
+            // 板が変える各レベルを間引くレベルチャンネルを通して別のスレッドで追って、最後に見たものを板と
+            // 照らし合わせる。使い方：nanofill [--levels] ...
+            follow_levels = true;
+            --argc;
+            ++argv;
+        } else if (option == "--top") {
+            // Read the top of the book and the strategy's quotes from another thread while it runs,
+            // and print them once a second. Usage: nanofill [--top] ...
+            // 動いている間に別のスレッドから板の一番上と戦略の気配を読んで、一秒ごとに出力する。
+            // 使い方：nanofill [--top] ...
+            follow_top_of_book = true;
+            --argc;
+            ++argv;
+        } else if (option == "--bars") {
+            // Build time, volume and dollar bars from every execution. Usage: nanofill [--bars] ...
+            // 全ての約定から時間、出来高とドルのバーを作る。使い方：nanofill [--bars] ...
+            build_bars = true;
+            --argc;
+            ++argv;
+        } else {
+            break;
+        }
+    }
+
+    if (argc > 2 && std::string_view(argv[1]) == "--watch") {
+        return watch(argv[2]);
+    }
+
+    if (argc > 2 && std::string_view(argv[1]) == "--replay") {
+        return replay(argc, argv);
+    }
+
+    if (argc > 2 && std::string_view(argv[1]) == "--history") {
+        return history(argc, argv);
+    }
+
+    if (argc > 1 && std::string_view(argv[1]) == "--sweep") {
+        return sweep(argc, argv);
+    }
+
+    if (argc > 1 && std::string_view(argv[1]) == "--backtest") {
+        return backtest(argc, argv, strategy_name);
+    }
+
+    if (argc > 3 && std::string_view(argv[1]) == "--symbols") {
+        return symbols(argc, argv);
+    }
+
+    if (argc > 2 && std::string_view(argv[1]) == "--stream") {
+        return stream(argv[2], flight_recorder.get(), shared_book.get());
+    }
+
+    if (argc > 3 && std::string_view(argv[1]) == "--feed" && std::string_view(argv[3]).contains(':')) {
+        return receive_two_line_feed(argv[2], argv[3], argc > 4 ? argv[4] : nullptr, flight_recorder.get(), shared_book.get());
+    }
+
+    if (argc > 2 && std::string_view(argv[1]) == "--feed") {
+        return receive_feed(argv[2], argc > 3 ? argv[3] : nullptr, flight_recorder.get(), shared_book.get());
+    }
+
+    if (argc > 3 && std::string_view(argv[1]) == "--send") {
+        return send_feed(argc, argv);
+    }
+
     OrderBook order_book;
-    TradingEngine trading_engine(10000);
+    std::vector<nanofill::consts::TradingDataCSVFormat> csv_data;
 
-    std::cout << "Opening data file..." << std::endl;
-    std::vector<std::string> file_data = nanofill::fileio::open_text_file("./data/MSFT_2012-06-21_34200000_57600000_message_10.csv");
+    // Read one stock of NASDAQ ITCH 5.0 instead of LOBSTER CSV. Usage: nanofill --itch <file> [stock locate]
+    // LOBSTERのCSVの代わりにNASDAQ ITCH 5.0の一つの銘柄を読む。使い方：nanofill --itch <ファイル> [銘柄の位置]
+    const bool itch = argc > 2 && std::string_view(argv[1]) == "--itch";
 
-    std::cout << "Parsing CSV data..." << std::endl;
-    auto csv_data = nanofill::fileio::parse_csv_data<nanofill::consts::TradingDataCSVFormat>(file_data);
-    std::cout << "Done!" << std::endl;
+    if (!itch) {
+        std::cout << "Opening data file..." << std::endl;
+        std::vector<std::string> file_data = nanofill::fileio::open_text_file("./data/MSFT_2012-06-21_34200000_57600000_message_10.csv");
+
+        std::cout << "Parsing CSV data..." << std::endl;
+        csv_data = nanofill::fileio::parse_csv_data<nanofill::consts::TradingDataCSVFormat>(file_data);
+        std::cout << "Done!" << std::endl;
+    }
 
     // ===== FROM HERE is where we care about performance ===== //
     // ===== ここから性能が大事だ ===== //
 
-    auto events = parse_events(csv_data);
-    auto performance_data = process_events(events, trading_engine, order_book);    
+    // Only counted when built with PERF_COUNTERS=1.
+    // PERF_COUNTERS=1でビルドしたときしか数えない。
+    nanofill::stats::PerfCounterProfile perf_counters;
+    nanofill::gateway::OrderStats order_stats;
+    std::vector<nanofill::tradingengine::Bar> bars;
+    LevelView level_view;
+    TopOfBookView top_of_book_view;
+    std::unique_ptr<nanofill::risk::RiskLimitsStore> risk_limits;
+    std::unique_ptr<nanofill::risk::RiskChecker> risk_checker;
+    std::atomic<bool> stop_watching_risk_limits{false};
+    std::thread risk_limits_thread;
+
+    if (send_orders) {
+        risk_limits = std::make_unique<nanofill::risk::RiskLimitsStore>(risk_limits_path.empty() ? nanofill::risk::RiskLimits{} : nanofill::risk::load_risk_limits(risk_limits_path));
+        risk_checker = std::make_unique<nanofill::risk::RiskChecker>(*risk_limits);
+    }
+
+    if (!risk_limits_path.empty()) {
+        risk_limits_thread = std::thread(nanofill::risk::watch_risk_limits, std::ref(*risk_limits), risk_limits_path, std::cref(stop_watching_risk_limits));
+    }
+
+    auto events = itch ? decode_itch_events(argv[2], argc > 3 ? argv[3] : nullptr) : parse_events(csv_data);
+    std::vector<unsigned int> performance_data;
+
+    std::cout << "Trading with the " << strategy_name << " strategy" << std::endl;
+
+    with_strategy(strategy_name, [&](auto& trading_engine) {
+        performance_data = process_events(events, trading_engine, order_book, {
+            .perf_counters = &perf_counters,
+            .flight_recorder = flight_recorder.get(),
+            .shared_book = shared_book.get(),
+            .risk_checker = risk_checker.get(),
+            .order_stats = &order_stats,
+            .bars = build_bars ? &bars : nullptr,
+            .level_view = follow_levels ? &level_view : nullptr,
+            .top_of_book_view = follow_top_of_book ? &top_of_book_view : nullptr
+        });
+    });
+
+    if (risk_limits_thread.joinable()) {
+        stop_watching_risk_limits = true;
+        risk_limits_thread.join();
+    }
 
     // ===== Don't care about performance after this ===== //
     // ===== ここから性能がどうでもいい ===== //
 
-    nanofill::graphics::render_latency_chart(performance_data);
+    // A stock locate with nothing in the file leaves nothing to chart.
+    // ファイルに何もない銘柄の位置だと、グラフにするものがない。
+    if (!performance_data.empty()) {
+        nanofill::graphics::render_latency_chart(performance_data);
+    }
+
+    if (risk_checker != nullptr) {
+        std::cout << std::endl << "===== Orders =====" << std::endl;
+        nanofill::gateway::print_order_report(std::cout, order_stats);
+
+        std::cout << std::endl << "===== Risk checks =====" << std::endl;
+        nanofill::risk::print_risk_report(std::cout, risk_checker->get_stats());
+    }
+
+    if (build_bars) {
+        std::cout << std::endl << "===== Bars (last 1 minute bars) =====" << std::endl;
+        nanofill::tradingengine::print_bars(std::cout, bars, nanofill::tradingengine::BarKind::Time, 60, 5);
+    }
+
+    if (follow_top_of_book) {
+        std::cout << std::endl << "===== Top of the book =====" << std::endl
+            << "Samples: " << top_of_book_view.samples << " (" << top_of_book_view.changes << " changed)" << std::endl;
+        print_top_of_book(top_of_book_view.last);
+    }
+
+    if (follow_levels) {
+        std::size_t levels_with_orders = 0;
+        std::size_t mismatches = 0;
+
+        for (std::uint32_t price = 0; price < level_view.levels.size(); ++price) {
+            levels_with_orders += level_view.levels[price].size != 0;
+            mismatches += level_view.levels[price].size != order_book.get_total_order_size_for_price(price);
+        }
+
+        std::cout << std::endl << "===== Level channel =====" << std::endl
+            << "Level updates read: " << level_view.updates << " in " << level_view.drains << " drains" << std::endl
+            << "Levels with orders at the end: " << levels_with_orders << std::endl;
+
+        if (mismatches != 0) {
+            std::cout << "WARNING: " << mismatches << " levels differ from the book" << std::endl;
+        }
+    }
+
+    if constexpr (nanofill::stats::perf_counters_enabled) {
+        std::cout << std::endl << "===== Hardware counters per event =====" << std::endl;
+
+        if (perf_counters.counters == nullptr || !perf_counters.counters->is_available()) {
+            std::cout << "Hardware counters aren't available here (see /proc/sys/kernel/perf_event_paranoid)" << std::endl;
+        } else {
+            nanofill::stats::print_perf_counter_report(std::cout, perf_counters.report);
+        }
+    }
+
+    write_flight_recording(flight_recorder.get());
 
     return 0;
 }
\ No newline at end of file
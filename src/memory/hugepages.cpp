@@ -0,0 +1,99 @@
+#include "hugepages.hpp"
+#include <algorithm>
+#include <atomic>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace nanofill::memory {
+
+namespace {
+
+std::atomic<bool> use_huge_pages{true};
+
+std::size_t round_to_huge_pages(const std::size_t bytes) noexcept {
+    return (bytes + huge_page_size - 1) & ~(huge_page_size - 1);
+}
+
+}
+
+void set_huge_pages_enabled(const bool enabled) noexcept {
+    use_huge_pages.store(enabled, std::memory_order_relaxed);
+}
+
+bool huge_pages_enabled() noexcept {
+    return use_huge_pages.load(std::memory_order_relaxed);
+}
+
+void* allocate_huge_pages(const std::size_t bytes) {
+    const std::size_t size = round_to_huge_pages(bytes == 0 ? 1 : bytes);
+    const bool enabled = huge_pages_enabled();
+    void* memory = MAP_FAILED;
+
+    if (enabled) {
+        // This only works if the system has huge pages reserved (vm.nr_hugepages).
+        // システムがヒュージページを予約している場合（vm.nr_hugepages）にしか使えない。
+        memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+
+    if (memory == MAP_FAILED) {
+        memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (memory == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+
+        // Ask for transparent huge pages instead. If it's refused we still have working memory,
+        // it's just slower.
+        // 代わりに透過的なヒュージページを頼む。断られても、メモリは使えるが、遅いだけだ。
+        madvise(memory, size, enabled ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+    }
+
+    // Fault every page in now rather than on the hot path. Touching one byte per small page works
+    // whichever page size we ended up with.
+    // ホットパスではなく、今すべてのページをフォルトさせる。小さいページごとに一バイトを触ると、結局どちらの
+    // ページサイズになっても大丈夫だ。
+    const auto page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    auto bytes_to_touch = static_cast<volatile std::byte*>(memory);
+
+    for (std::size_t offset = 0; offset < size; offset += page_size) {
+        bytes_to_touch[offset] = std::byte{0};
+    }
+
+    return memory;
+}
+
+void free_huge_pages(void* memory, const std::size_t bytes) noexcept {
+    munmap(memory, round_to_huge_pages(bytes == 0 ? 1 : bytes));
+}
+
+HugePageArena::HugePageArena(const std::size_t bytes)
+    : start(static_cast<std::byte*>(allocate_huge_pages(bytes))), capacity(bytes), total_capacity(bytes) {}
+
+HugePageArena::~HugePageArena() {
+    for (const Chunk& chunk : full_chunks) {
+        free_huge_pages(chunk.start, chunk.capacity);
+    }
+
+    free_huge_pages(start, capacity);
+}
+
+void HugePageArena::grow(const std::size_t bytes) {
+    // Doubling what we have keeps the number of chunks (and page faulting pauses) logarithmic.
+    // 今あるものを倍にすると、チャンクの数（とページフォルトの停止）が対数的になる。
+    const std::size_t chunk_capacity = round_to_huge_pages(std::max(bytes, total_capacity));
+    auto* chunk = static_cast<std::byte*>(allocate_huge_pages(chunk_capacity));
+
+    try {
+        full_chunks.push_back({ start, capacity });
+    } catch (...) {
+        free_huge_pages(chunk, chunk_capacity);
+        throw;
+    }
+
+    start = chunk;
+    capacity = chunk_capacity;
+    used = 0;
+    total_capacity += chunk_capacity;
+}
+
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace nanofill::memory {
+
+// The size of a huge page on x86-64.
+// x86-64のヒュージページのサイズ。
+constexpr std::size_t huge_page_size = 2 * 1024 * 1024;
+
+// Whether new allocations should use huge pages. This is on by default, and is only really worth
+// turning off to compare against.
+// 新しい割り当てがヒュージページを使うかどうか。デフォルトはオンで、比較するためにしかオフにする価値がない。
+void set_huge_pages_enabled(const bool enabled) noexcept;
+bool huge_pages_enabled() noexcept;
+
+// Map memory backed by huge pages, rounded up to a whole number of them. We try explicit huge
+// pages first, then fall back to asking for transparent ones. Every page is touched before
+// returning so that nothing page faults later on the hot path. Throws std::bad_alloc on failure.
+// ヒュージページに裏付けられたメモリをマップする（ヒュージページの整数倍に切り上げる）。まず明示的な
+// ヒュージページを試して、駄目なら透過的なヒュージページを頼む。後でホットパスでページフォルトが起こらない
+// ように、返す前に全ページを触る。失敗したら、std::bad_allocを投げる。
+void* allocate_huge_pages(const std::size_t bytes);
+void free_huge_pages(void* memory, const std::size_t bytes) noexcept;
+
+// A standard allocator that gives each allocation its own huge page mapping. Only use this for
+// a few big, long-lived allocations.
+// 各割り当てに独自のヒュージページのマッピングを与える標準アロケータ。少数の大きくて長く使う割り当てにしか
+// 使わないで。
+template<typename T>
+struct HugePageAllocator {
+    using value_type = T;
+
+    HugePageAllocator() noexcept = default;
+
+    template<typename U>
+    HugePageAllocator(const HugePageAllocator<U>&) noexcept {}
+
+    T* allocate(const std::size_t n) {
+        return static_cast<T*>(allocate_huge_pages(n * sizeof(T)));
+    }
+
+    void deallocate(T* memory, const std::size_t n) noexcept {
+        free_huge_pages(memory, n * sizeof(T));
+    }
+
+    template<typename U>
+    bool operator==(const HugePageAllocator<U>&) const noexcept {
+        return true;
+    }
+};
+
+// A pool of pre-faulted huge page memory that hands out pieces by bumping a pointer. Memory given
+// back is not reused (except for the most recent piece), so size the arena for the peak. Once it's
+// used up, another chunk of huge pages at least as big as everything so far is mapped, so the
+// arena never falls back to the normal heap and only grows a handful of times. Mapping a chunk
+// faults it in, so size the arena so that this is rare.
+// ポインタを進めるだけで一部を渡す、ページフォルト済みのヒュージページのメモリのプール。返されたメモリは
+// （一番最近のものを除いて）再利用しないので、最大の使用量に合わせてサイズを決めて。使い切ったら、今までの
+// 全部と少なくとも同じ大きさのヒュージページのチャンクをもう一つマップするので、普通のヒープは決して使わなくて、
+// 数回しか大きくならない。チャンクをマップするとページフォルトさせるので、それが稀になるようにサイズを決めて。
+class HugePageArena {
+public:
+    // Throws std::bad_alloc if the memory can't be mapped.
+    // メモリがマップできなかったら、std::bad_allocを投げる。
+    explicit HugePageArena(const std::size_t bytes);
+    ~HugePageArena();
+
+    HugePageArena(const HugePageArena&) = delete;
+    HugePageArena& operator=(const HugePageArena&) = delete;
+
+    [[gnu::always_inline]]
+    void* allocate(std::size_t bytes) {
+        // Keep everything 16 byte aligned.
+        // すべてを16バイトにアラインする。
+        bytes = (bytes + 15) & ~std::size_t{15};
+
+        if (bytes > capacity - used) [[unlikely]] {
+            grow(bytes);
+        }
+
+        void* memory = start + used;
+        used += bytes;
+
+        return memory;
+    }
+
+    [[gnu::always_inline]]
+    void deallocate(void* memory, std::size_t bytes) noexcept {
+        auto position = static_cast<std::byte*>(memory);
+
+        bytes = (bytes + 15) & ~std::size_t{15};
+
+        if (position + bytes == start + used) {
+            used -= bytes;
+        }
+    }
+
+    // Every byte mapped so far, across all the chunks.
+    // 今までマップした全てのチャンクの全てのバイト。
+    std::size_t get_capacity() const noexcept {
+        return total_capacity;
+    }
+
+    std::size_t get_chunk_count() const noexcept {
+        return full_chunks.size() + 1;
+    }
+
+private:
+    struct Chunk {
+        std::byte* start;
+        std::size_t capacity;
+    };
+
+    // Chunks that have been used up, kept until the arena is destroyed.
+    // 使い切ったチャンク。アリーナが破棄されるまで持つ。
+    std::vector<Chunk> full_chunks;
+    std::byte* start;
+    std::size_t capacity;
+    std::size_t used = 0;
+    std::size_t total_capacity;
+
+    [[gnu::noinline]]
+    void grow(const std::size_t bytes);
+};
+
+// A standard allocator that takes its memory from a HugePageArena, which must outlive it.
+// HugePageArenaからメモリを取る標準アロケータ。アリーナのほうが長生きしなければならない。
+template<typename T>
+struct ArenaAllocator {
+    using value_type = T;
+
+    HugePageArena* arena;
+
+    explicit ArenaAllocator(HugePageArena* arena) noexcept : arena(arena) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena(other.arena) {}
+
+    [[gnu::always_inline]]
+    T* allocate(const std::size_t n) {
+        return static_cast<T*>(arena->allocate(n * sizeof(T)));
+    }
+
+    [[gnu::always_inline]]
+    void deallocate(T* memory, const std::size_t n) noexcept {
+        arena->deallocate(memory, n * sizeof(T));
+    }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const noexcept {
+        return arena == other.arena;
+    }
+};
+
+template<typename T>
+struct HugePageDeleter {
+    void operator()(T* object) const noexcept {
+        object->~T();
+        free_huge_pages(object, sizeof(T));
+    }
+};
+
+template<typename T>
+using HugePageUniquePtr = std::unique_ptr<T, HugePageDeleter<T>>;
+
+// Construct an object in its own huge page mapping. Good for big fixed-size things like ring
+// buffers.
+// 独自のヒュージページのマッピングにオブジェクトを構築する。リングバッファなどの大きくて固定サイズのものに
+// 向いている。
+template<typename T, typename... Args>
+HugePageUniquePtr<T> make_huge_page_unique(Args&&... args) {
+    static_assert(alignof(T) <= huge_page_size);
+
+    void* memory = allocate_huge_pages(sizeof(T));
+
+    try {
+        return HugePageUniquePtr<T>(new (memory) T(std::forward<Args>(args)...));
+    } catch (...) {
+        free_huge_pages(memory, sizeof(T));
+        throw;
+    }
+}
+
+}
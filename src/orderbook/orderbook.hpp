@@ -1,14 +1,23 @@
 #pragma once
 
 #include "events/event.hpp"
+#include "memory/hugepages.hpp"
+#include <algorithm>
+#include <bit>
+#include <cassert>
 #include <climits>
+#include <cstdlib>
+#include <memory>
+#include <span>
 
 namespace nanofill::orderbook {
 
 using events::Event;
 using events::EventType;
 
-constexpr std::size_t order_book_size = 500000;
+// The most events process_events can take at once.
+// process_eventsが一発で受け取れるイベントの最大数。
+constexpr std::size_t max_batch_size = 64;
 
 // A trading event.
 // 取引のイベント。
@@ -25,20 +34,229 @@ struct OrderBookEntry {
     std::int32_t size;
 };
 
-// Note that this order book only supports one stock index (in our data - Microsoft).
-// For an order book that supports multiple, the choices here would probably be a lot
-// different (e.g. maybe stronger emphasis on rationing memory).
-// この注文板は一つの株価指数に対応している（Microsoft）。
-// 複数の株価指数に対応するために、ここでされている選択が全く違うほうがいいかもしれない（例えば、メモリ
-// の割り当ての制限を重視する）。
-class OrderBook {
+// How an order book keeps track of the buy and sell sides of each level.
+// 注文板が各レベルの買いと売りの側をどう管理するか。
+enum class SideLayout {
+    // Keep the buy size of each level as well as the total, so we know the best bid and ask.
+    // 合計の上に各レベルの買いのサイズも持つので、最良気配値が分かる。
+    PerSide,
+    // Only keep the total size of each level. Cheaper, but there is no best bid or ask.
+    // 各レベルの合計サイズしか持たない。安いが、最良気配値がない。
+    TotalsOnly,
+};
+
+// The compile-time configuration of an order book. Make a struct with the same members to
+// specialise a book for a different kind of instrument. Prices are always dollars times 10,000.
+// 注文板のコンパイル時の設定。違う種類の銘柄のために板を特殊化するには、同じメンバーのstructを作って。
+// 価格はいつも10,000倍したドルだ。
+struct DefaultOrderBookPolicy {
+    using Price = std::uint32_t;
+
+    // The lowest and highest prices (inclusive) the book can hold, and the gap between levels.
+    // 板が持てる一番安い価格と一番高い価格（含む）、とレベル間の差。
+    static constexpr Price min_price = 0;
+    static constexpr Price max_price = 499999;
+    static constexpr Price tick_size = 1;
+
+    // The number of orders a level makes room for the first time an order rests on it.
+    // 注文が初めてレベルに置かれたときに、そのレベルが場所を用意する注文の数。
+    static constexpr std::size_t level_reserve = 16;
+    // How many orders we expect to rest on the book at once. The huge page order pool starts with
+    // room for twice this many, since levels leave their old memory behind when they grow, and
+    // maps more huge pages if it runs out.
+    // 同時に板に置かれると予想する注文の数。レベルは大きくなるときに古いメモリを置いていくので、ヒュージページの
+    // 注文プールはこの二倍の場所で始まって、足りなくなったらヒュージページをもっとマップする。
+    static constexpr std::size_t expected_orders = 1 << 16;
+
+    // The container holding the orders on one level.
+    // 一つのレベルの注文を持つコンテナ。
+    template<typename Entry, typename Allocator>
+    using LevelContainer = std::vector<Entry, Allocator>;
+
+    static constexpr SideLayout side_layout = SideLayout::PerSide;
+};
+
+// One value per level, stored in huge pages so that jumping around prices doesn't thrash the TLB.
+// レベルごとに一つの値。価格をあちこちアクセスしてもTLBを荒らさないように、ヒュージページに格納する。
+template<typename T>
+using LevelArray = std::vector<T, memory::HugePageAllocator<T>>;
+
+// One bit per level saying whether that side has shares on it, plus one bit per 64 levels saying
+// whether any of those do, so the next level with shares above or below any level is found with a
+// handful of word scans however far away it is.
+// レベルごとにその側に株があるかを示す一ビットと、64レベルごとにそのどれかにあるかを示す一ビット。どれだけ
+// 離れていても、どのレベルの上か下の株がある次のレベルを少しのワードの走査で見つけられる。
+class LevelBitmap {
+    LevelArray<std::uint64_t> words;
+    LevelArray<std::uint64_t> summary;
+
+public:
+    // Returned when there's no such level.
+    // そんなレベルがないときに返す。
+    static constexpr std::size_t none = SIZE_MAX;
+
+    void resize(const std::size_t levels) {
+        words.resize((levels + 63) / 64);
+        summary.resize((words.size() + 63) / 64);
+    }
+
+    [[gnu::always_inline]]
+    void assign(const std::size_t level, const bool set) noexcept {
+        const std::size_t word = level / 64;
+        const std::uint64_t bit = 1ULL << (level % 64);
+        const std::uint64_t summary_bit = 1ULL << (word % 64);
+
+        words[word] = set ? words[word] | bit : words[word] & ~bit;
+        summary[word / 64] = words[word] != 0 ? summary[word / 64] | summary_bit : summary[word / 64] & ~summary_bit;
+    }
+
+    // The highest set level below level, or none.
+    // levelより下の一番高い設定したレベル。ないと、none。
+    std::size_t find_below(const std::size_t level) const noexcept {
+        if (level == 0) {
+            return none;
+        }
+
+        // Everything up to and including last.
+        // lastまでとlastを含む全部。
+        const std::size_t last = level - 1;
+        std::size_t word = last / 64;
+        const std::uint64_t bits = words[word] & (~0ULL >> (63 - last % 64));
+
+        if (bits != 0) {
+            return word * 64 + 63 - std::countl_zero(bits);
+        }
+
+        if (word == 0) {
+            return none;
+        }
+
+        --word;
+        std::size_t group = word / 64;
+        std::uint64_t groups = summary[group] & (~0ULL >> (63 - word % 64));
+
+        while (groups == 0) {
+            if (group == 0) {
+                return none;
+            }
+
+            groups = summary[--group];
+        }
+
+        word = group * 64 + 63 - std::countl_zero(groups);
+
+        return word * 64 + 63 - std::countl_zero(words[word]);
+    }
+
+    // The lowest set level above level, or none.
+    // levelより上の一番低い設定したレベル。ないと、none。
+    std::size_t find_above(const std::size_t level) const noexcept {
+        const std::size_t first = level + 1;
+        std::size_t word = first / 64;
+
+        if (word >= words.size()) {
+            return none;
+        }
+
+        const std::uint64_t bits = words[word] & (~0ULL << (first % 64));
+
+        if (bits != 0) {
+            return word * 64 + std::countr_zero(bits);
+        }
+
+        if (++word >= words.size()) {
+            return none;
+        }
+
+        std::size_t group = word / 64;
+        std::uint64_t groups = summary[group] & (~0ULL << (word % 64));
+
+        while (groups == 0) {
+            if (++group >= summary.size()) {
+                return none;
+            }
+
+            groups = summary[group];
+        }
+
+        word = group * 64 + std::countr_zero(groups);
+
+        return word * 64 + std::countr_zero(words[word]);
+    }
+};
+
+// An order book for one instrument. The policy fixes its price range, tick size, memory and
+// layout at compile time, so that books for very different instruments (see policies.hpp) can each
+// be sized for what they actually need, and all the level arithmetic folds into constants.
+// 一つの銘柄の注文板。ポリシーがコンパイル時に価格の範囲、呼値の単位、メモリとレイアウトを決めるので、全く
+// 違う銘柄の板（policies.hppを参照）がそれぞれ本当に必要なサイズになれて、レベルの計算がすべて定数になる。
+template<typename Policy>
+class BasicOrderBook {
 public:
-    OrderBook() noexcept;
+    using Price = typename Policy::Price;
+    // The orders on one level. These all come out of the order book's huge page order pool.
+    // 一つのレベルの注文。全部板のヒュージページの注文プールから割り当てられる。
+    using Level = typename Policy::template LevelContainer<OrderBookEntry, memory::ArenaAllocator<OrderBookEntry>>;
+
+    // The number of levels, which is also the size of every level array.
+    // レベルの数。すべてのレベルの配列のサイズでもある。
+    static constexpr std::size_t levels = (Policy::max_price - Policy::min_price) / Policy::tick_size + 1;
+    static constexpr bool per_side = Policy::side_layout == SideLayout::PerSide;
+    // What the order pool starts with (see DefaultOrderBookPolicy::expected_orders).
+    // 注文プールの最初のサイズ（DefaultOrderBookPolicy::expected_ordersを参照）。
+    static constexpr std::size_t order_pool_bytes = 2 * Policy::expected_orders * sizeof(OrderBookEntry);
 
-    // Returns true if the event was actioned, false if not.
-    // 処理したら、trueを返す。または、false。
+    static_assert(Policy::min_price <= Policy::max_price, "The price range is empty");
+    static_assert(Policy::tick_size > 0, "The tick size must be positive");
+
+    // Throws std::bad_alloc if the memory for the book can't be had.
+    // 板のメモリが取れなかったら、std::bad_allocを投げる。
+    BasicOrderBook()
+        : order_pool(std::make_unique<memory::HugePageArena>(order_pool_bytes)) {
+        levels_orders.resize(levels, Level(memory::ArenaAllocator<OrderBookEntry>(order_pool.get())));
+        levels_last_modified.resize(levels);
+        levels_size.resize(levels);
+
+        if constexpr (per_side) {
+            levels_buy_size.resize(levels);
+            bid_levels.resize(levels);
+            ask_levels.resize(levels);
+        }
+    }
+
+    // Whether the book has a level for a price: inside the policy's range and on a tick.
+    // 板に価格のレベルがあるか。ポリシーの範囲の中で、呼値の単位に乗っている。
+    [[gnu::always_inline]]
+    static constexpr bool is_valid_price(const Price price) noexcept {
+        return price >= Policy::min_price && price <= Policy::max_price && (price - Policy::min_price) % Policy::tick_size == 0;
+    }
+
+    // The level a price lives on. With the policy's constants this folds down to very little. The
+    // price must be valid (see is_valid_price); process_event checks, but the getters don't.
+    // 価格があるレベル。ポリシーの定数で、ほとんど何もない計算になる。価格は有効でなければならない
+    // （is_valid_priceを参照）。process_eventは確認するが、ゲッターは確認しない。
+    [[gnu::always_inline]]
+    static constexpr std::size_t level_of(const Price price) noexcept {
+        assert(is_valid_price(price));
+
+        return (price - Policy::min_price) / Policy::tick_size;
+    }
+
+    [[gnu::always_inline]]
+    static constexpr Price price_of(const std::size_t level) noexcept {
+        return static_cast<Price>(level * Policy::tick_size + Policy::min_price);
+    }
+
+    // Returns true if the event was actioned, false if not. Events at prices the book has no level
+    // for (see is_valid_price) are never actioned.
+    // 処理したら、trueを返す。または、false。板にレベルがない価格（is_valid_priceを参照）のイベントは
+    // 決して処理しない。
     [[gnu::always_inline]]
     bool process_event(const Event event) noexcept {
+        if (!is_valid_price(event.price)) [[unlikely]] {
+            return false;
+        }
+
         // Ordered from most to least common.
         // 多い順に並べっている。
         switch (event.type) {
@@ -59,19 +277,110 @@ public:
         }
     }
 
+    // Process events in order, max_batch_size at a time. Everything a batch will touch is
+    // prefetched first, so that the cache misses for each event overlap instead of happening one
+    // after another. Returns a mask where bit i is set if event i was actioned; only the first
+    // max_batch_size events have a bit, so pass at most that many if you need the mask.
+    // イベントを順番に、一度にmax_batch_size個ずつ処理する。まずバッチが触るものを全部プリフェッチするので、
+    // 各イベントのキャッシュミスが次々に起こらずに重なる。イベントiを処理したら、ビットiが立っているマスクを
+    // 返す。最初のmax_batch_size個のイベントにしかビットがないので、マスクが必要なら、それ以下しか渡さないで。
+    [[gnu::always_inline]]
+    std::uint64_t process_events(const std::span<const Event> events) noexcept {
+        static_assert(max_batch_size <= 64, "The mask has one bit per event in a batch");
+
+        std::uint64_t actioned = 0;
+
+        for (std::size_t start = 0; start < events.size(); start += max_batch_size) {
+            const auto batch = events.subspan(start, std::min(max_batch_size, events.size() - start));
+
+            prefetch_events(batch);
+
+            for (std::size_t i = 0; i < batch.size(); ++i) {
+                const bool done = process_event(batch[i]);
+
+                if (start == 0) {
+                    actioned |= static_cast<std::uint64_t>(done) << i;
+                }
+            }
+        }
+
+        return actioned;
+    }
+
+    // Start loading everything processing these events will touch into the cache.
+    // このイベントを処理するときに触るものを全部キャッシュに読み込み始める。
+    [[gnu::always_inline]]
+    void prefetch_events(const std::span<const Event> events) const noexcept {
+        for (const Event& event : events) {
+            const std::size_t level = is_valid_price(event.price) ? level_of(event.price) : 0;
+
+            __builtin_prefetch(&levels_last_modified[level], 1);
+            __builtin_prefetch(&levels_size[level], 1);
+
+            if constexpr (per_side) {
+                __builtin_prefetch(&levels_buy_size[level], 1);
+            }
+
+            __builtin_prefetch(&levels_orders[level], 1);
+        }
+
+        // The orders themselves live behind each level's vector, which the first pass has
+        // hopefully loaded by now.
+        // 注文そのものは各レベルのvectorの先にあって、そのvectorは一回目のループでもう読み込めているはずだ。
+        for (const Event& event : events) {
+            __builtin_prefetch(levels_orders[is_valid_price(event.price) ? level_of(event.price) : 0].data(), 1);
+        }
+    }
+
     [[gnu::always_inline]]
-    std::uint32_t get_last_modified_for_price(const std::uint32_t price) const noexcept {
-        return levels_last_modified[price];
+    std::uint32_t get_last_modified_for_price(const Price price) const noexcept {
+        return levels_last_modified[level_of(price)];
     }
 
     [[gnu::always_inline]]
-    std::uint32_t get_total_order_size_for_price(const std::uint32_t price) const noexcept {
-        return levels_size[price];
+    std::uint32_t get_total_order_size_for_price(const Price price) const noexcept {
+        return levels_size[level_of(price)];
     }
 
     [[gnu::always_inline]]
-    const std::vector<OrderBookEntry>& get_orders_for_price(const std::uint32_t price) const noexcept {
-        return levels_orders[price];
+    std::uint32_t get_buy_size_for_price(const Price price) const noexcept requires per_side {
+        return levels_buy_size[level_of(price)];
+    }
+
+    [[gnu::always_inline]]
+    std::uint32_t get_sell_size_for_price(const Price price) const noexcept requires per_side {
+        return levels_size[level_of(price)] - levels_buy_size[level_of(price)];
+    }
+
+    // The highest price with buy orders on it, or 0 if there are none.
+    // 買い注文がある一番高い価格。ないと、0。
+    [[gnu::always_inline]]
+    Price get_best_bid() const noexcept requires per_side {
+        return best_bid;
+    }
+
+    // The lowest price with sell orders on it, or 0 if there are none.
+    // 売り注文がある一番安い価格。ないと、0。
+    [[gnu::always_inline]]
+    Price get_best_ask() const noexcept requires per_side {
+        return best_ask;
+    }
+
+    // The next lower price with buy orders on it, or 0 if there are none.
+    // 買い注文がある次に安い価格。ないと、0。
+    Price get_next_bid(const Price price) const noexcept requires per_side {
+        return find_bid_below(level_of(price));
+    }
+
+    // The next higher price with sell orders on it, or 0 if there are none.
+    // 売り注文がある次に高い価格。ないと、0。
+    Price get_next_ask(const Price price) const noexcept requires per_side {
+        return find_ask_above(level_of(price));
+    }
+
+    [[gnu::always_inline]]
+    const Level& get_orders_for_price(const Price price) const noexcept {
+        return levels_orders[level_of(price)];
     }
     
 private:
@@ -81,15 +390,32 @@ private:
     // 注文板のレベルのデータ。structの代わりにvectorに格納することで、キャッシュ局所性を改善できる。
     // 各配列の各インデックスがすべての価格を表す。
 
+    // Where the orders on every level get their memory from. This has to outlive levels_orders.
+    // すべてのレベルの注文のメモリの出所。levels_ordersより長生きしなければならない。
+    std::unique_ptr<memory::HugePageArena> order_pool;
     // The time of the last event on each level (according to the event).
     // 各レベルの最後のイベントの時（イベントによって）。
-    std::vector<std::uint32_t> levels_last_modified;
+    LevelArray<std::uint32_t> levels_last_modified;
     // The number of shares on each level.
     // 各レベルの株の数。
-    std::vector<std::uint32_t> levels_size;
+    LevelArray<std::uint32_t> levels_size;
+    // The number of shares on each level that belong to buy orders. The rest are sell orders.
+    // Empty unless the side layout is PerSide.
+    // 各レベルの買い注文の株の数。残りは売り注文だ。サイドレイアウトがPerSideじゃなければ、空だ。
+    LevelArray<std::uint32_t> levels_buy_size;
     // The orders on each level.
     // 各レベルの注文。
-    std::vector<std::vector<OrderBookEntry>> levels_orders;
+    LevelArray<Level> levels_orders;
+    // See get_best_bid and get_best_ask.
+    // get_best_bidとget_best_askを参照。
+    Price best_bid = 0;
+    Price best_ask = 0;
+    // Which levels have buy and sell shares on them, so the next best price is found without
+    // walking every empty level in between. Empty unless the side layout is PerSide.
+    // どのレベルに買いと売りの株があるか。次の最良の価格を間の空のレベルを全部歩かずに見つけられる。
+    // サイドレイアウトがPerSideじゃなければ、空だ。
+    LevelBitmap bid_levels;
+    LevelBitmap ask_levels;
 
     // An order has been entirely deleted.
     // 注文が完全に削除された。
@@ -116,10 +442,13 @@ private:
     // remove_orderと同じだが、注文のインデックスがもう分かるので、もう少し速い。
     [[gnu::always_inline]]
     void remove_order_with_index(const Event event, const unsigned int index) noexcept {
-        levels_last_modified[event.price] = event.time;
-        levels_size[event.price] -= std::abs(event.size);
-        levels_orders[event.price][index] = levels_orders[event.price].back();
-        levels_orders[event.price].pop_back();
+        const std::size_t level = level_of(event.price);
+
+        levels_last_modified[level] = event.time;
+        levels_size[level] -= std::abs(event.size);
+        remove_side_size(level, event.size);
+        levels_orders[level][index] = levels_orders[level].back();
+        levels_orders[level].pop_back();
     }
 
     // Remove an order from the order book. Prefer remove_order_with_index if possible.
@@ -128,28 +457,30 @@ private:
     // 返す。
     [[gnu::always_inline]]
     bool remove_order(const Event event) noexcept {
-        auto entry = get_order_by_price_and_id(event.price, event.order_id);
+        const std::size_t level = level_of(event.price);
+        auto entry = get_order_by_level_and_id(level, event.order_id);
         
         if (entry == nullptr) {
             // Order not found.
             return false;
         }
 
-        levels_last_modified[event.price] = event.time;
-        levels_size[event.price] -= std::abs(entry->size);
-        *entry = levels_orders[event.price].back();
-        levels_orders[event.price].pop_back();
+        levels_last_modified[level] = event.time;
+        levels_size[level] -= std::abs(entry->size);
+        remove_side_size(level, entry->size);
+        *entry = levels_orders[level].back();
+        levels_orders[level].pop_back();
 
         return true;
     }
 
-    // Get a pointer to the order with the given price and id, or nullptr if it doesn't exist.
-    // この価格とIDがある注文のポインタを返す。ないと、nullptrを返す。
+    // Get a pointer to the order with the given level and id, or nullptr if it doesn't exist.
+    // このレベルとIDがある注文のポインタを返す。ないと、nullptrを返す。
     [[gnu::always_inline]]
-    OrderBookEntry* get_order_by_price_and_id(const std::uint32_t price, const std::uint32_t order_id) noexcept {
-        auto start = &levels_orders[price][0];
+    OrderBookEntry* get_order_by_level_and_id(const std::size_t level, const std::uint32_t order_id) noexcept {
+        auto start = levels_orders[level].data();
         auto position = start;
-        auto end = start + levels_orders[price].size();
+        auto end = start + levels_orders[level].size();
 
         while (position != end) {
             if (position->order_id == order_id) {
@@ -168,25 +499,96 @@ private:
     // 処理したら、trueを返す。
     [[gnu::always_inline]]
     bool process_cancellation_event(const Event event) noexcept {
-        OrderBookEntry* current_event = get_order_by_price_and_id(event.price, event.order_id);
+        const std::size_t level = level_of(event.price);
+        OrderBookEntry* current_event = get_order_by_level_and_id(level, event.order_id);
 
         if (current_event == nullptr) {
             return false;
         }
 
-        levels_size[event.price] -= std::abs(event.size);
-        current_event->size -= event.size * (1 - 2 * (current_event->size < 0));
-        levels_last_modified[event.price] = event.time;
+        // Cancellations can come signed either way depending on the source, so take the side from
+        // the order itself.
+        // 取消のサイズはソースによってどちらの符号でも来るので、注文そのものから売買を判断する。
+        const std::int32_t signed_size = current_event->size < 0 ? -std::abs(event.size) : std::abs(event.size);
+
+        levels_size[level] -= std::abs(event.size);
+        remove_side_size(level, signed_size);
+        current_event->size -= signed_size;
+        levels_last_modified[level] = event.time;
 
         return true;
     }
 
+    // Some shares have left a level. signed_size is negative for sell orders. If that emptied
+    // the best level on that side, move the best price to the next level that still has orders.
+    // レベルから株が出た。signed_sizeは売り注文ならネガティブだ。その側の最良のレベルが空になったら、
+    // まだ注文がある次のレベルに最良の価格を移す。
+    [[gnu::always_inline]]
+    void remove_side_size(const std::size_t level, const std::int32_t signed_size) noexcept {
+        if constexpr (per_side) {
+            const Price price = price_of(level);
+
+            if (signed_size > 0) {
+                levels_buy_size[level] -= signed_size;
+
+                if (levels_buy_size[level] == 0) {
+                    bid_levels.assign(level, false);
+
+                    if (price == best_bid) [[unlikely]] {
+                        best_bid = find_bid_below(level);
+                    }
+                }
+            } else if (levels_size[level] == levels_buy_size[level]) {
+                ask_levels.assign(level, false);
+
+                if (price == best_ask) [[unlikely]] {
+                    best_ask = find_ask_above(level);
+                }
+            }
+        }
+    }
+
+    // Returns the highest price below the given level with buy orders, or 0 if there is none.
+    // このレベルより安くて、買い注文がある一番高い価格を返す。ないと、0を返す。
+    Price find_bid_below(const std::size_t level) const noexcept {
+        const std::size_t found = bid_levels.find_below(level);
+
+        return found == LevelBitmap::none ? 0 : price_of(found);
+    }
+
+    // Returns the lowest price above the given level with sell orders, or 0 if there is none.
+    // このレベルより高くて、売り注文がある一番安い価格を返す。ないと、0を返す。
+    Price find_ask_above(const std::size_t level) const noexcept {
+        const std::size_t found = ask_levels.find_above(level);
+
+        return found == LevelBitmap::none ? 0 : price_of(found);
+    }
+
     // Insert an order into the order book.
     // 板に注文を入れる。
     [[gnu::always_inline]]
     void insert_order(const Event event) noexcept {
-        levels_last_modified[event.price] = event.time;
-        levels_size[event.price] += std::abs(event.size);
+        const std::size_t level = level_of(event.price);
+
+        levels_last_modified[level] = event.time;
+        levels_size[level] += std::abs(event.size);
+
+        if constexpr (per_side) {
+            if (event.size > 0) {
+                levels_buy_size[level] += event.size;
+                bid_levels.assign(level, true);
+
+                if (event.price > best_bid) {
+                    best_bid = event.price;
+                }
+            } else {
+                ask_levels.assign(level, levels_size[level] != levels_buy_size[level]);
+
+                if (event.price < best_ask || best_ask == 0) {
+                    best_ask = event.price;
+                }
+            }
+        }
 
         OrderBookEntry entry = {
             .price = event.price,
@@ -195,8 +597,29 @@ private:
             .size = event.size
         };
 
-        levels_orders[event.price].push_back(entry);
+        Level& orders = levels_orders[level];
+
+        // Levels only take memory from the pool once they're used, so an empty book costs little.
+        // レベルは使われてからしかプールからメモリを取らないので、空の板は安い。
+        if (orders.capacity() == 0) [[unlikely]] {
+            orders.reserve(Policy::level_reserve);
+        }
+
+        orders.push_back(entry);
     }
 };
 
+// The order book we use for our data. Other instruments can use a BasicOrderBook with their own
+// policy.
+// 今のデータに使う注文板。他の銘柄は独自のポリシーでBasicOrderBookを使える。
+using OrderBook = BasicOrderBook<DefaultOrderBookPolicy>;
+
+// The number of levels (and so the highest price plus one) in our default book.
+// デフォルトの板のレベルの数（つまり一番高い価格に一を足した数）。
+constexpr std::size_t order_book_size = OrderBook::levels;
+
+// Built once in orderbook.cpp rather than in every file that uses it.
+// 使うファイルごとではなく、orderbook.cppで一回ビルドする。
+extern template class BasicOrderBook<DefaultOrderBookPolicy>;
+
 }
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "orderbook.hpp"
+
+// Order book policies for common kinds of instrument. All prices are dollars times 10,000.
+// よくある種類の銘柄のための注文板のポリシー。すべての価格は10,000倍したドルだ。
+namespace nanofill::orderbook {
+
+// Stocks under $5, which can trade in sub-penny increments. Small range, so each level that's used
+// starts with lots of room.
+// 1セント未満の単位で取引できる$5以下の株。範囲が小さいので、使われる各レベルは場所が多い状態で始まる。
+struct PennyStockPolicy : DefaultOrderBookPolicy {
+    static constexpr Price min_price = 0;
+    static constexpr Price max_price = 50000;
+    static constexpr Price tick_size = 1;
+    static constexpr std::size_t level_reserve = 64;
+    static constexpr std::size_t expected_orders = 1 << 16;
+};
+
+// Stocks between $100 and $5,000, which trade in whole cents. Most of the range is empty at any
+// one time, so levels start small and grow from the order pool.
+// 1セント単位で取引する$100から$5,000までの株。ある時点でほとんどの範囲が空なので、レベルは小さく始めて、
+// 注文プールから大きくなる。
+struct HighPricedStockPolicy : DefaultOrderBookPolicy {
+    static constexpr Price min_price = 1000000;
+    static constexpr Price max_price = 50000000;
+    static constexpr Price tick_size = 100;
+    static constexpr std::size_t level_reserve = 4;
+    static constexpr std::size_t expected_orders = 1 << 18;
+};
+
+// Futures with a $0.25 tick between $1,000 and $10,000 (e.g. index futures). Few levels, but
+// each one can be deep.
+// $1,000から$10,000までの$0.25単位の先物（例えば、株価指数先物）。レベルは少ないが、各レベルは深くなり得る。
+struct FuturesPolicy : DefaultOrderBookPolicy {
+    static constexpr Price min_price = 10000000;
+    static constexpr Price max_price = 100000000;
+    static constexpr Price tick_size = 2500;
+    static constexpr std::size_t level_reserve = 256;
+    static constexpr std::size_t expected_orders = 1 << 16;
+};
+
+using PennyStockOrderBook = BasicOrderBook<PennyStockPolicy>;
+using HighPricedStockOrderBook = BasicOrderBook<HighPricedStockPolicy>;
+using FuturesOrderBook = BasicOrderBook<FuturesPolicy>;
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "concurrency/seqlock.hpp"
+#include <cstdint>
+
+namespace nanofill::orderbook {
+
+// A snapshot of the top of the book and what the trading engine wants to do about it, for
+// threads other than the consumer to read while the book is live. All prices are dollars times
+// 10,000, and 0 means there isn't one.
+// 板の一番上とそれに対して取引処理エンジンがしたいことのスナップショット。板が動いている間に消費者以外の
+// スレッドが読むためのもの。すべての価格は10,000倍したドルで、0はないという意味だ。
+struct TopOfBook {
+    std::uint32_t best_bid;
+    std::uint32_t best_ask;
+    // Halfway between the best bid and ask, or 0 if either side is empty.
+    // 最良買い気配値と最良売り気配値の真ん中。どちらかの側が空なら、0。
+    std::uint32_t mid_price;
+    std::uint32_t target_buy_price;
+    std::uint32_t target_sell_price;
+    // The time of the last event included in this snapshot.
+    // このスナップショットに含まれている最後のイベントの時。
+    std::uint32_t time;
+};
+
+using TopOfBookPublisher = concurrency::SeqLock<TopOfBook>;
+
+}
@@ -0,0 +1,104 @@
+#include "replay.hpp"
+#include "consts/consts.hpp"
+#include "fileio/csv.hpp"
+#include "fileio/fileio.hpp"
+#include <filesystem>
+#include <iomanip>
+#include <stdexcept>
+#include <glob.h>
+
+namespace nanofill::replay {
+
+std::vector<ReplayFile> find_replay_files(const std::string& path_or_pattern) {
+    std::vector<ReplayFile> files;
+
+    if (std::filesystem::is_directory(path_or_pattern)) {
+        for (const auto& entry : std::filesystem::directory_iterator(path_or_pattern)) {
+            const std::string name = entry.path().filename().string();
+
+            // LOBSTER names message files <ticker>_<date>_<start>_<end>_message_<levels>.csv.
+            // LOBSTERはメッセージファイルを<ticker>_<date>_<start>_<end>_message_<levels>.csvと名付ける。
+            if (entry.is_regular_file() && name.find("_message_") != std::string::npos && name.ends_with(".csv")) {
+                files.push_back({ .path = entry.path().string(), .size = entry.file_size() });
+            }
+        }
+    } else {
+        glob_t matches;
+
+        if (glob(path_or_pattern.c_str(), 0, nullptr, &matches) == 0) {
+            for (std::size_t i = 0; i < matches.gl_pathc; ++i) {
+                if (std::filesystem::is_regular_file(matches.gl_pathv[i])) {
+                    files.push_back({ .path = matches.gl_pathv[i], .size = std::filesystem::file_size(matches.gl_pathv[i]) });
+                }
+            }
+        }
+
+        globfree(&matches);
+    }
+
+    if (files.empty()) {
+        throw std::runtime_error("No LOBSTER message files found for " + path_or_pattern);
+    }
+
+    std::stable_sort(files.begin(), files.end(), [](const ReplayFile& a, const ReplayFile& b) {
+        return a.size > b.size;
+    });
+
+    return files;
+}
+
+std::vector<Event> load_lobster_events(const std::string& path) {
+    // Let the text go as soon as it's parsed so it doesn't count against the next day.
+    // 次の日の分を圧迫しないように、解析したらすぐテキストを手放す。
+    const auto csv_data = fileio::parse_csv_data<consts::TradingDataCSVFormat>(fileio::open_text_file(path.c_str()));
+
+    return events::events_from_csv_data(csv_data);
+}
+
+void print_replay_report(std::ostream& out, const std::vector<DayReport>& reports) {
+    stats::LatencyHistogram merged_latency;
+    std::uint64_t events = 0;
+    std::uint64_t actioned = 0;
+    std::uint64_t executed_shares = 0;
+    double seconds = 0;
+
+    out << "===== Replay by day =====" << '\n'
+        << std::left << std::setw(48) << "file" << std::right
+        << std::setw(12) << "events" << std::setw(12) << "actioned" << std::setw(14) << "executed"
+        << std::setw(12) << "avg price" << std::setw(12) << "buy at" << std::setw(12) << "sell at"
+        << std::setw(12) << "best bid" << std::setw(12) << "best ask"
+        << std::setw(10) << "P50 (ns)" << std::setw(10) << "P99 (ns)" << '\n';
+
+    for (const DayReport& report : reports) {
+        out << std::left << std::setw(48) << std::filesystem::path(report.path).filename().string() << std::right
+            << std::setw(12) << report.events
+            << std::setw(12) << report.actioned
+            << std::setw(14) << report.executed_shares
+            << std::setw(12) << report.average_share_price
+            << std::setw(12) << report.target_buy_price
+            << std::setw(12) << report.target_sell_price
+            << std::setw(12) << report.best_bid
+            << std::setw(12) << report.best_ask
+            << std::setw(10) << report.latency.get_percentile(0.5)
+            << std::setw(10) << report.latency.get_percentile(0.99) << '\n';
+
+        merged_latency.merge(report.latency);
+        events += report.events;
+        actioned += report.actioned;
+        executed_shares += report.executed_shares;
+        seconds += report.seconds;
+    }
+
+    out << '\n'
+        << "===== All days =====" << '\n'
+        << "Days: " << reports.size() << '\n'
+        << "Events: " << events << " (" << actioned << " actioned)" << '\n'
+        << "Executed shares: " << executed_shares << '\n'
+        << "Replay thread time: " << seconds << "s" << '\n'
+        << '\n'
+        << "===== Per-event latency percentiles (all days) =====" << '\n';
+
+    stats::print_latency_percentiles(out, merged_latency);
+}
+
+}
@@ -0,0 +1,249 @@
+#pragma once
+
+#include "events/event.hpp"
+#include "orderbook/orderbook.hpp"
+#include "stats/latencyhistogram.hpp"
+#include "storage/eventstore.hpp"
+#include "tradingengine/tradingengine.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Replays many days of LOBSTER data at once, one day per worker thread, and combines what each day
+// saw into one report. Each day gets its own book and engine, since days don't carry over.
+// 多くの日のLOBSTERデータを同時に、ワーカースレッドごとに一日ずつ再生して、各日の結果を一つのレポートに
+// まとめる。日は引き継がないので、各日が独自の板とエンジンを持つ。
+namespace nanofill::replay {
+
+using events::Event;
+
+// A day of data to replay.
+// 再生する一日のデータ。
+struct ReplayFile {
+    std::string path;
+    // In bytes.
+    // バイト単位。
+    std::uintmax_t size;
+};
+
+// What happened on one day.
+// 一日に起こったこと。
+struct DayReport {
+    std::string path;
+    std::uint64_t events = 0;
+    // Events the order book actioned (and so the engine saw).
+    // 注文板が処理した（なので、エンジンが見た）イベント。
+    std::uint64_t actioned = 0;
+    std::uint64_t executions = 0;
+    std::uint64_t executed_shares = 0;
+    // The engine and book at the end of the day.
+    // 一日の終わりのエンジンと板。
+    std::uint32_t average_share_price = 0;
+    std::uint32_t target_buy_price = 0;
+    std::uint32_t target_sell_price = 0;
+    std::uint32_t best_bid = 0;
+    std::uint32_t best_ask = 0;
+    // How long the book and engine took for each event.
+    // 板とエンジンが各イベントにかかった時間。
+    stats::LatencyHistogram latency;
+    double seconds = 0;
+};
+
+struct ReplayOptions {
+    unsigned int threads = std::max(1U, std::thread::hardware_concurrency());
+    // Roughly how much memory the days being replayed at once may use between them. A day that
+    // doesn't fit on its own still runs, but only by itself.
+    // 同時に再生している日が合わせて使っていいメモリの大体の量。単独でも収まらない日も動くが、それだけで動く。
+    std::size_t memory_budget = std::size_t{4} << 30;
+    // See TradingEngine.
+    // TradingEngineを参照。
+    int price_spread = 10000;
+};
+
+// Find the files to replay, biggest first. A directory means every LOBSTER message file in it, and
+// anything else is used as a glob pattern (e.g. "data/MSFT_*_message_10.csv"). Throws if nothing
+// matches.
+// 再生するファイルを大きい順に探す。ディレクトリなら、その中の全LOBSTERメッセージファイル。それ以外はグロブ
+// パターン（例えば、"data/MSFT_*_message_10.csv"）として使う。何も合わなかったら、投げる。
+std::vector<ReplayFile> find_replay_files(const std::string& path_or_pattern);
+
+// Read and parse a whole LOBSTER message file.
+// LOBSTERメッセージファイルを全部読み込んで、解析する。
+std::vector<Event> load_lobster_events(const std::string& path);
+
+// Print one line per day and then everything merged.
+// 一日に一行を出力して、まとめたものを出力する。
+void print_replay_report(std::ostream& out, const std::vector<DayReport>& reports);
+
+// Blocks threads until there is enough of a memory budget for them.
+// メモリの予算が足りるまで、スレッドを待たせる。
+class MemoryBudget {
+    std::mutex mutex;
+    std::condition_variable released;
+    std::size_t budget;
+    std::size_t in_use = 0;
+
+public:
+    explicit MemoryBudget(const std::size_t budget) noexcept : budget(budget) {}
+
+    // If nothing else is using the budget, go ahead even if bytes is more than all of it, so that
+    // a huge day can't wait forever.
+    // 他に予算を使っているものがなければ、bytesが予算全体より多くても進むので、巨大な日が永遠に待つことはない。
+    void acquire(const std::size_t bytes) {
+        std::unique_lock lock(mutex);
+        released.wait(lock, [&] { return in_use == 0 || in_use + bytes <= budget; });
+        in_use += bytes;
+    }
+
+    void release(const std::size_t bytes) {
+        {
+            std::lock_guard lock(mutex);
+            in_use -= bytes;
+        }
+
+        released.notify_all();
+    }
+};
+
+// Roughly how much memory replaying a file of this size takes: the text, the parsed CSV and the
+// events all exist at once while loading, plus the book.
+// このサイズのファイルを再生するのにかかる大体のメモリ。読み込み中はテキスト、解析したCSVとイベントが同時に
+// 存在して、板もある。
+template<typename Policy = orderbook::DefaultOrderBookPolicy>
+std::size_t estimate_replay_memory(const std::uintmax_t file_size) noexcept {
+    using Book = orderbook::BasicOrderBook<Policy>;
+
+    const std::size_t book_size = Book::order_pool_bytes
+        + Book::levels * (sizeof(typename Book::Level) + 3 * sizeof(std::uint32_t));
+
+    return static_cast<std::size_t>(file_size) * 3 + book_size;
+}
+
+// Replay the events for_each_event hands to the callback it's given through a fresh book and engine.
+// for_each_eventが渡されたコールバックに渡すイベントを新しい板とエンジンで再生する。
+template<typename Policy, typename ForEachEvent>
+DayReport replay_events(ForEachEvent&& for_each_event, const int price_spread) {
+    auto order_book = std::make_unique<orderbook::BasicOrderBook<Policy>>();
+    tradingengine::TradingEngine trading_engine(price_spread);
+    DayReport report;
+
+    const auto day_start = std::chrono::steady_clock::now();
+
+    for_each_event([&](const Event& event) {
+        const auto clock_start = std::chrono::steady_clock::now();
+
+        if (order_book->process_event(event)) {
+            trading_engine.process_event(event);
+            ++report.actioned;
+        }
+
+        const auto clock_end = std::chrono::steady_clock::now();
+
+        report.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_end - clock_start).count());
+        ++report.events;
+
+        if (event.type == events::EventType::ExecutionVisible || event.type == events::EventType::ExecutionHidden) {
+            ++report.executions;
+            report.executed_shares += event.size < 0 ? -event.size : event.size;
+        }
+    });
+
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - day_start).count();
+    report.average_share_price = trading_engine.average_share_price;
+    report.target_buy_price = trading_engine.target_buy_price;
+    report.target_sell_price = trading_engine.target_sell_price;
+
+    if constexpr (orderbook::BasicOrderBook<Policy>::per_side) {
+        report.best_bid = order_book->get_best_bid();
+        report.best_ask = order_book->get_best_ask();
+    }
+
+    return report;
+}
+
+// Replay one day's events through a fresh book and engine.
+// 一日のイベントを新しい板とエンジンで再生する。
+template<typename Policy = orderbook::DefaultOrderBookPolicy>
+DayReport replay_day(const std::vector<Event>& events, const int price_spread) {
+    return replay_events<Policy>([&](auto&& replay) {
+        for (const Event& event : events) {
+            replay(event);
+        }
+    }, price_spread);
+}
+
+// The same from a compressed store, decoding a block at a time, so that many days can be kept in
+// memory and replayed again and again.
+// 圧縮したストアから同じことをして、ブロックずつデコードするので、多くの日をメモリに置いて何度も再生できる。
+template<typename Policy = orderbook::DefaultOrderBookPolicy>
+DayReport replay_day(const storage::CompressedEventStore& store, const int price_spread) {
+    return replay_events<Policy>([&](auto&& replay) {
+        alignas(32) std::array<Event, storage::CompressedEventStore::block_size> decoded;
+
+        for (std::size_t block = 0; block < store.block_count(); ++block) {
+            const std::size_t count = store.decode_block(block, decoded.data());
+
+            for (std::size_t i = 0; i < count; ++i) {
+                replay(decoded[i]);
+            }
+        }
+    }, price_spread);
+}
+
+// Replay every file on a pool of worker threads, in the order given. Give the biggest files first
+// (as find_replay_files does) so that the longest day doesn't start last and hold everything up.
+// Reports come back in the same order as the files.
+// ワーカースレッドのプールで、与えられた順番で全ファイルを再生する。一番長い日が最後に始まって全体を遅らせない
+// ように、一番大きいファイルから与えて（find_replay_filesはそうする）。レポートはファイルと同じ順番で返る。
+template<typename Policy = orderbook::DefaultOrderBookPolicy>
+std::vector<DayReport> run_replay(const std::vector<ReplayFile>& files, const ReplayOptions& options) {
+    std::vector<DayReport> reports(files.size());
+    std::vector<std::exception_ptr> errors(files.size());
+    std::atomic<std::size_t> next_file{0};
+    MemoryBudget budget(options.memory_budget);
+    std::vector<std::thread> workers;
+    const std::size_t thread_count = std::clamp<std::size_t>(options.threads, 1, std::max<std::size_t>(files.size(), 1));
+
+    for (std::size_t i = 0; i < thread_count; ++i) {
+        workers.emplace_back([&] {
+            for (std::size_t file = next_file++; file < files.size(); file = next_file++) {
+                const std::size_t memory = estimate_replay_memory<Policy>(files[file].size);
+
+                budget.acquire(memory);
+
+                try {
+                    reports[file] = replay_day<Policy>(load_lobster_events(files[file].path), options.price_spread);
+                    reports[file].path = files[file].path;
+                } catch (...) {
+                    errors[file] = std::current_exception();
+                }
+
+                budget.release(memory);
+            }
+        });
+    }
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    return reports;
+}
+
+}
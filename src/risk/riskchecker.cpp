@@ -0,0 +1,126 @@
+#include "riskchecker.hpp"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace nanofill::risk {
+
+RiskLimits parse_risk_limits(std::istream& in) {
+    RiskLimits limits;
+    std::size_t line_number = 0;
+
+    for (std::string line; std::getline(in, line); ) {
+        ++line_number;
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream fields(line);
+        std::string name;
+        double value;
+
+        if (!(fields >> name)) {
+            continue;
+        }
+
+        std::string rest;
+
+        if (!(fields >> value) || value < 0 || (fields >> rest)) {
+            throw std::runtime_error("Bad value for " + name + " on line " + std::to_string(line_number));
+        }
+
+        if (name == "max_order_size") {
+            limits.max_order_size = static_cast<std::uint32_t>(value);
+        } else if (name == "price_band_basis_points") {
+            limits.price_band_basis_points = static_cast<std::uint32_t>(value);
+        } else if (name == "max_position") {
+            limits.max_position = static_cast<std::int64_t>(value);
+        } else if (name == "max_orders_per_second") {
+            limits.max_orders_per_second = value;
+        } else if (name == "max_burst") {
+            limits.max_burst = value;
+        } else {
+            throw std::runtime_error("Unknown risk limit " + name + " on line " + std::to_string(line_number));
+        }
+    }
+
+    return limits;
+}
+
+RiskLimits load_risk_limits(const std::string& path) {
+    std::ifstream file(path);
+
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open file " + path);
+    }
+
+    return parse_risk_limits(file);
+}
+
+RiskLimitsStore::RiskLimitsStore(const RiskLimits& limits) : owned(std::make_unique<const RiskLimits>(limits)) {
+    current.store(owned.get(), std::memory_order_release);
+}
+
+void RiskLimitsStore::publish(const RiskLimits& limits) {
+    std::lock_guard lock(writer_mutex);
+    auto next = std::make_unique<const RiskLimits>(limits);
+
+    current.store(next.get(), std::memory_order_release);
+    owned.swap(next);
+
+    // The trading thread can only have the old copy until it sees this epoch.
+    // 取引スレッドはこのエポックを見るまでしか古いコピーを持てない。
+    const std::uint64_t retired_epoch = epoch.fetch_add(1, std::memory_order_acq_rel) + 1;
+    retired.push_back({ std::move(next), retired_epoch });
+
+    const std::uint64_t seen = reader_epoch.load(std::memory_order_acquire);
+    std::erase_if(retired, [&](const Retired& old) { return old.epoch <= seen; });
+}
+
+std::size_t RiskLimitsStore::get_retired_count() {
+    std::lock_guard lock(writer_mutex);
+    const std::uint64_t seen = reader_epoch.load(std::memory_order_acquire);
+    std::erase_if(retired, [&](const Retired& old) { return old.epoch <= seen; });
+
+    return retired.size();
+}
+
+void watch_risk_limits(RiskLimitsStore& store, const std::string& path, const std::atomic<bool>& stop) {
+    std::error_code error;
+    auto last_written = std::filesystem::last_write_time(path, error);
+
+    while (!stop.load(std::memory_order_acquire)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        const auto written = std::filesystem::last_write_time(path, error);
+
+        if (error || written == last_written) {
+            continue;
+        }
+
+        last_written = written;
+
+        try {
+            store.publish(load_risk_limits(path));
+            std::cerr << "Reloaded risk limits from " << path << std::endl;
+        } catch (const std::exception& exception) {
+            std::cerr << "Kept the old risk limits: " << exception.what() << std::endl;
+        }
+    }
+}
+
+void print_risk_report(std::ostream& out, const RiskStats& stats) {
+    static constexpr const char* names[risk_check_count] = { "order size", "price band", "position", "message rate" };
+
+    out << "Passed: " << stats.passed << '\n';
+
+    for (std::size_t i = 0; i < risk_check_count; ++i) {
+        out << "Failed " << names[i] << ": " << stats.failed[i] << '\n';
+    }
+
+    out.flush();
+}
+
+}
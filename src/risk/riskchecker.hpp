@@ -0,0 +1,225 @@
+#pragma once
+
+#include "stats/tsc.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Pre-trade risk checks: every new order is checked against the limits before it leaves, in a
+// fixed number of instructions whatever the outcome, so the checks add no jitter.
+// 発注前のリスクチェック。全ての新しい注文は出る前に制限と照らし合わせる。結果にかかわらず決まった数の命令で
+// するので、チェックがジッターを増やさない。
+namespace nanofill::risk {
+
+// Each failed check sets one bit of the result.
+// 失敗した各チェックが結果の一つのビットを設定する。
+enum RiskCheck : std::uint32_t {
+    OrderSize = 1U << 0,
+    PriceBand = 1U << 1,
+    Position = 1U << 2,
+    MessageRate = 1U << 3
+};
+
+constexpr std::size_t risk_check_count = 4;
+
+// Everything the checks read, on one cache line.
+// チェックが読むもの全部。一つのキャッシュラインにある。
+struct alignas(64) RiskLimits {
+    // The most shares in one order.
+    // 一つの注文の株の最大数。
+    std::uint32_t max_order_size = 1000;
+    // How far an order's price may be from the mid price, in 1/100ths of a percent. With no mid
+    // price (one side of the book empty) every order is outside the band.
+    // 注文の価格が仲値からどれだけ離れていいか。1/100パーセント単位。仲値がない（板の片側が空）と、全ての
+    // 注文が幅の外にある。
+    std::uint32_t price_band_basis_points = 500;
+    // The most shares we could be long or short if every resting order on that side filled.
+    // その側に置いてある注文が全部約定したら、買い持ちか売り持ちになりうる株の最大数。
+    std::int64_t max_position = 10000;
+    // The token bucket: new orders refill at this rate, up to a burst of max_burst.
+    // トークンバケット。新しい注文はこの速さで補充されて、max_burstまで貯まる。
+    double max_orders_per_second = 100000;
+    double max_burst = 100;
+};
+
+// Read "name value" lines, one per limit, with # starting a comment. Limits that aren't given keep
+// their defaults. Throws on unknown names and bad values.
+// 制限ごとに一つの"名前 値"の行を読む。#はコメントを始める。与えられない制限は既定値のまま。知らない名前と
+// 不正な値で投げる。
+RiskLimits parse_risk_limits(std::istream& in);
+RiskLimits load_risk_limits(const std::string& path);
+
+// Holds the current limits for one trading thread, and lets any other thread replace them without
+// ever making the trading thread wait, RCU style: publish swaps in a new copy with one pointer store,
+// and the old copy is only freed once the trading thread has said (with quiescent) that it's finished
+// with everything it read before the swap. Reloads are rare, so the writer side just uses a mutex.
+// 一つの取引スレッドのために現在の制限を持って、取引スレッドを待たせることなく他のどのスレッドからでも置き換え
+// られるようにする。RCUのように、publishは一回のポインタの格納で新しいコピーに入れ替えて、古いコピーは取引
+// スレッドが（quiescentで）入れ替えの前に読んだもの全部を使い終わったと言ってから解放する。再読み込みは稀
+// なので、書き手の側はただミューテックスを使う。
+class RiskLimitsStore {
+    struct Retired {
+        std::unique_ptr<const RiskLimits> limits;
+        std::uint64_t epoch;
+    };
+
+    std::atomic<const RiskLimits*> current;
+    // Bumped by every publish.
+    // publishごとに増やす。
+    alignas(64) std::atomic<std::uint64_t> epoch{0};
+    // The last epoch the trading thread saw while it held nothing.
+    // 取引スレッドが何も持っていなかったときに見た最後のエポック。
+    alignas(64) std::atomic<std::uint64_t> reader_epoch{0};
+    std::mutex writer_mutex;
+    std::unique_ptr<const RiskLimits> owned;
+    std::vector<Retired> retired;
+
+public:
+    explicit RiskLimitsStore(const RiskLimits& limits = {});
+    RiskLimitsStore(const RiskLimitsStore&) = delete;
+    RiskLimitsStore& operator=(const RiskLimitsStore&) = delete;
+
+    // Trading thread only. Don't hold on to the result past the next quiescent.
+    // 取引スレッドだけ。結果を次のquiescentより後まで持たないで。
+    [[gnu::always_inline]]
+    const RiskLimits& read() const noexcept {
+        return *current.load(std::memory_order_acquire);
+    }
+
+    // Trading thread only: nothing read before this is still in use.
+    // 取引スレッドだけ。この前に読んだものはもう使っていない。
+    [[gnu::always_inline]]
+    void quiescent() noexcept {
+        const std::uint64_t latest = epoch.load(std::memory_order_acquire);
+
+        if (reader_epoch.load(std::memory_order_relaxed) != latest) [[unlikely]] {
+            reader_epoch.store(latest, std::memory_order_release);
+        }
+    }
+
+    // Any thread. Also frees whatever old copies the trading thread has finished with.
+    // どのスレッドでも。取引スレッドが使い終わった古いコピーも解放する。
+    void publish(const RiskLimits& limits);
+
+    // Old copies still waiting for the trading thread.
+    // まだ取引スレッドを待っている古いコピー。
+    std::size_t get_retired_count();
+};
+
+struct RiskStats {
+    std::uint64_t passed = 0;
+    // How many orders failed each check, indexed by bit (an order can fail more than one).
+    // 各チェックで失敗した注文の数。ビットで添字を付ける（注文は複数のチェックで失敗できる）。
+    std::array<std::uint64_t, risk_check_count> failed{};
+};
+
+// Checks new orders from one trading thread against a RiskLimitsStore, and keeps track of the
+// resting orders and position the checks need. Cancels are never checked, since they only ever
+// reduce risk.
+// 一つの取引スレッドからの新しい注文をRiskLimitsStoreと照らし合わせて、チェックが必要とする置いてある注文と
+// ポジションを管理する。取消はリスクを減らすだけなので、決してチェックしない。
+class RiskChecker {
+    RiskLimitsStore& limits;
+    double seconds_per_tick = 1e-9 / stats::tsc_ticks_per_nanosecond();
+    double tokens;
+    std::uint64_t last_tsc = 0;
+    // Shares held. Negative means short.
+    // 持っている株の数。ネガティブなら、空売り。
+    std::int64_t position = 0;
+    // Shares resting on each side, indexed by side (0 buy, 1 sell).
+    // 各側に置いてある株の数。側で添字を付ける（0は買い、1は売り）。
+    std::array<std::int64_t, 2> open{};
+    RiskStats stats;
+
+public:
+    explicit RiskChecker(RiskLimitsStore& limits) noexcept : limits(limits), tokens(limits.read().max_burst) {}
+
+    // Check a new order (side 0 buys, 1 sells) at now_tsc, returning the RiskCheck bits it failed, so
+    // 0 means it may go. Orders that pass take a token and count as resting until on_cancel or
+    // on_fill. Every check is always worked out and the results are combined with ors, so there are
+    // no branches to mispredict.
+    // 新しい注文（側0は買い、1は売り）をnow_tscでチェックして、失敗したRiskCheckのビットを返すので、0なら
+    // 出していい。通った注文はトークンを一つ取って、on_cancelかon_fillまで置いてあると数える。全てのチェック
+    // をいつも計算して、結果をorで合わせるので、予測を外す分岐がない。
+    [[gnu::always_inline]]
+    std::uint32_t check_new_order(
+        const std::uint32_t side,
+        const std::uint32_t price,
+        const std::uint32_t size,
+        const std::uint32_t reference_price,
+        const std::uint64_t now_tsc
+    ) noexcept {
+        const RiskLimits& current = limits.read();
+
+        tokens = std::min(tokens + (now_tsc - last_tsc) * seconds_per_tick * current.max_orders_per_second, current.max_burst);
+        last_tsc = now_tsc;
+
+        const std::uint64_t distance = price > reference_price ? price - reference_price : reference_price - price;
+        // Buying adds to the position and selling takes away, so flip it for sells.
+        // 買いはポジションに足して、売りは引くので、売りでは反転する。
+        const std::int64_t direction = 1 - 2 * static_cast<std::int64_t>(side);
+        const std::int64_t worst_position = direction * position + open[side] + size;
+
+        const std::uint32_t failed =
+            static_cast<std::uint32_t>(size > current.max_order_size) * OrderSize
+            | static_cast<std::uint32_t>(distance * 10000 > static_cast<std::uint64_t>(reference_price) * current.price_band_basis_points) * PriceBand
+            | static_cast<std::uint32_t>(worst_position > current.max_position) * Position
+            | static_cast<std::uint32_t>(tokens < 1) * MessageRate;
+        const std::uint32_t passed = failed == 0;
+
+        tokens -= passed;
+        open[side] += passed * size;
+        stats.passed += passed;
+
+        for (std::size_t i = 0; i < risk_check_count; ++i) {
+            stats.failed[i] += (failed >> i) & 1;
+        }
+
+        return failed;
+    }
+
+    // A resting order that passed has been cancelled.
+    // 通った置いてある注文が取り消された。
+    [[gnu::always_inline]]
+    void on_cancel(const std::uint32_t side, const std::uint32_t size) noexcept {
+        open[side] -= size;
+    }
+
+    [[gnu::always_inline]]
+    void on_fill(const std::uint32_t side, const std::uint32_t size) noexcept {
+        open[side] -= size;
+        position += (1 - 2 * static_cast<std::int64_t>(side)) * size;
+    }
+
+    // Call between orders, e.g. after each batch of events.
+    // 注文の間で呼ぶ。例えば、イベントのバッチごとに。
+    [[gnu::always_inline]]
+    void quiescent() noexcept {
+        limits.quiescent();
+    }
+
+    std::int64_t get_position() const noexcept {
+        return position;
+    }
+
+    const RiskStats& get_stats() const noexcept {
+        return stats;
+    }
+};
+
+// Reload path into store whenever the file changes, until stop is set. A file that can't be read
+// or parsed is reported on stderr and the old limits are kept.
+// stopが設定されるまで、ファイルが変わるたびにpathをstoreに再読み込みする。読めないか解析できないファイルは
+// 標準エラーに報告して、古い制限を使い続ける。
+void watch_risk_limits(RiskLimitsStore& store, const std::string& path, const std::atomic<bool>& stop);
+
+void print_risk_report(std::ostream& out, const RiskStats& stats);
+
+}
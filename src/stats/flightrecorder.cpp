@@ -0,0 +1,140 @@
+#include "flightrecorder.hpp"
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include <sys/resource.h>
+
+namespace nanofill::stats {
+
+FlightRecorder::FlightRecorder(const FlightRecorderOptions& options)
+    : ring(options.capacity),
+      mask(options.capacity - 1),
+      threshold_ticks(static_cast<std::uint64_t>(options.threshold_nanoseconds * tsc_ticks_per_nanosecond())),
+      window_before(options.window_before),
+      window_after(options.window_after),
+      thread_id(options.thread_id),
+      snapshots(options.max_snapshots) {
+    if (!std::has_single_bit(options.capacity)) {
+        throw std::invalid_argument("The flight recorder's capacity must be a power of two");
+    }
+
+    if (window_before + window_after + 1 > options.capacity) {
+        throw std::invalid_argument("The flight recorder's window doesn't fit in its capacity");
+    }
+
+    for (TraceSnapshot& snapshot : snapshots) {
+        snapshot.records.reserve(window_before + window_after + 1);
+    }
+}
+
+void FlightRecorder::start() noexcept {
+    rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    last_page_faults = usage.ru_minflt + usage.ru_majflt;
+    last_context_switches = usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+void FlightRecorder::on_outlier() noexcept {
+    ++outlier_count;
+
+    // Outliers inside a window being captured are in that snapshot already.
+    // 取り込んでいる窓の中の外れ値は、もうそのスナップショットに入っている。
+    if (outlier_position != not_capturing || snapshot_count == snapshots.size()) {
+        return;
+    }
+
+    outlier_position = head - 1;
+
+    rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+
+    const std::uint64_t page_faults = usage.ru_minflt + usage.ru_majflt;
+    const std::uint64_t context_switches = usage.ru_nvcsw + usage.ru_nivcsw;
+    TraceSnapshot& snapshot = snapshots[snapshot_count];
+
+    snapshot.page_faults = page_faults - last_page_faults;
+    snapshot.context_switches = context_switches - last_context_switches;
+    last_page_faults = page_faults;
+    last_context_switches = context_switches;
+}
+
+void FlightRecorder::freeze() noexcept {
+    TraceSnapshot& snapshot = snapshots[snapshot_count];
+    const std::uint64_t oldest_kept = head > ring.size() ? head - ring.size() : 0;
+    const std::uint64_t first = std::max(outlier_position >= window_before ? outlier_position - window_before : 0, oldest_kept);
+
+    snapshot.records.clear();
+
+    for (std::uint64_t position = first; position != head; ++position) {
+        snapshot.records.push_back(ring[position & mask]);
+    }
+
+    snapshot.outlier = outlier_position - first;
+    ++snapshot_count;
+    outlier_position = not_capturing;
+}
+
+void write_chrome_trace(std::ostream& out, const std::span<const FlightRecorder* const> recorders) {
+    const double ticks_per_microsecond = tsc_ticks_per_nanosecond() * 1000;
+    std::uint64_t base_tsc = std::numeric_limits<std::uint64_t>::max();
+
+    for (const FlightRecorder* recorder : recorders) {
+        for (const TraceSnapshot& snapshot : recorder->get_snapshots()) {
+            if (!snapshot.records.empty()) {
+                base_tsc = std::min(base_tsc, snapshot.records.front().start_tsc);
+            }
+        }
+    }
+
+    const auto microseconds = [&](const std::uint64_t ticks) {
+        return static_cast<double>(ticks) / ticks_per_microsecond;
+    };
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+    bool first = true;
+    const auto separate = [&] {
+        out << (first ? "\n" : ",\n");
+        first = false;
+    };
+
+    for (const FlightRecorder* recorder : recorders) {
+        const std::uint32_t thread = recorder->get_thread_id();
+
+        separate();
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << thread
+            << ",\"args\":{\"name\":\"consumer " << thread << "\"}}";
+
+        for (const TraceSnapshot& snapshot : recorder->get_snapshots()) {
+            for (std::size_t i = 0; i < snapshot.records.size(); ++i) {
+                const TraceRecord& record = snapshot.records[i];
+                const std::uint64_t ticks = record.end_tsc - record.start_tsc;
+
+                separate();
+                out << "{\"name\":\"" << events::event_type_name(record.event.type)
+                    << "\",\"cat\":\"event\",\"ph\":\"X\",\"pid\":0,\"tid\":" << thread
+                    << ",\"ts\":" << microseconds(record.start_tsc - base_tsc)
+                    << ",\"dur\":" << microseconds(ticks)
+                    << ",\"args\":{\"order_id\":" << record.event.order_id
+                    << ",\"price\":" << record.event.price
+                    << ",\"size\":" << record.event.size
+                    << ",\"time\":" << record.event.time
+                    << ",\"level_depth\":" << record.level_depth
+                    << ",\"queue_depth\":" << record.queue_depth
+                    << ",\"latency_ns\":" << static_cast<std::uint64_t>(microseconds(ticks) * 1000) << "}}";
+
+                if (i == snapshot.outlier) {
+                    separate();
+                    out << "{\"name\":\"outlier\",\"cat\":\"outlier\",\"ph\":\"i\",\"s\":\"t\",\"pid\":0,\"tid\":" << thread
+                        << ",\"ts\":" << microseconds(record.start_tsc - base_tsc)
+                        << ",\"args\":{\"page_faults_since_previous\":" << snapshot.page_faults
+                        << ",\"context_switches_since_previous\":" << snapshot.context_switches << "}}";
+                }
+            }
+        }
+    }
+
+    out << "\n]}" << std::endl;
+}
+
+}
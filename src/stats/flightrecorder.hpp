@@ -0,0 +1,165 @@
+#pragma once
+
+#include "events/event.hpp"
+#include "stats/tsc.hpp"
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <span>
+#include <vector>
+
+namespace nanofill::stats {
+
+// What the consumer was doing for one event.
+// 消費者が一つのイベントで何をしていたか。
+struct TraceRecord {
+    std::uint64_t start_tsc;
+    std::uint64_t end_tsc;
+    events::Event event;
+    // How many orders were on the event's level afterwards, since long levels mean long scans.
+    // 後でイベントのレベルにあった注文の数。長いレベルは長いスキャンを意味するから。
+    std::uint32_t level_depth;
+    // How many events were still waiting behind this one, in its batch and in the event buffer.
+    // バッチとイベントバッファで、このイベントの後ろにまだ待っていたイベントの数。
+    std::uint32_t queue_depth;
+};
+
+struct FlightRecorderOptions {
+    // Records kept, which must be a power of two.
+    // 持つレコードの数。二のべき乗でなければならない。
+    std::size_t capacity = 4096;
+    // Events that take longer than this are outliers.
+    // これより長くかかるイベントは外れ値だ。
+    std::uint32_t threshold_nanoseconds = 10000;
+    // How many records to keep from before and after an outlier.
+    // 外れ値の前と後から持つレコードの数。
+    std::size_t window_before = 64;
+    std::size_t window_after = 16;
+    // Outliers after this many are only counted.
+    // これ以降の外れ値は数えるだけだ。
+    std::size_t max_snapshots = 16;
+    // Which thread this is in the trace.
+    // トレースでこれがどのスレッドか。
+    std::uint32_t thread_id = 0;
+};
+
+// The records around one outlier.
+// 一つの外れ値の周りのレコード。
+struct TraceSnapshot {
+    std::vector<TraceRecord> records;
+    // Which record is the outlier.
+    // どのレコードが外れ値か。
+    std::size_t outlier = 0;
+    // What happened to the thread between the previous outlier (or the start) and this one. If
+    // these didn't move, the outlier wasn't a page fault or the thread being descheduled.
+    // 前の外れ値（または最初）からこれまでにスレッドに何が起きたか。これが動かなかったら、外れ値はページ
+    // フォルトやスレッドのスケジュール外しではなかった。
+    std::uint64_t page_faults = 0;
+    std::uint64_t context_switches = 0;
+};
+
+// Always keeps the last few thousand events one consumer thread processed, with TSC timestamps.
+// When one takes longer than the threshold, the records around it are frozen into a snapshot that
+// can be written out as a Chrome trace (chrome://tracing or ui.perfetto.dev) afterwards.
+//
+// Everything is allocated up front, and recording is two stores and a compare, so it can stay on
+// all the time.
+// 一つの消費者スレッドが処理した最後の数千のイベントをTSCのタイムスタンプ付きで常に持つ。一つが閾値より長く
+// かかったら、その周りのレコードをスナップショットに凍結して、後でChromeのトレース（chrome://tracingか
+// ui.perfetto.dev）として書き出せる。
+//
+// 全部最初に割り当てて、記録は二つのストアと一つの比較なので、常にオンのままでいい。
+class FlightRecorder {
+    static constexpr std::uint64_t not_capturing = std::numeric_limits<std::uint64_t>::max();
+
+    std::vector<TraceRecord> ring;
+    std::size_t mask;
+    std::uint64_t head = 0;
+    std::uint64_t threshold_ticks;
+    std::size_t window_before;
+    std::size_t window_after;
+    std::uint32_t thread_id;
+    // Where the outlier being captured is, while waiting for the records after it.
+    // 後のレコードを待っている間の、取り込んでいる外れ値の位置。
+    std::uint64_t outlier_position = not_capturing;
+    std::vector<TraceSnapshot> snapshots;
+    std::size_t snapshot_count = 0;
+    std::uint64_t outlier_count = 0;
+    // The thread's counts at the previous outlier, or at the first record, which is taken on the
+    // thread that records rather than the one that made the recorder.
+    // 前の外れ値か、最初の記録のときのスレッドの数。レコーダーを作ったスレッドではなく、記録するスレッドで取る。
+    std::uint64_t last_page_faults = 0;
+    std::uint64_t last_context_switches = 0;
+
+    [[gnu::noinline]]
+    void start() noexcept;
+
+    [[gnu::noinline]]
+    void on_outlier() noexcept;
+
+    [[gnu::noinline]]
+    void freeze() noexcept;
+
+public:
+    explicit FlightRecorder(const FlightRecorderOptions& options = {});
+
+    [[gnu::always_inline]]
+    void record(
+        const events::Event& event,
+        const std::uint64_t start_tsc,
+        const std::uint64_t end_tsc,
+        const std::uint32_t level_depth,
+        const std::uint32_t queue_depth
+    ) noexcept {
+        if (head == 0) [[unlikely]] {
+            start();
+        }
+
+        ring[head & mask] = TraceRecord {
+            .start_tsc = start_tsc,
+            .end_tsc = end_tsc,
+            .event = event,
+            .level_depth = level_depth,
+            .queue_depth = queue_depth
+        };
+        ++head;
+
+        if (end_tsc - start_tsc > threshold_ticks) [[unlikely]] {
+            on_outlier();
+        }
+
+        if (outlier_position != not_capturing && head - outlier_position > window_after) [[unlikely]] {
+            freeze();
+        }
+    }
+
+    // Freeze a capture that's still waiting for records after its outlier, e.g. at the end.
+    // 外れ値の後のレコードをまだ待っている取り込みを、例えば最後に凍結する。
+    void flush() noexcept {
+        if (outlier_position != not_capturing) {
+            freeze();
+        }
+    }
+
+    std::span<const TraceSnapshot> get_snapshots() const noexcept {
+        return { snapshots.data(), snapshot_count };
+    }
+
+    // Every outlier, including ones that weren't captured.
+    // 取り込まなかったものも含めた全ての外れ値。
+    std::uint64_t get_outlier_count() const noexcept {
+        return outlier_count;
+    }
+
+    std::uint32_t get_thread_id() const noexcept {
+        return thread_id;
+    }
+};
+
+// Write every recorder's snapshots as one Chrome trace. Each event is a slice on its recorder's
+// thread, with the outlier marked and the event's fields as arguments.
+// 全てのレコーダーのスナップショットを一つのChromeのトレースとして書く。各イベントはそのレコーダーの
+// スレッドのスライスで、外れ値に印を付けて、イベントのフィールドを引数にする。
+void write_chrome_trace(std::ostream& out, std::span<const FlightRecorder* const> recorders);
+
+}
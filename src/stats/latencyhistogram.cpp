@@ -0,0 +1,16 @@
+#include "latencyhistogram.hpp"
+
+namespace nanofill::stats {
+
+void print_latency_percentiles(std::ostream& out, const LatencyHistogram& histogram) {
+    out << "P0: " << histogram.get_min() << "ns" << '\n'
+        << "P50: " << histogram.get_percentile(0.5) << "ns" << '\n'
+        << "P75: " << histogram.get_percentile(0.75) << "ns" << '\n'
+        << "P90: " << histogram.get_percentile(0.90) << "ns" << '\n'
+        << "P95: " << histogram.get_percentile(0.95) << "ns" << '\n'
+        << "P99: " << histogram.get_percentile(0.99) << "ns" << '\n'
+        << "P99.9: " << histogram.get_percentile(0.999) << "ns" << '\n'
+        << "P100: " << histogram.get_max() << "ns" << std::endl;
+}
+
+}
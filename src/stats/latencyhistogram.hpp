@@ -0,0 +1,123 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+
+namespace nanofill::stats {
+
+// A fixed-size histogram of latencies in nanoseconds. Unlike keeping every sample (like
+// render_latency_chart wants), it takes the same memory however many samples go in, and two
+// histograms can be added together, so runs on different threads or days can be combined.
+//
+// Values under 128 get their own bucket. Above that, every power of two is split into 64 buckets,
+// so a bucket is never more than about 1.6% wide.
+// ナノ秒のレイテンシの固定サイズのヒストグラム。（render_latency_chartが欲しいように）全サンプルを持つのと
+// 違って、サンプルがいくつ入っても同じメモリしか使わなくて、二つのヒストグラムを足せるので、違うスレッドや
+// 違う日の実行を合わせられる。
+//
+// 128未満の値はそれぞれ独自のバケットを持つ。それ以上は、各二のべき乗を64個のバケットに分けるので、バケットの
+// 幅は約1.6%を超えない。
+class LatencyHistogram {
+    static constexpr unsigned int sub_bucket_bits = 6;
+    static constexpr std::uint32_t sub_buckets = 1U << sub_bucket_bits;
+    static constexpr std::size_t bucket_count = sub_buckets * (32 - sub_bucket_bits) + sub_buckets;
+
+    std::array<std::uint64_t, bucket_count> buckets{};
+    std::uint64_t count = 0;
+    std::uint32_t min = std::numeric_limits<std::uint32_t>::max();
+    std::uint32_t max = 0;
+
+    [[gnu::always_inline]]
+    static std::size_t bucket_of(const std::uint32_t value) noexcept {
+        if (value < sub_buckets * 2) {
+            return value;
+        }
+
+        const unsigned int shift = std::bit_width(value) - (sub_bucket_bits + 1);
+
+        return sub_buckets * shift + (value >> shift);
+    }
+
+    // The smallest value that goes in a bucket.
+    // バケットに入る一番小さい値。
+    static std::uint32_t lowest_value_of(const std::size_t bucket) noexcept {
+        if (bucket < sub_buckets * 2) {
+            return bucket;
+        }
+
+        const std::size_t shift = bucket / sub_buckets - 1;
+
+        return static_cast<std::uint32_t>((bucket - sub_buckets * shift) << shift);
+    }
+
+public:
+    [[gnu::always_inline]]
+    void record(const std::uint32_t nanoseconds) noexcept {
+        ++buckets[bucket_of(nanoseconds)];
+        ++count;
+        min = nanoseconds < min ? nanoseconds : min;
+        max = nanoseconds > max ? nanoseconds : max;
+    }
+
+    void merge(const LatencyHistogram& other) noexcept {
+        for (std::size_t i = 0; i < bucket_count; ++i) {
+            buckets[i] += other.buckets[i];
+        }
+
+        count += other.count;
+        min = other.min < min ? other.min : min;
+        max = other.max > max ? other.max : max;
+    }
+
+    // The latency that the given fraction (0 to 1) of samples are at or under, to within the
+    // bucket width. Returns 0 if there are no samples.
+    // 指定した割合（0から1まで）のサンプルがそれ以下であるレイテンシ。精度はバケットの幅まで。サンプルが
+    // なかったら、0を返す。
+    std::uint32_t get_percentile(const double fraction) const noexcept {
+        if (count == 0) {
+            return 0;
+        }
+
+        if (fraction >= 1) {
+            return max;
+        }
+
+        const auto target = static_cast<std::uint64_t>(fraction * count) + 1;
+        std::uint64_t seen = 0;
+
+        for (std::size_t i = 0; i < bucket_count; ++i) {
+            seen += buckets[i];
+
+            if (seen >= target) {
+                const std::uint32_t value = lowest_value_of(i);
+
+                return value < min ? min : value;
+            }
+        }
+
+        return max;
+    }
+
+    std::uint64_t get_count() const noexcept {
+        return count;
+    }
+
+    // Returns 0 if there are no samples.
+    // サンプルがなかったら、0を返す。
+    std::uint32_t get_min() const noexcept {
+        return count == 0 ? 0 : min;
+    }
+
+    std::uint32_t get_max() const noexcept {
+        return max;
+    }
+};
+
+// Print the same percentiles as render_latency_chart.
+// render_latency_chartと同じパーセンタイルを出力する。
+void print_latency_percentiles(std::ostream& out, const LatencyHistogram& histogram);
+
+}
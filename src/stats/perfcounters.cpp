@@ -0,0 +1,186 @@
+#include "perfcounters.hpp"
+#include <iomanip>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace nanofill::stats {
+
+namespace {
+
+constexpr std::uint64_t cache_event(const std::uint64_t cache, const std::uint64_t result) noexcept {
+    return cache | PERF_COUNT_HW_CACHE_OP_READ << 8 | result << 16;
+}
+
+struct CounterConfig {
+    std::uint32_t type;
+    std::uint64_t config;
+    const char* name;
+};
+
+// In the same order as PerfCounter.
+// PerfCounterと同じ順番で。
+constexpr std::array<CounterConfig, perf_counter_count> counter_configs {{
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions" },
+    { PERF_TYPE_HW_CACHE, cache_event(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS), "L1D miss" },
+    { PERF_TYPE_HW_CACHE, cache_event(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_RESULT_MISS), "LLC miss" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "branch miss" },
+    { PERF_TYPE_HW_CACHE, cache_event(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_RESULT_MISS), "dTLB miss" },
+}};
+
+}
+
+PerfCounterGroup::PerfCounterGroup() noexcept {
+    files.fill(-1);
+    const long page_size = sysconf(_SC_PAGESIZE);
+
+    for (std::size_t i = 0; i < perf_counter_count; ++i) {
+        perf_event_attr attributes{};
+        attributes.size = sizeof(attributes);
+        attributes.type = counter_configs[i].type;
+        attributes.config = counter_configs[i].config;
+        attributes.disabled = leader == -1;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        files[i] = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, leader, 0));
+
+        if (files[i] == -1) {
+            continue;
+        }
+
+        if (leader == -1) {
+            leader = files[i];
+        }
+
+        void* page = mmap(nullptr, page_size, PROT_READ, MAP_SHARED, files[i], 0);
+        pages[i] = page == MAP_FAILED ? nullptr : page;
+    }
+
+    if (leader == -1) {
+        return;
+    }
+
+    // rdpmc only works if every counter that opened can be read that way.
+    // rdpmcは開いた全てのカウンタがそう読める場合しか使えない。
+    rdpmc_usable = true;
+
+    for (std::size_t i = 0; i < perf_counter_count; ++i) {
+        if (files[i] != -1) {
+            const auto* page = static_cast<const perf_event_mmap_page*>(pages[i]);
+            rdpmc_usable = rdpmc_usable && page != nullptr && page->cap_user_rdpmc;
+        }
+    }
+
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+PerfCounterGroup::~PerfCounterGroup() {
+    const long page_size = sysconf(_SC_PAGESIZE);
+
+    for (std::size_t i = 0; i < perf_counter_count; ++i) {
+        if (pages[i] != nullptr) {
+            munmap(pages[i], page_size);
+        }
+
+        if (files[i] != -1) {
+            close(files[i]);
+        }
+    }
+}
+
+void PerfCounterGroup::read_with_system_call(PerfCounterValues& values) const noexcept {
+    values.fill(0);
+
+    if (leader == -1) {
+        return;
+    }
+
+    // The group comes back as a count and the times it was enabled and running, followed by a
+    // value and id for each counter, in the order they were opened.
+    // グループは数と有効だった時間と動いていた時間の後に、各カウンタの値とIDが開いた順番で返ってくる。
+    std::array<std::uint64_t, 3 + 2 * perf_counter_count> buffer{};
+
+    if (::read(leader, buffer.data(), sizeof(buffer)) <= 0) {
+        return;
+    }
+
+    std::size_t position = 3;
+
+    for (std::size_t i = 0; i < perf_counter_count && position < 3 + 2 * buffer[0]; ++i) {
+        if (files[i] != -1) {
+            values[i] = buffer[position];
+            position += 2;
+        }
+    }
+}
+
+void PerfCounterGroup::read_times(std::uint64_t& time_enabled, std::uint64_t& time_running) const noexcept {
+    time_enabled = 0;
+    time_running = 0;
+
+    if (leader == -1) {
+        return;
+    }
+
+    std::array<std::uint64_t, 3 + 2 * perf_counter_count> buffer{};
+
+    if (::read(leader, buffer.data(), sizeof(buffer)) <= 0) {
+        return;
+    }
+
+    time_enabled = buffer[1];
+    time_running = buffer[2];
+}
+
+void print_perf_counter_report(std::ostream& out, const PerfCounterReport& report) {
+    out << std::left << std::setw(18) << "event" << std::setw(8) << "phase" << std::right << std::setw(12) << "events";
+
+    for (const CounterConfig& config : counter_configs) {
+        out << std::setw(14) << config.name;
+    }
+
+    out << std::setw(8) << "IPC" << '\n';
+
+    constexpr std::array<const char*, phase_count> phase_names { "book", "engine", "extras" };
+    const double scale = report.get_scale();
+
+    for (std::size_t type = 0; type < report.totals.size(); ++type) {
+        for (std::size_t phase = 0; phase < phase_count; ++phase) {
+            const auto& totals = report.totals[type][phase];
+
+            if (totals.events == 0) {
+                continue;
+            }
+
+            out << std::left << std::setw(18) << events::event_type_name(static_cast<events::EventType>(type))
+                << std::setw(8) << phase_names[phase]
+                << std::right << std::setw(12) << totals.events
+                << std::fixed << std::setprecision(1);
+
+            for (const std::uint64_t count : totals.counts) {
+                out << std::setw(14) << static_cast<double>(count) * scale / totals.events;
+            }
+
+            const auto cycles = totals.counts[static_cast<std::size_t>(PerfCounter::Cycles)];
+            const auto instructions = totals.counts[static_cast<std::size_t>(PerfCounter::Instructions)];
+
+            out << std::setw(8) << std::setprecision(2) << (cycles == 0 ? 0.0 : static_cast<double>(instructions) / cycles) << '\n';
+            out.unsetf(std::ios_base::floatfield);
+            out << std::setprecision(6);
+        }
+    }
+
+    out << "(averages per event";
+
+    if (scale != 1.0) {
+        out << ", scaled by " << scale << " because the counters were only on the CPU part of the time";
+    }
+
+    out << ")" << std::endl;
+}
+
+}
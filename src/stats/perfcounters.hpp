@@ -0,0 +1,233 @@
+#pragma once
+
+#include "events/event.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <linux/perf_event.h>
+#include <x86intrin.h>
+
+namespace nanofill::stats {
+
+// Build with make PERF_COUNTERS=1 to count what the CPU does around each event. Otherwise none of
+// this is called from the hot path, so it costs nothing.
+// CPUが各イベントの周りで何をするかを数えるには、make PERF_COUNTERS=1でビルドして。そうでなければ、
+// ホットパスからは何も呼ばないので、コストはゼロだ。
+#ifdef NANOFILL_PERF_COUNTERS
+constexpr bool perf_counters_enabled = true;
+#else
+constexpr bool perf_counters_enabled = false;
+#endif
+
+enum class PerfCounter : std::uint8_t {
+    Cycles,
+    Instructions,
+    L1DMisses,
+    LLCMisses,
+    BranchMisses,
+    DTLBMisses,
+};
+
+constexpr std::size_t perf_counter_count = 6;
+
+// Where the time for an event went: changing the order book, the strategy, or the optional extras
+// after it (bars, orders and publishing levels and events), which aren't part of the timed latency.
+// イベントの時間がどこに行ったか。板を変えること、戦略、またはその後の任意の追加機能（バー、注文とレベルと
+// イベントの公開）。追加機能は測るレイテンシに入らない。
+enum class Phase : std::uint8_t {
+    Book,
+    Engine,
+    Extras,
+};
+
+constexpr std::size_t phase_count = 3;
+
+using PerfCounterValues = std::array<std::uint64_t, perf_counter_count>;
+
+// A group of hardware counters for the calling thread, scheduled together so they all cover the
+// same instructions. They're read with rdpmc straight from user space when the kernel allows it,
+// which takes tens of cycles instead of a system call.
+//
+// Any counter the CPU or kernel doesn't support (e.g. in most VMs) just stays at 0.
+// 呼び出したスレッドのハードウェアカウンタのグループ。同じ命令を数えるように一緒にスケジュールされる。
+// カーネルが許せば、rdpmcでユーザー空間から直接読むので、システムコールではなく、数十サイクルしかかからない。
+//
+// CPUかカーネルが対応しないカウンタ（例えば、ほとんどのVMで）は0のままだ。
+class PerfCounterGroup {
+    std::array<int, perf_counter_count> files;
+    // The first counter that opened, which the others are grouped under.
+    // 最初に開いたカウンタ。他はその下でグループになる。
+    int leader = -1;
+    // The kernel's page for each counter, which says how to read it with rdpmc.
+    // 各カウンタのカーネルのページ。rdpmcでどうやって読むかを示す。
+    std::array<void*, perf_counter_count> pages{};
+    bool rdpmc_usable = false;
+
+    void read_with_system_call(PerfCounterValues& values) const noexcept;
+
+public:
+    // Counts the calling thread, in user space only.
+    // ユーザー空間だけで、呼び出したスレッドを数える。
+    PerfCounterGroup() noexcept;
+    ~PerfCounterGroup();
+
+    PerfCounterGroup(const PerfCounterGroup&) = delete;
+    PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+
+    // Whether at least one counter could be opened.
+    // 少なくとも一つのカウンタが開けたか。
+    bool is_available() const noexcept {
+        return leader != -1;
+    }
+
+    bool is_counting(const PerfCounter counter) const noexcept {
+        return files[static_cast<std::size_t>(counter)] != -1;
+    }
+
+    // How long the group has been enabled and how long it has actually been on the CPU, in
+    // nanoseconds. These only differ when the kernel had to take turns with other counters.
+    // Takes a system call, so keep it off the hot path.
+    // グループが有効だった時間と実際にCPUにいた時間（ナノ秒）。カーネルが他のカウンタと交代しなければ
+    // ならなかったときしか違わない。システムコールを使うので、ホットパスでは使わないで。
+    void read_times(std::uint64_t& time_enabled, std::uint64_t& time_running) const noexcept;
+
+    [[gnu::always_inline]]
+    void read(PerfCounterValues& values) const noexcept {
+        if (!rdpmc_usable) {
+            read_with_system_call(values);
+
+            return;
+        }
+
+        for (std::size_t i = 0; i < perf_counter_count; ++i) {
+            const auto* page = static_cast<const volatile perf_event_mmap_page*>(pages[i]);
+
+            if (page == nullptr) {
+                values[i] = 0;
+                continue;
+            }
+
+            // The kernel bumps lock whenever it moves the counter, so retry if that happened
+            // while we were reading. index is 0 while the group isn't on the CPU.
+            // カーネルはカウンタを動かすたびにlockを増やすので、読んでいる間にそうなったら、やり直す。
+            // グループがCPUにいない間は、indexは0だ。
+            std::uint32_t sequence;
+            std::uint64_t count;
+
+            do {
+                sequence = page->lock;
+                std::atomic_signal_fence(std::memory_order_acquire);
+
+                const std::uint32_t index = page->index;
+                count = page->offset;
+
+                if (index != 0) {
+                    const unsigned int unused_bits = 64 - page->pmc_width;
+                    const auto raw = static_cast<std::int64_t>(__rdpmc(index - 1));
+                    count += static_cast<std::uint64_t>(raw << unused_bits >> unused_bits);
+                }
+
+                std::atomic_signal_fence(std::memory_order_acquire);
+            } while (page->lock != sequence);
+
+            values[i] = count;
+        }
+    }
+};
+
+// Totals of each counter for every event type and phase.
+// 各イベントの種類とフェーズの各カウンタの合計。
+class PerfCounterReport {
+    // Indexed by EventType, with 0 for anything unknown.
+    // EventTypeで添字を付けて、分からないものは0だ。
+    static constexpr std::size_t event_type_count = 6;
+
+    struct Totals {
+        PerfCounterValues counts{};
+        std::uint64_t events = 0;
+    };
+
+    std::array<std::array<Totals, phase_count>, event_type_count> totals{};
+    // While counting, for scaling up what was counted if the group was only on the CPU part of the
+    // time.
+    // グループがCPUに一部の時間しかいなかったら、数えたものを拡大するための、数えていた間の時間。
+    std::uint64_t time_enabled = 0;
+    std::uint64_t time_running = 0;
+
+    friend void print_perf_counter_report(std::ostream& out, const PerfCounterReport& report);
+
+public:
+    [[gnu::always_inline]]
+    void add(
+        const events::EventType type,
+        const Phase phase,
+        const PerfCounterValues& start,
+        const PerfCounterValues& end
+    ) noexcept {
+        const auto type_index = static_cast<std::size_t>(type);
+        Totals& phase_totals = totals[type_index < event_type_count ? type_index : 0][static_cast<std::size_t>(phase)];
+
+        for (std::size_t i = 0; i < perf_counter_count; ++i) {
+            phase_totals.counts[i] += end[i] - start[i];
+        }
+
+        ++phase_totals.events;
+    }
+
+    std::uint64_t get_total(const events::EventType type, const Phase phase, const PerfCounter counter) const noexcept {
+        return totals[static_cast<std::size_t>(type)][static_cast<std::size_t>(phase)].counts[static_cast<std::size_t>(counter)];
+    }
+
+    std::uint64_t get_events(const events::EventType type, const Phase phase) const noexcept {
+        return totals[static_cast<std::size_t>(type)][static_cast<std::size_t>(phase)].events;
+    }
+
+    void set_times(const std::uint64_t enabled, const std::uint64_t running) noexcept {
+        time_enabled = enabled;
+        time_running = running;
+    }
+
+    // What the totals have to be multiplied by to estimate what would have been counted if the
+    // counters had been on the CPU the whole time, as perf stat does.
+    // カウンタがずっとCPUにいたら数えたはずのものを推定するために合計に掛けるもの。perf statと同じだ。
+    double get_scale() const noexcept {
+        return time_running == 0 || time_running >= time_enabled ? 1.0 : static_cast<double>(time_enabled) / time_running;
+    }
+};
+
+// The counters an event consumer opens on its own thread and what it counted with them.
+// イベント消費者が自分のスレッドで開くカウンタと、それで数えたもの。
+struct PerfCounterProfile {
+    // Opened by the consumer when it starts, since the counters only count the thread that opens
+    // them.
+    // カウンタは開いたスレッドしか数えないので、消費者が始まるときに開く。
+    std::unique_ptr<PerfCounterGroup> counters;
+    PerfCounterReport report;
+    std::uint64_t start_time_enabled = 0;
+    std::uint64_t start_time_running = 0;
+
+    void start() {
+        counters = std::make_unique<PerfCounterGroup>();
+        counters->read_times(start_time_enabled, start_time_running);
+    }
+
+    // Called by the consumer once it has finished, so the report can be scaled.
+    // レポートを拡大できるように、消費者が終わったときに呼ぶ。
+    void stop() noexcept {
+        std::uint64_t time_enabled;
+        std::uint64_t time_running;
+
+        counters->read_times(time_enabled, time_running);
+        report.set_times(time_enabled - start_time_enabled, time_running - start_time_running);
+    }
+};
+
+// Print the average of each counter per event, for every event type and phase that was seen,
+// scaled up if the counters were multiplexed.
+// 見た各イベントの種類とフェーズの、イベントごとの各カウンタの平均を出力する。カウンタが多重化されて
+// いたら、拡大する。
+void print_perf_counter_report(std::ostream& out, const PerfCounterReport& report);
+
+}
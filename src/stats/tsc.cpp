@@ -0,0 +1,25 @@
+#include "tsc.hpp"
+#include <chrono>
+
+namespace nanofill::stats {
+
+double tsc_ticks_per_nanosecond() noexcept {
+    static const double ticks_per_nanosecond = [] {
+        const auto clock_start = std::chrono::steady_clock::now();
+        const std::uint64_t tsc_start = read_tsc();
+        auto clock_end = clock_start;
+
+        while (clock_end - clock_start < std::chrono::milliseconds(10)) {
+            clock_end = std::chrono::steady_clock::now();
+        }
+
+        const std::uint64_t tsc_end = read_tsc();
+        const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_end - clock_start).count();
+
+        return static_cast<double>(tsc_end - tsc_start) / nanoseconds;
+    }();
+
+    return ticks_per_nanosecond;
+}
+
+}
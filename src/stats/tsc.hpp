@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <x86intrin.h>
+
+namespace nanofill::stats {
+
+// The CPU's timestamp counter. Much cheaper to read than steady_clock (no vDSO call), and on
+// anything recent it ticks at a constant rate whatever the core's frequency is.
+// CPUのタイムスタンプカウンタ。steady_clockより読むのがずっと安くて（vDSOの呼び出しがない）、最近のCPUなら
+// コアの周波数にかかわらず一定の速さで進む。
+[[gnu::always_inline]]
+inline std::uint64_t read_tsc() noexcept {
+    return __rdtsc();
+}
+
+// How many TSC ticks there are in a nanosecond, measured against steady_clock the first time it's
+// asked for (which takes about 10ms).
+// 一ナノ秒にTSCが何回進むか。最初に聞かれたときにsteady_clockと比べて測る（約10msかかる）。
+double tsc_ticks_per_nanosecond() noexcept;
+
+}
@@ -0,0 +1,208 @@
+#include "bookhistory.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <limits>
+
+namespace nanofill::storage {
+
+namespace {
+
+constexpr std::size_t block_size = CompressedEventStore::block_size;
+
+[[gnu::always_inline]]
+inline bool order_less(const OrderBookEntry& a, const OrderBookEntry& b) noexcept {
+    return a.price != b.price ? a.price < b.price : a.order_id < b.order_id;
+}
+
+// Fibonacci hashing: the top bits of the product are well mixed even for sequential ids.
+// フィボナッチハッシュ。連続したIDでも積の上位ビットはよく混ざっている。
+[[gnu::always_inline]]
+inline std::size_t slot_of(const std::uint32_t order_id, const std::size_t slot_count) noexcept {
+    return static_cast<std::size_t>((order_id * 0x9E3779B97F4A7C15ULL) >> (64 - std::countr_zero(slot_count)));
+}
+
+}
+
+BookHistory::BookHistory(const CompressedEventStore& store, const std::size_t checkpoint_interval)
+    : store(store),
+      checkpoint_interval(std::max<std::size_t>((checkpoint_interval + block_size - 1) / block_size, 1) * block_size) {
+    HistoricalBook book;
+
+    checkpoints.reserve(store.size() / this->checkpoint_interval + 1);
+    checkpoints.push_back({ .first_order = 0, .order_count = 0, .time = 0, .nanoseconds = 0 });
+
+    for (std::size_t end = this->checkpoint_interval; end <= store.size(); end += this->checkpoint_interval) {
+        rebuild(checkpoints.size() - 1, end, std::numeric_limits<std::uint64_t>::max(), book);
+
+        checkpoints.push_back({ .first_order = checkpoint_orders.size(), .order_count = book.orders.size(),
+            .time = book.time, .nanoseconds = book.nanoseconds });
+        checkpoint_orders.insert(checkpoint_orders.end(), book.orders.begin(), book.orders.end());
+    }
+}
+
+void BookHistory::rebuild(const std::size_t checkpoint, std::size_t end, const std::uint64_t until, HistoricalBook& book) const noexcept {
+    const Checkpoint& start = checkpoints[checkpoint];
+    const auto first = checkpoint_orders.begin() + start.first_order;
+    // Twice as many slots as there can be new orders, so probes stay short.
+    // 新しい注文がありうる数の倍のスロットがあるので、探索は短いままだ。
+    const std::size_t slot_count = std::bit_ceil(checkpoint_interval * 2);
+
+    book.orders.assign(first, first + start.order_count);
+    book.added.clear();
+    book.added_slots.assign(slot_count, 0);
+    book.time = start.time;
+    book.nanoseconds = start.nanoseconds;
+
+    // An order is found the way OrderBook finds it, by its price and id, and one with no shares
+    // left counts as gone.
+    // 注文はOrderBookのように価格とIDで見つけて、株が残っていないものはなくなったと数える。
+    const auto find = [&book, slot_count](const Event& event) -> OrderBookEntry* {
+        const OrderBookEntry key { .price = event.price, .time = 0, .order_id = event.order_id, .size = 0 };
+
+        for (auto it = std::lower_bound(book.orders.begin(), book.orders.end(), key, order_less);
+             it != book.orders.end() && it->price == event.price && it->order_id == event.order_id; ++it) {
+            if (it->size != 0) {
+                return &*it;
+            }
+        }
+
+        for (std::size_t slot = slot_of(event.order_id, slot_count); book.added_slots[slot] != 0; slot = (slot + 1) & (slot_count - 1)) {
+            OrderBookEntry& order = book.added[book.added_slots[slot] - 1];
+
+            if (order.order_id == event.order_id && order.price == event.price && order.size != 0) {
+                return &order;
+            }
+        }
+
+        return nullptr;
+    };
+
+    // Never go past the next checkpoint, which is as far as the slots have room for.
+    // 次のチェックポイントを決して越えない。スロットに余裕があるのはそこまでだ。
+    const std::size_t begin = checkpoint * checkpoint_interval;
+    end = std::min({ end, begin + checkpoint_interval, store.size() });
+
+    std::size_t index = begin;
+
+    while (index < end) {
+        const std::size_t count = store.decode_block(CompressedEventStore::block_of(index), book.decoded.data());
+        const std::size_t block_end = std::min(end - index, count);
+        std::size_t i = 0;
+
+        for (; i < block_end; ++i) {
+            const Event& event = book.decoded[i];
+
+            if (events::time_in_nanoseconds(event) > until) {
+                break;
+            }
+
+            switch (event.type) {
+                case EventType::Submission: {
+                    book.added.push_back({ .price = event.price, .time = event.time, .order_id = event.order_id, .size = event.size });
+
+                    std::size_t slot = slot_of(event.order_id, slot_count);
+
+                    while (book.added_slots[slot] != 0) {
+                        slot = (slot + 1) & (slot_count - 1);
+                    }
+
+                    book.added_slots[slot] = static_cast<std::uint32_t>(book.added.size());
+                    break;
+                }
+                case EventType::Deletion:
+                case EventType::ExecutionVisible:
+                    if (OrderBookEntry* order = find(event)) {
+                        order->size = 0;
+                    }
+                    break;
+                case EventType::Cancellation:
+                    if (OrderBookEntry* order = find(event)) {
+                        order->size -= std::abs(event.size) * (1 - 2 * (order->size < 0));
+                    }
+                    break;
+                default:
+                    break;
+            }
+
+            book.time = event.time;
+            book.nanoseconds = event.nanoseconds;
+        }
+
+        index += i;
+
+        if (i < block_end) {
+            break;
+        }
+    }
+
+    book.events = index;
+
+    // Put the new orders in with the rest, dropping the ones that have gone.
+    // 新しい注文を他のものと合わせて、なくなったものを捨てる。
+    std::sort(book.added.begin(), book.added.end(), order_less);
+    book.merged.clear();
+
+    const auto gone = [](const OrderBookEntry& order) { return order.size == 0; };
+    auto base = book.orders.begin();
+    auto added = book.added.begin();
+
+    while (base != book.orders.end() || added != book.added.end()) {
+        const bool take_added = base == book.orders.end() || (added != book.added.end() && order_less(*added, *base));
+        const OrderBookEntry& order = take_added ? *added++ : *base++;
+
+        if (!gone(order)) {
+            book.merged.push_back(order);
+        }
+    }
+
+    std::swap(book.orders, book.merged);
+
+    book.levels.clear();
+    book.best_bid = 0;
+    book.best_ask = 0;
+
+    for (const OrderBookEntry& order : book.orders) {
+        if (book.levels.empty() || book.levels.back().price != order.price) {
+            book.levels.push_back({ .price = order.price, .buy_size = 0, .sell_size = 0 });
+        }
+
+        HistoricalLevel& level = book.levels.back();
+
+        if (order.size > 0) {
+            level.buy_size += order.size;
+            book.best_bid = order.price;
+        } else {
+            level.sell_size -= order.size;
+
+            if (book.best_ask == 0) {
+                book.best_ask = order.price;
+            }
+        }
+    }
+}
+
+void BookHistory::at_time(const std::uint32_t time, HistoricalBook& book) const noexcept {
+    at_time(time, static_cast<std::uint32_t>(events::nanoseconds_per_second - 1), book);
+}
+
+void BookHistory::at_time(const std::uint32_t time, const std::uint32_t nanoseconds, HistoricalBook& book) const noexcept {
+    const std::uint64_t until = time * events::nanoseconds_per_second + nanoseconds;
+
+    // The last checkpoint taken before any event after the time.
+    // その時より後のイベントの前に取った最後のチェックポイント。
+    const auto after = std::upper_bound(checkpoints.begin(), checkpoints.end(), until, [](const std::uint64_t until, const Checkpoint& checkpoint) {
+        return until < checkpoint.time * events::nanoseconds_per_second + checkpoint.nanoseconds;
+    });
+
+    rebuild(static_cast<std::size_t>(after - checkpoints.begin()) - 1, store.size(), until, book);
+    book.time = time;
+    book.nanoseconds = nanoseconds;
+}
+
+void BookHistory::at_event(std::size_t event_count, HistoricalBook& book) const noexcept {
+    event_count = std::min(event_count, store.size());
+    rebuild(event_count / checkpoint_interval, event_count, std::numeric_limits<std::uint64_t>::max(), book);
+}
+
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "storage/eventstore.hpp"
+#include "orderbook/orderbook.hpp"
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace nanofill::storage {
+
+using events::EventType;
+using orderbook::OrderBookEntry;
+
+// The shares on one price of a rebuilt book.
+// 作り直した板の一つの価格の株。
+struct HistoricalLevel {
+    std::uint32_t price;
+    std::uint32_t buy_size;
+    std::uint32_t sell_size;
+};
+
+// The book as it was at some point in the day, filled in by BookHistory. Keep one per thread and
+// reuse it: everything a query needs to work with lives in here, so after the first few queries
+// nothing is allocated.
+// 一日のある時点の板。BookHistoryが埋める。スレッドごとに一つ持って再利用して。クエリが使うもの全部がここに
+// あるので、最初の何回かのクエリの後は何も割り当てない。
+class HistoricalBook {
+    friend class BookHistory;
+
+    std::uint32_t time = 0;
+    std::uint32_t nanoseconds = 0;
+    std::size_t events = 0;
+    std::uint32_t best_bid = 0;
+    std::uint32_t best_ask = 0;
+    // The resting orders, sorted by price and then order id.
+    // 置いてある注文。価格と注文IDの順に並べてある。
+    std::vector<OrderBookEntry> orders;
+    std::vector<HistoricalLevel> levels;
+
+    // Orders submitted since the checkpoint, and a hash table of where to find them by order id.
+    // チェックポイントからの出された注文と、注文IDでそれらの場所を見つけるハッシュ表。
+    std::vector<OrderBookEntry> added;
+    std::vector<std::uint32_t> added_slots;
+    std::vector<OrderBookEntry> merged;
+    alignas(32) std::array<Event, CompressedEventStore::block_size> decoded;
+
+public:
+    // The time asked for, or for queries by event, the time of the last event applied.
+    // 求めた時。イベントでのクエリなら、最後に適用したイベントの時。
+    std::uint32_t get_time() const noexcept {
+        return time;
+    }
+
+    // Nanoseconds into the second get_time gives.
+    // get_timeが示す秒の中のナノ秒。
+    std::uint32_t get_nanoseconds() const noexcept {
+        return nanoseconds;
+    }
+
+    // How many events from the start of the day this is the book after.
+    // 一日の始めからのいくつのイベントの後の板か。
+    std::size_t get_event_count() const noexcept {
+        return events;
+    }
+
+    // The highest price with buy orders on it, or 0 if there are none.
+    // 買い注文がある一番高い価格。ないと、0。
+    std::uint32_t get_best_bid() const noexcept {
+        return best_bid;
+    }
+
+    // The lowest price with sell orders on it, or 0 if there are none.
+    // 売り注文がある一番安い価格。ないと、0。
+    std::uint32_t get_best_ask() const noexcept {
+        return best_ask;
+    }
+
+    // Every price with shares on it, lowest first.
+    // 株がある全ての価格。安い順。
+    std::span<const HistoricalLevel> get_levels() const noexcept {
+        return levels;
+    }
+
+    // Every resting order, sorted by price and then order id.
+    // 置いてある全ての注文。価格と注文IDの順。
+    std::span<const OrderBookEntry> get_orders() const noexcept {
+        return orders;
+    }
+};
+
+// Answers "what did the book look like at time T?" without replaying the day up to T. Building it
+// replays the day once, taking a checkpoint of every resting order every checkpoint_interval events
+// (stored flat, sorted by price and order id, 16 bytes an order). A query copies the nearest
+// checkpoint at or before T and applies the events after it from the store, which is never more
+// than checkpoint_interval of them, so a query costs the same wherever in the day it lands.
+//
+// Orders are kept and changed exactly as OrderBook keeps them, so the levels match what an
+// OrderBook given the same events would hold. Queries are const and every bit of scratch space is
+// in the HistoricalBook, so any number of threads can query one history at once.
+// 「時Tに板はどうだったか」にTまで一日を再生せずに答える。作るときに一日を一回再生して、
+// checkpoint_interval個のイベントごとに置いてある全ての注文のチェックポイントを取る（平らに、価格と注文IDの
+// 順に、注文ごとに16バイトで格納する）。クエリはT以前の一番近いチェックポイントをコピーして、その後の
+// イベントをストアから適用する。それは決してcheckpoint_interval個より多くないので、クエリは一日のどこに
+// 当たっても同じコストだ。
+//
+// 注文はOrderBookとちょうど同じように持って変えるので、レベルは同じイベントを与えたOrderBookが持つものと
+// 一致する。クエリはconstで、一時的な場所は全部HistoricalBookにあるので、いくつのスレッドでも同時に一つの
+// 履歴に問い合わせられる。
+class BookHistory {
+    struct Checkpoint {
+        // Where this checkpoint's orders start in checkpoint_orders.
+        // このチェックポイントの注文がcheckpoint_ordersのどこから始まるか。
+        std::size_t first_order;
+        std::size_t order_count;
+        // The time of the last event before it, or 0 for the start of the day.
+        // その前の最後のイベントの時。一日の始めなら0。
+        std::uint32_t time;
+        std::uint32_t nanoseconds;
+    };
+
+    const CompressedEventStore& store;
+    std::size_t checkpoint_interval;
+    std::vector<Checkpoint> checkpoints;
+    std::vector<OrderBookEntry> checkpoint_orders;
+
+    // Apply events from the checkpoint's until end, or until one after until (nanoseconds after
+    // midnight).
+    // チェックポイントのイベントからendまで、またはuntil（零時からのナノ秒）より後のものまでイベントを適用する。
+    void rebuild(std::size_t checkpoint, std::size_t end, std::uint64_t until, HistoricalBook& book) const noexcept;
+
+public:
+    // The store must outlive the history. The interval is rounded up to a whole number of blocks.
+    // ストアは履歴より長生きしなければならない。間隔はブロックの整数倍に切り上げる。
+    explicit BookHistory(const CompressedEventStore& store, std::size_t checkpoint_interval = 1024);
+
+    // The book after every event in or before the second time.
+    // 秒time以前の全てのイベントの後の板。
+    void at_time(std::uint32_t time, HistoricalBook& book) const noexcept;
+
+    // The book after every event at or before nanoseconds into the second time.
+    // 秒timeのnanosecondsナノ秒以前の全てのイベントの後の板。
+    void at_time(std::uint32_t time, std::uint32_t nanoseconds, HistoricalBook& book) const noexcept;
+
+    // The book after the first event_count events.
+    // 最初のevent_count個のイベントの後の板。
+    void at_event(std::size_t event_count, HistoricalBook& book) const noexcept;
+
+    std::size_t get_checkpoint_interval() const noexcept {
+        return checkpoint_interval;
+    }
+
+    std::size_t get_checkpoint_count() const noexcept {
+        return checkpoints.size();
+    }
+
+    // Roughly how much memory the checkpoints take up.
+    // チェックポイントが使うメモリの大体の量。
+    std::size_t checkpoint_bytes() const noexcept {
+        return checkpoints.size() * sizeof(Checkpoint) + checkpoint_orders.size() * sizeof(OrderBookEntry);
+    }
+};
+
+}
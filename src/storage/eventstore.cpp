@@ -0,0 +1,418 @@
+#include "eventstore.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <utility>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace nanofill::storage {
+
+namespace {
+
+constexpr std::size_t block_size = CompressedEventStore::block_size;
+
+// Columns are packed as 4 interleaved lanes: value i goes in lane i % 4, so each 32-bit word of a
+// lane sits next to the same word of the other three and one 128-bit load reads all of them.
+// A column of width w takes exactly 4 * w words.
+// 列は4つの交互のレーンとして詰め込む。値iはレーンi % 4に入るので、レーンの各32ビットのワードは他の三つの
+// 同じワードの隣にあって、128ビットの一回の読み込みで全部読める。幅wの列はちょうど4 * wワードを使う。
+constexpr std::size_t lanes = 4;
+
+[[gnu::always_inline]]
+inline std::uint32_t zigzag_encode(const std::int32_t value) noexcept {
+    return (static_cast<std::uint32_t>(value) << 1) ^ static_cast<std::uint32_t>(value >> 31);
+}
+
+[[gnu::always_inline]]
+inline std::int32_t zigzag_decode(const std::uint32_t value) noexcept {
+    return static_cast<std::int32_t>((value >> 1) ^ (0U - (value & 1)));
+}
+
+constexpr std::uint32_t low_bits(const unsigned int width) noexcept {
+    return width >= 32 ? ~0U : (1U << width) - 1;
+}
+
+// How many words a column takes up.
+// 列が使うワードの数。
+constexpr std::size_t column_words(const unsigned int width, const unsigned int exceptions) noexcept {
+    return lanes * width + (exceptions + 3) / 4 + exceptions;
+}
+
+// Pick the width that makes the column smallest, counting the values that need to go on the side.
+// 別に置く必要がある値を数えて、列を一番小さくする幅を選ぶ。
+std::pair<unsigned int, unsigned int> choose_width(const std::uint32_t* values) noexcept {
+    std::array<unsigned int, 33> counts{};
+
+    for (std::size_t i = 0; i < block_size; ++i) {
+        ++counts[std::bit_width(values[i])];
+    }
+
+    unsigned int best_width = 32;
+    unsigned int best_exceptions = 0;
+    unsigned int too_wide = 0;
+
+    for (int width = 32; width >= 0; --width) {
+        if (column_words(width, too_wide) < column_words(best_width, best_exceptions)) {
+            best_width = width;
+            best_exceptions = too_wide;
+        }
+
+        too_wide += counts[width];
+    }
+
+    return { best_width, best_exceptions };
+}
+
+void pack_column(const std::uint32_t* values, const unsigned int width, const unsigned int exceptions,
+    std::vector<std::uint32_t>& words) {
+    const std::size_t begin = words.size();
+    words.resize(begin + column_words(width, exceptions), 0);
+
+    std::uint32_t* packed = words.data() + begin;
+    auto* positions = reinterpret_cast<std::uint8_t*>(packed + lanes * width);
+    std::uint32_t* high_bits = packed + lanes * width + (exceptions + 3) / 4;
+    unsigned int exception = 0;
+
+    for (std::size_t i = 0; i < block_size; ++i) {
+        const std::uint32_t value = values[i] & low_bits(width);
+
+        if (width != 0) {
+            const std::size_t bit = (i / lanes) * width;
+            const std::size_t word = bit / 32;
+            const std::size_t shift = bit % 32;
+
+            packed[word * lanes + i % lanes] |= value << shift;
+
+            if (shift + width > 32) {
+                packed[(word + 1) * lanes + i % lanes] |= value >> (32 - shift);
+            }
+        }
+
+        if (width < 32 && values[i] >> width != 0) {
+            positions[exception] = static_cast<std::uint8_t>(i);
+            high_bits[exception] = values[i] >> width;
+            ++exception;
+        }
+    }
+}
+
+void unpack_column_scalar(const std::uint32_t* packed, const unsigned int width, std::uint32_t* values) noexcept {
+    for (std::size_t i = 0; i < block_size; ++i) {
+        const std::size_t bit = (i / lanes) * width;
+        const std::size_t word = bit / 32;
+        const std::size_t shift = bit % 32;
+        std::uint32_t value = width == 0 ? 0 : packed[word * lanes + i % lanes] >> shift;
+
+        if (shift + width > 32) {
+            value |= packed[(word + 1) * lanes + i % lanes] << (32 - shift);
+        }
+
+        values[i] = value & low_bits(width);
+    }
+}
+
+#ifdef __AVX2__
+
+// Unpack values 8 * Pair to 8 * Pair + 7, which are the same two positions of all four lanes.
+// With the width known at compile time, every shift and offset is a constant.
+// 値8 * Pairから8 * Pair + 7までを展開する。これは全4レーンの同じ二つの位置だ。コンパイル時に幅が分かるので、
+// 全てのシフトとオフセットは定数だ。
+template<unsigned int Width, std::size_t Pair>
+[[gnu::always_inline]]
+inline void unpack_pair(const std::uint32_t* packed, std::uint32_t* values, const __m256i mask) noexcept {
+    constexpr std::size_t low_bit = 2 * Pair * Width;
+    constexpr std::size_t high_bit = (2 * Pair + 1) * Width;
+    constexpr std::size_t low_word = low_bit / 32;
+    constexpr std::size_t high_word = high_bit / 32;
+    constexpr int low_shift = low_bit % 32;
+    constexpr int high_shift = high_bit % 32;
+    constexpr bool low_spills = low_shift + Width > 32;
+    constexpr bool high_spills = high_shift + Width > 32;
+
+    __m256i value = _mm256_set_m128i(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(packed + high_word * lanes)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(packed + low_word * lanes)));
+    value = _mm256_srlv_epi32(value, _mm256_setr_epi32(
+        low_shift, low_shift, low_shift, low_shift, high_shift, high_shift, high_shift, high_shift));
+
+    if constexpr (low_spills || high_spills) {
+        // A shift of 32 clears the half that doesn't spill.
+        // 32のシフトはあふれない半分を消す。
+        constexpr int low_spill_shift = low_spills ? 32 - low_shift : 32;
+        constexpr int high_spill_shift = high_spills ? 32 - high_shift : 32;
+        const __m256i next = _mm256_set_m128i(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(packed + (high_word + high_spills) * lanes)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(packed + (low_word + low_spills) * lanes)));
+        value = _mm256_or_si256(value, _mm256_sllv_epi32(next, _mm256_setr_epi32(
+            low_spill_shift, low_spill_shift, low_spill_shift, low_spill_shift,
+            high_spill_shift, high_spill_shift, high_spill_shift, high_spill_shift)));
+    }
+
+    _mm256_store_si256(reinterpret_cast<__m256i*>(values + Pair * 8), _mm256_and_si256(value, mask));
+}
+
+template<unsigned int Width>
+void unpack_column_avx2(const std::uint32_t* packed, std::uint32_t* values) noexcept {
+    if constexpr (Width == 0) {
+        std::memset(values, 0, block_size * sizeof(std::uint32_t));
+    } else {
+        const __m256i mask = _mm256_set1_epi32(static_cast<int>(low_bits(Width)));
+
+        [&]<std::size_t... Pairs>(std::index_sequence<Pairs...>) {
+            (unpack_pair<Width, Pairs>(packed, values, mask), ...);
+        }(std::make_index_sequence<block_size / 8>{});
+    }
+}
+
+using Unpacker = void (*)(const std::uint32_t*, std::uint32_t*) noexcept;
+
+// One unpacker for every width, picked once per column.
+// 幅ごとに一つの展開関数。列ごとに一回選ぶ。
+constexpr auto unpackers = []<unsigned int... Widths>(std::integer_sequence<unsigned int, Widths...>) {
+    return std::array<Unpacker, sizeof...(Widths)>{ &unpack_column_avx2<Widths>... };
+}(std::make_integer_sequence<unsigned int, 33>{});
+
+[[gnu::always_inline]]
+inline __m256i zigzag_decode(const __m256i value) noexcept {
+    return _mm256_xor_si256(_mm256_srli_epi32(value, 1),
+        _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_and_si256(value, _mm256_set1_epi32(1))));
+}
+
+// Turn zigzagged differences back into values, step times the running total after first.
+// ジグザグにした差を値に戻す。firstの後の累計のstep倍だ。
+void undo_differences_avx2(std::uint32_t* values, const std::uint32_t first, const std::uint32_t step) noexcept {
+    __m256i total = _mm256_set1_epi32(static_cast<int>(first));
+    const __m256i multiplier = _mm256_set1_epi32(static_cast<int>(step));
+
+    for (std::size_t i = 0; i < block_size; i += 8) {
+        __m256i value = _mm256_mullo_epi32(
+            zigzag_decode(_mm256_load_si256(reinterpret_cast<const __m256i*>(values + i))), multiplier);
+
+        // Add up within each 128-bit half, then carry the low half's total into the high half.
+        // 各128ビットの半分の中で足して、低い半分の合計を高い半分に繰り越す。
+        value = _mm256_add_epi32(value, _mm256_slli_si256(value, 4));
+        value = _mm256_add_epi32(value, _mm256_slli_si256(value, 8));
+        value = _mm256_add_epi32(value, _mm256_permute2x128_si256(
+            _mm256_shuffle_epi32(value, _MM_SHUFFLE(3, 3, 3, 3)), _mm256_setzero_si256(), 0x08));
+        value = _mm256_add_epi32(value, total);
+        total = _mm256_permutevar8x32_epi32(value, _mm256_set1_epi32(7));
+
+        _mm256_store_si256(reinterpret_cast<__m256i*>(values + i), value);
+    }
+}
+
+void undo_zigzag_avx2(std::uint32_t* values, const std::uint32_t step) noexcept {
+    const __m256i multiplier = _mm256_set1_epi32(static_cast<int>(step));
+
+    for (std::size_t i = 0; i < block_size; i += 8) {
+        auto* vector = reinterpret_cast<__m256i*>(values + i);
+        _mm256_store_si256(vector, _mm256_mullo_epi32(zigzag_decode(_mm256_load_si256(vector)), multiplier));
+    }
+}
+
+#endif
+
+void undo_differences_scalar(std::uint32_t* values, const std::uint32_t first, const std::uint32_t step) noexcept {
+    std::uint32_t total = first;
+
+    for (std::size_t i = 0; i < block_size; ++i) {
+        total += static_cast<std::uint32_t>(zigzag_decode(values[i])) * step;
+        values[i] = total;
+    }
+}
+
+void undo_zigzag_scalar(std::uint32_t* values, const std::uint32_t step) noexcept {
+    for (std::size_t i = 0; i < block_size; ++i) {
+        values[i] = static_cast<std::uint32_t>(zigzag_decode(values[i])) * step;
+    }
+}
+
+// What every value is a multiple of, or 1 if they're all 0.
+// 全ての値の約数。全部0なら、1。
+template<typename Value>
+std::uint32_t common_step(const Value& value_of) noexcept {
+    std::uint32_t step = 0;
+
+    for (std::size_t i = 0; i < block_size; ++i) {
+        step = std::gcd(step, static_cast<std::uint32_t>(std::abs(static_cast<std::int64_t>(value_of(i)))));
+    }
+
+    return step == 0 ? 1 : step;
+}
+
+}
+
+CompressedEventStore::CompressedEventStore(const std::span<const Event> events) {
+    words.reserve(events.size());
+    block_index.reserve(events.size() / block_size);
+
+    for (const Event& event : events) {
+        append(event);
+    }
+}
+
+void CompressedEventStore::encode_block() {
+    alignas(32) std::array<std::array<std::uint32_t, block_size>, column_count> columns;
+    auto& [times, prices, order_ids, sizes, types, symbol_ids, nanoseconds] = columns;
+    const auto price_difference = [&](const std::size_t i) {
+        return static_cast<std::int32_t>(pending[i].price - pending[i == 0 ? 0 : i - 1].price);
+    };
+
+    // Prices move in ticks and sizes are often round lots, so both shrink a lot when counted in
+    // those.
+    // 価格はティック単位で動いて、サイズはよく単元株の倍数なので、その単位で数えると両方かなり小さくなる。
+    const BlockIndexEntry entry {
+        .offset = words.size(),
+        .first_time = pending[0].time,
+        .first_price = pending[0].price,
+        .first_order_id = pending[0].order_id,
+        .first_nanoseconds = pending[0].nanoseconds,
+        .price_step = common_step(price_difference),
+        .size_step = common_step([&](const std::size_t i) { return pending[i].size; }),
+        .bit_widths = {},
+        .exception_counts = {}
+    };
+    block_index.push_back(entry);
+
+    for (std::size_t i = 0; i < block_size; ++i) {
+        const Event& previous = pending[i == 0 ? 0 : i - 1];
+        const Event& event = pending[i];
+
+        times[i] = zigzag_encode(static_cast<std::int32_t>(event.time - previous.time));
+        prices[i] = zigzag_encode(static_cast<std::int32_t>(price_difference(i) / static_cast<std::int64_t>(entry.price_step)));
+        order_ids[i] = zigzag_encode(static_cast<std::int32_t>(event.order_id - previous.order_id));
+        sizes[i] = zigzag_encode(event.size / static_cast<std::int32_t>(entry.size_step));
+        types[i] = static_cast<std::uint32_t>(event.type);
+        symbol_ids[i] = event.symbol_id;
+        // Wraps at each new second, but consecutive events are usually within the same one.
+        // 新しい秒ごとに一周するが、連続したイベントは普通同じ秒の中にある。
+        nanoseconds[i] = zigzag_encode(static_cast<std::int32_t>(event.nanoseconds - previous.nanoseconds));
+    }
+
+    for (std::size_t column = 0; column < column_count; ++column) {
+        const auto [width, exceptions] = choose_width(columns[column].data());
+
+        block_index.back().bit_widths[column] = static_cast<std::uint8_t>(width);
+        block_index.back().exception_counts[column] = static_cast<std::uint8_t>(exceptions);
+        pack_column(columns[column].data(), width, exceptions, words);
+    }
+
+    pending_count = 0;
+}
+
+template<bool UseSimd>
+std::size_t CompressedEventStore::decode(const std::size_t block, Event* events) const noexcept {
+    if (block == block_index.size()) {
+        std::copy_n(pending.begin(), pending_count, events);
+
+        return pending_count;
+    }
+
+    const BlockIndexEntry& entry = block_index[block];
+    alignas(32) std::array<std::array<std::uint32_t, block_size>, column_count> columns;
+    const std::uint32_t* packed = words.data() + entry.offset;
+
+    for (std::size_t column = 0; column < column_count; ++column) {
+        const unsigned int width = entry.bit_widths[column];
+        const unsigned int exceptions = entry.exception_counts[column];
+        std::uint32_t* values = columns[column].data();
+
+#ifdef __AVX2__
+        if constexpr (UseSimd) {
+            unpackers[width](packed, values);
+        } else {
+            unpack_column_scalar(packed, width, values);
+        }
+#else
+        unpack_column_scalar(packed, width, values);
+#endif
+
+        const auto* positions = reinterpret_cast<const std::uint8_t*>(packed + lanes * width);
+        const std::uint32_t* high_bits = packed + lanes * width + (exceptions + 3) / 4;
+
+        for (unsigned int exception = 0; exception < exceptions; ++exception) {
+            values[positions[exception]] |= high_bits[exception] << width;
+        }
+
+        packed += column_words(width, exceptions);
+    }
+
+    auto& [times, prices, order_ids, sizes, types, symbol_ids, nanoseconds] = columns;
+
+#ifdef __AVX2__
+    if constexpr (UseSimd) {
+        undo_differences_avx2(times.data(), entry.first_time, 1);
+        undo_differences_avx2(prices.data(), entry.first_price, entry.price_step);
+        undo_differences_avx2(order_ids.data(), entry.first_order_id, 1);
+        undo_differences_avx2(nanoseconds.data(), entry.first_nanoseconds, 1);
+        undo_zigzag_avx2(sizes.data(), entry.size_step);
+    } else
+#endif
+    {
+        undo_differences_scalar(times.data(), entry.first_time, 1);
+        undo_differences_scalar(prices.data(), entry.first_price, entry.price_step);
+        undo_differences_scalar(order_ids.data(), entry.first_order_id, 1);
+        undo_differences_scalar(nanoseconds.data(), entry.first_nanoseconds, 1);
+        undo_zigzag_scalar(sizes.data(), entry.size_step);
+    }
+
+    for (std::size_t i = 0; i < block_size; ++i) {
+        events[i] = Event {
+            .price = prices[i],
+            .time = times[i],
+            .order_id = order_ids[i],
+            .size = static_cast<std::int16_t>(sizes[i]),
+            .type = static_cast<events::EventType>(types[i]),
+            .symbol_id = static_cast<std::uint16_t>(symbol_ids[i]),
+            .nanoseconds = nanoseconds[i]
+        };
+    }
+
+    return block_size;
+}
+
+std::size_t CompressedEventStore::decode_block(const std::size_t block, Event* events) const noexcept {
+    return decode<true>(block, events);
+}
+
+std::size_t CompressedEventStore::decode_block_scalar(const std::size_t block, Event* events) const noexcept {
+    return decode<false>(block, events);
+}
+
+std::size_t CompressedEventStore::find_block_for_time(const std::uint32_t time) const noexcept {
+    const std::size_t blocks = block_count();
+    const auto first_time = [&](const std::size_t block) {
+        return block == block_index.size() ? pending[0].time : block_index[block].first_time;
+    };
+
+    // The first block starting at or after the time; the one before might end there too.
+    // その時以降に始まる最初のブロック。その前のブロックもそこで終わるかもしれない。
+    std::size_t low = 0;
+    std::size_t high = blocks;
+
+    while (low < high) {
+        const std::size_t middle = (low + high) / 2;
+
+        if (first_time(middle) < time) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low == 0 ? 0 : low - 1;
+}
+
+Event CompressedEventStore::get(const std::size_t event) const noexcept {
+    alignas(32) std::array<Event, block_size> decoded;
+    decode_block(block_of(event), decoded.data());
+
+    return decoded[event % block_size];
+}
+
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "events/event.hpp"
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace nanofill::storage {
+
+using events::Event;
+
+// Keeps a whole day of events in memory at a fraction of their size. Events are split into blocks
+// of 128, and each field of a block is stored as its own column: times, nanoseconds, prices and
+// order ids as the difference from the event before, sizes and types as they are (prices and sizes counted in
+// whatever step every one in the block is a multiple of),
+// and all of them bit-packed to the fewest bits that fit nearly every value in the block, with
+// the few that don't fit kept on the side. Consecutive events are usually close together, so most
+// columns only need a few bits per event.
+//
+// Blocks are independent and listed in an index, so reading can start at any event or time
+// without decoding what's before it.
+// 一日分のイベントを元のサイズの一部でメモリに置く。イベントを128個のブロックに分けて、ブロックの各フィールドを
+// 独自の列として格納する。時、ナノ秒、価格と注文IDは前のイベントとの差として、サイズと種類はそのままで（価格と
+// サイズはブロックの全部が倍数である単位で数える）、全部ブロックのほぼ全ての値が収まる一番少ないビット数に詰め込んで、収まらない少しの値は
+// 別に置く。連続したイベントは普通近いので、ほとんどの列はイベントごとに数ビットしか要らない。
+//
+// ブロックは独立していてインデックスに載っているので、前のものをデコードせずに、どのイベントや時からでも読み
+// 始められる。
+class CompressedEventStore {
+public:
+    static constexpr std::size_t block_size = 128;
+
+private:
+    // time, price, order id, size, type, symbol and nanoseconds.
+    // 時、価格、注文ID、サイズ、種類、銘柄とナノ秒。
+    static constexpr std::size_t column_count = 7;
+
+    // Where to find a block and what it starts from.
+    // ブロックの場所と、何から始まるか。
+    struct BlockIndexEntry {
+        // Where the block's packed columns start in words.
+        // ブロックの詰め込んだ列がwordsのどこから始まるか。
+        std::uint64_t offset;
+        // The first event's time, price, order id and nanoseconds, which the differences are from.
+        // 最初のイベントの時、価格、注文IDとナノ秒。差はこれからの差だ。
+        std::uint32_t first_time;
+        std::uint32_t first_price;
+        std::uint32_t first_order_id;
+        std::uint32_t first_nanoseconds;
+        // What every price difference and every size in the block is a multiple of.
+        // ブロックの全ての価格の差と全てのサイズの約数。
+        std::uint32_t price_step;
+        std::uint32_t size_step;
+        // Bits per value in each column.
+        // 各列の値ごとのビット数。
+        std::array<std::uint8_t, column_count> bit_widths;
+        // How many values in each column didn't fit in its bits.
+        // 各列のビットに収まらなかった値の数。
+        std::array<std::uint8_t, column_count> exception_counts;
+    };
+
+    std::vector<BlockIndexEntry> block_index;
+    std::vector<std::uint32_t> words;
+    // Events that haven't made a whole block yet.
+    // まだ一つのブロックにならないイベント。
+    std::array<Event, block_size> pending;
+    std::size_t pending_count = 0;
+
+    void encode_block();
+
+    template<bool UseSimd>
+    std::size_t decode(std::size_t block, Event* events) const noexcept;
+
+public:
+    CompressedEventStore() = default;
+    explicit CompressedEventStore(std::span<const Event> events);
+
+    void append(const Event& event) {
+        pending[pending_count++] = event;
+
+        if (pending_count == block_size) {
+            encode_block();
+        }
+    }
+
+    // The number of events stored.
+    // 格納したイベントの数。
+    std::size_t size() const noexcept {
+        return block_index.size() * block_size + pending_count;
+    }
+
+    // The number of blocks, counting any partly filled one at the end.
+    // 最後の一部しか埋まっていないブロックも数えたブロックの数。
+    std::size_t block_count() const noexcept {
+        return block_index.size() + (pending_count != 0);
+    }
+
+    // Roughly how much memory the events take up now.
+    // 今イベントが使っているメモリの大体の量。
+    std::size_t compressed_bytes() const noexcept {
+        return words.size() * sizeof(std::uint32_t)
+            + block_index.size() * sizeof(BlockIndexEntry)
+            + pending_count * sizeof(Event);
+    }
+
+    // How many times smaller than plain Events this is.
+    // 普通のEventより何倍小さいか。
+    double compression_ratio() const noexcept {
+        return compressed_bytes() == 0 ? 0 : static_cast<double>(size() * sizeof(Event)) / compressed_bytes();
+    }
+
+    // Decode a block into events (which must have room for block_size), returning how many there
+    // were. Uses AVX2 when it's available.
+    // ブロックをevents（block_size個の余裕がなければならない）にデコードして、いくつあったかを返す。使えれば、
+    // AVX2を使う。
+    std::size_t decode_block(std::size_t block, Event* events) const noexcept;
+
+    // The same without SIMD, for comparison.
+    // 比較のために、SIMDなしで同じことをする。
+    std::size_t decode_block_scalar(std::size_t block, Event* events) const noexcept;
+
+    // The block holding an event.
+    // イベントを持っているブロック。
+    static constexpr std::size_t block_of(const std::size_t event) noexcept {
+        return event / block_size;
+    }
+
+    // The block to start decoding from to find the first event at or after the time, assuming
+    // events are in time order. If every event is before it, this is the last block.
+    // イベントが時間順であれば、その時以降の最初のイベントを見つけるためにデコードし始めるブロック。全イベントが
+    // それより前なら、最後のブロックだ。
+    std::size_t find_block_for_time(std::uint32_t time) const noexcept;
+
+    // Decode one event. Decodes its whole block, so use decode_block to read many.
+    // 一つのイベントをデコードする。ブロック全体をデコードするので、たくさん読むには、decode_blockを使って。
+    Event get(std::size_t event) const noexcept;
+};
+
+}
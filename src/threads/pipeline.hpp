@@ -0,0 +1,132 @@
+#pragma once
+
+#include "events/event.hpp"
+#include "concurrency/broadcastringbuffer.hpp"
+#include "orderbook/orderbook.hpp"
+#include "tradingengine/tradingengine.hpp"
+#include <array>
+#include <vector>
+
+// A pipelined alternative to event_consumer, where the book, the engine and anything else (a
+// journal, stats, ...) each run on their own thread and read the same slots of a broadcast ring.
+// event_consumerのパイプライン版。板、エンジンとその他のもの（ジャーナル、統計など）がそれぞれ独自のスレッドで
+// 動いて、ブロードキャストリングの同じスロットを読む。
+namespace nanofill::threads {
+
+using concurrency::BroadcastRingBuffer;
+using events::Event;
+
+// Every stage reads the same events. Anything a stage works out for later stages goes in a
+// StageResults instead of the ring.
+// 全てのステージが同じイベントを読む。ステージが後のステージのために求めたものは、リングではなく
+// StageResultsに入れる。
+template<std::size_t N, std::size_t Consumers>
+using PipelineRing = BroadcastRingBuffer<Event, N, Consumers>;
+
+// What one stage found out about each event, for the stages that depend on it, indexed by the
+// event's position in the ring. The ring's slots stay read-only, so stages that don't depend on the
+// writer can read or copy them at the same time.
+//
+// The writing stage's ring cursor is what publishes an entry: it's written before the writer
+// advances past that position, and a dependent stage only gets to that position after seeing the
+// cursor move. The producer can't reuse a position until every stage is past it, so an entry is
+// never overwritten while it's still being read.
+// 各ステージが各イベントについて分かったことを、それに依存するステージのために、リングでのイベントの位置で
+// 索引して持つ。リングのスロットは読み取り専用のままなので、書き手に依存しないステージは同時にそれを読んだり
+// コピーしたりできる。
+//
+// エントリを公開するのは書き込むステージのリングのカーソルだ。書き手がその位置を過ぎる前に書き込んで、依存する
+// ステージはカーソルが動いたのを見てからしかその位置に来ない。全てのステージが過ぎるまで生産者はその位置を
+// 再利用できないので、エントリはまだ読まれている間に上書きされない。
+template<typename T, std::size_t N>
+class StageResults {
+    std::array<T, N> values{};
+
+public:
+    [[gnu::always_inline]]
+    void set(const std::size_t position, const T value) noexcept {
+        values[position & (N - 1)] = value;
+    }
+
+    [[gnu::always_inline]]
+    T get(const std::size_t position) const noexcept {
+        return values[position & (N - 1)];
+    }
+};
+
+// Whether the book actioned each event.
+// 板が各イベントを処理したか。
+template<std::size_t N>
+using ActionedResults = StageResults<bool, N>;
+
+// Pushes events into the pipeline ring one by one, like event_producer.
+// event_producerと同じように、パイプラインのリングにイベントを一つずつ入れる。
+template<std::size_t N, std::size_t Consumers>
+void pipeline_producer(PipelineRing<N, Consumers>& ring, const std::vector<Event>& events) noexcept {
+    for (const Event& event : events) {
+        while (!ring.push(event)) {}
+    }
+}
+
+// Runs one stage of the pipeline: hands every event and its position to the handler in order until
+// event_count events have been seen.
+// パイプラインの一つのステージを動かす。event_count個のイベントを見るまで、順番に各イベントとその位置を
+// ハンドラに渡す。
+template<std::size_t N, std::size_t Consumers, typename Handler>
+void run_pipeline_stage(
+    PipelineRing<N, Consumers>& ring,
+    const std::size_t consumer,
+    const std::size_t event_count,
+    Handler&& handler
+) noexcept {
+    std::size_t events_seen = 0;
+
+    while (events_seen != event_count) {
+        const std::size_t position = ring.get_position(consumer);
+        const auto events = ring.read(consumer, orderbook::max_batch_size);
+
+        for (std::size_t i = 0; i < events.size(); ++i) {
+            handler(events[i], position + i);
+        }
+
+        ring.advance(consumer, events.size());
+        events_seen += events.size();
+    }
+}
+
+// The book stage. Records whether each event was actioned for the stages after it.
+// 板のステージ。後のステージのために、各イベントが処理されたかどうかを記録する。
+template<std::size_t N, std::size_t Consumers>
+void book_stage(
+    PipelineRing<N, Consumers>& ring,
+    const std::size_t consumer,
+    orderbook::OrderBook& order_book,
+    ActionedResults<N>& actioned,
+    const std::size_t event_count
+) noexcept {
+    run_pipeline_stage(ring, consumer, event_count, [&](const Event& event, const std::size_t position) {
+        actioned.set(position, order_book.process_event(event));
+    });
+}
+
+// The engine stage. Must depend on the book stage.
+// エンジンのステージ。板のステージに依存しなければならない。
+template<std::size_t N, std::size_t Consumers>
+void engine_stage(
+    PipelineRing<N, Consumers>& ring,
+    const std::size_t consumer,
+    tradingengine::TradingEngine& trading_engine,
+    const ActionedResults<N>& actioned,
+    const std::size_t event_count
+) noexcept {
+    run_pipeline_stage(ring, consumer, event_count, [&](const Event& event, const std::size_t position) {
+        // If the order book deemed an event to be invalid, then we should probably
+        // ignore it in the trading engine too.
+        // 板がイベントを無効だと判断したら、取引処理エンジンには無視したほうがいいかもしれない。
+        if (actioned.get(position)) {
+            trading_engine.process_event(event);
+        }
+    });
+}
+
+}
@@ -2,18 +2,93 @@
 
 #include "events/event.hpp"
 #include "concurrency/spscringbuffer.hpp"
+#include "concurrency/conflatedlevelchannel.hpp"
 #include "orderbook/orderbook.hpp"
+#include "orderbook/topofbook.hpp"
 #include "tradingengine/tradingengine.hpp"
+#include "tradingengine/strategy.hpp"
+#include "tradingengine/bars.hpp"
+#include "fileio/blockreader.hpp"
+#include "fileio/lobsterparser.hpp"
+#include "feed/udpfeed.hpp"
+#include "feed/arbiter.hpp"
+#include "ipc/sharedbook.hpp"
+#include "gateway/gateway.hpp"
+#include "stats/latencyhistogram.hpp"
+#include "stats/perfcounters.hpp"
+#include "stats/flightrecorder.hpp"
+#include "storage/eventstore.hpp"
 #include <array>
+#include <atomic>
 #include <chrono>
+#include <string>
 
 namespace nanofill::threads {
 
 using concurrency::SPSCRingBuffer;
+using concurrency::ConflatedLevelChannel;
 using orderbook::OrderBook;
 using tradingengine::TradingEngine;
 using events::Event;
 
+// Optional extras for the event consumer. Anything left as nullptr is skipped.
+// イベント消費者の任意の追加機能。nullptrのままのものは飛ばす。
+struct ConsumerHooks {
+    // Receives the latest state of each level the order book changes.
+    // 板が変えた各レベルの最新の状態を受け取る。
+    ConflatedLevelChannel<orderbook::order_book_size>* level_channel = nullptr;
+    // Receives a snapshot of the top of the book after each batch of events.
+    // イベントのバッチごとに板の一番上のスナップショットを受け取る。
+    orderbook::TopOfBookPublisher* top_of_book = nullptr;
+    // Counts what the CPU does for each event, split into the book, engine and extras phases. Only
+    // used when built with PERF_COUNTERS=1, and it slows every event down while it's on.
+    // CPUが各イベントで何をするかを板、エンジンと追加機能のフェーズに分けて数える。PERF_COUNTERS=1で
+    // ビルドしたときしか使わなくて、使っている間は各イベントが遅くなる。
+    stats::PerfCounterProfile* perf_counters = nullptr;
+    // Keeps the last few thousand events and freezes the ones around any outlier.
+    // 最後の数千のイベントを持って、外れ値の周りのものを凍結する。
+    stats::FlightRecorder* flight_recorder = nullptr;
+    // Publishes every event, the level it changed and the top of the book for other processes.
+    // 全てのイベント、それが変えたレベルと板の一番上を他のプロセスのために公開する。
+    ipc::SharedBookWriter* shared_book = nullptr;
+    // Sends orders whenever the strategy's targets change, and reads the gateway's acks after each
+    // batch.
+    // 戦略の目標が変わるたびに注文を送って、バッチごとにゲートウェイの受付を読む。
+    gateway::OrderRouter* order_router = nullptr;
+    // Builds bars from every execution, including hidden ones the book doesn't action.
+    // 板が処理しない見えないものも含めて、全ての約定からバーを作る。
+    tradingengine::BarAggregator* bars = nullptr;
+};
+
+// Open the hardware counters on the calling thread, if they're built in and asked for.
+// 組み込まれていて、頼まれたら、呼び出したスレッドでハードウェアカウンタを開く。
+inline void start_perf_counters(const ConsumerHooks hooks) {
+    if constexpr (stats::perf_counters_enabled) {
+        if (hooks.perf_counters != nullptr) {
+            hooks.perf_counters->start();
+        }
+    }
+}
+
+// Note how long the counters were actually counting, once the consumer has finished.
+// 消費者が終わったら、カウンタが実際に数えていた時間を記録する。
+inline void stop_perf_counters(const ConsumerHooks hooks) noexcept {
+    if constexpr (stats::perf_counters_enabled) {
+        if (hooks.perf_counters != nullptr) {
+            hooks.perf_counters->stop();
+        }
+    }
+}
+
+[[gnu::always_inline]]
+inline void read_perf_counters(const ConsumerHooks hooks, stats::PerfCounterValues& values) noexcept {
+    if constexpr (stats::perf_counters_enabled) {
+        if (hooks.perf_counters != nullptr) {
+            hooks.perf_counters->counters->read(values);
+        }
+    }
+}
+
 // Pushes events into the event buffer.
 // イベントバッファにイベントを入れる。
 template<size_t N>
@@ -35,47 +110,502 @@ void event_producer(SPSCRingBuffer<Event, N>& event_buffer, const std::vector<Ev
     }
 }
 
-// Reads and processes events from the event buffer.
-// イベントバッファからのイベントを読み取って、処理する。
+// Pushes events from a compressed store into the event buffer one by one, like event_producer.
+// Decoding a block takes far less time than the consumer spends on its events, so a month of data
+// can be replayed from RAM without ever expanding it.
+// 圧縮したストアからイベントバッファにevent_producerと同じように一つずつイベントを入れる。ブロックのデコードは
+// 消費者がそのイベントにかける時間よりずっと短いので、一ヶ月分のデータを展開せずにRAMから再生できる。
 template<size_t N>
+void store_producer(SPSCRingBuffer<Event, N>& event_buffer, const storage::CompressedEventStore& store) noexcept {
+    alignas(32) std::array<Event, storage::CompressedEventStore::block_size> decoded;
+
+    for (std::size_t block = 0; block < store.block_count(); ++block) {
+        const std::size_t count = store.decode_block(block, decoded.data());
+
+        for (std::size_t i = 0; i < count; ++i) {
+            while (!event_buffer.push(decoded[i])) {}
+        }
+    }
+}
+
+// Process one batch of events that has been taken off the event buffer, calling record with how
+// many nanoseconds each event took.
+// イベントバッファから取ったイベントのバッチを一つ処理して、各イベントにかかったナノ秒でrecordを呼ぶ。
+template<size_t N, typename Engine, typename Record>
+[[gnu::always_inline]]
+inline void consume_batch(
+    const SPSCRingBuffer<Event, N>& event_buffer,
+    const Event* events,
+    const unsigned int events_found,
+    OrderBook& order_book,
+    Engine& trading_engine,
+    const ConsumerHooks hooks,
+    Record&& record
+) noexcept {
+    std::chrono::steady_clock::time_point clock_start;
+    std::chrono::steady_clock::time_point clock_end;
+    stats::PerfCounterValues counts_start;
+    stats::PerfCounterValues counts_after_book;
+    stats::PerfCounterValues counts_after_engine;
+    stats::PerfCounterValues counts_end;
+
+    if (events_found == 0 && hooks.level_channel != nullptr) {
+        // Nothing to do, so let any level channel reader catch up.
+        // することがないので、レベルチャンネルの読み取り側に追いつかせる。
+        hooks.level_channel->service();
+    }
+
+    // Start the cache misses for the whole batch now so they overlap with each other. We still
+    // apply and time each event on its own below so the latency data stays per-event.
+    // バッチ全体のキャッシュミスが重なるように、今始める。レイテンシのデータがイベントごとのままであるように、
+    // 下ではまだ各イベントを別々に処理して、測る。
+    order_book.prefetch_events({ events, events_found });
+
+    for (unsigned int i = 0; i < events_found; ++i) {
+        // Logging on this hot path is probably not a good idea for performance.
+        // このホットパスでログするのは性能に悪いはずだ。
+        clock_start = std::chrono::steady_clock::now();
+        // When the event was picked up, which is where tick-to-trade starts.
+        // イベントを取り上げたとき。ここからtick-to-tradeが始まる。
+        const std::uint64_t tsc_start = hooks.flight_recorder != nullptr || hooks.order_router != nullptr ? stats::read_tsc() : 0;
+        read_perf_counters(hooks, counts_start);
+
+        const bool valid = order_book.process_event(events[i]);
+
+        read_perf_counters(hooks, counts_after_book);
+
+        if (valid) {
+            // If the order book deemed an event to be invalid, then we should probably
+            // ignore it in the trading engine too.
+            // 板がイベントを無効だと判断したら、取引処理エンジンには無視したほうがいいかもしれない。
+            trading_engine.on_event(events[i], order_book);
+        }
+
+        read_perf_counters(hooks, counts_after_engine);
+
+        // Only the book and the engine are timed, so the latency means the same with or without the
+        // extras below. Orders are timed separately, from tsc_start to the gateway.
+        // 板とエンジンだけを測るので、下の追加機能があってもなくてもレイテンシの意味は同じだ。注文は
+        // tsc_startからゲートウェイまで別に測る。
+        clock_end = std::chrono::steady_clock::now();
+        const std::uint64_t tsc_end = hooks.flight_recorder != nullptr ? stats::read_tsc() : 0;
+        record(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_end - clock_start).count());
+
+        if (hooks.bars != nullptr) {
+            hooks.bars->on_event(events[i]);
+        }
+
+        if (valid) {
+            if constexpr (requires { trading_engine.target_buy_price; trading_engine.target_sell_price; }) {
+                if (hooks.order_router != nullptr) {
+                    const std::uint32_t best_bid = order_book.get_best_bid();
+                    const std::uint32_t best_ask = order_book.get_best_ask();
+
+                    hooks.order_router->on_targets(
+                        trading_engine.target_buy_price,
+                        trading_engine.target_sell_price,
+                        (best_bid != 0 && best_ask != 0) ? (best_bid + best_ask) / 2 : 0,
+                        tsc_start
+                    );
+                }
+            }
+
+            if (hooks.level_channel != nullptr) {
+                hooks.level_channel->publish(
+                    events[i].price,
+                    order_book.get_total_order_size_for_price(events[i].price),
+                    order_book.get_last_modified_for_price(events[i].price)
+                );
+            }
+
+            if (hooks.shared_book != nullptr) {
+                hooks.shared_book->publish_event(events[i]);
+                hooks.shared_book->publish_level(
+                    events[i].price,
+                    order_book.get_total_order_size_for_price(events[i].price),
+                    order_book.get_last_modified_for_price(events[i].price)
+                );
+            }
+        }
+
+        if (hooks.flight_recorder != nullptr) {
+            hooks.flight_recorder->record(
+                events[i],
+                tsc_start,
+                tsc_end,
+                valid ? static_cast<std::uint32_t>(order_book.get_orders_for_price(events[i].price).size()) : 0,
+                static_cast<std::uint32_t>(events_found - i - 1 + event_buffer.size())
+            );
+        }
+
+        read_perf_counters(hooks, counts_end);
+
+        if constexpr (stats::perf_counters_enabled) {
+            if (hooks.perf_counters != nullptr) {
+                hooks.perf_counters->report.add(events[i].type, stats::Phase::Book, counts_start, counts_after_book);
+                hooks.perf_counters->report.add(events[i].type, stats::Phase::Engine, counts_after_book, counts_after_engine);
+                hooks.perf_counters->report.add(events[i].type, stats::Phase::Extras, counts_after_engine, counts_end);
+            }
+        }
+    }
+
+    if (hooks.order_router != nullptr) {
+        hooks.order_router->drain_acks();
+    }
+
+    if (events_found != 0 && (hooks.top_of_book != nullptr || hooks.shared_book != nullptr)) {
+        const std::uint32_t best_bid = order_book.get_best_bid();
+        const std::uint32_t best_ask = order_book.get_best_ask();
+        std::uint32_t target_buy_price = 0;
+        std::uint32_t target_sell_price = 0;
+
+        // Not every strategy quotes a single price.
+        // すべての戦略が一つの価格で気配を出すわけではない。
+        if constexpr (requires { trading_engine.target_buy_price; trading_engine.target_sell_price; }) {
+            target_buy_price = trading_engine.target_buy_price;
+            target_sell_price = trading_engine.target_sell_price;
+        }
+
+        const orderbook::TopOfBook top_of_book {
+            .best_bid = best_bid,
+            .best_ask = best_ask,
+            .mid_price = (best_bid != 0 && best_ask != 0) ? (best_bid + best_ask) / 2 : 0,
+            .target_buy_price = target_buy_price,
+            .target_sell_price = target_sell_price,
+            .time = events[events_found - 1].time
+        };
+
+        if (hooks.top_of_book != nullptr) {
+            hooks.top_of_book->store(top_of_book);
+        }
+
+        if (hooks.shared_book != nullptr) {
+            hooks.shared_book->store_top_of_book(top_of_book);
+        }
+    }
+}
+
+// Runs a simulated gateway until finished is set and every order it has taken has been acknowledged.
+// Set finished only once nothing more will be sent (see OrderRouter::wait_for_acks).
+// finishedが設定されて、取った注文が全部受け付けられるまで、シミュレートしたゲートウェイを動かす。もう何も
+// 送られなくなってからfinishedを設定して（OrderRouter::wait_for_acksを参照）。
+inline void order_gateway(gateway::SimulatedGateway& gateway, const std::atomic<bool>& finished) noexcept {
+    while (true) {
+        // Read this first, so any order sent before it was set is taken below.
+        // 設定される前に送られた注文が下で取られるように、これを先に読む。
+        const bool ending = finished.load(std::memory_order_acquire);
+
+        if (gateway.poll() == 0 && ending && gateway.is_idle()) {
+            return;
+        }
+    }
+}
+
+// Reads and processes events from the event buffer, stopping once performance_data is full. Engine
+// can be any strategy (or StrategySet) from tradingengine/strategy.hpp.
+// イベントバッファからのイベントを読み取って、処理する。performance_dataが一杯になったら止める。Engineは
+// tradingengine/strategy.hppのどの戦略（またはStrategySet）でもいい。
+template<size_t N, typename Engine = TradingEngine>
+    requires tradingengine::Strategy<Engine>
 void event_consumer(
     SPSCRingBuffer<Event, N>& event_buffer,
     OrderBook& order_book,
-    TradingEngine& trading_engine,
-    std::vector<unsigned int>& performance_data
+    Engine& trading_engine,
+    std::vector<unsigned int>& performance_data,
+    const ConsumerHooks hooks
 ) noexcept {
+    static_assert(N > orderbook::max_batch_size, "The event buffer must be bigger than a batch");
+
     std::size_t events_consumed = 0;
-    Event events[8];
+    const std::size_t events_expected = performance_data.size();
+    Event events[orderbook::max_batch_size];
     unsigned int events_found = 0;
-    std::chrono::steady_clock::time_point clock_start;
-    std::chrono::steady_clock::time_point clock_end;
-    unsigned int i = 0;
+
+    start_perf_counters(hooks);
 
     // Consume all the events. We'll stop when we've processed them all. In the real world,
     // this would keep going.
     // すべてのイベントを処理する。それから、止める。本当の世界では、これが続く。
-    while (events_consumed != 668765) {
-        events_found = event_buffer.pop_many(events, 8);
-
-        for (i = 0; i < events_found; ++i) {
-            // Logging on this hot path is probably not a good idea for performance.
-            // このホットパスでログするのは性能に悪いはずだ。
-            clock_start = std::chrono::steady_clock::now();
-
-            if (order_book.process_event(events[i])) {
-                // If the order book deemed an event to be invalid, then we should probably
-                // ignore it in the trading engine too.
-                // 板がイベントを無効だと判断したら、取引処理エンジンには無視したほうがいいかもしれない。
-                trading_engine.process_event(events[i]);
+    while (events_consumed != events_expected) {
+        // Take however many events are waiting (up to a full batch) rather than a fixed number, so
+        // batches grow when we fall behind and shrink back to one event when we're keeping up.
+        // 決まった数ではなく、待っているイベントを全部（バッチの最大まで）取るので、遅れたらバッチが大きくなって、
+        // 追いついたら一つのイベントまで小さくなる。
+        events_found = event_buffer.pop_many(events, orderbook::max_batch_size);
+
+        consume_batch(event_buffer, events, events_found, order_book, trading_engine, hooks, [&](const unsigned int nanoseconds) {
+            performance_data[events_consumed] = nanoseconds;
+            ++events_consumed;
+        });
+    }
+
+    stop_perf_counters(hooks);
+}
+
+// What stream_producer saw.
+// stream_producerが見たもの。
+struct StreamStats {
+    std::uint64_t events = 0;
+    std::uint64_t bytes = 0;
+    // Lines that couldn't be parsed.
+    // 解析できなかった行。
+    std::uint64_t bad_lines = 0;
+    // From being called to pushing the first event.
+    // 呼ばれてから最初のイベントを入れるまで。
+    std::chrono::nanoseconds time_to_first_event{0};
+    bool failed = false;
+};
+
+// Streams LOBSTER events from a file, pipe or stdin ("-") into the event buffer as they're parsed,
+// rather than loading everything first, and sets finished once they've all been pushed. .gz and
+// .zst files are decompressed on the fly. Memory use doesn't depend on the size of the input.
+// Throws if the input can't be opened.
+// 全部読み込んでからではなく、ファイル、パイプまたは標準入力（"-"）から、解析するたびにLOBSTERのイベントを
+// イベントバッファに入れて、全部入れたらfinishedを設定する。.gzと.zstのファイルはその場で解凍する。
+// メモリ使用量は入力のサイズによらない。入力が開けなかったら、投げる。
+template<size_t N>
+StreamStats stream_producer(const std::string& path, SPSCRingBuffer<Event, N>& event_buffer, std::atomic<bool>& finished) {
+    const auto clock_start = std::chrono::steady_clock::now();
+    StreamStats stats;
+    fileio::LobsterStreamParser parser;
+    fileio::BlockReader reader(path);
+
+    auto push = [&](const Event& event) {
+        while (!event_buffer.push(event)) {}
+
+        if (stats.events++ == 0) [[unlikely]] {
+            stats.time_to_first_event = std::chrono::steady_clock::now() - clock_start;
+        }
+    };
+
+    for (auto block = reader.next_block(); !block.empty(); block = reader.next_block()) {
+        stats.bytes += block.size();
+        parser.feed(block, push);
+    }
+
+    parser.finish(push);
+    stats.bad_lines = parser.get_bad_lines();
+    stats.failed = reader.has_failed();
+    finished.store(true, std::memory_order_release);
+
+    return stats;
+}
+
+// Calls receive, which returns how many datagrams it handled, until has_ended says the sender has
+// finished, or nothing has arrived for idle_timeout since the last datagram.
+// 送信者が終わったとhas_endedが言うか、最後のデータグラムからidle_timeoutの間何も来なくなるまで、処理した
+// データグラムの数を返すreceiveを呼ぶ。
+template<typename Receive, typename HasEnded>
+void receive_until_ended(Receive&& receive, HasEnded&& has_ended, const std::chrono::nanoseconds idle_timeout) noexcept {
+    std::chrono::steady_clock::time_point idle_since;
+    bool started = false;
+
+    while (!has_ended()) {
+        const unsigned int received = receive();
+
+        // Only look at the clock when there was nothing to do.
+        // することがなかったときだけ時計を見る。
+        if (received != 0) {
+            started = true;
+            idle_since = {};
+        } else if (started) {
+            const auto now = std::chrono::steady_clock::now();
+
+            if (idle_since == std::chrono::steady_clock::time_point{}) {
+                idle_since = now;
+            } else if (now - idle_since > idle_timeout) {
+                break;
             }
+        }
+    }
+}
 
-            clock_end = std::chrono::steady_clock::now();
-            performance_data[events_consumed] = 
-                std::chrono::duration_cast<std::chrono::nanoseconds>(clock_end - clock_start).count();
+// Receives sequenced ITCH datagrams and decodes them straight into the event buffer, until the
+// sender says it has finished or nothing has arrived for idle_timeout since the last datagram, and
+// then sets finished. Sequence gaps are counted in the handler's stats. Pair it with
+// stream_consumer.
+// シーケンス付きのITCHのデータグラムを受け取って、直接イベントバッファにデコードする。送信者が終わったと
+// 言うか、最後のデータグラムからidle_timeoutの間何も来なくなるまで続けて、それからfinishedを設定する。
+// シーケンスのギャップはハンドラーの統計で数える。stream_consumerと組み合わせる。
+template<size_t N>
+void feed_producer(
+    feed::UdpReceiver& receiver,
+    feed::FeedHandler& handler,
+    SPSCRingBuffer<Event, N>& event_buffer,
+    std::atomic<bool>& finished,
+    const std::chrono::nanoseconds idle_timeout
+) noexcept {
+    const auto push = [&](const Event& event) {
+        while (!event_buffer.push(event)) {}
+    };
 
-            ++events_consumed;
+    receive_until_ended([&] {
+        return receiver.receive([&](const std::span<const std::uint8_t> datagram) {
+            handler.on_packet(datagram, push);
+        });
+    }, [&] { return handler.has_ended(); }, idle_timeout);
+
+    finished.store(true, std::memory_order_release);
+}
+
+// Receives both lines of an A/B feed, taking turns, and pushes each line's messages, undecoded and
+// stamped with when they arrived, into its line buffer for feed_arbitrator. Runs until both senders
+// say they have finished or nothing has arrived on either line for idle_timeout, so one dead line
+// doesn't hold it up, and then sets lines_finished.
+// A/Bのフィードの両方の回線を交互に受け取って、各回線のメッセージをデコードせずに、届いた時を付けて、
+// feed_arbitratorのためのその回線のバッファに入れる。両方の送信者が終わったと言うか、どちらの回線にも
+// idle_timeoutの間何も来なくなるまで動くので、片方の回線が死んでも止まらない。それからlines_finishedを設定する。
+template<size_t LineN>
+void line_receiver(
+    feed::UdpReceiver& receiver_a,
+    feed::UdpReceiver& receiver_b,
+    feed::LineSplitter& splitter_a,
+    feed::LineSplitter& splitter_b,
+    SPSCRingBuffer<feed::Sequenced<feed::ItchMessage>, LineN>& line_a,
+    SPSCRingBuffer<feed::Sequenced<feed::ItchMessage>, LineN>& line_b,
+    std::atomic<bool>& lines_finished,
+    const std::chrono::nanoseconds idle_timeout
+) noexcept {
+    const auto receive = [&](feed::UdpReceiver& receiver, feed::LineSplitter& splitter,
+        SPSCRingBuffer<feed::Sequenced<feed::ItchMessage>, LineN>& line) {
+        return receiver.receive([&](const std::span<const std::uint8_t> datagram) {
+            splitter.on_packet(datagram, stats::read_tsc(), [&](const feed::Sequenced<feed::ItchMessage>& message) {
+                while (!line.push(message)) {}
+            });
+        });
+    };
+
+    receive_until_ended([&] {
+        return receive(receiver_a, splitter_a, line_a) + receive(receiver_b, splitter_b, line_b);
+    }, [&] { return splitter_a.has_ended() && splitter_b.has_ended(); }, idle_timeout);
+
+    lines_finished.store(true, std::memory_order_release);
+}
+
+// Takes sequenced messages from the A and B line buffers and decodes each sequence number once, in
+// order, into the event buffer, until lines_finished is set and both line buffers are empty, and
+// then sets finished. Pair it with line_receiver and stream_consumer.
+//
+// Whatever is waiting on both lines is merged by arrival time, so which line counts as first
+// doesn't depend on which buffer happened to be read first.
+// AとBの回線のバッファからシーケンス付きのメッセージを取って、各シーケンス番号を一回、順番にイベントバッファに
+// デコードする。lines_finishedが設定されて、両方の回線のバッファが空になるまで続けて、それからfinishedを
+// 設定する。line_receiverとstream_consumerと組み合わせる。
+//
+// 両方の回線で待っているものは届いた時間で合わせるので、どの回線が先と数えられるかは、たまたまどちらのバッファを
+// 先に読んだかによらない。
+template<size_t LineN, size_t N, std::size_t Window>
+void feed_arbitrator(
+    SPSCRingBuffer<feed::Sequenced<feed::ItchMessage>, LineN>& line_a,
+    SPSCRingBuffer<feed::Sequenced<feed::ItchMessage>, LineN>& line_b,
+    const std::atomic<bool>& lines_finished,
+    feed::FeedArbiter<feed::ItchMessage, Window>& arbiter,
+    fileio::ItchDecoder& decoder,
+    SPSCRingBuffer<Event, N>& event_buffer,
+    std::atomic<bool>& finished
+) noexcept {
+    static constexpr unsigned int batch_size = 32;
+    static_assert(LineN > batch_size, "The line buffers must be bigger than a batch");
+
+    feed::Sequenced<feed::ItchMessage> a[batch_size];
+    feed::Sequenced<feed::ItchMessage> b[batch_size];
+    unsigned int a_position = 0;
+    unsigned int a_size = 0;
+    unsigned int b_position = 0;
+    unsigned int b_size = 0;
+    const auto push = [&](const Event& event) {
+        while (!event_buffer.push(event)) {}
+    };
+    const auto release = [&](const feed::ItchMessage& message) {
+        decoder.decode_message(message.bytes.data(), message.length, push);
+    };
+
+    while (true) {
+        // Read this first, so anything pushed before it was set is seen below.
+        // 設定される前に入れられたものが下で見えるように、これを先に読む。
+        const bool ending = lines_finished.load(std::memory_order_acquire);
+
+        if (a_position == a_size) {
+            a_size = line_a.pop_many(a, batch_size);
+            a_position = 0;
+        }
+
+        if (b_position == b_size) {
+            b_size = line_b.pop_many(b, batch_size);
+            b_position = 0;
+        }
+
+        if (a_position == a_size && b_position == b_size && ending) {
+            break;
+        }
+
+        if (a_position == a_size) {
+            // Line A has nothing waiting, so whatever B has arrived first.
+            // 回線Aに待っているものがないので、Bが持っているものが先に届いた。
+            while (b_position != b_size) {
+                arbiter.on_message(feed::Line::B, b[b_position++], release);
+            }
+        } else if (b_position == b_size) {
+            while (a_position != a_size) {
+                arbiter.on_message(feed::Line::A, a[a_position++], release);
+            }
+        } else {
+            // Merge until one runs out, then refill it before going on.
+            // 片方がなくなるまで合わせて、続ける前にそれを補充する。
+            while (a_position != a_size && b_position != b_size) {
+                if (a[a_position].arrival_tsc <= b[b_position].arrival_tsc) {
+                    arbiter.on_message(feed::Line::A, a[a_position++], release);
+                } else {
+                    arbiter.on_message(feed::Line::B, b[b_position++], release);
+                }
+            }
         }
-    }    
+    }
+
+    arbiter.flush(release);
+    finished.store(true, std::memory_order_release);
+}
+
+// Like event_consumer, but for a stream of unknown length: runs until finished is set and the event
+// buffer is empty, and records latencies in a fixed-size histogram instead of one entry per event.
+// event_consumerと同じだが、長さが分からないストリームのため。finishedが設定されて、イベントバッファが空に
+// なるまで動いて、イベントごとに一つのエントリではなく、固定サイズのヒストグラムにレイテンシを記録する。
+template<size_t N, typename Engine = TradingEngine>
+    requires tradingengine::Strategy<Engine>
+void stream_consumer(
+    SPSCRingBuffer<Event, N>& event_buffer,
+    OrderBook& order_book,
+    Engine& trading_engine,
+    stats::LatencyHistogram& latency,
+    const std::atomic<bool>& finished,
+    const ConsumerHooks hooks
+) noexcept {
+    static_assert(N > orderbook::max_batch_size, "The event buffer must be bigger than a batch");
+
+    Event events[orderbook::max_batch_size];
+
+    start_perf_counters(hooks);
+
+    while (true) {
+        unsigned int events_found = event_buffer.pop_many(events, orderbook::max_batch_size);
+
+        if (events_found == 0 && finished.load(std::memory_order_acquire)) {
+            // The producer pushes everything before setting finished, so if the buffer is still
+            // empty after seeing it, we're done.
+            // 生産者はfinishedを設定する前に全部入れるので、それを見てもバッファが空なら、終わりだ。
+            events_found = event_buffer.pop_many(events, orderbook::max_batch_size);
+
+            if (events_found == 0) {
+                stop_perf_counters(hooks);
+
+                return;
+            }
+        }
+
+        consume_batch(event_buffer, events, events_found, order_book, trading_engine, hooks, [&](const unsigned int nanoseconds) {
+            latency.record(nanoseconds);
+        });
+    }
 }
 
 }
\ No newline at end of file
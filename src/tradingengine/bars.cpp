@@ -0,0 +1,45 @@
+#include "bars.hpp"
+
+namespace nanofill::tradingengine {
+
+void print_bars(std::ostream& out, const std::span<const Bar> bars, const BarKind kind, const std::uint32_t interval, const std::size_t last) {
+    std::size_t second_bars = 0;
+    std::size_t minute_bars = 0;
+    std::size_t volume_bars = 0;
+
+    for (const Bar& bar : bars) {
+        second_bars += bar.kind == BarKind::Time && bar.interval == 1;
+        minute_bars += bar.kind == BarKind::Time && bar.interval == 60;
+        volume_bars += bar.kind == BarKind::Volume;
+    }
+
+    out << "1 second bars: " << second_bars << '\n'
+        << "1 minute bars: " << minute_bars << '\n'
+        << "Volume bars: " << volume_bars << '\n';
+
+    std::size_t skipped = 0;
+    std::size_t matching = 0;
+
+    for (const Bar& bar : bars) {
+        matching += bar.kind == kind && bar.interval == interval;
+    }
+
+    for (const Bar& bar : bars) {
+        if (bar.kind != kind || bar.interval != interval || skipped++ + last < matching) {
+            continue;
+        }
+
+        out << "time=" << bar.start_time << "-" << bar.end_time
+            << " open=" << bar.open
+            << " high=" << bar.high
+            << " low=" << bar.low
+            << " close=" << bar.close
+            << " vwap=" << bar.vwap
+            << " volume=" << bar.volume
+            << " executions=" << bar.executions << '\n';
+    }
+
+    out.flush();
+}
+
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include "events/event.hpp"
+#include "concurrency/spscringbuffer.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <ostream>
+#include <span>
+
+namespace nanofill::tradingengine {
+
+using events::Event;
+using events::EventType;
+
+enum class BarKind : std::uint8_t {
+    // A fixed number of seconds.
+    // 決まった秒数。
+    Time = 1,
+    // A fixed number of shares traded.
+    // 決まった取引株数。
+    Volume = 2
+};
+
+// One finished bar. Prices are dollars times 10,000.
+// 一つの終わったバー。価格は10,000倍したドル。
+struct alignas(64) Bar {
+    BarKind kind;
+    // Seconds for time bars, shares for volume bars.
+    // 時間のバーなら秒、出来高のバーなら株。
+    std::uint32_t interval;
+    // For time bars, the start of the interval. For volume bars, the time of the first execution.
+    // 時間のバーなら区間の始まり。出来高のバーなら最初の約定の時。
+    std::uint32_t start_time;
+    // The time of the last execution.
+    // 最後の約定の時。
+    std::uint32_t end_time;
+    std::uint32_t open;
+    std::uint32_t high;
+    std::uint32_t low;
+    std::uint32_t close;
+    // Volume-weighted average price.
+    // 出来高加重平均価格。
+    std::uint32_t vwap;
+    std::uint32_t executions;
+    std::uint64_t volume;
+    // Price times shares, summed.
+    // 価格掛ける株の合計。
+    std::uint64_t notional;
+};
+
+static_assert(sizeof(Bar) == 64, "A bar should be one cache line");
+
+constexpr std::size_t bar_ring_size = 1024;
+using BarRing = concurrency::SPSCRingBuffer<Bar, bar_ring_size>;
+
+// Builds one kind of bar from executions. Rolling over is the same few stores whatever happened in
+// the bar: the finished bar is handed to publish and the next one starts from the execution that
+// didn't fit. Time bars with no executions are skipped rather than published empty, so a long quiet
+// spell doesn't mean a burst of work, and a volume bar closes on the execution that takes it to at
+// least interval shares (that execution isn't split, so bars can run a little over).
+// 約定から一種類のバーを作る。繰り越しはバーで何が起きても同じ少しの格納だ。終わったバーをpublishに渡して、
+// 収まらなかった約定から次のものを始める。約定がない時間のバーは空で出さずに飛ばすので、長い静かな時間が仕事の
+// 集中にならなくて、出来高のバーは少なくともinterval株にする約定で閉じる（その約定は分けないので、バーは少し
+// 超えることがある）。
+class BarBuilder {
+    Bar current{};
+    bool building = false;
+
+    [[gnu::always_inline]]
+    void start(const std::uint32_t price, const std::uint32_t time) noexcept {
+        current.start_time = current.kind == BarKind::Time ? time / current.interval * current.interval : time;
+        current.open = price;
+        current.high = price;
+        current.low = price;
+        current.executions = 0;
+        current.volume = 0;
+        current.notional = 0;
+        building = true;
+    }
+
+    template<typename Publish>
+    [[gnu::always_inline]]
+    void finish(Publish& publish) noexcept {
+        current.vwap = static_cast<std::uint32_t>(current.notional / current.volume);
+        publish(current);
+        building = false;
+    }
+
+public:
+    BarBuilder(const BarKind kind, const std::uint32_t interval) noexcept {
+        current.kind = kind;
+        current.interval = interval;
+    }
+
+    // Add an execution of shares at price, calling publish with any bar that finishes.
+    // priceでsharesの約定を足して、終わったバーでpublishを呼ぶ。
+    template<typename Publish>
+    [[gnu::always_inline]]
+    void on_execution(const std::uint32_t price, const std::uint32_t shares, const std::uint32_t time, Publish&& publish) noexcept {
+        if (shares == 0) [[unlikely]] {
+            return;
+        }
+
+        if (building && current.kind == BarKind::Time && time >= current.start_time + current.interval) {
+            finish(publish);
+        }
+
+        if (!building) {
+            start(price, time);
+        }
+
+        current.end_time = time;
+        current.high = std::max(current.high, price);
+        current.low = std::min(current.low, price);
+        current.close = price;
+        current.executions += 1;
+        current.volume += shares;
+        current.notional += static_cast<std::uint64_t>(price) * shares;
+
+        if (current.kind == BarKind::Volume && current.volume >= current.interval) {
+            finish(publish);
+        }
+    }
+
+    // Publish the bar being built, if there is one, e.g. at the end of the data.
+    // 作っているバーがあれば出す。例えば、データの終わりで。
+    template<typename Publish>
+    void flush(Publish&& publish) noexcept {
+        if (building) {
+            finish(publish);
+        }
+    }
+};
+
+// Builds 1 second, 1 minute and volume bars from every visible and hidden execution, and pushes each
+// finished bar onto a ring for another thread to read. Nothing is allocated and nothing waits: if
+// the ring is full the bar is dropped and counted. Give it every event, including the ones the book
+// didn't action, since hidden executions never reach the book.
+// 全ての見える約定と見えない約定から、1秒、1分と出来高のバーを作って、終わった各バーを他のスレッドが読むための
+// リングに入れる。何も割り当てなくて、何も待たない。リングが一杯なら、バーを捨てて数える。板が処理しなかった
+// ものも含めて全てのイベントを渡して。見えない約定は板に届かないから。
+class BarAggregator {
+    BarRing& output;
+    BarBuilder second_bars{BarKind::Time, 1};
+    BarBuilder minute_bars{BarKind::Time, 60};
+    BarBuilder volume_bars;
+    std::uint64_t dropped = 0;
+
+    [[gnu::always_inline]]
+    void publish(const Bar& bar) noexcept {
+        dropped += !output.push(bar);
+    }
+
+public:
+    BarAggregator(BarRing& output, const std::uint32_t shares_per_volume_bar = 10000) noexcept
+        : output(output), volume_bars(BarKind::Volume, shares_per_volume_bar) {}
+
+    [[gnu::always_inline]]
+    void on_event(const Event event) noexcept {
+        if (event.type != EventType::ExecutionVisible && event.type != EventType::ExecutionHidden) {
+            return;
+        }
+
+        const std::uint32_t shares = std::abs(event.size);
+        const auto push = [this](const Bar& bar) { publish(bar); };
+
+        second_bars.on_execution(event.price, shares, event.time, push);
+        minute_bars.on_execution(event.price, shares, event.time, push);
+        volume_bars.on_execution(event.price, shares, event.time, push);
+    }
+
+    // Publish the bars still being built. Only call this from the thread that gives it events, or
+    // once that thread has finished.
+    // まだ作っているバーを出す。イベントを渡すスレッドからか、そのスレッドが終わった後にしか呼ばないで。
+    void flush() noexcept {
+        const auto push = [this](const Bar& bar) { publish(bar); };
+
+        second_bars.flush(push);
+        minute_bars.flush(push);
+        volume_bars.flush(push);
+    }
+
+    // Bars that didn't fit in the ring.
+    // リングに収まらなかったバー。
+    std::uint64_t get_dropped() const noexcept {
+        return dropped;
+    }
+};
+
+// How many bars of each kind there were, and the last few of the given kind and interval.
+// 各種類のバーがいくつあったかと、与えられた種類と区間の最後のいくつか。
+void print_bars(std::ostream& out, std::span<const Bar> bars, BarKind kind, std::uint32_t interval, std::size_t last);
+
+}
@@ -0,0 +1,280 @@
+#pragma once
+
+#include "events/event.hpp"
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <string_view>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace nanofill::tradingengine {
+
+using events::Event;
+
+// What BookFeatures keeps up to date. Prices are dollars times 10,000, and anything that needs both
+// sides of the book is 0 while either side is empty.
+// BookFeaturesが最新に保つもの。価格は10,000倍したドルで、板の両側が必要なものはどちらかの側が空の間は0。
+struct BookFeatureValues {
+    // Shares on the top levels of each side.
+    // 各側の上位のレベルの株。
+    float bid_depth = 0;
+    float ask_depth = 0;
+    // (bid depth - ask depth) / (bid depth + ask depth), from -1 (all asks) to 1 (all bids).
+    // (買いの厚み - 売りの厚み) / (買いの厚み + 売りの厚み)。-1（全部売り）から1（全部買い）まで。
+    float imbalance = 0;
+    // The best bid and ask weighted by the size on the opposite side, so it leans towards the side
+    // that's about to run out.
+    // 反対側のサイズで重み付けした最良買い気配値と最良売り気配値なので、なくなりそうな側に寄る。
+    float microprice = 0;
+    // Like the microprice, but with each side's volume-weighted price over all the top levels
+    // instead of just the best one.
+    // マイクロプライスと同じだが、最良のものだけではなく、上位のレベル全部での各側の出来高加重価格を使う。
+    float weighted_mid = 0;
+    // Order flow imbalance (Cont, Kukanov and Stoikov) summed over the last FlowWindow events:
+    // shares joining the best bid or leaving the best ask count up, and the opposite counts down.
+    // 最後のFlowWindow個のイベントで合計した注文フローの不均衡（Cont、KukanovとStoikov）。最良買いに加わる
+    // 株と最良売りから出る株は上に数えて、その逆は下に数える。
+    std::int64_t order_flow_imbalance = 0;
+};
+
+// Keeps the top Depth levels of each side in contiguous arrays and the features above up to date
+// as the book changes, so a strategy can read them for the price of a load. Pass it every event the
+// book actioned, after the book has applied it (it's a Strategy, so it can sit in a StrategySet).
+//
+// Most events only change the size of one level that's already in the arrays, which is found with
+// one vector compare and updated in place. Only when a level appears or disappears within the top
+// Depth, or the best price moves, is that side rebuilt from the book. The features are then
+// recomputed from the arrays with AVX2 (eight levels per instruction), which is cheaper than
+// keeping running float sums that would drift.
+// 各側の上位Depth個のレベルを連続した配列に持って、板が変わるたびに上の特徴量を最新に保つので、戦略は一回の
+// ロードの値段で読める。板が処理した全てのイベントを、板が適用した後に渡して（Strategyなので、StrategySetに
+// 入れられる）。
+//
+// ほとんどのイベントはもう配列にある一つのレベルのサイズしか変えないので、それを一回のベクトル比較で見つけて、
+// その場で更新する。上位Depth個の中でレベルが現れたり消えたりするか、最良の価格が動いたときだけ、その側を板から
+// 作り直す。それから特徴量を配列からAVX2で（一命令で8レベル）計算し直す。ずれていく浮動小数点の累計を持つより
+// 安い。
+template<std::size_t Depth = 8, std::size_t FlowWindow = 64>
+class BookFeatures {
+    static_assert(Depth % 8 == 0, "Depth must be a multiple of 8");
+    static_assert(std::has_single_bit(FlowWindow), "FlowWindow must be a power of 2");
+
+    // One side's top levels, best first. Unused slots have a price and size of 0.
+    // 一つの側の上位のレベル。最良が最初。使っていないスロットの価格とサイズは0。
+    struct alignas(32) Levels {
+        std::array<float, Depth> prices{};
+        std::array<float, Depth> sizes{};
+        std::size_t count = 0;
+    };
+
+    Levels bids;
+    Levels asks;
+    std::uint32_t best_bid = 0;
+    std::uint32_t best_ask = 0;
+    std::uint32_t best_bid_size = 0;
+    std::uint32_t best_ask_size = 0;
+    std::array<std::int64_t, FlowWindow> flows{};
+    std::size_t flow_position = 0;
+    BookFeatureValues values;
+
+    // The slot holding price, or Depth if it isn't there.
+    // priceを持っているスロット。なければ、Depth。
+    [[gnu::always_inline]]
+    static std::size_t find_level(const Levels& levels, const std::uint32_t price) noexcept {
+#ifdef __AVX2__
+        const __m256 target = _mm256_set1_ps(static_cast<float>(price));
+
+        for (std::size_t i = 0; i < Depth; i += 8) {
+            const int matches = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_load_ps(&levels.prices[i]), target, _CMP_EQ_OQ));
+
+            if (matches != 0) {
+                return i + std::countr_zero(static_cast<unsigned int>(matches));
+            }
+        }
+#else
+        for (std::size_t i = 0; i < Depth; ++i) {
+            if (levels.prices[i] == static_cast<float>(price)) {
+                return i;
+            }
+        }
+#endif
+
+        return Depth;
+    }
+
+    // Fill a side from the book, jumping from each level straight to the next one with orders on
+    // that side with the book's level bitmaps, so empty prices in between cost nothing.
+    // 板から側を埋める。板のレベルのビットマップで各レベルからその側の注文がある次のレベルに直接飛ぶので、
+    // 間の空の価格はコストがかからない。
+    template<typename Book, bool Bids>
+    [[gnu::noinline]]
+    void rebuild(const Book& book, Levels& levels, const std::uint32_t best) noexcept {
+        levels = {};
+
+        for (std::uint32_t price = best; price != 0 && levels.count < Depth; price = Bids ? book.get_next_bid(price) : book.get_next_ask(price)) {
+            levels.prices[levels.count] = static_cast<float>(price);
+            levels.sizes[levels.count] = static_cast<float>(Bids ? book.get_buy_size_for_price(price) : book.get_sell_size_for_price(price));
+            ++levels.count;
+        }
+    }
+
+    // A level at price on one side changed to size. Returns whether the side needs rebuilding.
+    // 一つの側のpriceのレベルがsizeに変わった。側を作り直す必要があるかを返す。
+    [[gnu::always_inline]]
+    static bool update_level(Levels& levels, const std::uint32_t price, const std::uint32_t size) noexcept {
+        const std::size_t slot = find_level(levels, price);
+
+        if (slot == Depth || size == 0) [[unlikely]] {
+            // A new level inside the top Depth, or one of them emptied.
+            // 上位Depth個の中の新しいレベル、またはその一つが空になった。
+            return true;
+        }
+
+        levels.sizes[slot] = static_cast<float>(size);
+
+        return false;
+    }
+
+    // Recompute everything from the arrays.
+    // 配列から全部計算し直す。
+    [[gnu::always_inline]]
+    void recompute() noexcept {
+        float bid_depth;
+        float ask_depth;
+        float bid_notional;
+        float ask_notional;
+
+#ifdef __AVX2__
+        __m256 bid_sizes = _mm256_setzero_ps();
+        __m256 ask_sizes = _mm256_setzero_ps();
+        __m256 bid_values = _mm256_setzero_ps();
+        __m256 ask_values = _mm256_setzero_ps();
+
+        for (std::size_t i = 0; i < Depth; i += 8) {
+            const __m256 bid_size = _mm256_load_ps(&bids.sizes[i]);
+            const __m256 ask_size = _mm256_load_ps(&asks.sizes[i]);
+
+            bid_sizes = _mm256_add_ps(bid_sizes, bid_size);
+            ask_sizes = _mm256_add_ps(ask_sizes, ask_size);
+            bid_values = _mm256_add_ps(bid_values, _mm256_mul_ps(_mm256_load_ps(&bids.prices[i]), bid_size));
+            ask_values = _mm256_add_ps(ask_values, _mm256_mul_ps(_mm256_load_ps(&asks.prices[i]), ask_size));
+        }
+
+        // Add the eight lanes of all four sums at once: two rounds of horizontal adds leave each
+        // 128-bit half holding its four sums, and then the halves are added together.
+        // 四つの合計の8レーンを一度に足す。二回の水平加算で各128ビットの半分に四つの合計が残って、それから半分
+        // 同士を足す。
+        const __m256 pairs = _mm256_hadd_ps(_mm256_hadd_ps(bid_sizes, ask_sizes), _mm256_hadd_ps(bid_values, ask_values));
+        const __m128 sums = _mm_add_ps(_mm256_castps256_ps128(pairs), _mm256_extractf128_ps(pairs, 1));
+        alignas(16) float totals[4];
+        _mm_store_ps(totals, sums);
+
+        bid_depth = totals[0];
+        ask_depth = totals[1];
+        bid_notional = totals[2];
+        ask_notional = totals[3];
+#else
+        bid_depth = 0;
+        ask_depth = 0;
+        bid_notional = 0;
+        ask_notional = 0;
+
+        for (std::size_t i = 0; i < Depth; ++i) {
+            bid_depth += bids.sizes[i];
+            ask_depth += asks.sizes[i];
+            bid_notional += bids.prices[i] * bids.sizes[i];
+            ask_notional += asks.prices[i] * asks.sizes[i];
+        }
+#endif
+
+        const float total_depth = bid_depth + ask_depth;
+        const bool two_sided = bid_depth > 0 && ask_depth > 0;
+
+        values.bid_depth = bid_depth;
+        values.ask_depth = ask_depth;
+        values.imbalance = total_depth > 0 ? (bid_depth - ask_depth) / total_depth : 0;
+        values.microprice = two_sided
+            ? (bids.prices[0] * asks.sizes[0] + asks.prices[0] * bids.sizes[0]) / (bids.sizes[0] + asks.sizes[0])
+            : 0;
+        // Each side's average price weighted by the other side's depth: bid VWAP * ask depth is
+        // bid notional * ask depth / bid depth.
+        // 各側の平均価格を反対側の厚みで重み付けする。買いのVWAP * 売りの厚みは、買いの金額 * 売りの厚み /
+        // 買いの厚み。
+        values.weighted_mid = two_sided
+            ? (bid_notional * (ask_depth / bid_depth) + ask_notional * (bid_depth / ask_depth)) / total_depth
+            : 0;
+    }
+
+public:
+    static constexpr std::string_view name = "book_features";
+
+    template<typename Book>
+    [[gnu::always_inline]]
+    void on_event(const Event event, const Book& book) noexcept {
+        static_assert(Book::price_of(Book::levels - 1) < (1U << 24), "Prices must fit in a float exactly");
+
+        const std::uint32_t bid = book.get_best_bid();
+        const std::uint32_t ask = book.get_best_ask();
+        const std::uint32_t price = event.price;
+        bool changed = true;
+
+        if (bid != best_bid) {
+            rebuild<Book, true>(book, bids, bid);
+        } else if (bid != 0 && price <= bid && (bids.count < Depth || static_cast<float>(price) >= bids.prices[Depth - 1])) {
+            if (update_level(bids, price, book.get_buy_size_for_price(price))) {
+                rebuild<Book, true>(book, bids, bid);
+            }
+        } else {
+            changed = false;
+        }
+
+        if (ask != best_ask) {
+            rebuild<Book, false>(book, asks, ask);
+            changed = true;
+        } else if (ask != 0 && price >= ask && (asks.count < Depth || static_cast<float>(price) <= asks.prices[Depth - 1])) {
+            if (update_level(asks, price, book.get_sell_size_for_price(price))) {
+                rebuild<Book, false>(book, asks, ask);
+            }
+
+            changed = true;
+        }
+
+        // This event's order flow, from how the best levels moved. Every term is worked out and
+        // masked, rather than branched on.
+        // 最良のレベルがどう動いたかからのこのイベントの注文フロー。全ての項を計算してマスクする。分岐しない。
+        // An empty ask side is 0, but it's really the highest ask there could be, so subtracting
+        // one (and wrapping) puts it there.
+        // 空の売り側は0だが、本当はありうる一番高い売り気配なので、一を引けば（折り返して）そこに行く。
+        const std::uint32_t bid_size = bid != 0 ? book.get_buy_size_for_price(bid) : 0;
+        const std::uint32_t ask_size = ask != 0 ? book.get_sell_size_for_price(ask) : 0;
+        const std::uint32_t ask_rank = ask - 1;
+        const std::uint32_t previous_ask_rank = best_ask - 1;
+        const std::int64_t flow =
+            static_cast<std::int64_t>(bid >= best_bid) * bid_size
+            - static_cast<std::int64_t>(bid <= best_bid) * best_bid_size
+            - static_cast<std::int64_t>(ask_rank <= previous_ask_rank) * ask_size
+            + static_cast<std::int64_t>(ask_rank >= previous_ask_rank) * best_ask_size;
+
+        values.order_flow_imbalance += flow - flows[flow_position];
+        flows[flow_position] = flow;
+        flow_position = (flow_position + 1) & (FlowWindow - 1);
+
+        best_bid = bid;
+        best_ask = ask;
+        best_bid_size = bid_size;
+        best_ask_size = ask_size;
+
+        if (changed) {
+            recompute();
+        }
+    }
+
+    const BookFeatureValues& get() const noexcept {
+        return values;
+    }
+};
+
+}
@@ -0,0 +1,111 @@
+#include "parametersweep.hpp"
+#include "orderbook/orderbook.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <memory>
+#include <thread>
+
+namespace nanofill::tradingengine {
+
+ParameterSweep::ParameterSweep(std::span<const SweepParameters> parameters)
+    : price_spreads(parameters.size()),
+      quote_sizes(parameters.size()),
+      target_buy_prices(parameters.size()),
+      target_sell_prices(parameters.size()),
+      fills(parameters.size()),
+      positions(parameters.size()),
+      cash(parameters.size()) {
+    for (std::size_t i = 0; i < parameters.size(); ++i) {
+        price_spreads[i] = parameters[i].price_spread;
+        quote_sizes[i] = parameters[i].quote_size;
+    }
+
+    update_targets();
+}
+
+std::vector<SweepResult> ParameterSweep::get_results() const {
+    std::vector<SweepResult> results(price_spreads.size());
+
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        results[i] = SweepResult {
+            .parameters = { .price_spread = price_spreads[i], .quote_size = quote_sizes[i] },
+            .fills = fills[i],
+            .position = positions[i],
+            .cash = cash[i],
+            .profit = cash[i] + positions[i] * static_cast<std::int64_t>(last_execution_price)
+        };
+    }
+
+    return results;
+}
+
+std::vector<Event> filter_actioned_events(std::span<const Event> events) {
+    auto order_book = std::make_unique<orderbook::OrderBook>();
+    std::vector<Event> actioned;
+    actioned.reserve(events.size());
+
+    for (const Event& event : events) {
+        if (order_book->process_event(event)) {
+            actioned.push_back(event);
+        }
+    }
+
+    return actioned;
+}
+
+std::vector<SweepResult> run_parameter_sweep(
+    std::span<const Event> events,
+    std::span<const SweepParameters> parameters,
+    unsigned int thread_count
+) {
+    thread_count = std::clamp<std::size_t>(thread_count, 1, std::max<std::size_t>(parameters.size(), 1));
+
+    std::vector<std::vector<SweepResult>> slice_results(thread_count);
+    std::vector<std::thread> threads;
+    const std::size_t slice_size = (parameters.size() + thread_count - 1) / thread_count;
+
+    for (unsigned int i = 0; i < thread_count; ++i) {
+        const std::size_t begin = std::min(parameters.size(), i * slice_size);
+        const std::size_t end = std::min(parameters.size(), begin + slice_size);
+
+        threads.emplace_back([&, i, begin, end] {
+            // Each thread builds its own sweep so that its arrays are local to it.
+            // 配列がスレッドのローカルになるように、各スレッドが独自のスイープを作る。
+            ParameterSweep sweep(parameters.subspan(begin, end - begin));
+            sweep.process_events(events);
+            slice_results[i] = sweep.get_results();
+        });
+    }
+
+    std::vector<SweepResult> results;
+    results.reserve(parameters.size());
+
+    for (unsigned int i = 0; i < thread_count; ++i) {
+        threads[i].join();
+        results.insert(results.end(), slice_results[i].begin(), slice_results[i].end());
+    }
+
+    return results;
+}
+
+void print_sweep_results(std::ostream& out, std::vector<SweepResult> results, const std::size_t max_rows) {
+    std::stable_sort(results.begin(), results.end(), [](const SweepResult& a, const SweepResult& b) {
+        return a.profit > b.profit;
+    });
+
+    out << std::setw(12) << "spread" << std::setw(12) << "quote size" << std::setw(10) << "fills"
+        << std::setw(12) << "position" << std::setw(16) << "cash ($)" << std::setw(16) << "profit ($)" << '\n';
+
+    for (std::size_t i = 0; i < results.size() && i < max_rows; ++i) {
+        const SweepResult& result = results[i];
+
+        out << std::setw(12) << result.parameters.price_spread
+            << std::setw(12) << result.parameters.quote_size
+            << std::setw(10) << result.fills
+            << std::setw(12) << result.position
+            << std::setw(16) << std::fixed << std::setprecision(2) << result.cash / 10000.0
+            << std::setw(16) << result.profit / 10000.0 << '\n';
+    }
+}
+
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "events/event.hpp"
+#include "tradingengine.hpp"
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <vector>
+
+// Runs lots of parameterisations of the trading engine over the same events at once, to find out
+// which would have done best. Every parameterisation sees the same average price (it doesn't depend
+// on the parameters), so that is only worked out once per event, and what does differ is kept as
+// a struct of arrays and updated for every parameterisation in one vectorised loop.
+// 同じイベントで取引処理エンジンの多くのパラメータ設定を同時に動かして、どれが一番良かったかを調べる。各
+// パラメータ設定が見る平均価格は同じ（パラメータによらない）なので、イベントごとに一回しか計算しなくて、違う
+// ものは配列の構造体として持って、一つのベクトル化されたループで全パラメータ設定を更新する。
+namespace nanofill::tradingengine {
+
+using events::Event;
+
+// One parameterisation of the engine.
+// エンジンの一つのパラメータ設定。
+struct SweepParameters {
+    // See TradingEngine.
+    // TradingEngineを参照。
+    std::uint32_t price_spread;
+    // The most shares we buy or sell in one fill.
+    // 一回の約定で売買する株の最大数。
+    std::uint32_t quote_size;
+};
+
+// How one parameterisation did.
+// 一つのパラメータ設定の成績。
+struct SweepResult {
+    SweepParameters parameters;
+    std::uint32_t fills;
+    // Shares held. Negative means short.
+    // 持っている株の数。ネガティブなら、空売り。
+    std::int64_t position;
+    // Cash in 10,000ths of a dollar.
+    // 10,000倍したドルの現金。
+    std::int64_t cash;
+    // Cash plus the position valued at the last execution price.
+    // 現金と、最後の約定価格で評価したポジション。
+    std::int64_t profit;
+};
+
+// A simple fill model: we quote at each parameterisation's target prices, and whenever an order
+// on the book executes at a price our quote matches or beats, we assume we'd have been filled at
+// our price instead. Only feed this events that the order book actioned, in order.
+// 簡単な約定モデル。各パラメータ設定の目標価格で気配を出して、自分の気配と同じかより悪い価格で板の注文が
+// 約定したら、代わりに自分が自分の価格で約定したとみなす。板が処理したイベントだけを、順番に入れて。
+class ParameterSweep {
+    // Only used for the shared average price.
+    // 共有の平均価格にしか使わない。
+    TradingEngine engine{0};
+    std::uint32_t last_execution_price = 0;
+
+    std::vector<std::uint32_t> price_spreads;
+    std::vector<std::uint32_t> quote_sizes;
+    std::vector<std::uint32_t> target_buy_prices;
+    std::vector<std::uint32_t> target_sell_prices;
+    std::vector<std::uint32_t> fills;
+    std::vector<std::int64_t> positions;
+    std::vector<std::int64_t> cash;
+
+    // Fill every parameterisation whose quote the execution would have reached. Branch free, so
+    // the compiler turns this into SIMD.
+    // 約定が届いた気配を出している各パラメータ設定を約定させる。分岐がないので、コンパイラがSIMDにする。
+    [[gnu::always_inline]]
+    void fill(const Event event) noexcept {
+        const std::size_t count = price_spreads.size();
+        const std::uint32_t price = event.price;
+        const std::uint32_t executed = event.size < 0 ? -event.size : event.size;
+        const std::uint32_t* __restrict quote_size = quote_sizes.data();
+        const std::uint32_t* __restrict target_buy = target_buy_prices.data();
+        const std::uint32_t* __restrict target_sell = target_sell_prices.data();
+        std::uint32_t* __restrict fill_count = fills.data();
+        std::int64_t* __restrict position = positions.data();
+        std::int64_t* __restrict balance = cash.data();
+
+        if (event.size > 0) {
+            // A resting buy was hit, so someone sold at this price. Our bid fills (at our price) if
+            // it's as high.
+            // 買い注文が約定したので、誰かがこの価格で売った。自分の買い気配が同じ以上なら、（自分の価格で）
+            // 約定する。
+            for (std::size_t i = 0; i < count; ++i) {
+                const std::uint32_t size = target_buy[i] >= price ? (quote_size[i] < executed ? quote_size[i] : executed) : 0;
+
+                fill_count[i] += size != 0;
+                position[i] += size;
+                balance[i] -= static_cast<std::int64_t>(target_buy[i]) * size;
+            }
+        } else {
+            // A resting sell was lifted. Our ask fills if it's as low.
+            // 売り注文が約定した。自分の売り気配が同じ以下なら約定する。
+            for (std::size_t i = 0; i < count; ++i) {
+                const std::uint32_t size = target_sell[i] <= price ? (quote_size[i] < executed ? quote_size[i] : executed) : 0;
+
+                fill_count[i] += size != 0;
+                position[i] -= size;
+                balance[i] += static_cast<std::int64_t>(target_sell[i]) * size;
+            }
+        }
+    }
+
+    // Move every parameterisation's quotes to the new average price.
+    // 各パラメータ設定の気配を新しい平均価格に移す。
+    [[gnu::always_inline]]
+    void update_targets() noexcept {
+        const std::size_t count = price_spreads.size();
+        const std::uint32_t average = engine.average_share_price;
+        const std::uint32_t* __restrict spread = price_spreads.data();
+        std::uint32_t* __restrict target_buy = target_buy_prices.data();
+        std::uint32_t* __restrict target_sell = target_sell_prices.data();
+
+        for (std::size_t i = 0; i < count; ++i) {
+            // Same as TradingEngine::update_position.
+            // TradingEngine::update_positionと同じ。
+            target_buy[i] = spread[i] > average ? 0 : average - spread[i];
+            target_sell[i] = average + spread[i];
+        }
+    }
+
+public:
+    explicit ParameterSweep(std::span<const SweepParameters> parameters);
+
+    [[gnu::always_inline]]
+    void process_event(const Event event) noexcept {
+        // Hidden executions never get here: the order book doesn't action them, so neither does the
+        // engine in event_consumer.
+        // 隠れた約定はここに来ない。注文板が処理しないので、event_consumerのエンジンも処理しない。
+        const bool execution = event.type == events::EventType::ExecutionVisible;
+
+        // Nobody quotes until there's an average price to quote around.
+        // 基準になる平均価格があるまで、誰も気配を出さない。
+        if (execution && engine.average_share_price != 0) {
+            fill(event);
+        }
+
+        if (execution) {
+            last_execution_price = event.price;
+        }
+
+        engine.process_event(event);
+        update_targets();
+    }
+
+    void process_events(std::span<const Event> events) noexcept {
+        for (const Event& event : events) {
+            process_event(event);
+        }
+    }
+
+    std::vector<SweepResult> get_results() const;
+};
+
+// Only keep the events the order book actions, so that the sweep (and anything else replaying the
+// same stream) sees exactly what the engine would in event_consumer.
+// 注文板が処理するイベントだけを残すので、スイープ（と同じストリームを再生する他のもの）は、event_consumerで
+// エンジンが見るものと全く同じものを見る。
+std::vector<Event> filter_actioned_events(std::span<const Event> events);
+
+// Split the parameterisations into one slice per thread, and have every thread run its slice over
+// all the events. Results come back in the same order as the parameters.
+// パラメータ設定をスレッドごとに一つのスライスに分けて、各スレッドが全イベントで自分のスライスを動かす。結果は
+// パラメータと同じ順番で返る。
+std::vector<SweepResult> run_parameter_sweep(
+    std::span<const Event> events,
+    std::span<const SweepParameters> parameters,
+    unsigned int thread_count
+);
+
+// Print the results as a table, best first.
+// 一番良いものから、結果を表として出力する。
+void print_sweep_results(std::ostream& out, std::vector<SweepResult> results, std::size_t max_rows);
+
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include "events/event.hpp"
+#include "orderbook/orderbook.hpp"
+#include "tradingengine.hpp"
+#include "bookfeatures.hpp"
+#include <concepts>
+#include <cstdint>
+#include <string_view>
+#include <tuple>
+#include <utility>
+
+namespace nanofill::tradingengine {
+
+// A trading strategy. It is told about every event the book actioned, after the book has applied
+// it, and can look at the book however it likes. Strategies are plain types rather than virtual
+// classes, so calls into them are resolved (and usually inlined) at compile time.
+// 取引戦略。板が処理した各イベントについて、板が適用した後に知らされて、板を自由に見られる。戦略は仮想クラス
+// ではなく普通の型なので、呼び出しはコンパイル時に解決される（そして普通インライン化される）。
+template<typename S, typename Book = orderbook::OrderBook>
+concept Strategy = requires(S strategy, const Event event, const Book& book) {
+    { strategy.on_event(event, book) } noexcept -> std::same_as<void>;
+    { S::name } -> std::convertible_to<std::string_view>;
+};
+
+// Quotes price_spread either side of the middle of the best bid and ask, and doesn't quote when
+// either side of the book is empty.
+// 最良買い気配値と最良売り気配値の真ん中からprice_spreadだけ離れた価格で気配を出す。板のどちらかの側が空なら、
+// 気配を出さない。
+class BookMidStrategy {
+public:
+    static constexpr std::string_view name = "book_mid";
+
+    // The price the strategy wants to buy at.
+    // 戦略が買ってもらいたい価格。
+    std::uint32_t target_buy_price = 0;
+    // The price the strategy wants to sell at.
+    // 戦略が売ってもらいたい価格。
+    std::uint32_t target_sell_price = 0;
+
+    explicit BookMidStrategy(const std::uint32_t price_spread) noexcept : price_spread(price_spread) {}
+
+    template<typename Book>
+    [[gnu::always_inline]]
+    void on_event(const Event, const Book& book) noexcept {
+        const std::uint32_t best_bid = book.get_best_bid();
+        const std::uint32_t best_ask = book.get_best_ask();
+
+        if (best_bid == 0 || best_ask == 0) {
+            target_buy_price = 0;
+            target_sell_price = 0;
+            return;
+        }
+
+        const std::uint32_t mid_price = (best_bid + best_ask) / 2;
+
+        target_buy_price = mid_price > price_spread ? mid_price - price_spread : 0;
+        target_sell_price = mid_price + price_spread;
+    }
+
+private:
+    std::uint32_t price_spread;
+};
+
+// Quotes price_spread either side of the microprice, so the quotes lean towards whichever side of
+// the book is about to run out. Doesn't quote when either side of the book is empty.
+// マイクロプライスからprice_spreadだけ離れた価格で気配を出すので、気配は板のなくなりそうな側に寄る。板の
+// どちらかの側が空なら、気配を出さない。
+class MicropriceStrategy {
+public:
+    static constexpr std::string_view name = "microprice";
+
+    std::uint32_t target_buy_price = 0;
+    std::uint32_t target_sell_price = 0;
+
+    explicit MicropriceStrategy(const std::uint32_t price_spread) noexcept : price_spread(price_spread) {}
+
+    template<typename Book>
+    [[gnu::always_inline]]
+    void on_event(const Event event, const Book& book) noexcept {
+        features.on_event(event, book);
+
+        const auto microprice = static_cast<std::uint32_t>(features.get().microprice + 0.5F);
+
+        target_buy_price = microprice > price_spread ? microprice - price_spread : 0;
+        target_sell_price = microprice != 0 ? microprice + price_spread : 0;
+    }
+
+    const BookFeatureValues& get_features() const noexcept {
+        return features.get();
+    }
+
+private:
+    BookFeatures<> features;
+    std::uint32_t price_spread;
+};
+
+// A set of strategies compiled into the consumer together. Which strategies exist is decided at
+// build time by the template arguments, and which of those actually run can be chosen at start
+// time by name. Every strategy is enabled to begin with.
+// 一緒に消費者にコンパイルされる戦略のセット。どの戦略があるかはビルド時にテンプレート引数で決まって、その中で
+// どれが実際に動くかは起動時に名前で選べる。最初はすべての戦略が有効だ。
+template<typename... Strategies>
+class StrategySet {
+    static_assert(sizeof...(Strategies) <= 64, "Too many strategies");
+
+    std::tuple<Strategies...> strategies;
+    std::uint64_t enabled = sizeof...(Strategies) == 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << sizeof...(Strategies)) - 1;
+
+    template<typename Book, std::size_t... Indexes>
+    [[gnu::always_inline]]
+    void dispatch(const Event event, const Book& book, std::index_sequence<Indexes...>) noexcept {
+        // The enabled check is the same every time, so it predicts perfectly.
+        // 有効かどうかのチェックは毎回同じなので、完璧に予測される。
+        ((enabled & (std::uint64_t{1} << Indexes) ? std::get<Indexes>(strategies).on_event(event, book) : void()), ...);
+    }
+
+public:
+    static constexpr std::string_view name = "strategy_set";
+
+    explicit StrategySet(Strategies... strategies) noexcept : strategies(std::move(strategies)...) {}
+
+    template<typename Book>
+    [[gnu::always_inline]]
+    void on_event(const Event event, const Book& book) noexcept {
+        dispatch(event, book, std::index_sequence_for<Strategies...>{});
+    }
+
+    // Only run the strategies named in a comma separated list (e.g. "average_price,book_mid").
+    // Returns false, changing nothing, if a name isn't in the set.
+    // カンマ区切りのリストにある名前の戦略（例えば、"average_price,book_mid"）だけを動かす。名前がセットに
+    // なかったら、何も変えずにfalseを返す。
+    bool select(std::string_view names) noexcept {
+        std::uint64_t selected = 0;
+
+        while (!names.empty()) {
+            const std::size_t comma = names.find(',');
+            const std::string_view current = names.substr(0, comma);
+            const std::uint64_t bit = find(current, std::index_sequence_for<Strategies...>{});
+
+            if (bit == 0) {
+                return false;
+            }
+
+            selected |= bit;
+            names = comma == std::string_view::npos ? std::string_view{} : names.substr(comma + 1);
+        }
+
+        enabled = selected;
+
+        return true;
+    }
+
+    bool is_enabled(const std::string_view strategy_name) const noexcept {
+        return enabled & find(strategy_name, std::index_sequence_for<Strategies...>{});
+    }
+
+    template<typename S>
+    S& get() noexcept {
+        return std::get<S>(strategies);
+    }
+
+    template<typename S>
+    const S& get() const noexcept {
+        return std::get<S>(strategies);
+    }
+
+private:
+    // The bit for the strategy with this name, or 0 if there isn't one.
+    // この名前の戦略のビット。なければ、0。
+    template<std::size_t... Indexes>
+    static std::uint64_t find(const std::string_view strategy_name, std::index_sequence<Indexes...>) noexcept {
+        return ((Strategies::name == strategy_name ? std::uint64_t{1} << Indexes : 0) | ... | 0);
+    }
+};
+
+static_assert(Strategy<TradingEngine>);
+static_assert(Strategy<BookMidStrategy>);
+static_assert(Strategy<BookFeatures<>>);
+static_assert(Strategy<MicropriceStrategy>);
+static_assert(Strategy<StrategySet<TradingEngine, BookMidStrategy>>);
+
+}
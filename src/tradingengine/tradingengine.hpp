@@ -2,6 +2,7 @@
 
 #include "events/event.hpp"
 #include <cstdlib>
+#include <string_view>
 
 // Most of this code is really just a simple example since this will be mostly business logic.
 // This currently only supports one market index.
@@ -12,8 +13,14 @@ namespace nanofill::tradingengine {
 using events::Event;
 using events::EventType;
 
+// The reference strategy: quote price_spread either side of the average price of everything on
+// the book. See strategy.hpp for how to plug in others.
+// 参照戦略。板にあるもの全部の平均価格からprice_spreadだけ離れた価格で気配を出す。他の戦略の差し込み方は
+// strategy.hppを参照。
 class TradingEngine {
 public:
+    static constexpr std::string_view name = "average_price";
+
     // Sum of the value of all orders in 10,000ths of a dollar. This includes both sell and buy orders.
     // E.g. $100 sell and $100 buy would be $200 (2,000,000).
     // 10,000倍したドルの価格での各注文の価値の合計。売り注文と買い注文が含まれている。たとえば、$100売り注文と
@@ -37,6 +44,14 @@ public:
     
     TradingEngine(const int price_spread) noexcept;
 
+    // The strategy interface. This strategy only needs the event.
+    // 戦略のインターフェース。この戦略はイベントしか必要ない。
+    template<typename Book>
+    [[gnu::always_inline]] inline
+    void on_event(const Event event, const Book&) noexcept {
+        process_event(event);
+    }
+
     [[gnu::always_inline]] inline
     void process_event(const Event event) noexcept {
         if (event.type == EventType::Submission) {
@@ -0,0 +1,241 @@
+#include "gtest/gtest.h"
+#include "backtest/fillsimulator.hpp"
+#include "orderbook/orderbook.hpp"
+#include "tradingengine/tradingengine.hpp"
+#include <vector>
+
+using nanofill::backtest::FillSimulator;
+using nanofill::backtest::QuoteDriver;
+using nanofill::backtest::Side;
+using nanofill::backtest::SimulatedFill;
+using nanofill::events::Event;
+using nanofill::events::EventType;
+using nanofill::orderbook::BasicOrderBook;
+using nanofill::orderbook::DefaultOrderBookPolicy;
+using nanofill::tradingengine::TradingEngine;
+
+struct BacktestPolicy : DefaultOrderBookPolicy {
+    static constexpr Price max_price = 1000;
+    static constexpr std::size_t level_reserve = 4;
+    static constexpr std::size_t expected_orders = 10000;
+};
+
+TEST(Backtest, FillSimulatorQueuePosition) {
+    BasicOrderBook<BacktestPolicy> book;
+    FillSimulator<> simulator;
+    std::vector<SimulatedFill> fills;
+
+    auto record = [&](const SimulatedFill& fill) { fills.push_back(fill); };
+    auto replay = [&](const Event event) {
+        simulator.process_event(event, record);
+        book.process_event(event);
+    };
+
+    replay({ .price = 100, .time = 1, .order_id = 1, .size = 30, .type = EventType::Submission, .symbol_id = 0 });
+    replay({ .price = 100, .time = 2, .order_id = 2, .size = 20, .type = EventType::Submission, .symbol_id = 0 });
+    replay({ .price = 105, .time = 3, .order_id = 3, .size = -50, .type = EventType::Submission, .symbol_id = 0 });
+
+    const int bid = simulator.place(Side::Buy, 100, 10, 4, book, record);
+
+    ASSERT_EQ(50U, simulator.get_shares_ahead(bid));
+
+    // Joins behind us.
+    replay({ .price = 100, .time = 5, .order_id = 4, .size = 40, .type = EventType::Submission, .symbol_id = 0 });
+    ASSERT_EQ(50U, simulator.get_shares_ahead(bid));
+
+    // Cancelling an order ahead of us moves us up, but one behind us doesn't.
+    replay({ .price = 100, .time = 6, .order_id = 2, .size = 20, .type = EventType::Cancellation, .symbol_id = 0 });
+    ASSERT_EQ(30U, simulator.get_shares_ahead(bid));
+    replay({ .price = 100, .time = 7, .order_id = 4, .size = 10, .type = EventType::Cancellation, .symbol_id = 0 });
+    ASSERT_EQ(30U, simulator.get_shares_ahead(bid));
+
+    // Executions eat the queue in front of us first.
+    replay({ .price = 100, .time = 8, .order_id = 1, .size = 30, .type = EventType::ExecutionVisible, .symbol_id = 0 });
+    ASSERT_EQ(0U, simulator.get_shares_ahead(bid));
+    ASSERT_TRUE(fills.empty());
+
+    // Then us, and only up to our size.
+    replay({ .price = 100, .time = 10, .order_id = 4, .size = 15, .type = EventType::ExecutionVisible, .symbol_id = 0 });
+    ASSERT_EQ(1U, fills.size());
+    ASSERT_EQ(10U, fills[0].size);
+    ASSERT_EQ(100U, fills[0].price);
+    ASSERT_EQ(10U, fills[0].time);
+    ASSERT_EQ(0U, simulator.get_remaining(bid));
+    ASSERT_EQ(10, simulator.get_position());
+    ASSERT_EQ(-1000, simulator.get_cash());
+
+    // Crossing the spread fills straight away at the best opposite price.
+    replay({ .price = 100, .time = 11, .order_id = 5, .size = 10, .type = EventType::Submission, .symbol_id = 0 });
+    simulator.place(Side::Sell, 90, 5, 11, book, record);
+    ASSERT_EQ(2U, fills.size());
+    ASSERT_EQ(100U, fills[1].price);
+    ASSERT_EQ(5, simulator.get_position());
+
+    // The market trading through our price fills us before anything at its own level.
+    const int ask = simulator.place(Side::Sell, 105, 10, 12, book, record);
+    const int better_ask = simulator.place(Side::Sell, 104, 10, 12, book, record);
+
+    ASSERT_EQ(50U, simulator.get_shares_ahead(ask));
+    ASSERT_EQ(0U, simulator.get_shares_ahead(better_ask));
+
+    replay({ .price = 105, .time = 13, .order_id = 3, .size = -20, .type = EventType::ExecutionVisible, .symbol_id = 0 });
+    ASSERT_EQ(3U, fills.size());
+    ASSERT_EQ(104U, fills[2].price);
+    ASSERT_EQ(30U, simulator.get_shares_ahead(ask));
+    ASSERT_EQ(10U, simulator.get_remaining(ask));
+
+    ASSERT_EQ(-5, simulator.get_position());
+    ASSERT_EQ(-500 + 1040, simulator.get_cash());
+    ASSERT_EQ(540 - 5 * 105, simulator.get_profit());
+    ASSERT_EQ(3U, simulator.get_fill_count());
+    ASSERT_EQ(10U, simulator.get_shares_bought());
+    ASSERT_EQ(15U, simulator.get_shares_sold());
+
+    ASSERT_TRUE(simulator.cancel(ask));
+    ASSERT_FALSE(simulator.cancel(ask));
+}
+
+TEST(Backtest, FillSimulatorCapacity) {
+    BasicOrderBook<BacktestPolicy> book;
+    FillSimulator<1> simulator;
+
+    const int order = simulator.place(Side::Buy, 100, 10, 1, book);
+
+    ASSERT_EQ(0, order);
+    ASSERT_EQ(-1, simulator.place(Side::Buy, 101, 10, 1, book));
+
+    simulator.cancel(order);
+
+    ASSERT_EQ(0, simulator.place(Side::Buy, 101, 10, 1, book));
+}
+
+TEST(Backtest, FillSimulatorSharesAnExecution) {
+    BasicOrderBook<BacktestPolicy> book;
+    FillSimulator<> simulator;
+    std::vector<SimulatedFill> fills;
+
+    auto record = [&](const SimulatedFill& fill) { fills.push_back(fill); };
+
+    book.process_event({ .price = 100, .time = 1, .order_id = 1, .size = 30, .type = EventType::Submission, .symbol_id = 0 });
+
+    const int worse = simulator.place(Side::Buy, 101, 10, 2, book, record);
+    const int better = simulator.place(Side::Buy, 102, 10, 2, book, record);
+
+    // 15 shares traded through both of our bids, so the better one fills first and the other
+    // gets what's left.
+    const Event execution { .price = 100, .time = 3, .order_id = 1, .size = 15, .type = EventType::ExecutionVisible, .symbol_id = 0 };
+    simulator.process_event(execution, record);
+    book.process_event(execution);
+
+    ASSERT_EQ(2U, fills.size());
+    ASSERT_EQ(better, fills[0].order);
+    ASSERT_EQ(10U, fills[0].size);
+    ASSERT_EQ(worse, fills[1].order);
+    ASSERT_EQ(5U, fills[1].size);
+    ASSERT_EQ(5U, simulator.get_remaining(worse));
+    ASSERT_EQ(15, simulator.get_position());
+}
+
+TEST(Backtest, FillSimulatorTakesTheSideFromTheSign) {
+    BasicOrderBook<BacktestPolicy> book;
+    FillSimulator<> simulator;
+    std::vector<SimulatedFill> fills;
+
+    auto record = [&](const SimulatedFill& fill) { fills.push_back(fill); };
+
+    const int bid = simulator.place(Side::Buy, 100, 10, 1, book, record);
+    const int ask = simulator.place(Side::Sell, 105, 10, 1, book, record);
+
+    // A sell order executing at our bid's price is on the other side, so it can't fill the bid,
+    // whatever the book looks like.
+    simulator.process_event({ .price = 100, .time = 2, .order_id = 1, .size = -10, .type = EventType::ExecutionVisible, .symbol_id = 0 }, record);
+    ASSERT_TRUE(fills.empty());
+
+    // A sell order executing above our ask means the market traded through it.
+    simulator.process_event({ .price = 106, .time = 3, .order_id = 2, .size = -4, .type = EventType::ExecutionVisible, .symbol_id = 0 }, record);
+    ASSERT_EQ(1U, fills.size());
+    ASSERT_EQ(ask, fills[0].order);
+    ASSERT_EQ(4U, fills[0].size);
+
+    simulator.process_event({ .price = 100, .time = 4, .order_id = 3, .size = 10, .type = EventType::ExecutionVisible, .symbol_id = 0 }, record);
+    ASSERT_EQ(2U, fills.size());
+    ASSERT_EQ(bid, fills[1].order);
+}
+
+TEST(Backtest, FillSimulatorWalksTheBook) {
+    BasicOrderBook<BacktestPolicy> book;
+    FillSimulator<> simulator;
+    std::vector<SimulatedFill> fills;
+
+    auto record = [&](const SimulatedFill& fill) { fills.push_back(fill); };
+
+    book.process_event({ .price = 105, .time = 1, .order_id = 1, .size = -10, .type = EventType::Submission, .symbol_id = 0 });
+    book.process_event({ .price = 106, .time = 1, .order_id = 2, .size = -20, .type = EventType::Submission, .symbol_id = 0 });
+    book.process_event({ .price = 108, .time = 1, .order_id = 3, .size = -5, .type = EventType::Submission, .symbol_id = 0 });
+
+    // Takes everything up to 106 and rests the rest there.
+    const int bid = simulator.place(Side::Buy, 106, 40, 2, book, record);
+
+    ASSERT_EQ(2U, fills.size());
+    ASSERT_EQ(105U, fills[0].price);
+    ASSERT_EQ(10U, fills[0].size);
+    ASSERT_EQ(106U, fills[1].price);
+    ASSERT_EQ(20U, fills[1].size);
+    ASSERT_EQ(10U, simulator.get_remaining(bid));
+    ASSERT_EQ(-(105 * 10 + 106 * 20), simulator.get_cash());
+
+    // One small enough for the best level only fills there.
+    simulator.place(Side::Buy, 108, 5, 3, book, record);
+
+    ASSERT_EQ(3U, fills.size());
+    ASSERT_EQ(105U, fills[2].price);
+    ASSERT_EQ(35, simulator.get_position());
+}
+
+TEST(Backtest, QuoteDriverFollowsTheEngine) {
+    BasicOrderBook<BacktestPolicy> book;
+    FillSimulator<> simulator;
+    QuoteDriver<> driver(simulator, 10);
+    TradingEngine engine(4);
+
+    auto replay = [&](const Event event) {
+        simulator.process_event(event);
+
+        if (book.process_event(event)) {
+            engine.process_event(event);
+            driver.on_targets(engine.target_buy_price, engine.target_sell_price, event.time, book);
+        }
+    };
+
+    replay({ .price = 100, .time = 1, .order_id = 1, .size = 30, .type = EventType::Submission, .symbol_id = 0 });
+    replay({ .price = 110, .time = 2, .order_id = 2, .size = -30, .type = EventType::Submission, .symbol_id = 0 });
+
+    // The average is 105, so we bid 101 and offer 109. Each move cancels and replaces both.
+    ASSERT_EQ(4U, driver.get_placed());
+    ASSERT_EQ(2U, driver.get_cancelled());
+    ASSERT_EQ(0U, simulator.get_shares_ahead(driver.get_order(Side::Buy)));
+    ASSERT_EQ(10U, simulator.get_remaining(driver.get_order(Side::Sell)));
+
+    // A sell at 100 trades through our bid. The average moves to 107, so the filled bid is placed
+    // again at 103 and the offer moves to 111.
+    replay({ .price = 100, .time = 3, .order_id = 1, .size = 20, .type = EventType::ExecutionVisible, .symbol_id = 0 });
+
+    ASSERT_EQ(10, simulator.get_position());
+    ASSERT_EQ(-1010, simulator.get_cash());
+    ASSERT_EQ(6U, driver.get_placed());
+    ASSERT_EQ(3U, driver.get_cancelled());
+    ASSERT_EQ(10U, simulator.get_remaining(driver.get_order(Side::Buy)));
+
+    // The same targets leave the quotes alone, and a target of 0 pulls that side.
+    driver.on_targets(103, 0, 4, book);
+
+    ASSERT_EQ(6U, driver.get_placed());
+    ASSERT_EQ(4U, driver.get_cancelled());
+    ASSERT_EQ(-1, driver.get_order(Side::Sell));
+
+    // A target across the spread fills straight away and leaves nothing resting.
+    driver.on_targets(110, 0, 5, book);
+
+    ASSERT_EQ(-1, driver.get_order(Side::Buy));
+    ASSERT_EQ(20, simulator.get_position());
+}
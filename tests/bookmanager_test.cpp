@@ -0,0 +1,131 @@
+#include "gtest/gtest.h"
+#include "bookmanager/bookmanager.hpp"
+
+using nanofill::bookmanager::BookManager;
+using nanofill::events::Event;
+using nanofill::events::EventType;
+using nanofill::orderbook::DefaultOrderBookPolicy;
+
+struct SmallPolicy : DefaultOrderBookPolicy {
+    static constexpr Price max_price = 1000;
+    static constexpr std::size_t level_reserve = 4;
+    static constexpr std::size_t expected_orders = 100000;
+};
+
+TEST(BookManager, RoutesEventsToEachSymbolsBook) {
+    auto manager = BookManager<SmallPolicy, 128>(2);
+
+    manager.add_symbol(0, 20);
+    manager.add_symbol(1, 20);
+    manager.add_symbol(700, 20);
+
+    // Symbols are spread over the shards as they're added.
+    ASSERT_EQ(0U, manager.get_shard_for_symbol(0));
+    ASSERT_EQ(1U, manager.get_shard_for_symbol(1));
+    ASSERT_EQ(0U, manager.get_shard_for_symbol(700));
+
+    manager.start();
+
+    for (std::uint32_t i = 0; i < 3000; ++i) {
+        const auto symbol_id = static_cast<std::uint16_t>(i % 3 == 2 ? 700 : i % 3);
+
+        manager.route({ .price = static_cast<std::uint32_t>(10 + symbol_id), .time = i, .order_id = i, .size = 1, .type = EventType::Submission, .symbol_id = symbol_id });
+    }
+
+    // Symbol 3 was never added.
+    manager.route({ .price = 10, .time = 3000, .order_id = 3000, .size = 1, .type = EventType::Submission, .symbol_id = 3 });
+
+    manager.stop();
+
+    ASSERT_EQ(1U, manager.get_unknown_symbol_events());
+    ASSERT_EQ(1000U, manager.get_book(0).get_total_order_size_for_price(10));
+    ASSERT_EQ(1000U, manager.get_book(1).get_total_order_size_for_price(11));
+    ASSERT_EQ(1000U, manager.get_book(700).get_total_order_size_for_price(710));
+    ASSERT_EQ(0U, manager.get_book(0).get_total_order_size_for_price(11));
+    ASSERT_EQ(1000U, manager.get_engine(700).market_shares);
+    ASSERT_EQ(710U, manager.get_engine(700).average_share_price);
+}
+
+TEST(BookManager, RebalancesByEventRate) {
+    auto manager = BookManager<SmallPolicy, 128>(2);
+
+    for (std::uint16_t symbol_id = 0; symbol_id < 4; ++symbol_id) {
+        manager.add_symbol(symbol_id, 20);
+    }
+
+    manager.start();
+
+    // Symbol 0 is as busy as all the others put together.
+    auto route = [&](const std::uint16_t symbol_id, const std::uint32_t count) {
+        for (std::uint32_t i = 0; i < count; ++i) {
+            manager.route({ .price = 10, .time = i, .order_id = i, .size = 1, .type = EventType::Submission, .symbol_id = symbol_id });
+        }
+    };
+
+    route(0, 300);
+    route(1, 100);
+    route(2, 100);
+    route(3, 100);
+
+    manager.stop();
+    manager.rebalance();
+
+    // The busy symbol gets a shard to itself.
+    const auto busy_shard = manager.get_shard_for_symbol(0);
+    ASSERT_NE(busy_shard, manager.get_shard_for_symbol(1));
+    ASSERT_NE(busy_shard, manager.get_shard_for_symbol(2));
+    ASSERT_NE(busy_shard, manager.get_shard_for_symbol(3));
+
+    // And everything still works afterwards.
+    manager.start();
+    route(1, 10);
+    manager.stop();
+
+    ASSERT_EQ(110U, manager.get_book(1).get_total_order_size_for_price(10));
+}
+
+TEST(BookManager, RebalancesWhileRunning) {
+    auto manager = BookManager<SmallPolicy, 128>(2, {}, 400);
+
+    for (std::uint16_t symbol_id = 0; symbol_id < 4; ++symbol_id) {
+        manager.add_symbol(symbol_id, 20);
+    }
+
+    manager.start();
+
+    // Symbols 0 and 2 start on the same shard, but are the busiest by far.
+    ASSERT_EQ(manager.get_shard_for_symbol(0), manager.get_shard_for_symbol(2));
+
+    for (std::uint32_t i = 0; i < 400; ++i) {
+        const auto symbol_id = static_cast<std::uint16_t>(i % 10 < 8 ? (i % 2) * 2 : 1 + (i % 2) * 2);
+
+        manager.route({ .price = 10, .time = i, .order_id = i, .size = 1, .type = EventType::Submission, .symbol_id = symbol_id });
+    }
+
+    manager.stop();
+
+    ASSERT_EQ(1U, manager.get_rebalance_count());
+    ASSERT_NE(manager.get_shard_for_symbol(0), manager.get_shard_for_symbol(2));
+
+    // Nothing was lost while the symbols moved.
+    std::uint32_t total = 0;
+
+    for (std::uint16_t symbol_id = 0; symbol_id < 4; ++symbol_id) {
+        total += manager.get_book(symbol_id).get_total_order_size_for_price(10);
+    }
+
+    ASSERT_EQ(400U, total);
+}
+
+TEST(BookManager, StartingTwiceThrows) {
+    auto manager = BookManager<SmallPolicy, 128>(2);
+
+    manager.add_symbol(0, 20);
+    manager.start();
+
+    ASSERT_THROW(manager.start(), std::logic_error);
+
+    manager.stop();
+    manager.start();
+    manager.stop();
+}
@@ -1,8 +1,17 @@
 #include "gtest/gtest.h"
 #include "concurrency/spscringbuffer.hpp"
+#include "concurrency/conflatedlevelchannel.hpp"
+#include "concurrency/seqlock.hpp"
+#include "concurrency/broadcastringbuffer.hpp"
 #include <vector>
+#include <map>
+#include <atomic>
 
 using nanofill::concurrency::SPSCRingBuffer;
+using nanofill::concurrency::ConflatedLevelChannel;
+using nanofill::concurrency::LevelUpdate;
+using nanofill::concurrency::SeqLock;
+using nanofill::concurrency::BroadcastRingBuffer;
 
 TEST(Concurrency, SPSCRingBuffer) {
     auto buffer = SPSCRingBuffer<int, 128>();
@@ -46,10 +55,12 @@ TEST(Concurrency, SPSCRingBuffer) {
 
     // Make it full.
     ASSERT_FALSE(buffer.pop(item));
+    ASSERT_EQ(0U, buffer.size());
     for (int i = 0; i < 127; ++i) {
         ASSERT_TRUE(buffer.push(i));
     }
     ASSERT_FALSE(buffer.push(999));
+    ASSERT_EQ(127U, buffer.size());
 
     // Pop them, checking order.
     for (int i = 0; i < 127; ++i) {
@@ -65,6 +76,7 @@ TEST(Concurrency, SPSCRingBuffer) {
 
     // Pop them all at once, checking order.
     ASSERT_EQ(127U, buffer.pop_many(items, 9999));
+    ASSERT_EQ(0U, buffer.size());
     ASSERT_FALSE(buffer.pop(item));
     for (int i = 0; i < 127; ++i) {
         ASSERT_EQ(i, items[i]);
@@ -138,4 +150,277 @@ TEST(Concurrency, SPSCRingBufferConcurrencyStressTestPopMany) {
     reader.join();
 
     ASSERT_EQ(10000, read_count);
-}
\ No newline at end of file
+}
+
+TEST(Concurrency, ConflatedLevelChannel) {
+    auto channel = ConflatedLevelChannel<1000>();
+    std::map<std::uint32_t, LevelUpdate> updates;
+    auto collect = [&](const LevelUpdate update) { updates[update.price] = update; };
+    // Two rounds of handing over and draining are always enough to see everything.
+    auto drain_everything = [&] {
+        std::size_t drained = 0;
+
+        for (int i = 0; i < 2; ++i) {
+            channel.service();
+            drained += channel.drain(collect);
+        }
+
+        return drained;
+    };
+
+    // Nothing published yet.
+    ASSERT_EQ(0U, drain_everything());
+
+    channel.publish(10, 100, 1);
+    channel.publish(999, 5, 2);
+    channel.publish(10, 50, 3);
+
+    // Level 10 was conflated down to its latest value.
+    ASSERT_GE(3U, drain_everything());
+    ASSERT_EQ(2U, updates.size());
+    ASSERT_EQ(50U, updates[10].size);
+    ASSERT_EQ(3U, updates[10].last_modified);
+    ASSERT_EQ(5U, updates[999].size);
+    ASSERT_EQ(2U, updates[999].last_modified);
+
+    // Drained levels aren't seen again.
+    updates.clear();
+    ASSERT_EQ(0U, drain_everything());
+
+    channel.publish(64, 7, 4);
+    ASSERT_EQ(1U, drain_everything());
+    ASSERT_EQ(7U, updates[64].size);
+}
+
+TEST(Concurrency, ConflatedLevelChannelConcurrencyStressTest) {
+    auto channel = ConflatedLevelChannel<256>();
+    std::atomic<bool> writer_done{false};
+    std::uint32_t last_seen[256]{};
+    bool went_backwards = false;
+
+    std::thread writer([&] {
+        for (std::uint32_t i = 1; i <= 100000; ++i) {
+            channel.publish(i % 256, i, i);
+        }
+
+        // Keep handing over until the reader has everything.
+        while (!writer_done.load(std::memory_order_acquire)) {
+            channel.service();
+        }
+    });
+
+    auto check = [&](const LevelUpdate update) {
+        if (update.size < last_seen[update.price] || update.size != update.last_modified) {
+            went_backwards = true;
+        }
+
+        last_seen[update.price] = update.size;
+    };
+
+    // The last value written to each level.
+    auto expected = [](const std::uint32_t price) { return 99840U + price - (price > 160 ? 256 : 0); };
+    auto all_seen = [&] {
+        for (std::uint32_t price = 0; price < 256; ++price) {
+            if (last_seen[price] != expected(price)) {
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    while (!all_seen()) {
+        channel.drain(check);
+    }
+
+    writer_done.store(true, std::memory_order_release);
+    writer.join();
+
+    ASSERT_FALSE(went_backwards);
+}
+
+
+TEST(Concurrency, SeqLock) {
+    struct Pair {
+        std::uint32_t first;
+        std::uint64_t second;
+    };
+
+    auto seqlock = SeqLock<Pair>();
+    Pair value{};
+
+    ASSERT_TRUE(seqlock.try_load(value));
+    ASSERT_EQ(0U, value.first);
+    ASSERT_EQ(0U, value.second);
+
+    seqlock.store({ 1, 2 });
+    ASSERT_TRUE(seqlock.try_load(value));
+    ASSERT_EQ(1U, value.first);
+    ASSERT_EQ(2U, value.second);
+
+    seqlock.store({ 3, 4 });
+    value = seqlock.load();
+    ASSERT_EQ(3U, value.first);
+    ASSERT_EQ(4U, value.second);
+}
+
+TEST(Concurrency, SeqLockConcurrencyStressTest) {
+    struct Triple {
+        std::uint64_t a;
+        std::uint64_t b;
+        std::uint64_t c;
+    };
+
+    auto seqlock = SeqLock<Triple>();
+    std::atomic<bool> writer_done{false};
+    bool torn = false;
+    bool went_backwards = false;
+
+    std::thread writer([&] {
+        for (std::uint64_t i = 1; i <= 100000; ++i) {
+            seqlock.store({ i, i * 2, i * 3 });
+        }
+
+        writer_done = true;
+    });
+
+    std::thread reader([&] {
+        std::uint64_t last_seen = 0;
+
+        while (!writer_done) {
+            auto value = seqlock.load();
+
+            if (value.b != value.a * 2 || value.c != value.a * 3) {
+                torn = true;
+            }
+
+            if (value.a < last_seen) {
+                went_backwards = true;
+            }
+
+            last_seen = value.a;
+        }
+    });
+
+    writer.join();
+    reader.join();
+
+    ASSERT_FALSE(torn);
+    ASSERT_FALSE(went_backwards);
+    ASSERT_EQ(100000U, seqlock.load().a);
+}
+
+
+TEST(Concurrency, BroadcastRingBuffer) {
+    using Ring = BroadcastRingBuffer<int, 8, 2>;
+
+    // Consumer 1 follows consumer 0.
+    auto buffer = Ring({ Ring::no_dependency, 0 });
+    int items[8]{};
+
+    // Nothing to read.
+    ASSERT_EQ(0U, buffer.read(0, 8).size());
+    ASSERT_EQ(0U, buffer.pop_many(1, items, 8));
+
+    ASSERT_TRUE(buffer.push(1));
+    ASSERT_TRUE(buffer.push(2));
+    ASSERT_TRUE(buffer.push(3));
+
+    // Consumer 1 can't see anything until consumer 0 has finished with it.
+    ASSERT_EQ(0U, buffer.pop_many(1, items, 8));
+
+    auto slots = buffer.read(0, 2);
+    ASSERT_EQ(0U, buffer.get_position(0));
+    ASSERT_EQ(2U, slots.size());
+    ASSERT_EQ(1, slots[0]);
+    ASSERT_EQ(2, slots[1]);
+    buffer.advance(0, 2);
+    ASSERT_EQ(2U, buffer.get_position(0));
+
+    ASSERT_EQ(2U, buffer.pop_many(1, items, 8));
+    ASSERT_EQ(1, items[0]);
+    ASSERT_EQ(2, items[1]);
+
+    // All slots are usable, and the slowest consumer holds up the producer.
+    for (int i = 4; i <= 10; ++i) {
+        ASSERT_TRUE(buffer.push(i));
+    }
+
+    ASSERT_FALSE(buffer.push(11));
+
+    // Reads stop at the end of the buffer, then carry on from the start.
+    slots = buffer.read(0, 8);
+    ASSERT_EQ(6U, slots.size());
+    ASSERT_EQ(3, slots[0]);
+    ASSERT_EQ(8, slots[5]);
+    buffer.advance(0, 6);
+    slots = buffer.read(0, 8);
+    ASSERT_EQ(2U, slots.size());
+    ASSERT_EQ(9, slots[0]);
+    ASSERT_EQ(10, slots[1]);
+    buffer.advance(0, 2);
+
+    // Consumer 1 is still holding up the producer.
+    ASSERT_FALSE(buffer.push(11));
+
+    // Copying wraps around in one go.
+    ASSERT_EQ(8U, buffer.pop_many(1, items, 8));
+    for (int i = 0; i < 8; ++i) {
+        ASSERT_EQ(i + 3, items[i]);
+    }
+
+    ASSERT_TRUE(buffer.push(11));
+}
+
+TEST(Concurrency, BroadcastRingBufferRejectsCycles) {
+    using Ring = BroadcastRingBuffer<int, 8, 3>;
+
+    ASSERT_THROW(Ring({ 1, 0, Ring::no_dependency }), std::invalid_argument);
+    ASSERT_THROW(Ring({ 0, Ring::no_dependency, Ring::no_dependency }), std::invalid_argument);
+    ASSERT_THROW(Ring({ 5, Ring::no_dependency, Ring::no_dependency }), std::invalid_argument);
+    ASSERT_NO_THROW(Ring({ Ring::no_dependency, 0, 1 }));
+}
+
+TEST(Concurrency, BroadcastRingBufferConcurrencyStressTest) {
+    using Ring = BroadcastRingBuffer<int, 64, 3>;
+
+    // Consumer 2 follows consumer 1, consumer 0 is independent.
+    auto buffer = Ring({ Ring::no_dependency, Ring::no_dependency, 1 });
+    int read_counts[3]{};
+
+    std::thread writer([&] {
+        for (int i = 0; i < 10000;) {
+            if (buffer.push(i)) {
+                ++i;
+            }
+        }
+    });
+
+    std::vector<std::thread> readers;
+
+    for (std::size_t consumer = 0; consumer < 3; ++consumer) {
+        readers.emplace_back([&, consumer] {
+            while (read_counts[consumer] < 10000) {
+                auto slots = buffer.read(consumer, 10);
+
+                for (int value : slots) {
+                    if (value == read_counts[consumer]) {
+                        ++read_counts[consumer];
+                    }
+                }
+
+                buffer.advance(consumer, slots.size());
+            }
+        });
+    }
+
+    writer.join();
+
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    ASSERT_EQ(10000, read_counts[0]);
+    ASSERT_EQ(10000, read_counts[1]);
+    ASSERT_EQ(10000, read_counts[2]);
+}
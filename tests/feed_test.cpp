@@ -0,0 +1,409 @@
+#include "gtest/gtest.h"
+#include "feed/udpfeed.hpp"
+#include "feed/arbiter.hpp"
+#include "threads/threads.hpp"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <thread>
+
+using nanofill::events::Event;
+using nanofill::events::EventType;
+using nanofill::feed::FeedHandler;
+namespace itch = nanofill::fileio::itch;
+namespace mold = nanofill::feed::mold;
+
+namespace {
+
+// A packet holding an add for each of references, starting at sequence.
+// referencesの各々の追加を持つ、sequenceから始まるパケット。
+std::vector<std::uint8_t> make_packet(const std::uint64_t sequence, const std::vector<std::uint64_t>& references) {
+    std::vector<std::uint8_t> packet(mold::header_length);
+
+    for (const std::uint64_t reference : references) {
+        itch::append_add_order(packet, 34200000000000ULL, reference, true, 100, 3000 + reference);
+    }
+
+    mold::write_header(packet.data(), sequence, static_cast<std::uint16_t>(references.size()));
+
+    return packet;
+}
+
+// The one length-prefixed message in data, as an ItchMessage.
+// dataの中の一つの長さを前に付けたメッセージを、ItchMessageとして。
+nanofill::feed::ItchMessage to_message(const std::vector<std::uint8_t>& data) {
+    nanofill::feed::ItchMessage message { .length = static_cast<std::uint16_t>(data.size() - 2), .bytes = {} };
+    std::copy(data.begin() + 2, data.end(), message.bytes.begin());
+
+    return message;
+}
+
+}
+
+TEST(Feed, HandlerDetectsGapsAndDuplicates) {
+    FeedHandler handler(64);
+    std::vector<std::uint32_t> order_ids;
+    const auto on_event = [&](const Event& event) {
+        ASSERT_EQ(event.type, EventType::Submission);
+        order_ids.push_back(event.order_id);
+    };
+
+    handler.on_packet(make_packet(1, { 1, 2 }), on_event);
+    // Messages 3 and 4 go missing.
+    // メッセージ3と4がなくなる。
+    handler.on_packet(make_packet(5, { 5, 6, 7 }), on_event);
+    // A repeat, and one that overlaps what we've seen.
+    // 繰り返しと、見たものと重なるもの。
+    handler.on_packet(make_packet(5, { 5, 6, 7 }), on_event);
+    handler.on_packet(make_packet(7, { 7, 8 }), on_event);
+
+    // Cut short in the middle of its second message.
+    // 二つ目のメッセージの途中で短く切れている。
+    auto truncated = make_packet(9, { 9, 10 });
+    truncated.resize(truncated.size() - 3);
+    handler.on_packet(truncated, on_event);
+
+    handler.on_packet(std::vector<std::uint8_t>(5), on_event);
+    ASSERT_FALSE(handler.has_ended());
+
+    std::vector<std::uint8_t> end(mold::header_length);
+    mold::write_header(end.data(), 10, mold::end_of_session);
+    handler.on_packet(end, on_event);
+
+    ASSERT_TRUE(handler.has_ended());
+    ASSERT_EQ(order_ids, (std::vector<std::uint32_t>{ 1, 2, 5, 6, 7, 8, 9 }));
+
+    const auto& stats = handler.get_stats();
+
+    ASSERT_EQ(stats.packets, 7U);
+    ASSERT_EQ(stats.messages, 7U);
+    ASSERT_EQ(stats.events, 7U);
+    ASSERT_EQ(stats.gaps, 1U);
+    ASSERT_EQ(stats.missing_messages, 2U);
+    ASSERT_EQ(stats.duplicate_packets, 1U);
+    ASSERT_EQ(stats.bad_packets, 2U);
+    ASSERT_EQ(handler.get_next_sequence(), 10U);
+}
+
+TEST(Feed, LoopbackRoundTrip) {
+    constexpr std::uint64_t message_count = 2000;
+    std::vector<std::uint8_t> messages;
+
+    for (std::uint64_t reference = 1; reference <= message_count / 2; ++reference) {
+        itch::append_add_order(messages, 34200000000000ULL + reference, reference, reference % 2 == 0, 100, 3000);
+        itch::append_order_delete(messages, 34200000000000ULL + reference, reference);
+    }
+
+    nanofill::feed::UdpReceiver receiver("127.0.0.1:0");
+    FeedHandler handler(64);
+    std::uint64_t deletions = 0;
+
+    ASSERT_NE(receiver.get_port(), 0);
+
+    // Small packets so there are plenty of them.
+    // パケットが沢山あるように小さくする。
+    nanofill::feed::SenderStats sent;
+    std::thread sender([&] {
+        sent = nanofill::feed::send_itch_feed(messages, "127.0.0.1:" + std::to_string(receiver.get_port()),
+            { .messages_per_second = 1000000, .max_packet_size = 200 });
+    });
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+    while (!handler.has_ended() && std::chrono::steady_clock::now() < deadline) {
+        receiver.receive([&](const std::span<const std::uint8_t> datagram) {
+            handler.on_packet(datagram, [&](const Event& event) {
+                deletions += event.type == EventType::Deletion;
+            });
+        });
+    }
+
+    sender.join();
+
+    ASSERT_TRUE(handler.has_ended());
+    ASSERT_EQ(sent.messages, message_count);
+    ASSERT_GT(sent.packets, message_count / 10);
+    ASSERT_EQ(handler.get_stats().messages, message_count);
+    ASSERT_EQ(handler.get_stats().gaps, 0U);
+    ASSERT_EQ(handler.get_stats().bad_packets, 0U);
+    ASSERT_EQ(deletions, message_count / 2);
+    ASSERT_EQ(handler.get_decoder().get_live_order_count(), 0U);
+}
+
+TEST(Feed, ArbiterReleasesEachSequenceOnce) {
+    using nanofill::feed::Line;
+    using Arbiter = nanofill::feed::FeedArbiter<std::uint32_t, 8>;
+
+    Arbiter arbiter;
+    std::vector<std::uint32_t> released;
+    const auto send = [&](const Line line, const std::uint64_t sequence, const std::uint64_t tsc) {
+        arbiter.on_message(line, { .sequence = sequence, .arrival_tsc = tsc, .payload = static_cast<std::uint32_t>(sequence) },
+            [&](const std::uint32_t payload) { released.push_back(payload); });
+    };
+
+    send(Line::A, 1, 100);
+    send(Line::B, 1, 150);
+    send(Line::B, 2, 200);
+    send(Line::A, 2, 260);
+    // 3 is late on both lines, so 4 waits for it.
+    // 3は両方の回線で遅いので、4はそれを待つ。
+    send(Line::A, 4, 300);
+    ASSERT_EQ(released, (std::vector<std::uint32_t>{ 1, 2 }));
+    send(Line::B, 3, 320);
+    ASSERT_EQ(released, (std::vector<std::uint32_t>{ 1, 2, 3, 4 }));
+    send(Line::B, 4, 330);
+    send(Line::A, 3, 400);
+    // A repeats itself.
+    // Aが繰り返す。
+    send(Line::A, 3, 500);
+
+    // 5 never comes, and 13 is too far ahead for the window, so 5 is given up on.
+    // 5は来なくて、13は窓には先すぎるので、5を諦める。
+    send(Line::A, 6, 600);
+    send(Line::A, 7, 700);
+    ASSERT_EQ(released.size(), 4U);
+    send(Line::A, 13, 800);
+    ASSERT_EQ(released, (std::vector<std::uint32_t>{ 1, 2, 3, 4, 6, 7 }));
+    send(Line::B, 5, 900);
+
+    arbiter.flush([&](const std::uint32_t payload) { released.push_back(payload); });
+    ASSERT_EQ(released, (std::vector<std::uint32_t>{ 1, 2, 3, 4, 6, 7, 13 }));
+    ASSERT_EQ(arbiter.get_next_sequence(), 14U);
+
+    const auto& stats = arbiter.get_stats();
+    const auto& a = arbiter.get_line_stats(Line::A);
+    const auto& b = arbiter.get_line_stats(Line::B);
+
+    ASSERT_EQ(stats.released, 7U);
+    ASSERT_EQ(stats.out_of_order, 4U);
+    ASSERT_EQ(stats.gaps, 2U);
+    ASSERT_EQ(stats.missing, 6U);
+    ASSERT_EQ(a.received, 8U);
+    ASSERT_EQ(a.first, 5U);
+    ASSERT_EQ(a.second, 2U);
+    ASSERT_EQ(a.stale, 1U);
+    ASSERT_EQ(b.received, 5U);
+    ASSERT_EQ(b.first, 2U);
+    ASSERT_EQ(b.second, 2U);
+    ASSERT_EQ(b.stale, 1U);
+    // A was ahead on 1 and 4, and B on 2 and 3.
+    // Aは1と4で、Bは2と3で先だった。
+    ASSERT_EQ(a.lead.get_count(), 2U);
+    ASSERT_EQ(b.lead.get_count(), 2U);
+}
+
+TEST(Feed, ArbitratesMessagesBeforeDecoding) {
+    using nanofill::feed::FeedArbiter;
+    using nanofill::feed::ItchMessage;
+    using nanofill::feed::Line;
+    using nanofill::feed::LineSplitter;
+
+    // An add and then a replace of it, which decodes to two events under one sequence number.
+    // 追加とその置き換え。置き換えは一つのシーケンス番号で二つのイベントにデコードされる。
+    std::vector<std::uint8_t> packet(mold::header_length);
+    itch::append_add_order(packet, 34200000000000ULL, 1, true, 100, 3000);
+    itch::append_order_replace(packet, 34200000000001ULL, 1, 2, 50, 3100);
+    mold::write_header(packet.data(), 1, 2);
+
+    LineSplitter splitter_a;
+    LineSplitter splitter_b;
+    auto arbiter = std::make_unique<FeedArbiter<ItchMessage, 8>>();
+    nanofill::fileio::ItchDecoder decoder(64);
+    std::vector<Event> events;
+    const auto release = [&](const ItchMessage& message) {
+        decoder.decode_message(message.bytes.data(), message.length, [&](const Event& event) { events.push_back(event); });
+    };
+
+    splitter_a.on_packet(packet, 100, [&](const auto& message) { arbiter->on_message(Line::A, message, release); });
+    splitter_b.on_packet(packet, 150, [&](const auto& message) { arbiter->on_message(Line::B, message, release); });
+
+    ASSERT_EQ(splitter_a.get_stats().messages, 2U);
+    ASSERT_EQ(arbiter->get_stats().released, 2U);
+    ASSERT_EQ(arbiter->get_line_stats(Line::B).second, 2U);
+    ASSERT_EQ(events.size(), 3U);
+    ASSERT_EQ(events[0].type, EventType::Submission);
+    ASSERT_EQ(events[1].type, EventType::Deletion);
+    ASSERT_EQ(events[2].type, EventType::Submission);
+    ASSERT_EQ(events[2].order_id, 2U);
+    ASSERT_EQ(events[2].price, 3100U);
+}
+
+TEST(Feed, ArbiterWithJitterAndDrops) {
+    using nanofill::concurrency::SPSCRingBuffer;
+    using nanofill::feed::ItchMessage;
+    using nanofill::feed::Sequenced;
+    using Arbiter = nanofill::feed::FeedArbiter<ItchMessage, 256>;
+
+    constexpr std::uint32_t sequences = 20000;
+    SPSCRingBuffer<Sequenced<ItchMessage>, 128> line_a;
+    SPSCRingBuffer<Sequenced<ItchMessage>, 128> line_b;
+    SPSCRingBuffer<Event, 1024> event_buffer;
+    std::atomic<bool> lines_finished{false};
+    std::atomic<bool> finished{false};
+    std::atomic<std::uint32_t> progress_a{0};
+    std::atomic<std::uint32_t> progress_b{0};
+    std::vector<bool> dropped_a(sequences + 1);
+    std::vector<bool> dropped_b(sequences + 1);
+    auto arbiter = std::make_unique<Arbiter>();
+    nanofill::fileio::ItchDecoder decoder(1 << 16);
+    std::vector<std::uint32_t> released;
+
+    // Each line drops about one in twenty and waits a random while before each message, but stays
+    // within 64 messages of the other so the window is always enough to line them up.
+    // 各回線は約二十に一つを落として、各メッセージの前にランダムな時間待つが、窓でいつも揃えられるように、
+    // もう片方から64メッセージ以内に留まる。
+    const auto produce = [&](SPSCRingBuffer<Sequenced<ItchMessage>, 128>& line, std::vector<bool>& dropped,
+        std::atomic<std::uint32_t>& progress, const std::atomic<std::uint32_t>& other, const unsigned int seed) {
+        std::mt19937 random(seed);
+
+        for (std::uint32_t sequence = 1; sequence <= sequences; ++sequence) {
+            while (sequence > other.load(std::memory_order_acquire) + 64) {
+                std::this_thread::yield();
+            }
+
+            const auto wait_until = std::chrono::steady_clock::now() + std::chrono::nanoseconds(random() % 2000);
+
+            while (std::chrono::steady_clock::now() < wait_until) {}
+
+            if (random() % 20 == 0) {
+                dropped[sequence] = true;
+            } else {
+                std::vector<std::uint8_t> add;
+                itch::append_add_order(add, 34200000000000ULL, sequence, true, 1, 3000);
+
+                const Sequenced<ItchMessage> message {
+                    .sequence = sequence,
+                    .arrival_tsc = nanofill::stats::read_tsc(),
+                    .payload = to_message(add)
+                };
+
+                while (!line.push(message)) {
+                    std::this_thread::yield();
+                }
+            }
+
+            progress.store(sequence, std::memory_order_release);
+        }
+    };
+
+    std::thread consumer([&] {
+        Event event;
+
+        while (true) {
+            const bool ending = finished.load(std::memory_order_acquire);
+
+            if (event_buffer.pop(event)) {
+                released.push_back(event.order_id);
+            } else if (ending) {
+                return;
+            }
+        }
+    });
+    std::thread arbitrator(nanofill::threads::feed_arbitrator<128, 1024, 256>,
+        std::ref(line_a), std::ref(line_b), std::cref(lines_finished), std::ref(*arbiter), std::ref(decoder), std::ref(event_buffer), std::ref(finished));
+    std::thread producer_a([&] { produce(line_a, dropped_a, progress_a, progress_b, 1); });
+    std::thread producer_b([&] { produce(line_b, dropped_b, progress_b, progress_a, 2); });
+
+    producer_a.join();
+    producer_b.join();
+    lines_finished.store(true, std::memory_order_release);
+    arbitrator.join();
+    consumer.join();
+
+    std::vector<std::uint32_t> expected;
+    std::uint64_t sent = 0;
+
+    for (std::uint32_t sequence = 1; sequence <= sequences; ++sequence) {
+        sent += !dropped_a[sequence] + !dropped_b[sequence];
+
+        if (!dropped_a[sequence] || !dropped_b[sequence]) {
+            expected.push_back(sequence);
+        }
+    }
+
+    ASSERT_EQ(released, expected);
+
+    const auto& stats = arbiter->get_stats();
+    const auto& a = arbiter->get_line_stats(nanofill::feed::Line::A);
+    const auto& b = arbiter->get_line_stats(nanofill::feed::Line::B);
+
+    ASSERT_EQ(stats.released, expected.size());
+    ASSERT_EQ(stats.missing, sequences - expected.size());
+    ASSERT_EQ(a.received + b.received, sent);
+    ASSERT_EQ(a.first + b.first, expected.size());
+    ASSERT_EQ(a.stale + b.stale, 0U);
+    ASSERT_EQ(a.second + b.second, sent - expected.size());
+    ASSERT_EQ(a.lead.get_count() + b.lead.get_count(), sent - expected.size());
+}
+
+TEST(Feed, TwoLineLoopbackRoundTrip) {
+    using nanofill::concurrency::SPSCRingBuffer;
+    using nanofill::feed::ItchMessage;
+    using nanofill::feed::Sequenced;
+
+    constexpr std::uint64_t message_count = 1000;
+    std::vector<std::uint8_t> messages;
+
+    for (std::uint64_t reference = 1; reference <= message_count / 2; ++reference) {
+        itch::append_add_order(messages, 34200000000000ULL + reference, reference, true, 100, 3000);
+        itch::append_order_replace(messages, 34200000000000ULL + reference, reference, reference + message_count, 100, 3100);
+    }
+
+    nanofill::feed::UdpReceiver receiver_a("127.0.0.1:0");
+    nanofill::feed::UdpReceiver receiver_b("127.0.0.1:0");
+    nanofill::feed::LineSplitter splitter_a;
+    nanofill::feed::LineSplitter splitter_b;
+    auto line_a = std::make_unique<SPSCRingBuffer<Sequenced<ItchMessage>, 1024>>();
+    auto line_b = std::make_unique<SPSCRingBuffer<Sequenced<ItchMessage>, 1024>>();
+    auto event_buffer = std::make_unique<SPSCRingBuffer<Event, 1024>>();
+    auto arbiter = std::make_unique<nanofill::feed::FeedArbiter<ItchMessage>>();
+    nanofill::fileio::ItchDecoder decoder(1 << 12);
+    std::atomic<bool> lines_finished{false};
+    std::atomic<bool> finished{false};
+    std::uint64_t submissions = 0;
+    std::uint64_t deletions = 0;
+
+    std::thread receiver(nanofill::threads::line_receiver<1024>, std::ref(receiver_a), std::ref(receiver_b),
+        std::ref(splitter_a), std::ref(splitter_b), std::ref(*line_a), std::ref(*line_b), std::ref(lines_finished),
+        std::chrono::seconds(2));
+    std::thread arbitrator(nanofill::threads::feed_arbitrator<1024, 1024, 256>,
+        std::ref(*line_a), std::ref(*line_b), std::cref(lines_finished), std::ref(*arbiter), std::ref(decoder), std::ref(*event_buffer), std::ref(finished));
+    std::thread consumer([&] {
+        Event event;
+
+        while (true) {
+            const bool ending = finished.load(std::memory_order_acquire);
+
+            if (event_buffer->pop(event)) {
+                submissions += event.type == EventType::Submission;
+                deletions += event.type == EventType::Deletion;
+            } else if (ending) {
+                return;
+            }
+        }
+    });
+
+    // Both lines carry the same messages with the same sequence numbers.
+    // 両方の回線が同じシーケンス番号で同じメッセージを運ぶ。
+    for (const auto* line : { &receiver_a, &receiver_b }) {
+        nanofill::feed::send_itch_feed(messages, "127.0.0.1:" + std::to_string(line->get_port()),
+            { .messages_per_second = 1000000, .max_packet_size = 200 });
+    }
+
+    receiver.join();
+    arbitrator.join();
+    consumer.join();
+
+    ASSERT_TRUE(splitter_a.has_ended());
+    ASSERT_TRUE(splitter_b.has_ended());
+    ASSERT_EQ(splitter_a.get_stats().messages, message_count);
+    ASSERT_EQ(splitter_b.get_stats().messages, message_count);
+    ASSERT_EQ(arbiter->get_stats().released, message_count);
+    ASSERT_EQ(arbiter->get_stats().missing, 0U);
+    // Every replace is a delete and an add, none of them dropped as a repeat.
+    // 各置き換えは削除と追加で、どれも繰り返しとして捨てられない。
+    ASSERT_EQ(submissions, message_count);
+    ASSERT_EQ(deletions, message_count / 2);
+    ASSERT_EQ(decoder.get_unknown_orders(), 0U);
+}
@@ -2,6 +2,17 @@
 #include "fileio/csv.hpp"
 #include "fileio/fileio.hpp"
 #include "consts/consts.hpp"
+#include "fileio/lobsterparser.hpp"
+#include "fileio/itchdecoder.hpp"
+#include "orderbook/orderbook.hpp"
+#include "threads/threads.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <zlib.h>
 
 TEST(FileIO, ParseCSVData) {
     std::vector<std::string> file_data = {
@@ -44,4 +55,315 @@ TEST(FileIO, ParseCSVData) {
     ASSERT_EQ(std::get<5>(columns[1]), -1);
     ASSERT_EQ(std::get<5>(columns[2]), -1);
     ASSERT_EQ(std::get<5>(columns[3]), 1);
-}
\ No newline at end of file
+}
+TEST(FileIO, LobsterStreamParserSplitsAnywhere) {
+    const std::string data =
+        "34200.01399412,3,16085616,100,310400,-1\n"
+        "34200.01399412,1,16116348,100,310500,-1\r\n"
+        "not a line\n"
+        "\n"
+        "34201.5,4,16116658,25,310400,1";
+
+    // Feeding it in every possible split gives the same events.
+    for (std::size_t split = 0; split <= data.size(); ++split) {
+        nanofill::fileio::LobsterStreamParser parser;
+        std::vector<nanofill::events::Event> events;
+        auto collect = [&](const nanofill::events::Event& event) { events.push_back(event); };
+
+        parser.feed(std::span(data.data(), split), collect);
+        parser.feed(std::span(data.data() + split, data.size() - split), collect);
+        parser.finish(collect);
+
+        ASSERT_EQ(3U, events.size());
+        ASSERT_EQ(1U, parser.get_bad_lines());
+
+        ASSERT_EQ(34200U, events[0].time);
+        ASSERT_EQ(13994120U, events[0].nanoseconds);
+        ASSERT_EQ(nanofill::events::EventType::Deletion, events[0].type);
+        ASSERT_EQ(16085616U, events[0].order_id);
+        ASSERT_EQ(-100, events[0].size);
+        ASSERT_EQ(310400U, events[0].price);
+
+        ASSERT_EQ(310500U, events[1].price);
+
+        ASSERT_EQ(34201U, events[2].time);
+        ASSERT_EQ(500000000U, events[2].nanoseconds);
+        ASSERT_EQ(nanofill::events::EventType::ExecutionVisible, events[2].type);
+        ASSERT_EQ(25, events[2].size);
+    }
+}
+
+TEST(FileIO, LobsterStreamParserSkipsLongLines) {
+    nanofill::fileio::LobsterStreamParser parser;
+    std::size_t events = 0;
+    const std::string long_line(nanofill::fileio::LobsterStreamParser::max_line_length * 2, '1');
+    const std::string data = long_line + "\n34200.0,1,1,100,310400,1\n";
+
+    parser.feed(std::span(data.data(), 10), [&](auto) { ++events; });
+    parser.feed(std::span(data.data() + 10, data.size() - 10), [&](auto) { ++events; });
+
+    ASSERT_EQ(1U, events);
+    ASSERT_EQ(1U, parser.get_bad_lines());
+}
+
+// Write a LOBSTER file big enough to take several blocks, returning how many lines it has.
+std::size_t write_stream_test_data(std::ostream& out) {
+    std::size_t lines = 0;
+
+    while (lines * 30 < nanofill::fileio::stream_block_size * 3) {
+        out << "34200." << lines << ",1," << lines + 1 << ",1,100,1\n";
+        ++lines;
+    }
+
+    return lines;
+}
+
+std::size_t count_streamed_events(const std::string& path, bool& failed) {
+    nanofill::concurrency::SPSCRingBuffer<nanofill::events::Event, 1024> buffer;
+    std::atomic<bool> finished{false};
+    std::size_t consumed = 0;
+    std::uint32_t last_order_id = 0;
+
+    std::thread consumer([&] {
+        nanofill::events::Event event;
+
+        while (true) {
+            const bool done = finished.load();
+
+            if (buffer.pop(event)) {
+                EXPECT_EQ(last_order_id + 1, event.order_id);
+                last_order_id = event.order_id;
+                ++consumed;
+            } else if (done) {
+                return;
+            }
+        }
+    });
+
+    nanofill::threads::StreamStats stats;
+
+    try {
+        stats = nanofill::threads::stream_producer(path, buffer, finished);
+    } catch (...) {
+        finished = true;
+        consumer.join();
+        throw;
+    }
+
+    consumer.join();
+
+    EXPECT_EQ(stats.events, consumed);
+    failed = stats.failed;
+
+    return consumed;
+}
+
+TEST(FileIO, StreamFromFiles) {
+    const auto directory = std::filesystem::temp_directory_path() / "nanofill_stream_test";
+    std::filesystem::create_directories(directory);
+
+    const auto plain_path = (directory / "events.csv").string();
+    std::ofstream plain(plain_path);
+    const std::size_t lines = write_stream_test_data(plain);
+    plain.close();
+
+    std::stringstream text;
+    write_stream_test_data(text);
+    const auto gz_path = (directory / "events.csv.gz").string();
+    gzFile gz = gzopen(gz_path.c_str(), "wb");
+    gzwrite(gz, text.str().data(), text.str().size());
+    gzclose(gz);
+
+    bool failed = true;
+
+    ASSERT_EQ(lines, count_streamed_events(plain_path, failed));
+    ASSERT_FALSE(failed);
+    ASSERT_EQ(lines, count_streamed_events(gz_path, failed));
+    ASSERT_FALSE(failed);
+
+    // zstd isn't always installed.
+    if (std::system(("zstd -qf " + plain_path + " -o " + plain_path + ".zst 2>/dev/null").c_str()) == 0) {
+        ASSERT_EQ(lines, count_streamed_events(plain_path + ".zst", failed));
+        ASSERT_FALSE(failed);
+        ASSERT_EQ(0U, count_streamed_events((directory / "missing.csv.zst").string(), failed));
+        ASSERT_TRUE(failed);
+    }
+
+    ASSERT_THROW(count_streamed_events((directory / "missing.csv").string(), failed), std::runtime_error);
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST(FileIO, ItchDecoderMapsMessagesToEvents) {
+    using nanofill::events::Event;
+    using nanofill::events::EventType;
+    namespace itch = nanofill::fileio::itch;
+
+    constexpr std::uint64_t second = 1000000000;
+    std::vector<std::uint8_t> data;
+
+    itch::append_add_order(data, 34200 * second, 11, true, 100, 3100, 7);
+    itch::append_add_order(data, 34200 * second + 5, 12, false, 300, 3200, 7);
+    itch::append_order_executed(data, 34201 * second, 11, 40, 7);
+    itch::append_order_cancel(data, 34202 * second, 12, 100, 7);
+    itch::append_order_replace(data, 34203 * second, 12, 13, 250, 3300, 7);
+    itch::append_order_cancel(data, 34204 * second, 11, 60, 7);
+    itch::append_order_delete(data, 34205 * second, 13, 7);
+    // Neither of these is known any more.
+    // どちらももう知られていない。
+    itch::append_order_delete(data, 34206 * second, 11, 7);
+    itch::append_order_executed(data, 34206 * second, 99, 1, 7);
+
+    // A system event, which should be skipped.
+    // システムイベント。飛ばすべきだ。
+    const std::uint8_t system_event[] = { 0, 12, 'S', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 'O' };
+    data.insert(data.end(), std::begin(system_event), std::end(system_event));
+
+    nanofill::fileio::ItchDecoder decoder(16);
+    std::vector<Event> events;
+
+    // Leave off the last byte so the final message is incomplete.
+    // 最後のメッセージが不完全になるように、最後のバイトを外す。
+    const std::size_t used = decoder.decode_buffer({ data.data(), data.size() - 1 }, [&](const Event& event) {
+        events.push_back(event);
+    });
+
+    ASSERT_EQ(used, data.size() - sizeof(system_event));
+    ASSERT_EQ(decoder.decode_buffer({ data.data() + used, data.size() - used }, [&](const Event& event) {
+        events.push_back(event);
+    }), sizeof(system_event));
+
+    ASSERT_EQ(decoder.get_messages(), 10U);
+    ASSERT_EQ(decoder.get_skipped_messages(), 1U);
+    ASSERT_EQ(decoder.get_unknown_orders(), 2U);
+    ASSERT_EQ(decoder.get_live_order_count(), 0U);
+    ASSERT_EQ(events.size(), 8U);
+
+    const auto expect_event = [](const Event& event, EventType type, std::uint32_t order_id, std::uint32_t price, std::int16_t size, std::uint32_t time) {
+        EXPECT_EQ(event.type, type);
+        EXPECT_EQ(event.order_id, order_id);
+        EXPECT_EQ(event.price, price);
+        EXPECT_EQ(event.size, size);
+        EXPECT_EQ(event.time, time);
+        EXPECT_EQ(event.symbol_id, 7);
+    };
+
+    expect_event(events[0], EventType::Submission, 11, 3100, 100, 34200);
+    expect_event(events[1], EventType::Submission, 12, 3200, -300, 34200);
+    EXPECT_EQ(events[0].nanoseconds, 0U);
+    EXPECT_EQ(events[1].nanoseconds, 5U);
+    expect_event(events[2], EventType::ExecutionVisible, 11, 3100, 40, 34201);
+    expect_event(events[3], EventType::Cancellation, 12, 3200, -100, 34202);
+    // A replace is a delete of what's left of the old order and an add on the same side.
+    // 置き換えは古い注文の残りの削除と同じ側の追加だ。
+    expect_event(events[4], EventType::Deletion, 12, 3200, -200, 34203);
+    expect_event(events[5], EventType::Submission, 13, 3300, -250, 34203);
+    // Cancelling everything that's left is a delete.
+    // 残り全部の取消は削除だ。
+    expect_event(events[6], EventType::Deletion, 11, 3100, 60, 34204);
+    expect_event(events[7], EventType::Deletion, 13, 3300, -250, 34205);
+}
+
+TEST(FileIO, ItchDecoderFiltersStocksAndPrices) {
+    using nanofill::events::Event;
+    using nanofill::fileio::ItchDecoder;
+    using nanofill::fileio::ItchFilter;
+    namespace itch = nanofill::fileio::itch;
+
+    std::vector<std::uint8_t> data;
+
+    itch::append_add_order(data, 1, 1, true, 100, 3100, 8);
+    itch::append_add_order(data, 2, 2, true, 100, 3100, 7);
+    // A locate that doesn't fit in one byte.
+    // 1バイトに収まらない銘柄の位置。
+    itch::append_add_order(data, 3, 3, true, 100, 3100, 300);
+    // Past the highest price, and off the tick.
+    // 一番高い価格を超えたものと、呼値の単位から外れたもの。
+    itch::append_add_order(data, 4, 4, false, 100, 6000, 7);
+    itch::append_add_order(data, 5, 5, false, 100, 3150, 7);
+    // Replaced into range, then deleted.
+    // 範囲内に置き換えて、削除する。
+    itch::append_order_replace(data, 6, 4, 6, 100, 3200, 7);
+    itch::append_order_delete(data, 7, 5, 7);
+    itch::append_order_delete(data, 8, 6, 7);
+
+    const auto decode = [&](const ItchFilter& filter) {
+        ItchDecoder decoder(16, filter);
+        std::vector<Event> events;
+
+        decoder.decode_buffer(data, [&](const Event& event) { events.push_back(event); });
+
+        return std::pair(std::move(decoder), events);
+    };
+
+    const ItchFilter book { .min_price = 1000, .max_price = 5000, .tick_size = 100 };
+
+    // Every stock, as its own symbol.
+    // 全ての銘柄を、それ自身の銘柄として。
+    const auto [every_stock, every_stock_events] = decode(book);
+
+    ASSERT_EQ(every_stock.get_other_stock_messages(), 0U);
+    ASSERT_EQ(every_stock.get_out_of_range_events(), 4U);
+    ASSERT_EQ(every_stock.get_unknown_orders(), 0U);
+    ASSERT_EQ(every_stock.get_live_order_count(), 3U);
+    ASSERT_EQ(every_stock_events.size(), 5U);
+    ASSERT_EQ(every_stock_events[0].symbol_id, 8);
+    ASSERT_EQ(every_stock_events[1].symbol_id, 7);
+    ASSERT_EQ(every_stock_events[2].symbol_id, 300);
+    ASSERT_EQ(every_stock_events[3].order_id, 6U);
+    ASSERT_EQ(every_stock_events[4].type, nanofill::events::EventType::Deletion);
+
+    // One stock, as symbol 0.
+    // 一つの銘柄を、銘柄0として。
+    const auto [one_stock, one_stock_events] = decode({ .stock_locate = 300 });
+
+    ASSERT_EQ(one_stock.get_other_stock_messages(), 7U);
+    ASSERT_EQ(one_stock_events.size(), 1U);
+    ASSERT_EQ(one_stock_events[0].order_id, 3U);
+    ASSERT_EQ(one_stock_events[0].symbol_id, 0);
+
+    // The first stock with orders.
+    // 注文がある最初の銘柄。
+    const auto [first_stock, first_stock_events] = decode({ .first_stock = true });
+
+    ASSERT_EQ(first_stock.get_stock_locate(), 8U);
+    ASSERT_EQ(first_stock_events.size(), 1U);
+    ASSERT_EQ(first_stock_events[0].order_id, 1U);
+}
+
+struct ItchPolicy : nanofill::orderbook::DefaultOrderBookPolicy {
+    static constexpr Price max_price = 1000;
+    static constexpr std::size_t level_reserve = 4;
+    static constexpr std::size_t expected_orders = 10000;
+};
+
+TEST(FileIO, ItchDecoderFeedsOrderBook) {
+    namespace itch = nanofill::fileio::itch;
+
+    std::vector<std::uint8_t> data;
+
+    // Lots of orders coming and going, so the table wraps and shifts entries back on erase.
+    // 多くの注文が出入りするので、表が一周して、削除で項目を戻す。
+    for (std::uint64_t i = 1; i <= 2000; ++i) {
+        itch::append_add_order(data, i, i, i % 2 == 0, 10, 500 + (i % 2 == 0 ? -1 : 1) * static_cast<std::uint32_t>(i % 7 + 1));
+
+        if (i > 20) {
+            itch::append_order_delete(data, i, i - 20);
+        }
+    }
+
+    itch::append_order_replace(data, 3000, 2000, 5000, 30, 490);
+
+    nanofill::orderbook::BasicOrderBook<ItchPolicy> book;
+    nanofill::fileio::ItchDecoder decoder(64);
+
+    decoder.decode_buffer(data, [&](const nanofill::events::Event& event) {
+        ASSERT_TRUE(book.process_event(event));
+    });
+
+    ASSERT_EQ(decoder.get_unknown_orders(), 0U);
+    ASSERT_EQ(decoder.get_live_order_count(), 20U);
+    ASSERT_EQ(book.get_total_order_size_for_price(490), 30U);
+    ASSERT_EQ(book.get_best_bid(), 499U);
+    ASSERT_EQ(book.get_best_ask(), 501U);
+}
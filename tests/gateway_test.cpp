@@ -0,0 +1,179 @@
+#include "gtest/gtest.h"
+#include "gateway/gateway.hpp"
+#include "threads/threads.hpp"
+#include "memory/hugepages.hpp"
+#include <thread>
+#include <vector>
+
+using nanofill::events::Event;
+using nanofill::events::EventType;
+using nanofill::gateway::AckRing;
+using nanofill::gateway::OrderAction;
+using nanofill::gateway::OrderMessage;
+using nanofill::gateway::OrderRing;
+using nanofill::gateway::OrderRouter;
+using nanofill::gateway::Side;
+using nanofill::gateway::SimulatedGateway;
+using nanofill::risk::RiskChecker;
+using nanofill::risk::RiskLimits;
+using nanofill::risk::RiskLimitsStore;
+
+namespace {
+
+// Loose enough that nothing in these tests is stopped.
+const RiskLimits loose_limits { .max_order_size = 1000, .price_band_basis_points = 10000, .max_position = 1000000000,
+    .max_orders_per_second = 1e12, .max_burst = 1e12 };
+
+}
+
+TEST(Gateway, RouterCancelsAndReplacesWhenTargetsChange) {
+    auto orders = std::make_unique<OrderRing>();
+    auto acks = std::make_unique<AckRing>();
+    RiskLimitsStore limits(loose_limits);
+    RiskChecker risk(limits);
+    OrderRouter router(*orders, *acks, risk);
+    OrderMessage message;
+
+    router.on_targets(990, 1010, 1000, 1);
+    // Nothing changed, so nothing is sent.
+    router.on_targets(990, 1010, 1000, 2);
+    router.on_targets(995, 1010, 1000, 3);
+    router.on_targets(0, 1010, 1000, 4);
+
+    ASSERT_TRUE(orders->pop(message));
+    ASSERT_EQ(message.action, OrderAction::New);
+    ASSERT_EQ(message.side, Side::Buy);
+    ASSERT_EQ(message.price, 990U);
+    ASSERT_EQ(message.tick_tsc, 1U);
+    const std::uint32_t first_buy = message.order_id;
+
+    ASSERT_TRUE(orders->pop(message));
+    ASSERT_EQ(message.action, OrderAction::New);
+    ASSERT_EQ(message.side, Side::Sell);
+    ASSERT_EQ(message.price, 1010U);
+    ASSERT_EQ(message.size, 100U);
+
+    ASSERT_TRUE(orders->pop(message));
+    ASSERT_EQ(message.action, OrderAction::Cancel);
+    ASSERT_EQ(message.order_id, first_buy);
+    ASSERT_EQ(message.price, 990U);
+    ASSERT_EQ(message.tick_tsc, 3U);
+
+    ASSERT_TRUE(orders->pop(message));
+    ASSERT_EQ(message.action, OrderAction::New);
+    ASSERT_EQ(message.price, 995U);
+    const std::uint32_t second_buy = message.order_id;
+    ASSERT_NE(second_buy, first_buy);
+
+    // A target of 0 only cancels.
+    ASSERT_TRUE(orders->pop(message));
+    ASSERT_EQ(message.action, OrderAction::Cancel);
+    ASSERT_EQ(message.order_id, second_buy);
+    ASSERT_FALSE(orders->pop(message));
+
+    ASSERT_EQ(router.get_stats().new_orders, 3U);
+    ASSERT_EQ(router.get_stats().cancels, 2U);
+    ASSERT_EQ(router.get_outstanding(), 5U);
+}
+
+TEST(Gateway, AcksComeBackAfterTheDelay) {
+    auto orders = std::make_unique<OrderRing>();
+    auto acks = std::make_unique<AckRing>();
+    RiskLimitsStore limits(loose_limits);
+    RiskChecker risk(limits);
+    OrderRouter router(*orders, *acks, risk);
+    SimulatedGateway gateway(*orders, *acks, 50000000);
+
+    router.on_targets(990, 1010, 1000, nanofill::stats::read_tsc());
+    ASSERT_EQ(gateway.poll(), 2U);
+    ASSERT_FALSE(gateway.is_idle());
+
+    // Not due for another 50ms.
+    router.drain_acks();
+    ASSERT_EQ(router.get_stats().acks, 0U);
+
+    while (!gateway.is_idle()) {
+        gateway.poll();
+    }
+
+    router.drain_acks();
+    ASSERT_EQ(router.get_stats().acks, 2U);
+    ASSERT_EQ(router.get_outstanding(), 0U);
+    ASSERT_EQ(gateway.get_orders_received(), 2U);
+    ASSERT_EQ(router.get_stats().round_trip.get_count(), 2U);
+    ASSERT_GE(router.get_stats().round_trip.get_min(), 45000000U);
+    ASSERT_LT(router.get_stats().tick_to_trade.get_max(), 45000000U);
+}
+
+TEST(Gateway, ConsumerAndGatewayOnSeparateThreads) {
+    auto buffer = nanofill::memory::make_huge_page_unique<nanofill::concurrency::SPSCRingBuffer<Event, 1024>>();
+    auto orders = nanofill::memory::make_huge_page_unique<OrderRing>();
+    auto acks = nanofill::memory::make_huge_page_unique<AckRing>();
+    auto order_book = std::make_unique<nanofill::orderbook::OrderBook>();
+    nanofill::tradingengine::TradingEngine trading_engine(20);
+    RiskLimitsStore limits(loose_limits);
+    RiskChecker risk(limits);
+    OrderRouter router(*orders, *acks, risk);
+    SimulatedGateway gateway(*orders, *acks);
+    std::atomic<bool> orders_finished{false};
+    std::vector<Event> events;
+
+    // Every submission moves the average price, so both targets change every time. Buys and sells
+    // alternate so the book has a mid price from the second event on.
+    for (std::uint32_t i = 0; i < 5000; ++i) {
+        const bool buy = i % 2 == 0;
+        events.push_back({ .price = (buy ? 2900 : 3100) + i % 50, .time = i, .order_id = i + 1,
+            .size = static_cast<std::int16_t>(buy ? 100 : -100), .type = EventType::Submission, .symbol_id = 0 });
+    }
+
+    std::vector<unsigned int> performance_data(events.size());
+
+    std::thread gateway_thread(nanofill::threads::order_gateway, std::ref(gateway), std::cref(orders_finished));
+    std::thread producer(nanofill::threads::event_producer<1024>, std::ref(*buffer), std::cref(events));
+    nanofill::threads::event_consumer(*buffer, *order_book, trading_engine, performance_data,
+        nanofill::threads::ConsumerHooks{ .order_router = &router });
+    producer.join();
+
+    router.wait_for_acks();
+    orders_finished = true;
+    gateway_thread.join();
+
+    const auto& stats = router.get_stats();
+
+    ASSERT_GT(stats.new_orders, 0U);
+    ASSERT_EQ(stats.acks, stats.new_orders + stats.cancels);
+    ASSERT_EQ(stats.acks, gateway.get_orders_received());
+    ASSERT_EQ(stats.tick_to_trade.get_count(), stats.acks);
+    ASSERT_EQ(stats.round_trip.get_count(), stats.acks);
+    ASSERT_TRUE(gateway.is_idle());
+}
+
+TEST(Gateway, RouterDoesNotSendWhatRiskRejects) {
+    auto orders = std::make_unique<OrderRing>();
+    auto acks = std::make_unique<AckRing>();
+    RiskLimits limits = loose_limits;
+    limits.price_band_basis_points = 100;
+    RiskLimitsStore store(limits);
+    RiskChecker risk(store);
+    OrderRouter router(*orders, *acks, risk);
+    OrderMessage message;
+
+    // The sell is 2% away from the mid, outside the 1% band.
+    router.on_targets(995, 1020, 1000, 1);
+
+    ASSERT_TRUE(orders->pop(message));
+    ASSERT_EQ(message.side, Side::Buy);
+    ASSERT_FALSE(orders->pop(message));
+    ASSERT_EQ(router.get_stats().rejected, 1U);
+
+    // Not retried until the target moves, and then the rejected side has nothing to cancel.
+    router.on_targets(995, 1020, 1000, 2);
+    ASSERT_FALSE(orders->pop(message));
+    router.on_targets(995, 1005, 1000, 3);
+
+    ASSERT_TRUE(orders->pop(message));
+    ASSERT_EQ(message.action, OrderAction::New);
+    ASSERT_EQ(message.side, Side::Sell);
+    ASSERT_FALSE(orders->pop(message));
+    ASSERT_EQ(risk.get_stats().passed, 2U);
+}
@@ -0,0 +1,174 @@
+#include "gtest/gtest.h"
+#include "ipc/sharedbook.hpp"
+#include <memory>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using nanofill::events::Event;
+using nanofill::events::EventType;
+using nanofill::ipc::RecordKind;
+using nanofill::ipc::SharedBookReader;
+using nanofill::ipc::SharedBookWriter;
+using nanofill::ipc::SharedRecord;
+using Result = nanofill::ipc::SharedBookReader::Result;
+
+namespace {
+
+// A name no other test run will be using.
+// 他のテストの実行が使っていない名前。
+std::string test_segment_name(const char* test) {
+    return std::string("/nanofill_test_") + test + "_" + std::to_string(getpid());
+}
+
+Event make_event(const std::uint32_t order_id) {
+    return Event { .price = 3000, .time = 34200, .order_id = order_id, .size = 100, .type = EventType::Submission, .symbol_id = 0 };
+}
+
+}
+
+TEST(Ipc, ReaderSeesRecordsAndTopOfBook) {
+    SharedBookWriter writer(test_segment_name("records"), 16);
+    SharedBookReader reader(writer.get_name());
+    SharedRecord record;
+
+    ASSERT_EQ(reader.next(record), Result::Empty);
+    ASSERT_FALSE(reader.is_writer_closed());
+    ASSERT_EQ(reader.get_writer_pid(), static_cast<std::uint64_t>(getpid()));
+
+    writer.publish_event(make_event(7));
+    writer.publish_level(3000, 100, 34200);
+    writer.store_top_of_book({ .best_bid = 2990, .best_ask = 3000, .mid_price = 2995, .target_buy_price = 0, .target_sell_price = 0, .time = 34200 });
+
+    ASSERT_EQ(reader.get_lag(), 2U);
+    ASSERT_EQ(reader.next(record), Result::Record);
+    ASSERT_EQ(record.kind, RecordKind::Event);
+    ASSERT_EQ(record.event.order_id, 7U);
+    ASSERT_EQ(record.event.type, EventType::Submission);
+    ASSERT_EQ(reader.next(record), Result::Record);
+    ASSERT_EQ(record.kind, RecordKind::Level);
+    ASSERT_EQ(record.level.price, 3000U);
+    ASSERT_EQ(record.level.size, 100U);
+    ASSERT_EQ(record.level.last_modified, 34200U);
+    ASSERT_EQ(reader.next(record), Result::Empty);
+    ASSERT_EQ(reader.get_lag(), 0U);
+
+    const auto top_of_book = reader.load_top_of_book();
+
+    ASSERT_EQ(top_of_book.best_bid, 2990U);
+    ASSERT_EQ(top_of_book.best_ask, 3000U);
+    ASSERT_EQ(top_of_book.mid_price, 2995U);
+
+    // A reader attaching now starts at the newest record.
+    // 今接続する読み手は一番新しいレコードから始まる。
+    SharedBookReader late_reader(writer.get_name());
+    ASSERT_EQ(late_reader.next(record), Result::Empty);
+}
+
+TEST(Ipc, ReaderSkipsAheadWhenLapped) {
+    SharedBookWriter writer(test_segment_name("lapped"), 16);
+    SharedBookReader reader(writer.get_name());
+    SharedRecord record;
+
+    for (std::uint32_t i = 0; i < 40; ++i) {
+        writer.publish_event(make_event(i));
+    }
+
+    // It comes back half a ring behind the writer.
+    // 書き手の半周後ろに戻ってくる。
+    ASSERT_EQ(reader.next(record), Result::Overrun);
+    ASSERT_EQ(reader.get_lost_records(), 32U);
+
+    for (std::uint32_t i = 32; i < 40; ++i) {
+        ASSERT_EQ(reader.next(record), Result::Record);
+        ASSERT_EQ(record.event.order_id, i);
+    }
+
+    ASSERT_EQ(reader.next(record), Result::Empty);
+}
+
+TEST(Ipc, ReaderRejectsOtherSegments) {
+    ASSERT_THROW(SharedBookReader(test_segment_name("missing")), std::runtime_error);
+
+    const std::string name = test_segment_name("version");
+    auto writer = std::make_unique<SharedBookWriter>(name, 16);
+
+    // Pretend a newer writer made it.
+    // 新しい書き手が作ったふりをする。
+    const int file = shm_open(name.c_str(), O_RDWR, 0);
+    ASSERT_NE(file, -1);
+    void* memory = mmap(nullptr, sizeof(nanofill::ipc::SegmentHeader), PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    close(file);
+    ASSERT_NE(memory, MAP_FAILED);
+
+    auto header = static_cast<nanofill::ipc::SegmentHeader*>(memory);
+    header->version = nanofill::ipc::segment_version + 1;
+    ASSERT_THROW(SharedBookReader{name}, std::runtime_error);
+    header->version = nanofill::ipc::segment_version;
+    ASSERT_NO_THROW(SharedBookReader{name});
+
+    munmap(memory, sizeof(nanofill::ipc::SegmentHeader));
+
+    // Gone once the writer shuts down.
+    // 書き手が終了したらなくなる。
+    writer.reset();
+    ASSERT_THROW(SharedBookReader{name}, std::runtime_error);
+}
+
+TEST(Ipc, ReaderInAnotherProcess) {
+    constexpr std::uint32_t event_count = 10000;
+    auto writer = std::make_unique<SharedBookWriter>(test_segment_name("process"), 1 << 16);
+    int ready[2];
+
+    ASSERT_EQ(pipe(ready), 0);
+
+    const pid_t child = fork();
+    ASSERT_NE(child, -1);
+
+    if (child == 0) {
+        // Exit with 0 only if every event arrives, in order, followed by the writer closing.
+        // 全てのイベントが順番に届いて、その後書き手が閉じた場合だけ0で終わる。
+        int status = 1;
+
+        try {
+            SharedBookReader reader(writer->get_name());
+            SharedRecord record;
+            std::uint32_t expected = 0;
+            const char signal = 1;
+
+            if (write(ready[1], &signal, 1) == 1) {
+                while (expected < event_count) {
+                    const Result result = reader.next(record);
+
+                    if (result == Result::Overrun || (result == Result::Record && record.event.order_id != expected++)) {
+                        break;
+                    }
+                }
+
+                while (!reader.is_writer_closed()) {}
+
+                status = expected == event_count && reader.get_lost_records() == 0 ? 0 : 2;
+            }
+        } catch (...) {}
+
+        _exit(status);
+    }
+
+    char signal;
+    ASSERT_EQ(read(ready[0], &signal, 1), 1);
+    close(ready[0]);
+    close(ready[1]);
+
+    for (std::uint32_t i = 0; i < event_count; ++i) {
+        writer->publish_event(make_event(i));
+    }
+
+    writer.reset();
+
+    int status = -1;
+    ASSERT_EQ(waitpid(child, &status, 0), child);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+}
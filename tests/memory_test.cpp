@@ -0,0 +1,99 @@
+#include "gtest/gtest.h"
+#include "memory/hugepages.hpp"
+#include <cstring>
+#include <vector>
+
+using nanofill::memory::ArenaAllocator;
+using nanofill::memory::HugePageAllocator;
+using nanofill::memory::HugePageArena;
+
+TEST(Memory, AllocateHugePages) {
+    for (bool enabled : { true, false }) {
+        nanofill::memory::set_huge_pages_enabled(enabled);
+
+        auto memory = static_cast<char*>(nanofill::memory::allocate_huge_pages(3 * 1024 * 1024));
+
+        ASSERT_NE(nullptr, memory);
+
+        // Comes back zeroed and writable.
+        ASSERT_EQ(0, memory[0]);
+        ASSERT_EQ(0, memory[3 * 1024 * 1024 - 1]);
+        std::memset(memory, 1, 3 * 1024 * 1024);
+
+        nanofill::memory::free_huge_pages(memory, 3 * 1024 * 1024);
+    }
+
+    nanofill::memory::set_huge_pages_enabled(true);
+}
+
+TEST(Memory, HugePageAllocator) {
+    std::vector<int, HugePageAllocator<int>> values(1000, 5);
+
+    values.push_back(6);
+
+    ASSERT_EQ(1001U, values.size());
+    ASSERT_EQ(5, values[999]);
+    ASSERT_EQ(6, values[1000]);
+}
+
+TEST(Memory, HugePageArena) {
+    HugePageArena arena(64);
+
+    auto first = static_cast<char*>(arena.allocate(16));
+    auto second = static_cast<char*>(arena.allocate(10));
+
+    // Pieces are handed out in order and 16 byte aligned.
+    ASSERT_EQ(first + 16, second);
+
+    // Giving back the most recent piece lets it be reused.
+    arena.deallocate(second, 10);
+    ASSERT_EQ(second, arena.allocate(32));
+
+    // Once the arena is full it maps another chunk of huge pages.
+    auto chunk = static_cast<char*>(arena.allocate(32));
+    ASSERT_TRUE(chunk < first || chunk >= first + 64);
+    ASSERT_EQ(2U, arena.get_chunk_count());
+    ASSERT_EQ(64 + nanofill::memory::huge_page_size, arena.get_capacity());
+    arena.deallocate(chunk, 32);
+    ASSERT_EQ(chunk, arena.allocate(nanofill::memory::huge_page_size));
+
+    // Bigger than everything so far, so the next chunk is bigger too.
+    arena.allocate(16);
+    ASSERT_EQ(3U, arena.get_chunk_count());
+    ASSERT_EQ(64 + 3 * nanofill::memory::huge_page_size, arena.get_capacity());
+}
+
+TEST(Memory, ArenaAllocator) {
+    HugePageArena arena(1024);
+    std::vector<int, ArenaAllocator<int>> values{ ArenaAllocator<int>(&arena) };
+
+    values.reserve(10);
+    auto reserved = values.data();
+
+    for (int i = 0; i < 10; ++i) {
+        values.push_back(i);
+    }
+
+    // Growing past the arena's first chunk still works.
+    for (int i = 10; i < 1000; ++i) {
+        values.push_back(i);
+    }
+
+    ASSERT_NE(reserved, values.data());
+
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_EQ(i, values[i]);
+    }
+}
+
+TEST(Memory, MakeHugePageUnique) {
+    struct Pair {
+        int first;
+        int second;
+    };
+
+    auto pair = nanofill::memory::make_huge_page_unique<Pair>(1, 2);
+
+    ASSERT_EQ(1, pair->first);
+    ASSERT_EQ(2, pair->second);
+}
@@ -1,9 +1,18 @@
 #include "gtest/gtest.h"
 #include "orderbook/orderbook.hpp"
+#include "orderbook/policies.hpp"
+#include <random>
+#include <set>
+#include <type_traits>
+#include <vector>
 
 using nanofill::events::Event;
 using nanofill::events::EventType;
 using nanofill::orderbook::OrderBook;
+using nanofill::orderbook::BasicOrderBook;
+using nanofill::orderbook::DefaultOrderBookPolicy;
+using nanofill::orderbook::SideLayout;
+using nanofill::orderbook::LevelBitmap;
 
 TEST(OrderBook, ProcessSubmissionEvent) {
     auto orderbook = OrderBook();
@@ -222,4 +231,217 @@ TEST(OrderBook, ProcessDeletionEvent) {
     auto orders = orderbook.get_orders_for_price(10);
 
     ASSERT_EQ(orders.size(), 0U);
+}
+
+TEST(OrderBook, TracksBestBidAndAsk) {
+    auto orderbook = OrderBook();
+
+    ASSERT_EQ(0U, orderbook.get_best_bid());
+    ASSERT_EQ(0U, orderbook.get_best_ask());
+
+    // Buys at 10 and 12, sells at 20 and 15.
+    ASSERT_TRUE(orderbook.process_event({ .price = 10, .time = 100, .order_id = 1, .size = 5, .type = EventType::Submission }));
+    ASSERT_TRUE(orderbook.process_event({ .price = 12, .time = 101, .order_id = 2, .size = 5, .type = EventType::Submission }));
+    ASSERT_TRUE(orderbook.process_event({ .price = 20, .time = 102, .order_id = 3, .size = -5, .type = EventType::Submission }));
+    ASSERT_TRUE(orderbook.process_event({ .price = 15, .time = 103, .order_id = 4, .size = -5, .type = EventType::Submission }));
+
+    ASSERT_EQ(12U, orderbook.get_best_bid());
+    ASSERT_EQ(15U, orderbook.get_best_ask());
+    ASSERT_EQ(5U, orderbook.get_buy_size_for_price(12));
+    ASSERT_EQ(0U, orderbook.get_sell_size_for_price(12));
+    ASSERT_EQ(0U, orderbook.get_buy_size_for_price(15));
+    ASSERT_EQ(5U, orderbook.get_sell_size_for_price(15));
+
+    // A partial cancellation leaves the best prices alone.
+    ASSERT_TRUE(orderbook.process_event({ .price = 15, .time = 104, .order_id = 4, .size = 2, .type = EventType::Cancellation }));
+    ASSERT_EQ(15U, orderbook.get_best_ask());
+    ASSERT_EQ(3U, orderbook.get_sell_size_for_price(15));
+
+    // Emptying the best levels moves to the next ones.
+    ASSERT_TRUE(orderbook.process_event({ .price = 12, .time = 105, .order_id = 2, .size = 5, .type = EventType::Deletion }));
+    ASSERT_TRUE(orderbook.process_event({ .price = 15, .time = 106, .order_id = 4, .size = 3, .type = EventType::ExecutionVisible }));
+    ASSERT_EQ(10U, orderbook.get_best_bid());
+    ASSERT_EQ(20U, orderbook.get_best_ask());
+
+    // And then to nothing.
+    ASSERT_TRUE(orderbook.process_event({ .price = 10, .time = 107, .order_id = 1, .size = 5, .type = EventType::Deletion }));
+    ASSERT_TRUE(orderbook.process_event({ .price = 20, .time = 108, .order_id = 3, .size = 5, .type = EventType::Deletion }));
+    ASSERT_EQ(0U, orderbook.get_best_bid());
+    ASSERT_EQ(0U, orderbook.get_best_ask());
+}
+
+TEST(OrderBook, BestPricesJumpAcrossEmptyLevels) {
+    auto orderbook = OrderBook();
+
+    // The whole price range apart.
+    ASSERT_TRUE(orderbook.process_event({ .price = 1, .time = 100, .order_id = 1, .size = 5, .type = EventType::Submission }));
+    ASSERT_TRUE(orderbook.process_event({ .price = 250000, .time = 101, .order_id = 2, .size = 5, .type = EventType::Submission }));
+    ASSERT_TRUE(orderbook.process_event({ .price = 250100, .time = 102, .order_id = 3, .size = -5, .type = EventType::Submission }));
+    ASSERT_TRUE(orderbook.process_event({ .price = 499999, .time = 103, .order_id = 4, .size = -5, .type = EventType::Submission }));
+
+    ASSERT_TRUE(orderbook.process_event({ .price = 250000, .time = 104, .order_id = 2, .size = 5, .type = EventType::Deletion }));
+    ASSERT_TRUE(orderbook.process_event({ .price = 250100, .time = 105, .order_id = 3, .size = -5, .type = EventType::Deletion }));
+    ASSERT_EQ(1U, orderbook.get_best_bid());
+    ASSERT_EQ(499999U, orderbook.get_best_ask());
+}
+
+TEST(OrderBook, LevelBitmapFindsNeighbours) {
+    constexpr std::size_t levels = 300000;
+    LevelBitmap bitmap;
+    std::set<std::size_t> expected;
+    std::mt19937 random(5);
+
+    bitmap.resize(levels);
+    ASSERT_EQ(LevelBitmap::none, bitmap.find_below(levels));
+    ASSERT_EQ(LevelBitmap::none, bitmap.find_above(0));
+
+    for (int i = 0; i < 20000; ++i) {
+        const std::size_t level = random() % levels;
+        const bool set = random() % 3 != 0;
+
+        bitmap.assign(level, set);
+
+        if (set) {
+            expected.insert(level);
+        } else {
+            expected.erase(level);
+        }
+
+        const std::size_t probe = random() % levels;
+        const auto above = expected.upper_bound(probe);
+        const auto below = expected.lower_bound(probe);
+
+        ASSERT_EQ(above == expected.end() ? LevelBitmap::none : *above, bitmap.find_above(probe)) << probe;
+        ASSERT_EQ(below == expected.begin() ? LevelBitmap::none : *std::prev(below), bitmap.find_below(probe)) << probe;
+    }
+}
+
+TEST(OrderBook, ProcessEventsInBatch) {
+    auto orderbook = OrderBook();
+
+    Event events[] = {
+        { .price = 10, .time = 100, .order_id = 1, .size = 10, .type = EventType::Submission },
+        // Order doesn't exist.
+        { .price = 10, .time = 101, .order_id = 2, .size = 0, .type = EventType::Deletion },
+        { .price = 20, .time = 102, .order_id = 3, .size = -5, .type = EventType::Submission },
+        { .price = 10, .time = 103, .order_id = 1, .size = 4, .type = EventType::Cancellation },
+        // Hidden executions are never actioned.
+        { .price = 20, .time = 104, .order_id = 4, .size = 1, .type = EventType::ExecutionHidden },
+    };
+
+    ASSERT_EQ(0b01101U, orderbook.process_events(events));
+
+    ASSERT_EQ(103U, orderbook.get_last_modified_for_price(10));
+    ASSERT_EQ(6U, orderbook.get_total_order_size_for_price(10));
+    ASSERT_EQ(5U, orderbook.get_total_order_size_for_price(20));
+    ASSERT_EQ(10U, orderbook.get_best_bid());
+    ASSERT_EQ(20U, orderbook.get_best_ask());
+}
+
+
+TEST(OrderBook, ProcessEventsLongerThanABatch) {
+    auto orderbook = OrderBook();
+    std::vector<Event> events;
+
+    for (std::uint32_t i = 0; i < 200; ++i) {
+        events.push_back({ .price = 100 + i % 7, .time = 100 + i, .order_id = i, .size = 1, .type = EventType::Submission });
+    }
+
+    // Every event is processed, and the mask covers the first batch.
+    ASSERT_EQ(~0ULL, orderbook.process_events(events));
+
+    std::uint32_t total = 0;
+
+    for (std::uint32_t price = 100; price < 107; ++price) {
+        total += orderbook.get_total_order_size_for_price(price);
+    }
+
+    ASSERT_EQ(200U, total);
+}
+
+struct TinyPolicy : DefaultOrderBookPolicy {
+    static constexpr Price min_price = 1000;
+    static constexpr Price max_price = 2000;
+    static constexpr Price tick_size = 10;
+    static constexpr std::size_t level_reserve = 0;
+    static constexpr std::size_t expected_orders = 1000;
+    static constexpr SideLayout side_layout = SideLayout::TotalsOnly;
+};
+
+using TinyOrderBook = BasicOrderBook<TinyPolicy>;
+
+TEST(OrderBook, CustomPolicy) {
+    static_assert(TinyOrderBook::levels == 101);
+    static_assert(TinyOrderBook::level_of(1000) == 0);
+    static_assert(TinyOrderBook::level_of(2000) == 100);
+    static_assert(TinyOrderBook::price_of(50) == 1500);
+
+    auto orderbook = TinyOrderBook();
+
+    ASSERT_TRUE(orderbook.process_event({ .price = 1000, .time = 100, .order_id = 1, .size = 5, .type = EventType::Submission }));
+    ASSERT_TRUE(orderbook.process_event({ .price = 2000, .time = 101, .order_id = 2, .size = -7, .type = EventType::Submission }));
+    ASSERT_TRUE(orderbook.process_event({ .price = 2000, .time = 102, .order_id = 3, .size = -1, .type = EventType::Submission }));
+    ASSERT_TRUE(orderbook.process_event({ .price = 2000, .time = 103, .order_id = 2, .size = 2, .type = EventType::Cancellation }));
+    ASSERT_FALSE(orderbook.process_event({ .price = 1500, .time = 104, .order_id = 1, .size = 5, .type = EventType::Deletion }));
+
+    ASSERT_EQ(5U, orderbook.get_total_order_size_for_price(1000));
+    ASSERT_EQ(6U, orderbook.get_total_order_size_for_price(2000));
+    ASSERT_EQ(103U, orderbook.get_last_modified_for_price(2000));
+    ASSERT_EQ(2U, orderbook.get_orders_for_price(2000).size());
+    ASSERT_EQ(-5, orderbook.get_orders_for_price(2000)[0].size);
+}
+
+TEST(OrderBook, IgnoresPricesWithoutALevel) {
+    static_assert(TinyOrderBook::is_valid_price(1000));
+    static_assert(TinyOrderBook::is_valid_price(2000));
+    static_assert(!TinyOrderBook::is_valid_price(990));
+    static_assert(!TinyOrderBook::is_valid_price(2010));
+    static_assert(!TinyOrderBook::is_valid_price(1005));
+
+    auto orderbook = TinyOrderBook();
+
+    // Below the range, above it and between ticks.
+    ASSERT_FALSE(orderbook.process_event({ .price = 10, .time = 100, .order_id = 1, .size = 5, .type = EventType::Submission }));
+    ASSERT_FALSE(orderbook.process_event({ .price = 5000000, .time = 101, .order_id = 2, .size = 5, .type = EventType::Submission }));
+    ASSERT_FALSE(orderbook.process_event({ .price = 1005, .time = 102, .order_id = 3, .size = 5, .type = EventType::Submission }));
+
+    Event events[] = {
+        { .price = 1010, .time = 103, .order_id = 4, .size = 5, .type = EventType::Submission },
+        { .price = 4000000, .time = 104, .order_id = 5, .size = 5, .type = EventType::Submission },
+    };
+
+    ASSERT_EQ(0b01U, orderbook.process_events(events));
+    ASSERT_EQ(0U, orderbook.get_total_order_size_for_price(1000));
+    ASSERT_EQ(5U, orderbook.get_total_order_size_for_price(1010));
+}
+
+TEST(OrderBook, OrderPoolGrowsPastExpectedOrders) {
+    // Running out of memory while building a book can be caught.
+    static_assert(!std::is_nothrow_default_constructible_v<TinyOrderBook>);
+
+    auto orderbook = TinyOrderBook();
+
+    // Far more than the pool starts with room for, all on one level.
+    for (std::uint32_t i = 0; i < 20 * TinyPolicy::expected_orders; ++i) {
+        ASSERT_TRUE(orderbook.process_event({ .price = 1500, .time = i, .order_id = i + 1, .size = 1, .type = EventType::Submission }));
+    }
+
+    ASSERT_EQ(20 * TinyPolicy::expected_orders, orderbook.get_total_order_size_for_price(1500));
+    ASSERT_EQ(20 * TinyPolicy::expected_orders, orderbook.get_orders_for_price(1500).size());
+    ASSERT_EQ(20 * TinyPolicy::expected_orders, orderbook.get_orders_for_price(1500).back().order_id);
+}
+
+TEST(OrderBook, FuturesPolicy) {
+    auto orderbook = nanofill::orderbook::FuturesOrderBook();
+
+    // $4,000.00 and $4,000.25.
+    ASSERT_TRUE(orderbook.process_event({ .price = 40000000, .time = 100, .order_id = 1, .size = 5, .type = EventType::Submission }));
+    ASSERT_TRUE(orderbook.process_event({ .price = 40002500, .time = 101, .order_id = 2, .size = -5, .type = EventType::Submission }));
+    ASSERT_TRUE(orderbook.process_event({ .price = 39997500, .time = 102, .order_id = 3, .size = 5, .type = EventType::Submission }));
+
+    ASSERT_EQ(40000000U, orderbook.get_best_bid());
+    ASSERT_EQ(40002500U, orderbook.get_best_ask());
+
+    ASSERT_TRUE(orderbook.process_event({ .price = 40000000, .time = 103, .order_id = 1, .size = 5, .type = EventType::Deletion }));
+    ASSERT_EQ(39997500U, orderbook.get_best_bid());
 }
\ No newline at end of file
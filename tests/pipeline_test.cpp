@@ -0,0 +1,49 @@
+#include "gtest/gtest.h"
+#include "threads/pipeline.hpp"
+#include <thread>
+
+using nanofill::events::Event;
+using nanofill::events::EventType;
+using nanofill::orderbook::OrderBook;
+using nanofill::threads::PipelineRing;
+using nanofill::threads::ActionedResults;
+using nanofill::tradingengine::TradingEngine;
+
+TEST(Pipeline, BookEngineAndJournalOnSeparateThreads) {
+    using Ring = PipelineRing<64, 3>;
+
+    // 0 is the book, 1 is the engine (after the book), 2 is a journal reading alongside the book.
+    auto ring = std::make_unique<Ring>(std::array<std::size_t, 3>{ Ring::no_dependency, 0, Ring::no_dependency });
+    auto order_book = std::make_unique<OrderBook>();
+    ActionedResults<64> actioned;
+    TradingEngine trading_engine(20);
+    std::vector<Event> journal;
+
+    std::vector<Event> events;
+
+    for (std::uint32_t i = 0; i < 1000; ++i) {
+        events.push_back({ .price = 10, .time = i, .order_id = i, .size = 1, .type = EventType::Submission });
+    }
+
+    // Deleting an order that doesn't exist isn't actioned, so the engine shouldn't see it.
+    events.push_back({ .price = 10, .time = 1000, .order_id = 5000, .size = 1, .type = EventType::Deletion });
+
+    std::thread producer(nanofill::threads::pipeline_producer<64, 3>, std::ref(*ring), std::ref(events));
+    std::thread book(nanofill::threads::book_stage<64, 3>, std::ref(*ring), 0, std::ref(*order_book), std::ref(actioned), events.size());
+    std::thread engine(nanofill::threads::engine_stage<64, 3>, std::ref(*ring), 1, std::ref(trading_engine), std::cref(actioned), events.size());
+    std::thread journal_thread([&] {
+        nanofill::threads::run_pipeline_stage(*ring, 2, events.size(), [&](const Event& event, std::size_t) {
+            journal.push_back(event);
+        });
+    });
+
+    producer.join();
+    book.join();
+    engine.join();
+    journal_thread.join();
+
+    ASSERT_EQ(1000U, order_book->get_total_order_size_for_price(10));
+    ASSERT_EQ(1000U, trading_engine.market_shares);
+    ASSERT_EQ(1001U, journal.size());
+    ASSERT_EQ(5000U, journal[1000].order_id);
+}
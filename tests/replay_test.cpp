@@ -0,0 +1,135 @@
+#include "gtest/gtest.h"
+#include "replay/replay.hpp"
+#include "stats/latencyhistogram.hpp"
+#include "storage/eventstore.hpp"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+using nanofill::events::Event;
+using nanofill::events::EventType;
+using nanofill::orderbook::DefaultOrderBookPolicy;
+using nanofill::replay::ReplayOptions;
+using nanofill::stats::LatencyHistogram;
+
+struct ReplayPolicy : DefaultOrderBookPolicy {
+    static constexpr Price max_price = 1000;
+    static constexpr std::size_t level_reserve = 4;
+    static constexpr std::size_t expected_orders = 10000;
+};
+
+TEST(Replay, LatencyHistogram) {
+    LatencyHistogram histogram;
+
+    ASSERT_EQ(0U, histogram.get_percentile(0.5));
+
+    for (std::uint32_t i = 1; i <= 100; ++i) {
+        histogram.record(i);
+    }
+
+    // Small values are exact.
+    ASSERT_EQ(100U, histogram.get_count());
+    ASSERT_EQ(1U, histogram.get_min());
+    ASSERT_EQ(50U, histogram.get_percentile(0.495));
+    ASSERT_EQ(100U, histogram.get_percentile(1));
+
+    LatencyHistogram other;
+    other.record(1000000);
+    histogram.merge(other);
+
+    // Big values are within a bucket.
+    ASSERT_EQ(101U, histogram.get_count());
+    ASSERT_EQ(1000000U, histogram.get_max());
+    ASSERT_NEAR(1000000.0, histogram.get_percentile(0.999), 1000000.0 / 64);
+}
+
+TEST(Replay, ReplaysEveryDayBiggestFirst) {
+    const auto directory = std::filesystem::temp_directory_path() / "nanofill_replay_test";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    // Day n has n buy orders at price 100 and one execution of 1 share.
+    for (int day = 1; day <= 3; ++day) {
+        std::ofstream file(directory / ("TEST_2012-06-2" + std::to_string(day) + "_0_0_message_10.csv"));
+
+        for (int order = 0; order < day; ++order) {
+            file << "34200." << order << ",1," << order + 1 << ",10,100,1\n";
+        }
+
+        file << "34300.0,4,1,1,100,1\n";
+    }
+
+    // Not a message file, so a directory doesn't pick it up.
+    std::ofstream(directory / "TEST_2012-06-21_0_0_orderbook_10.csv") << "1,2,3,4\n";
+
+    auto files = nanofill::replay::find_replay_files(directory.string());
+
+    ASSERT_EQ(3U, files.size());
+    ASSERT_GE(files[0].size, files[1].size);
+    ASSERT_GE(files[1].size, files[2].size);
+
+    // Globs work too.
+    ASSERT_EQ(1U, nanofill::replay::find_replay_files((directory / "*06-22*message*").string()).size());
+    ASSERT_THROW(nanofill::replay::find_replay_files((directory / "nothing*").string()), std::runtime_error);
+
+    const auto reports = nanofill::replay::run_replay<ReplayPolicy>(files, ReplayOptions {
+        .threads = 2,
+        .memory_budget = 1,
+        .price_spread = 10
+    });
+
+    ASSERT_EQ(3U, reports.size());
+
+    for (std::size_t i = 0; i < reports.size(); ++i) {
+        const std::uint64_t orders = 3 - i;
+
+        ASSERT_EQ(files[i].path, reports[i].path);
+        ASSERT_EQ(orders + 1, reports[i].events);
+        ASSERT_EQ(orders + 1, reports[i].actioned);
+        ASSERT_EQ(orders + 1, reports[i].latency.get_count());
+        ASSERT_EQ(1U, reports[i].executions);
+        // The book removes an executed order entirely, which empties the first day's book.
+        ASSERT_EQ(orders > 1 ? 100U : 0U, reports[i].best_bid);
+        ASSERT_EQ(90U, reports[i].target_buy_price);
+    }
+
+    std::ostringstream report;
+    nanofill::replay::print_replay_report(report, reports);
+
+    ASSERT_NE(std::string::npos, report.str().find("Events: 9 (9 actioned)"));
+    ASSERT_NE(std::string::npos, report.str().find("best bid    best ask"));
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST(Replay, ReplaysFromACompressedStore) {
+    std::vector<Event> events;
+
+    // Orders around 500 that are all deleted or executed a few events later, over a few blocks.
+    for (std::uint32_t i = 0; i < 700; ++i) {
+        const bool buy = i % 2 == 0;
+
+        events.push_back({ .price = (buy ? 400 : 600) + i % 20 * 5, .time = 34200 + i / 10, .order_id = i + 1,
+            .size = static_cast<std::int16_t>(buy ? 100 : -100), .type = EventType::Submission, .symbol_id = 0 });
+
+        if (i >= 10 && i % 3 == 0) {
+            Event removal = events[events.size() - 10];
+            removal.type = i % 2 == 0 ? EventType::ExecutionVisible : EventType::Deletion;
+            events.push_back(removal);
+        }
+    }
+
+    const nanofill::storage::CompressedEventStore store(events);
+    const auto expected = nanofill::replay::replay_day<ReplayPolicy>(events, 10);
+    const auto actual = nanofill::replay::replay_day<ReplayPolicy>(store, 10);
+
+    ASSERT_EQ(events.size(), actual.events);
+    ASSERT_EQ(expected.actioned, actual.actioned);
+    ASSERT_EQ(expected.executions, actual.executions);
+    ASSERT_EQ(expected.executed_shares, actual.executed_shares);
+    ASSERT_EQ(expected.average_share_price, actual.average_share_price);
+    ASSERT_EQ(expected.best_bid, actual.best_bid);
+    ASSERT_EQ(expected.best_ask, actual.best_ask);
+    ASSERT_EQ(events.size(), actual.latency.get_count());
+    ASSERT_GT(actual.executions, 0U);
+}
@@ -0,0 +1,154 @@
+#include "gtest/gtest.h"
+#include "risk/riskchecker.hpp"
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+
+using nanofill::risk::RiskCheck;
+using nanofill::risk::RiskChecker;
+using nanofill::risk::RiskLimits;
+using nanofill::risk::RiskLimitsStore;
+
+namespace {
+
+const RiskLimits test_limits { .max_order_size = 500, .price_band_basis_points = 100, .max_position = 1000,
+    .max_orders_per_second = 1e12, .max_burst = 1e12 };
+
+// Ticks in a second, for driving the token bucket by hand.
+std::uint64_t ticks_per_second() {
+    return static_cast<std::uint64_t>(nanofill::stats::tsc_ticks_per_nanosecond() * 1e9);
+}
+
+}
+
+TEST(Risk, EachCheckSetsItsOwnBit) {
+    RiskLimitsStore store(test_limits);
+    RiskChecker risk(store);
+
+    ASSERT_EQ(risk.check_new_order(0, 10000, 100, 10000, 1), 0U);
+    ASSERT_EQ(risk.check_new_order(0, 10000, 501, 10000, 2), RiskCheck::OrderSize);
+    // 1% either side of the reference is fine, beyond it isn't.
+    ASSERT_EQ(risk.check_new_order(1, 10100, 100, 10000, 3), 0U);
+    ASSERT_EQ(risk.check_new_order(1, 10101, 100, 10000, 4), RiskCheck::PriceBand);
+    ASSERT_EQ(risk.check_new_order(0, 9899, 100, 10000, 5), RiskCheck::PriceBand);
+    // No reference price means no band to be inside.
+    ASSERT_EQ(risk.check_new_order(0, 10000, 100, 0, 6), RiskCheck::PriceBand);
+    // Everything failing at once.
+    ASSERT_EQ(risk.check_new_order(0, 20000, 600, 10000, 7), RiskCheck::OrderSize | RiskCheck::PriceBand);
+
+    const auto& stats = risk.get_stats();
+    ASSERT_EQ(stats.passed, 2U);
+    ASSERT_EQ(stats.failed[0], 2U);
+    ASSERT_EQ(stats.failed[1], 4U);
+    ASSERT_EQ(stats.failed[2], 0U);
+}
+
+TEST(Risk, PositionCountsRestingOrdersAndFills) {
+    RiskLimitsStore store(test_limits);
+    RiskChecker risk(store);
+
+    // Two buys of 500 fill the limit; a third would go over.
+    ASSERT_EQ(risk.check_new_order(0, 10000, 500, 10000, 1), 0U);
+    ASSERT_EQ(risk.check_new_order(0, 10000, 500, 10000, 2), 0U);
+    ASSERT_EQ(risk.check_new_order(0, 10000, 1, 10000, 3), RiskCheck::Position);
+
+    // Selling doesn't add to the long side.
+    ASSERT_EQ(risk.check_new_order(1, 10000, 500, 10000, 4), 0U);
+
+    risk.on_cancel(0, 500);
+    ASSERT_EQ(risk.check_new_order(0, 10000, 500, 10000, 5), 0U);
+
+    // Once filled, a long position makes room on the short side.
+    risk.on_fill(0, 500);
+    risk.on_fill(0, 500);
+    ASSERT_EQ(risk.get_position(), 1000);
+    ASSERT_EQ(risk.check_new_order(0, 10000, 1, 10000, 6), RiskCheck::Position);
+    ASSERT_EQ(risk.check_new_order(1, 10000, 500, 10000, 7), 0U);
+}
+
+TEST(Risk, TokenBucketLimitsTheMessageRate) {
+    RiskLimits limits = test_limits;
+    limits.max_orders_per_second = 10;
+    limits.max_burst = 2;
+    RiskLimitsStore store(limits);
+    RiskChecker risk(store);
+    const std::uint64_t second = ticks_per_second();
+    const std::uint64_t start = 1000 * second;
+
+    ASSERT_EQ(risk.check_new_order(0, 10000, 1, 10000, start), 0U);
+    ASSERT_EQ(risk.check_new_order(1, 10000, 1, 10000, start), 0U);
+    ASSERT_EQ(risk.check_new_order(0, 10000, 1, 10000, start), RiskCheck::MessageRate);
+
+    // A tenth of a second buys one more order, not two.
+    ASSERT_EQ(risk.check_new_order(0, 10000, 1, 10000, start + second / 10 + second / 100), 0U);
+    ASSERT_EQ(risk.check_new_order(0, 10000, 1, 10000, start + second / 10 + second / 100), RiskCheck::MessageRate);
+
+    // Waiting longer never saves up more than the burst.
+    const std::uint64_t later = start + 100 * second;
+    ASSERT_EQ(risk.check_new_order(0, 10000, 1, 10000, later), 0U);
+    ASSERT_EQ(risk.check_new_order(0, 10000, 1, 10000, later), 0U);
+    ASSERT_EQ(risk.check_new_order(0, 10000, 1, 10000, later), RiskCheck::MessageRate);
+}
+
+TEST(Risk, ParsesLimitsFiles) {
+    std::istringstream in(
+        "# Tighter limits for the open\n"
+        "max_order_size 200\n"
+        "\n"
+        "max_orders_per_second 5000   # per second\n"
+    );
+    const RiskLimits limits = nanofill::risk::parse_risk_limits(in);
+
+    ASSERT_EQ(limits.max_order_size, 200U);
+    ASSERT_EQ(limits.max_orders_per_second, 5000);
+    // Not given, so left alone.
+    ASSERT_EQ(limits.max_position, RiskLimits{}.max_position);
+
+    std::istringstream unknown("max_shares 10\n");
+    ASSERT_THROW(nanofill::risk::parse_risk_limits(unknown), std::runtime_error);
+    std::istringstream bad("max_order_size lots\n");
+    ASSERT_THROW(nanofill::risk::parse_risk_limits(bad), std::runtime_error);
+    ASSERT_THROW(nanofill::risk::load_risk_limits("/nonexistent/limits"), std::runtime_error);
+}
+
+TEST(Risk, ReloadSwapsLimitsWithoutTheTradingThreadWaiting) {
+    RiskLimitsStore store(test_limits);
+    RiskChecker risk(store);
+
+    ASSERT_EQ(risk.check_new_order(0, 10000, 400, 10000, 1), 0U);
+
+    RiskLimits tighter = test_limits;
+    tighter.max_order_size = 300;
+    store.publish(tighter);
+
+    // The next order sees the new limits straight away.
+    ASSERT_EQ(risk.check_new_order(0, 10000, 400, 10000, 2), RiskCheck::OrderSize);
+
+    // The old copy is kept until the trading thread says it's done with it.
+    ASSERT_EQ(store.get_retired_count(), 1U);
+    risk.quiescent();
+    ASSERT_EQ(store.get_retired_count(), 0U);
+
+    // And reloading from a file that changes underneath a watcher.
+    const std::string path = std::filesystem::temp_directory_path() / ("nanofill_risk_" + std::to_string(getpid()));
+    std::ofstream(path) << "max_order_size 300\n";
+    std::atomic<bool> stop{false};
+    std::thread watcher(nanofill::risk::watch_risk_limits, std::ref(store), path, std::cref(stop));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    std::ofstream(path) << "max_order_size 50\n";
+    std::filesystem::last_write_time(path, std::filesystem::last_write_time(path) + std::chrono::seconds(1));
+
+    for (int i = 0; i < 100 && store.read().max_order_size != 50; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    stop = true;
+    watcher.join();
+    std::filesystem::remove(path);
+
+    ASSERT_EQ(store.read().max_order_size, 50U);
+}
@@ -0,0 +1,183 @@
+#include "gtest/gtest.h"
+#include "stats/perfcounters.hpp"
+#include "stats/flightrecorder.hpp"
+#include <sstream>
+#include <thread>
+
+using nanofill::events::Event;
+using nanofill::events::EventType;
+using nanofill::stats::FlightRecorder;
+using nanofill::stats::FlightRecorderOptions;
+using nanofill::stats::PerfCounter;
+using nanofill::stats::PerfCounterGroup;
+using nanofill::stats::PerfCounterReport;
+using nanofill::stats::PerfCounterValues;
+using nanofill::stats::Phase;
+
+TEST(Stats, PerfCounterReport) {
+    PerfCounterReport report;
+
+    report.add(EventType::Submission, Phase::Book, { 100, 200, 1, 0, 2, 0 }, { 150, 300, 3, 1, 2, 1 });
+    report.add(EventType::Submission, Phase::Book, { 150, 300, 3, 1, 2, 1 }, { 250, 350, 3, 1, 3, 1 });
+    report.add(EventType::Deletion, Phase::Engine, {}, { 10, 20, 0, 0, 0, 0 });
+    // Unknown types are counted together.
+    // 分からない種類はまとめて数える。
+    report.add(static_cast<EventType>(42), Phase::Book, {}, { 5, 5, 5, 5, 5, 5 });
+
+    ASSERT_EQ(report.get_events(EventType::Submission, Phase::Book), 2U);
+    ASSERT_EQ(report.get_events(EventType::Submission, Phase::Engine), 0U);
+    ASSERT_EQ(report.get_total(EventType::Submission, Phase::Book, PerfCounter::Cycles), 150U);
+    ASSERT_EQ(report.get_total(EventType::Submission, Phase::Book, PerfCounter::Instructions), 150U);
+    ASSERT_EQ(report.get_total(EventType::Submission, Phase::Book, PerfCounter::L1DMisses), 2U);
+    ASSERT_EQ(report.get_total(EventType::Submission, Phase::Book, PerfCounter::BranchMisses), 1U);
+    ASSERT_EQ(report.get_total(EventType::Deletion, Phase::Engine, PerfCounter::Instructions), 20U);
+    ASSERT_EQ(report.get_events(static_cast<EventType>(0), Phase::Book), 1U);
+
+    std::ostringstream out;
+    nanofill::stats::print_perf_counter_report(out, report);
+
+    EXPECT_NE(out.str().find("submission        book"), std::string::npos);
+    EXPECT_NE(out.str().find("deletion          engine"), std::string::npos);
+    EXPECT_EQ(out.str().find("submission        engine"), std::string::npos);
+}
+
+TEST(Stats, PerfCounterReportScalesMultiplexedCounts) {
+    PerfCounterReport report;
+
+    report.add(EventType::Submission, Phase::Extras, {}, { 100, 300, 0, 0, 0, 0 });
+    EXPECT_EQ(report.get_scale(), 1.0);
+
+    // On the CPU a quarter of the time, so four times as much would have been counted.
+    // 四分の一の時間しかCPUにいなかったので、四倍数えたはずだ。
+    report.set_times(4000, 1000);
+    EXPECT_EQ(report.get_scale(), 4.0);
+
+    std::ostringstream out;
+    nanofill::stats::print_perf_counter_report(out, report);
+
+    EXPECT_NE(out.str().find("submission        extras"), std::string::npos);
+    EXPECT_NE(out.str().find("400.0"), std::string::npos);
+    EXPECT_NE(out.str().find("1200.0"), std::string::npos);
+    EXPECT_NE(out.str().find("3.00"), std::string::npos);
+    EXPECT_NE(out.str().find("scaled by 4"), std::string::npos);
+}
+
+TEST(Stats, PerfCounterGroupCounts) {
+    const PerfCounterGroup counters;
+
+    if (!counters.is_available()) {
+        GTEST_SKIP() << "Hardware counters aren't available here";
+    }
+
+    PerfCounterValues start;
+    PerfCounterValues end;
+    volatile std::uint64_t total = 0;
+
+    counters.read(start);
+
+    for (std::uint64_t i = 0; i < 100000; ++i) {
+        total = total + i;
+    }
+
+    counters.read(end);
+
+    if (counters.is_counting(PerfCounter::Instructions)) {
+        EXPECT_GT(end[static_cast<std::size_t>(PerfCounter::Instructions)] - start[static_cast<std::size_t>(PerfCounter::Instructions)], 100000U);
+    }
+}
+
+TEST(Stats, FlightRecorderFreezesAroundOutliers) {
+    FlightRecorder recorder(FlightRecorderOptions {
+        .capacity = 16,
+        .threshold_nanoseconds = 1000,
+        .window_before = 4,
+        .window_after = 2,
+        .max_snapshots = 2,
+        .thread_id = 3
+    });
+
+    // Far longer than the threshold at any TSC rate.
+    // どのTSCの速さでも閾値よりずっと長い。
+    constexpr std::uint64_t slow = 1000000000;
+
+    const auto record = [&](const std::uint32_t order_id, const std::uint64_t ticks) {
+        const Event event { .price = 100, .time = 1, .order_id = order_id, .size = 10, .type = EventType::Submission, .symbol_id = 0 };
+        recorder.record(event, order_id * slow * 2, order_id * slow * 2 + ticks, order_id % 5, 0);
+    };
+
+    for (std::uint32_t i = 0; i < 40; ++i) {
+        record(i, i == 20 || i == 21 || i == 30 || i == 38 ? slow : 10);
+    }
+
+    recorder.flush();
+
+    // 21 is inside 20's window, and 38 is past the snapshot limit.
+    // 21は20の窓の中にあって、38はスナップショットの上限を超えている。
+    ASSERT_EQ(recorder.get_outlier_count(), 4U);
+    ASSERT_EQ(recorder.get_snapshots().size(), 2U);
+
+    const auto& first = recorder.get_snapshots()[0];
+    ASSERT_EQ(first.records.size(), 7U);
+    ASSERT_EQ(first.outlier, 4U);
+    ASSERT_EQ(first.records.front().event.order_id, 16U);
+    ASSERT_EQ(first.records[first.outlier].event.order_id, 20U);
+    ASSERT_EQ(first.records.back().event.order_id, 22U);
+    ASSERT_EQ(first.records.back().level_depth, 2U);
+
+    ASSERT_EQ(recorder.get_snapshots()[1].records[recorder.get_snapshots()[1].outlier].event.order_id, 30U);
+
+    std::ostringstream out;
+    const FlightRecorder* recorders[] = { &recorder };
+    nanofill::stats::write_chrome_trace(out, recorders);
+    const std::string trace = out.str();
+
+    std::size_t slices = 0;
+
+    for (std::size_t position = trace.find("\"ph\":\"X\""); position != std::string::npos; position = trace.find("\"ph\":\"X\"", position + 1)) {
+        ++slices;
+    }
+
+    EXPECT_EQ(slices, 14U);
+    EXPECT_NE(trace.find("\"name\":\"outlier\""), std::string::npos);
+    EXPECT_NE(trace.find("\"tid\":3"), std::string::npos);
+    EXPECT_EQ(trace.front(), '{');
+    EXPECT_EQ(trace.substr(trace.size() - 3), "]}\n");
+}
+
+TEST(Stats, FlightRecorderFlushesShortWindows) {
+    FlightRecorder recorder(FlightRecorderOptions { .capacity = 8, .threshold_nanoseconds = 1000, .window_before = 4, .window_after = 3 });
+    const Event event { .price = 100, .time = 1, .order_id = 1, .size = 10, .type = EventType::Deletion, .symbol_id = 0 };
+
+    recorder.record(event, 0, 1000000000, 0, 0);
+    recorder.record(event, 0, 1, 0, 0);
+
+    ASSERT_TRUE(recorder.get_snapshots().empty());
+
+    recorder.flush();
+
+    ASSERT_EQ(recorder.get_snapshots().size(), 1U);
+    ASSERT_EQ(recorder.get_snapshots()[0].records.size(), 2U);
+    ASSERT_EQ(recorder.get_snapshots()[0].outlier, 0U);
+
+    EXPECT_THROW(FlightRecorder(FlightRecorderOptions { .capacity = 12 }), std::invalid_argument);
+}
+
+TEST(Stats, FlightRecorderCountsTheRecordingThread) {
+    // Made here but recorded on another thread, like the consumers do.
+    // 消費者と同じように、ここで作って、別のスレッドで記録する。
+    FlightRecorder recorder(FlightRecorderOptions { .capacity = 8, .threshold_nanoseconds = 1000, .window_before = 2, .window_after = 1 });
+    const Event event { .price = 100, .time = 1, .order_id = 1, .size = 10, .type = EventType::Deletion, .symbol_id = 0 };
+
+    std::thread([&] {
+        recorder.record(event, 0, 1, 0, 0);
+        recorder.record(event, 0, 1000000000, 0, 0);
+    }).join();
+
+    recorder.flush();
+
+    // Measured against this thread's counts, they'd have wrapped around.
+    // このスレッドの数と比べたら、一周してしまったはずだ。
+    ASSERT_EQ(recorder.get_snapshots().size(), 1U);
+    EXPECT_LT(recorder.get_snapshots()[0].page_faults, 1000000U);
+    EXPECT_LT(recorder.get_snapshots()[0].context_switches, 1000000U);
+}
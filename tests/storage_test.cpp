@@ -0,0 +1,357 @@
+#include "gtest/gtest.h"
+#include "storage/eventstore.hpp"
+#include "storage/bookhistory.hpp"
+#include "orderbook/orderbook.hpp"
+#include "threads/threads.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+using nanofill::events::Event;
+using nanofill::events::EventType;
+using nanofill::storage::CompressedEventStore;
+using nanofill::storage::BookHistory;
+using nanofill::storage::HistoricalBook;
+using nanofill::orderbook::OrderBook;
+
+namespace {
+
+// A day's worth of events that look like LOBSTER data, plus the odd far away one.
+// LOBSTERのデータらしい一日分のイベントと、時々の遠いもの。
+std::vector<Event> make_events(const std::size_t count) {
+    std::mt19937 random(7);
+    std::vector<Event> events;
+    std::uint32_t time = 34200;
+    std::uint32_t nanoseconds = 0;
+    std::uint32_t price = 2000000;
+    std::uint32_t next_order_id = 1000000;
+
+    for (std::size_t i = 0; i < count; ++i) {
+        const bool next_second = random() % 8 == 0;
+        time += next_second;
+        // Within a second, events come in bursts up to 100us apart.
+        // 一秒の中では、イベントは最大100us間隔でまとまって来る。
+        nanoseconds = next_second ? static_cast<std::uint32_t>(random() % 100000) : nanoseconds + static_cast<std::uint32_t>(random() % 100000);
+        price += (static_cast<int>(random() % 5) - 2) * 100;
+
+        const bool submission = random() % 2 == 0;
+        const bool far_away = random() % 64 == 0;
+
+        events.push_back(Event {
+            .price = far_away ? price + static_cast<std::uint32_t>(random() % 10000) * 100 : price,
+            .time = time,
+            .order_id = submission ? next_order_id++ : next_order_id - 1 - static_cast<std::uint32_t>(random() % (far_away ? 100000 : 50)),
+            .size = static_cast<std::int16_t>((random() % 2 == 0 ? 1 : -1) * static_cast<int>(random() % 5 + 1) * 100),
+            .type = submission ? EventType::Submission : static_cast<EventType>(random() % 4 + 2),
+            .symbol_id = static_cast<std::uint16_t>(i % 3),
+            .nanoseconds = nanoseconds
+        });
+    }
+
+    return events;
+}
+
+// Orders placed around a moving price and later cancelled in part, deleted or executed, so the
+// book always has something on it. Sell cancellations are negative like LOBSTER's.
+// 動く価格の周りに出して、後で一部取り消すか、削除か約定する注文なので、板にいつも何かがある。売りの取消は
+// LOBSTERのようにネガティブだ。
+std::vector<Event> make_book_events(const std::size_t count) {
+    std::mt19937 random(11);
+    std::vector<Event> events;
+    std::vector<Event> resting;
+    std::uint32_t time = 34200;
+    std::uint32_t nanoseconds = 0;
+    std::uint32_t price = 300000;
+    std::uint32_t next_order_id = 1;
+
+    while (events.size() < count) {
+        const bool next_second = random() % 16 == 0;
+        time += next_second;
+        nanoseconds = next_second ? 0 : nanoseconds + static_cast<std::uint32_t>(random() % 1000 + 1) * 1000;
+        price += (static_cast<int>(random() % 3) - 1) * 100;
+
+        if (resting.size() < 200 || random() % 2 == 0) {
+            const int side = random() % 2 == 0 ? 1 : -1;
+            const Event submission {
+                .price = price - side * static_cast<std::uint32_t>(random() % 10 + 1) * 100,
+                .time = time,
+                .order_id = next_order_id++,
+                .size = static_cast<std::int16_t>(side * static_cast<int>(random() % 10 + 1) * 100),
+                .type = EventType::Submission,
+                .symbol_id = 0,
+                .nanoseconds = nanoseconds
+            };
+
+            events.push_back(submission);
+            resting.push_back(submission);
+            continue;
+        }
+
+        const std::size_t which = resting.size() - 1 - random() % std::min<std::size_t>(resting.size(), 50);
+        Event& order = resting[which];
+        Event event = order;
+        event.time = time;
+        event.nanoseconds = nanoseconds;
+
+        if (random() % 3 == 0 && std::abs(order.size) > 100) {
+            event.type = EventType::Cancellation;
+            event.size = order.size > 0 ? 100 : -100;
+            order.size -= event.size;
+        } else {
+            event.type = random() % 4 == 0 ? EventType::ExecutionVisible : EventType::Deletion;
+            std::swap(order, resting.back());
+            resting.pop_back();
+        }
+
+        events.push_back(event);
+    }
+
+    return events;
+}
+
+// Every price the events touch has the same shares in both.
+// イベントが触る全ての価格で、両方の株が同じだ。
+void expect_same_book(const OrderBook& expected, const HistoricalBook& actual, const std::vector<Event>& events) {
+    const auto [lowest, highest] = std::minmax_element(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.price < b.price; });
+    auto level = actual.get_levels().begin();
+
+    for (std::uint32_t price = lowest->price; price <= highest->price; price += 100) {
+        std::uint32_t buy_size = 0;
+        std::uint32_t sell_size = 0;
+
+        if (level != actual.get_levels().end() && level->price == price) {
+            buy_size = level->buy_size;
+            sell_size = level->sell_size;
+            ++level;
+        }
+
+        ASSERT_EQ(buy_size, expected.get_buy_size_for_price(price)) << price << " after " << actual.get_event_count();
+        ASSERT_EQ(sell_size, expected.get_sell_size_for_price(price)) << price << " after " << actual.get_event_count();
+    }
+
+    ASSERT_EQ(level, actual.get_levels().end());
+    ASSERT_EQ(actual.get_best_bid(), expected.get_best_bid());
+    ASSERT_EQ(actual.get_best_ask(), expected.get_best_ask());
+}
+
+void expect_same(const Event& expected, const Event& actual, const std::size_t index) {
+    EXPECT_EQ(expected.price, actual.price) << index;
+    EXPECT_EQ(expected.time, actual.time) << index;
+    EXPECT_EQ(expected.order_id, actual.order_id) << index;
+    EXPECT_EQ(expected.size, actual.size) << index;
+    EXPECT_EQ(expected.type, actual.type) << index;
+    EXPECT_EQ(expected.symbol_id, actual.symbol_id) << index;
+    EXPECT_EQ(expected.nanoseconds, actual.nanoseconds) << index;
+}
+
+}
+
+TEST(Storage, CompressedEventStoreRoundTrips) {
+    const auto events = make_events(CompressedEventStore::block_size * 40 + 17);
+    const CompressedEventStore store(events);
+
+    ASSERT_EQ(store.size(), events.size());
+    ASSERT_EQ(store.block_count(), 41U);
+
+    std::array<Event, CompressedEventStore::block_size> simd;
+    std::array<Event, CompressedEventStore::block_size> scalar;
+
+    for (std::size_t block = 0; block < store.block_count(); ++block) {
+        const std::size_t count = store.decode_block(block, simd.data());
+
+        ASSERT_EQ(count, store.decode_block_scalar(block, scalar.data()));
+        ASSERT_EQ(count, block + 1 == store.block_count() ? 17U : CompressedEventStore::block_size);
+
+        for (std::size_t i = 0; i < count; ++i) {
+            const std::size_t index = block * CompressedEventStore::block_size + i;
+            expect_same(events[index], simd[i], index);
+            expect_same(events[index], scalar[i], index);
+        }
+    }
+
+    expect_same(events[1234], store.get(1234), 1234);
+}
+
+TEST(Storage, CompressedEventStoreHandlesExtremes) {
+    // Differences that need all 32 bits and prices with no common step.
+    // 全32ビットが要る差と、共通の単位がない価格。
+    std::vector<Event> events;
+
+    for (std::uint32_t i = 0; i < CompressedEventStore::block_size; ++i) {
+        events.push_back(Event {
+            .price = i % 2 == 0 ? 0xFFFFFFFFU - i : i * 7,
+            .time = i % 3 == 0 ? 0 : 0xFFFFFFFFU,
+            .order_id = i * 0x9E3779B9U,
+            .size = static_cast<std::int16_t>(i % 2 == 0 ? -32768 : 32767),
+            .type = EventType::ExecutionHidden,
+            .symbol_id = 65535,
+            .nanoseconds = i % 2 == 0 ? 0 : 999999999U
+        });
+    }
+
+    const CompressedEventStore store(events);
+    std::array<Event, CompressedEventStore::block_size> decoded;
+
+    ASSERT_EQ(store.decode_block(0, decoded.data()), CompressedEventStore::block_size);
+
+    for (std::size_t i = 0; i < events.size(); ++i) {
+        expect_same(events[i], decoded[i], i);
+    }
+}
+
+TEST(Storage, CompressedEventStoreCompresses) {
+    const auto events = make_events(100000);
+    const CompressedEventStore store(events);
+
+    EXPECT_GE(store.compression_ratio(), 4);
+}
+
+TEST(Storage, CompressedEventStoreSeeksByTime) {
+    const auto events = make_events(CompressedEventStore::block_size * 20 + 5);
+    const CompressedEventStore store(events);
+    std::array<Event, CompressedEventStore::block_size> decoded;
+
+    for (const std::uint32_t time : { events.front().time, events[700].time, events[2000].time, events.back().time }) {
+        // Start from the block it gives and the first event at or after the time must be found
+        // before passing it.
+        // 返されたブロックから始めて、その時以降の最初のイベントを通り過ぎる前に見つけなければならない。
+        const auto first = std::find_if(events.begin(), events.end(), [&](const Event& event) { return event.time >= time; });
+        const std::size_t block = store.find_block_for_time(time);
+
+        ASSERT_LE(block * CompressedEventStore::block_size, static_cast<std::size_t>(first - events.begin()));
+
+        store.decode_block(block, decoded.data());
+        EXPECT_TRUE(decoded[0].time <= time);
+    }
+
+    EXPECT_EQ(store.find_block_for_time(0), 0U);
+    EXPECT_EQ(store.find_block_for_time(0xFFFFFFFFU), store.block_count() - 1);
+}
+
+TEST(Storage, CompressedEventStoreFeedsTheRing) {
+    const auto events = make_events(CompressedEventStore::block_size * 30 + 9);
+    const CompressedEventStore store(events);
+    auto buffer = std::make_unique<nanofill::concurrency::SPSCRingBuffer<Event, 1024>>();
+
+    std::thread producer(nanofill::threads::store_producer<1024>, std::ref(*buffer), std::cref(store));
+
+    // Everything comes out in order, however the producer and consumer interleave.
+    // 生産者と消費者がどう交互になっても、全部が順番に出てくる。
+    for (std::size_t i = 0; i < events.size(); ++i) {
+        Event event;
+
+        while (!buffer->pop(event)) {}
+
+        expect_same(events[i], event, i);
+    }
+
+    producer.join();
+
+    Event extra;
+    EXPECT_FALSE(buffer->pop(extra));
+}
+
+TEST(Storage, BookHistoryMatchesTheBook) {
+    const auto events = make_book_events(20000);
+    const CompressedEventStore store(events);
+    const BookHistory history(store, 1000);
+    HistoricalBook book;
+    auto order_book = std::make_unique<OrderBook>();
+    std::size_t applied = 0;
+
+    // Rounded up to whole blocks.
+    // ブロックの整数倍に切り上げる。
+    ASSERT_EQ(history.get_checkpoint_interval(), 1024U);
+    ASSERT_EQ(history.get_checkpoint_count(), events.size() / 1024 + 1);
+
+    // Right on checkpoints, either side of them and in between.
+    // ちょうどチェックポイントで、その両側で、その間で。
+    for (const std::size_t count : { 0, 1, 1023, 1024, 1025, 5000, 8192, 12345, 19999, 20000 }) {
+        while (applied < count) {
+            order_book->process_event(events[applied++]);
+        }
+
+        history.at_event(count, book);
+        ASSERT_EQ(book.get_event_count(), count);
+        expect_same_book(*order_book, book, events);
+    }
+
+    ASSERT_FALSE(book.get_levels().empty());
+    ASSERT_TRUE(std::is_sorted(book.get_orders().begin(), book.get_orders().end(), [](const auto& a, const auto& b) {
+        return a.price != b.price ? a.price < b.price : a.order_id < b.order_id;
+    }));
+
+    // Past the end is the end.
+    // 終わりを過ぎたら終わりだ。
+    history.at_event(events.size() + 10, book);
+    ASSERT_EQ(book.get_event_count(), events.size());
+}
+
+TEST(Storage, BookHistoryByTime) {
+    const auto events = make_book_events(20000);
+    const CompressedEventStore store(events);
+    const BookHistory history(store, 512);
+    HistoricalBook book;
+    auto order_book = std::make_unique<OrderBook>();
+    std::size_t applied = 0;
+
+    for (const std::uint32_t time : { events[0].time, events[700].time, events[4096].time + 1, events[15000].time, events.back().time + 100 }) {
+        // Every event at or before the time, and nothing after it.
+        // その時以前の全てのイベントで、その後のものは何もない。
+        while (applied < events.size() && events[applied].time <= time) {
+            order_book->process_event(events[applied++]);
+        }
+
+        history.at_time(time, book);
+        ASSERT_EQ(book.get_time(), time);
+        ASSERT_EQ(book.get_event_count(), applied);
+        expect_same_book(*order_book, book, events);
+    }
+
+    // Before anything happened.
+    // 何か起きる前。
+    history.at_time(0, book);
+    ASSERT_EQ(book.get_event_count(), 0U);
+    ASSERT_TRUE(book.get_levels().empty());
+    ASSERT_EQ(book.get_best_bid(), 0U);
+}
+
+TEST(Storage, BookHistoryWithinASecond) {
+    using nanofill::events::time_in_nanoseconds;
+
+    const auto events = make_book_events(20000);
+    const CompressedEventStore store(events);
+    const BookHistory history(store, 512);
+    HistoricalBook book;
+    auto order_book = std::make_unique<OrderBook>();
+    std::size_t applied = 0;
+
+    // Right on an event, just before the next one, and in the middle of a second.
+    // ちょうどイベントで、次のものの直前で、一秒の途中で。
+    for (const std::size_t index : { 10, 700, 4095, 4096, 15000 }) {
+        for (const std::uint64_t until : { time_in_nanoseconds(events[index]), time_in_nanoseconds(events[index + 1]) - 1 }) {
+            while (applied < events.size() && time_in_nanoseconds(events[applied]) <= until) {
+                order_book->process_event(events[applied++]);
+            }
+
+            const auto time = static_cast<std::uint32_t>(until / nanofill::events::nanoseconds_per_second);
+            const auto nanoseconds = static_cast<std::uint32_t>(until % nanofill::events::nanoseconds_per_second);
+
+            history.at_time(time, nanoseconds, book);
+            ASSERT_EQ(book.get_time(), time);
+            ASSERT_EQ(book.get_nanoseconds(), nanoseconds);
+            ASSERT_EQ(book.get_event_count(), applied);
+            expect_same_book(*order_book, book, events);
+        }
+    }
+
+    // A whole second takes in everything in it.
+    // 秒だけなら、その中の全てを含む。
+    history.at_time(events[15000].time, book);
+    ASSERT_GE(book.get_event_count(), applied);
+    ASSERT_EQ(events[book.get_event_count() - 1].time, events[15000].time);
+    ASSERT_GT(events[book.get_event_count()].time, events[15000].time);
+}
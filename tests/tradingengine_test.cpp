@@ -1,9 +1,33 @@
 #include "gtest/gtest.h"
 #include "tradingengine/tradingengine.hpp"
+#include "tradingengine/strategy.hpp"
+#include "tradingengine/parametersweep.hpp"
+#include "tradingengine/bookfeatures.hpp"
+#include "tradingengine/bars.hpp"
+#include "orderbook/orderbook.hpp"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
 
 using nanofill::events::Event;
 using nanofill::events::EventType;
 using nanofill::tradingengine::TradingEngine;
+using nanofill::tradingengine::BookMidStrategy;
+using nanofill::tradingengine::BookFeatures;
+using nanofill::tradingengine::MicropriceStrategy;
+using nanofill::tradingengine::Bar;
+using nanofill::tradingengine::BarAggregator;
+using nanofill::tradingengine::BarBuilder;
+using nanofill::tradingengine::BarKind;
+using nanofill::tradingengine::BarRing;
+using nanofill::tradingengine::StrategySet;
+using nanofill::tradingengine::ParameterSweep;
+using nanofill::tradingengine::SweepParameters;
+using nanofill::tradingengine::SweepResult;
+using nanofill::orderbook::OrderBook;
 
 TEST(TradingEngine, ProcessAllEvents) {
     auto trading_engine = TradingEngine(20);
@@ -166,4 +190,393 @@ TEST(TradingEngine, DoesntCrashWhenSharesReachZero) {
     trading_engine.process_event(deletion_event);
 
     ASSERT_EQ(0U, trading_engine.market_shares);
-}
\ No newline at end of file
+}
+
+TEST(TradingEngine, BookMidStrategy) {
+    auto order_book = std::make_unique<OrderBook>();
+    BookMidStrategy strategy(5);
+
+    Event buy { .price = 100, .time = 1, .order_id = 1, .size = 10, .type = EventType::Submission };
+    Event sell { .price = 120, .time = 2, .order_id = 2, .size = -10, .type = EventType::Submission };
+
+    ASSERT_TRUE(order_book->process_event(buy));
+    strategy.on_event(buy, *order_book);
+
+    // Only one side of the book, so no quote.
+    ASSERT_EQ(0U, strategy.target_buy_price);
+    ASSERT_EQ(0U, strategy.target_sell_price);
+
+    ASSERT_TRUE(order_book->process_event(sell));
+    strategy.on_event(sell, *order_book);
+
+    ASSERT_EQ(105U, strategy.target_buy_price);
+    ASSERT_EQ(115U, strategy.target_sell_price);
+}
+
+TEST(TradingEngine, BookFeaturesMatchTheBook) {
+    auto order_book = std::make_unique<OrderBook>();
+    BookFeatures<8, 16> features;
+    std::mt19937 random(7);
+    std::vector<Event> live;
+    std::vector<std::int64_t> flows;
+    std::uint32_t previous_bid = 0;
+    std::uint32_t previous_ask = 0;
+    std::uint32_t previous_bid_size = 0;
+    std::uint32_t previous_ask_size = 0;
+
+    // The top levels of one side, worked out the slow way.
+    auto top_levels = [&](const bool bids) {
+        std::vector<std::pair<double, double>> levels;
+        const std::uint32_t best = bids ? order_book->get_best_bid() : order_book->get_best_ask();
+
+        for (std::uint32_t price = best; best != 0 && levels.size() < 8 && price > 0 && price < 3000; bids ? --price : ++price) {
+            const std::uint32_t size = bids ? order_book->get_buy_size_for_price(price) : order_book->get_sell_size_for_price(price);
+
+            if (size != 0) {
+                levels.emplace_back(price, size);
+            }
+        }
+
+        return levels;
+    };
+
+    for (std::uint32_t i = 0; i < 20000; ++i) {
+        Event event;
+
+        // Adds either side of 2000 and deletions of random live orders.
+        if (live.empty() || random() % 3 != 0) {
+            const bool buy = random() % 2 == 0;
+            const std::uint32_t price = buy ? 1990 - random() % 30 + 5 : 2010 + random() % 30 - 5;
+            event = { .price = price, .time = i, .order_id = i + 1, .size = static_cast<std::int16_t>((buy ? 1 : -1) * (random() % 500 + 1)),
+                .type = EventType::Submission, .symbol_id = 0 };
+            live.push_back(event);
+        } else {
+            const std::size_t index = random() % live.size();
+            event = live[index];
+            event.type = EventType::Deletion;
+            live[index] = live.back();
+            live.pop_back();
+        }
+
+        ASSERT_TRUE(order_book->process_event(event));
+        features.on_event(event, *order_book);
+
+        const std::uint32_t bid = order_book->get_best_bid();
+        const std::uint32_t ask = order_book->get_best_ask();
+        const std::uint32_t bid_size = bid != 0 ? order_book->get_buy_size_for_price(bid) : 0;
+        const std::uint32_t ask_size = ask != 0 ? order_book->get_sell_size_for_price(ask) : 0;
+        const std::uint32_t ask_rank = ask == 0 ? UINT32_MAX : ask;
+        const std::uint32_t previous_ask_rank = previous_ask == 0 ? UINT32_MAX : previous_ask;
+        std::int64_t flow = 0;
+
+        flow += bid >= previous_bid ? bid_size : 0;
+        flow -= bid <= previous_bid ? previous_bid_size : 0;
+        flow -= ask_rank <= previous_ask_rank ? ask_size : 0;
+        flow += ask_rank >= previous_ask_rank ? previous_ask_size : 0;
+        flows.push_back(flow);
+        previous_bid = bid;
+        previous_ask = ask;
+        previous_bid_size = bid_size;
+        previous_ask_size = ask_size;
+
+        const auto bids = top_levels(true);
+        const auto asks = top_levels(false);
+        double bid_depth = 0;
+        double ask_depth = 0;
+        double bid_notional = 0;
+        double ask_notional = 0;
+
+        for (const auto& [price, size] : bids) {
+            bid_depth += size;
+            bid_notional += price * size;
+        }
+
+        for (const auto& [price, size] : asks) {
+            ask_depth += size;
+            ask_notional += price * size;
+        }
+
+        const auto& values = features.get();
+        const std::size_t window_start = flows.size() > 16 ? flows.size() - 16 : 0;
+
+        ASSERT_EQ(values.bid_depth, bid_depth) << "after event " << i;
+        ASSERT_EQ(values.ask_depth, ask_depth) << "after event " << i;
+        ASSERT_EQ(values.order_flow_imbalance, std::accumulate(flows.begin() + window_start, flows.end(), std::int64_t{0})) << "after event " << i;
+
+        if (bids.empty() || asks.empty()) {
+            ASSERT_EQ(values.microprice, 0);
+            ASSERT_EQ(values.weighted_mid, 0);
+            continue;
+        }
+
+        const double microprice = (bids[0].first * asks[0].second + asks[0].first * bids[0].second) / (bids[0].second + asks[0].second);
+        const double weighted_mid = (bid_notional / bid_depth * ask_depth + ask_notional / ask_depth * bid_depth) / (bid_depth + ask_depth);
+
+        ASSERT_NEAR(values.imbalance, (bid_depth - ask_depth) / (bid_depth + ask_depth), 1e-5);
+        ASSERT_NEAR(values.microprice, microprice, 0.01);
+        ASSERT_NEAR(values.weighted_mid, weighted_mid, 0.01);
+    }
+}
+
+TEST(TradingEngine, BookFeaturesFindFarLevels) {
+    auto order_book = std::make_unique<OrderBook>();
+    BookFeatures<> features;
+
+    // Tens of thousands of empty prices between the levels on each side.
+    const std::vector<Event> events {
+        { .price = 100000, .time = 1, .order_id = 1, .size = 10, .type = EventType::Submission, .symbol_id = 0 },
+        { .price = 10000, .time = 1, .order_id = 2, .size = 20, .type = EventType::Submission, .symbol_id = 0 },
+        { .price = 100010, .time = 1, .order_id = 3, .size = -30, .type = EventType::Submission, .symbol_id = 0 },
+        { .price = 400000, .time = 1, .order_id = 4, .size = -40, .type = EventType::Submission, .symbol_id = 0 },
+    };
+
+    for (const Event& event : events) {
+        ASSERT_TRUE(order_book->process_event(event));
+        features.on_event(event, *order_book);
+    }
+
+    ASSERT_EQ(features.get().bid_depth, 30);
+    ASSERT_EQ(features.get().ask_depth, 70);
+
+    // Emptying the best level on each side leaves only the far ones.
+    const Event bid_deletion { .price = 100000, .time = 2, .order_id = 1, .size = 10, .type = EventType::Deletion, .symbol_id = 0 };
+    const Event ask_deletion { .price = 100010, .time = 2, .order_id = 3, .size = -30, .type = EventType::Deletion, .symbol_id = 0 };
+
+    ASSERT_TRUE(order_book->process_event(bid_deletion));
+    features.on_event(bid_deletion, *order_book);
+    ASSERT_TRUE(order_book->process_event(ask_deletion));
+    features.on_event(ask_deletion, *order_book);
+
+    ASSERT_EQ(features.get().bid_depth, 20);
+    ASSERT_EQ(features.get().ask_depth, 40);
+    ASSERT_NEAR(features.get().microprice, (10000.0 * 40 + 400000.0 * 20) / 60, 0.1);
+}
+
+TEST(TradingEngine, MicropriceStrategy) {
+    auto order_book = std::make_unique<OrderBook>();
+    MicropriceStrategy strategy(5);
+
+    Event buy { .price = 100, .time = 1, .order_id = 1, .size = 30, .type = EventType::Submission };
+    Event sell { .price = 120, .time = 2, .order_id = 2, .size = -10, .type = EventType::Submission };
+
+    ASSERT_TRUE(order_book->process_event(buy));
+    strategy.on_event(buy, *order_book);
+    ASSERT_EQ(0U, strategy.target_buy_price);
+
+    ASSERT_TRUE(order_book->process_event(sell));
+    strategy.on_event(sell, *order_book);
+
+    // Three times as many shares bid as offered, so the microprice is three quarters of the way up.
+    ASSERT_EQ(110U, strategy.target_buy_price);
+    ASSERT_EQ(120U, strategy.target_sell_price);
+    ASSERT_FLOAT_EQ(0.5F, strategy.get_features().imbalance);
+}
+
+TEST(TradingEngine, TimeBars) {
+    BarBuilder builder(BarKind::Time, 60);
+    std::vector<Bar> bars;
+    const auto publish = [&bars](const Bar& bar) { bars.push_back(bar); };
+
+    builder.on_execution(1000, 100, 34210, publish);
+    builder.on_execution(1200, 300, 34230, publish);
+    builder.on_execution(900, 100, 34259, publish);
+    ASSERT_TRUE(bars.empty());
+
+    // Nothing happens between 34260 and 34380, so the next bar starts at 34380.
+    // 34260から34380まで何も起きないので、次のバーは34380から始まる。
+    builder.on_execution(1100, 50, 34400, publish);
+    ASSERT_EQ(bars.size(), 1U);
+
+    const Bar& first = bars[0];
+    ASSERT_EQ(first.kind, BarKind::Time);
+    ASSERT_EQ(first.interval, 60U);
+    ASSERT_EQ(first.start_time, 34200U);
+    ASSERT_EQ(first.end_time, 34259U);
+    ASSERT_EQ(first.open, 1000U);
+    ASSERT_EQ(first.high, 1200U);
+    ASSERT_EQ(first.low, 900U);
+    ASSERT_EQ(first.close, 900U);
+    ASSERT_EQ(first.executions, 3U);
+    ASSERT_EQ(first.volume, 500U);
+    ASSERT_EQ(first.notional, 100000U + 360000U + 90000U);
+    ASSERT_EQ(first.vwap, 1100U);
+
+    builder.flush(publish);
+    ASSERT_EQ(bars.size(), 2U);
+    ASSERT_EQ(bars[1].start_time, 34380U);
+    ASSERT_EQ(bars[1].open, 1100U);
+    ASSERT_EQ(bars[1].close, 1100U);
+    ASSERT_EQ(bars[1].volume, 50U);
+
+    // Nothing is left to flush.
+    // 出すものはもう残っていない。
+    builder.flush(publish);
+    ASSERT_EQ(bars.size(), 2U);
+}
+
+TEST(TradingEngine, VolumeBars) {
+    BarBuilder builder(BarKind::Volume, 1000);
+    std::vector<Bar> bars;
+    const auto publish = [&bars](const Bar& bar) { bars.push_back(bar); };
+
+    builder.on_execution(1000, 400, 34200, publish);
+    builder.on_execution(1010, 500, 34201, publish);
+    ASSERT_TRUE(bars.empty());
+
+    // Takes it over 1000 shares, and isn't split.
+    // 1000株を超えさせて、分けない。
+    builder.on_execution(1020, 300, 34205, publish);
+    ASSERT_EQ(bars.size(), 1U);
+    ASSERT_EQ(bars[0].start_time, 34200U);
+    ASSERT_EQ(bars[0].end_time, 34205U);
+    ASSERT_EQ(bars[0].volume, 1200U);
+    ASSERT_EQ(bars[0].high, 1020U);
+    ASSERT_EQ(bars[0].low, 1000U);
+
+    builder.on_execution(1030, 1000, 34300, publish);
+    ASSERT_EQ(bars.size(), 2U);
+    ASSERT_EQ(bars[1].start_time, 34300U);
+    ASSERT_EQ(bars[1].open, 1030U);
+    ASSERT_EQ(bars[1].volume, 1000U);
+}
+
+TEST(TradingEngine, BarAggregator) {
+    auto ring = std::make_unique<BarRing>();
+    BarAggregator aggregator(*ring, 150);
+
+    aggregator.on_event(Event { .price = 1000, .time = 34200, .order_id = 1, .size = 100, .type = EventType::Submission, .symbol_id = 0 });
+    aggregator.on_event(Event { .price = 1000, .time = 34200, .order_id = 1, .size = 100, .type = EventType::ExecutionVisible, .symbol_id = 0 });
+    aggregator.on_event(Event { .price = 1010, .time = 34201, .order_id = 2, .size = 100, .type = EventType::ExecutionHidden, .symbol_id = 0 });
+
+    Bar bar;
+
+    // The second bar from 34200 and the volume bar, which the hidden execution closed.
+    // 34200からの秒のバーと、見えない約定が閉じた出来高のバー。
+    ASSERT_TRUE(ring->pop(bar));
+    ASSERT_EQ(bar.kind, BarKind::Time);
+    ASSERT_EQ(bar.interval, 1U);
+    ASSERT_EQ(bar.volume, 100U);
+    ASSERT_TRUE(ring->pop(bar));
+    ASSERT_EQ(bar.kind, BarKind::Volume);
+    ASSERT_EQ(bar.volume, 200U);
+    ASSERT_EQ(bar.vwap, 1005U);
+    ASSERT_FALSE(ring->pop(bar));
+
+    aggregator.flush();
+    ASSERT_TRUE(ring->pop(bar));
+    ASSERT_EQ(bar.interval, 1U);
+    ASSERT_EQ(bar.start_time, 34201U);
+    ASSERT_TRUE(ring->pop(bar));
+    ASSERT_EQ(bar.interval, 60U);
+    ASSERT_EQ(bar.volume, 200U);
+    ASSERT_FALSE(ring->pop(bar));
+    ASSERT_EQ(aggregator.get_dropped(), 0U);
+}
+
+TEST(TradingEngine, StrategySet) {
+    auto order_book = std::make_unique<OrderBook>();
+    StrategySet<TradingEngine, BookMidStrategy> strategies(TradingEngine(20), BookMidStrategy(5));
+
+    Event buy { .price = 100, .time = 1, .order_id = 1, .size = 10, .type = EventType::Submission };
+    Event sell { .price = 120, .time = 2, .order_id = 2, .size = -10, .type = EventType::Submission };
+
+    ASSERT_TRUE(strategies.is_enabled("average_price"));
+    ASSERT_TRUE(strategies.is_enabled("book_mid"));
+
+    ASSERT_TRUE(order_book->process_event(buy));
+    strategies.on_event(buy, *order_book);
+    ASSERT_TRUE(order_book->process_event(sell));
+    strategies.on_event(sell, *order_book);
+
+    // Both strategies saw both events.
+    ASSERT_EQ(110U, strategies.get<TradingEngine>().average_share_price);
+    ASSERT_EQ(115U, strategies.get<BookMidStrategy>().target_sell_price);
+
+    // Unknown names leave the selection alone.
+    ASSERT_FALSE(strategies.select("book_mid,nonsense"));
+    ASSERT_TRUE(strategies.is_enabled("average_price"));
+
+    ASSERT_TRUE(strategies.select("average_price"));
+    ASSERT_TRUE(strategies.is_enabled("average_price"));
+    ASSERT_FALSE(strategies.is_enabled("book_mid"));
+
+    Event deletion { .price = 120, .time = 3, .order_id = 2, .size = 10, .type = EventType::Deletion };
+
+    ASSERT_TRUE(order_book->process_event(deletion));
+    strategies.on_event(deletion, *order_book);
+
+    // Only the average price strategy saw the deletion.
+    ASSERT_EQ(100U, strategies.get<TradingEngine>().average_share_price);
+    ASSERT_EQ(115U, strategies.get<BookMidStrategy>().target_sell_price);
+}
+
+TEST(TradingEngine, ParameterSweep) {
+    const std::vector<Event> events {
+        { .price = 100, .time = 1, .order_id = 1, .size = 50, .type = EventType::Submission, .symbol_id = 0 },
+        { .price = 120, .time = 2, .order_id = 2, .size = -50, .type = EventType::Submission, .symbol_id = 0 },
+        // Average is 110. A resting buy at 100 executes, so someone sold at 100.
+        { .price = 100, .time = 3, .order_id = 1, .size = 20, .type = EventType::ExecutionVisible, .symbol_id = 0 },
+        // Average is now (3000 + 6000) / 80 = 112. A resting sell at 120 executes.
+        { .price = 120, .time = 4, .order_id = 2, .size = -30, .type = EventType::ExecutionVisible, .symbol_id = 0 },
+    };
+
+    const std::vector<SweepParameters> parameters {
+        { .price_spread = 5, .quote_size = 10 },
+        { .price_spread = 10, .quote_size = 10 },
+        { .price_spread = 10, .quote_size = 100 },
+        { .price_spread = 8, .quote_size = 25 },
+        { .price_spread = 200, .quote_size = 10 },
+    };
+
+    ParameterSweep sweep(parameters);
+    sweep.process_events(events);
+    const std::vector<SweepResult> results = sweep.get_results();
+
+    ASSERT_EQ(5U, results.size());
+
+    // Bid 105 buys 10 at 105, then ask 117 sells them at 117.
+    ASSERT_EQ(2U, results[0].fills);
+    ASSERT_EQ(0, results[0].position);
+    ASSERT_EQ(120, results[0].cash);
+    ASSERT_EQ(120, results[0].profit);
+
+    // Bid 100 buys 10 at 100, then ask 122 isn't reached.
+    ASSERT_EQ(1U, results[1].fills);
+    ASSERT_EQ(10, results[1].position);
+    ASSERT_EQ(-1000, results[1].cash);
+    ASSERT_EQ(200, results[1].profit);
+
+    // Fills are capped at the executed size.
+    ASSERT_EQ(20, results[2].position);
+    ASSERT_EQ(-2000, results[2].cash);
+
+    // Bid 102 buys 20, then ask 120 sells 25.
+    ASSERT_EQ(2U, results[3].fills);
+    ASSERT_EQ(-5, results[3].position);
+    ASSERT_EQ(-2040 + 3000, results[3].cash);
+    ASSERT_EQ(360, results[3].profit);
+
+    // Bid of 0 and an ask far away.
+    ASSERT_EQ(0U, results[4].fills);
+
+    // Splitting over threads gives the same answers in the same order.
+    const auto threaded = nanofill::tradingengine::run_parameter_sweep(events, parameters, 3);
+
+    ASSERT_EQ(results.size(), threaded.size());
+
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        ASSERT_EQ(results[i].parameters.price_spread, threaded[i].parameters.price_spread);
+        ASSERT_EQ(results[i].parameters.quote_size, threaded[i].parameters.quote_size);
+        ASSERT_EQ(results[i].position, threaded[i].position);
+        ASSERT_EQ(results[i].cash, threaded[i].cash);
+    }
+
+    // Hidden executions aren't actioned by the order book, so they never fill a quote.
+    ParameterSweep hidden_sweep(parameters);
+    hidden_sweep.process_events(std::span(events).first(2));
+    hidden_sweep.process_event({ .price = 100, .time = 3, .order_id = 9, .size = 20, .type = EventType::ExecutionHidden, .symbol_id = 0 });
+
+    for (const SweepResult& result : hidden_sweep.get_results()) {
+        ASSERT_EQ(0U, result.fills);
+    }
+}